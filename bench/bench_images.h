@@ -0,0 +1,130 @@
+#ifndef _BENCH_IMAGES_H_
+#define _BENCH_IMAGES_H_
+
+#include "../src/asi_image.h"
+#include <math.h>
+
+/* Octaves of the value noise of natural-image-like textures */
+#define BENCH_OCTAVES 6
+
+/* Synthetic test images */
+typedef enum bench_pattern
+{
+    BENCH_GRADIENT, /* Smooth diagonal ramp */
+    BENCH_NOISE, /* Uniform white noise */
+    BENCH_TEXTURE, /* Fractal value noise with sharp edges */
+    BENCH_NUM_PATTERNS
+} bench_pattern_enum;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Hash of a lattice point of the value noise, uniform in [0, 1).
+ * @x, y    [ I ] Lattice coordinates
+ * @octave  [ I ] Octave of the lattice
+ */
+static double bench_hash(int x, int y, int octave)
+{
+    unsigned int h; /* Hash value */
+
+    h = (unsigned int) x * 374761393u + (unsigned int) y * 668265263u
+        + (unsigned int) octave * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    h ^= h >> 16;
+
+    return (h & 0xffffff) / 16777216.0;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Smoothly interpolated value noise at a point.
+ * @x, y    [ I ] Position in lattice units
+ * @octave  [ I ] Octave of the lattice
+ */
+static double bench_value_noise(double x, double y, int octave)
+{
+    int ix, iy; /* Lattice cell */
+    double fx, fy; /* Smoothed position within the cell */
+
+    ix = (int) floor(x);
+    iy = (int) floor(y);
+    fx = x - ix;
+    fy = y - iy;
+    fx = fx * fx * (3.0 - 2.0 * fx);
+    fy = fy * fy * (3.0 - 2.0 * fy);
+
+    return (1.0 - fy) * ((1.0 - fx) * bench_hash(ix, iy, octave)
+            + fx * bench_hash(ix + 1, iy, octave))
+        + fy * ((1.0 - fx) * bench_hash(ix, iy + 1, octave)
+            + fx * bench_hash(ix + 1, iy + 1, octave));
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Generates an integer-valued synthetic test image with grey values in
+ * [0, 255]. Textures sum octaves of value noise with amplitudes halving per
+ * octave, which mimics the decaying spectrum of natural images, and add
+ * piecewise constant regions whose edges stress mask selection.
+ * @image   [ O ] Generated image
+ * @size    [ I ] Edge length
+ * @pattern [ I ] Synthetic pattern
+ */
+static int bench_generate(image_type *image, int size,
+        bench_pattern_enum pattern)
+{
+    unsigned int state = 2463534242u; /* Xorshift state of the noise */
+    double v, amplitude, scale; /* Value, octave amplitude and frequency */
+    int i, j, o; /* Loop variables */
+    int ret; /* Return value */
+
+    ret = image_init(image, size, size, ASI_DTYPE_INT);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        for (j = 0; j < size; j++)
+        {
+            if (pattern == BENCH_GRADIENT)
+            {
+                v = 255.0 * (i + j) / (2.0 * size - 2.0 + (size == 1));
+            }
+            else if (pattern == BENCH_NOISE)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                v = state % 256;
+            }
+            else
+            {
+                v = 0.0;
+                amplitude = 0.5;
+                scale = 8.0 / size;
+
+                for (o = 0; o < BENCH_OCTAVES; o++)
+                {
+                    v += amplitude * bench_value_noise(j * scale, i * scale,
+                            o);
+                    amplitude *= 0.5;
+                    scale *= 2.0;
+                }
+
+                /* Regions of the coarsest octave with a sharp boundary */
+                v = 160.0 * v + (bench_value_noise(j * 4.0 / size,
+                            i * 4.0 / size, BENCH_OCTAVES) > 0.5 ? 64.0 : 0.0);
+            }
+
+            image_put(*image, (int) (v > 255.0 ? 255.0 : v), i, j);
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+#endif
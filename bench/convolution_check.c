@@ -0,0 +1,199 @@
+#include "../src/asi_convolution.h"
+#include "../src/asi_metrics.h"
+#include "../src/asi_scheduler.h"
+#include "../src/asi_telemetry.h"
+#include "bench_images.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Accuracy of the reference FIR kernels in standard deviations */
+#define CHECK_FIR_ACCURACY 4.0
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Smooths a copy of an image and measures the time of the convolution.
+ * @image   [ I ] Double-valued image
+ * @result  [ O ] Smoothed image, initialised beforehand
+ * @kernel  [ I ] Convolution kernel
+ * @sched   [I/O] Task scheduler
+ * @seconds [ O ] Time of the convolution
+ */
+static int check_smooth(const image_type image, image_type result,
+        const kernel_type kernel, scheduler_type *sched, double *seconds)
+{
+    double start; /* Timing */
+    int ret; /* Return value */
+
+    memcpy(result.data, image.data, (size_t) image.width * image.height
+            * sizeof(double));
+
+    start = telemetry_time();
+    ret = image_convolve_parallel(result, kernel, sched);
+    *seconds = telemetry_time() - start;
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Prints the command line usage.
+ * @name    [ I ] Program name
+ */
+static void check_usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s size] [-g sigmas] [-t threads] "
+            "[-p min_psnr] [-a max_abs]\n"
+            "  -s  edge length of the synthetic texture, default 1024\n"
+            "  -g  comma-separated standard deviations, default "
+            "1,2,4,8,16,32\n"
+            "  -t  number of threads, default all cores\n"
+            "  -p, -a  tolerances of PSNR and largest difference against "
+            "the FIR\n      Gaussian, negative to disable\n", name);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Accuracy check of the recursive Gaussian: a synthetic texture is smoothed
+ * with the recursive and the FIR Gaussian for several standard deviations,
+ * and the results are compared. Prints one CSV row per standard deviation
+ * with the times of both filters and the metrics of the difference, and
+ * exits with a non-zero status if any is out of tolerance.
+ */
+int main(int argc, char **argv)
+{
+    metrics_tolerance_type tol; /* Tolerances */
+    metrics_report_type report; /* Metrics against the FIR Gaussian */
+    scheduler_type sched; /* Scheduler of convolutions and metrics */
+    kernel_type fir, iir; /* Convolution kernels */
+    image_type image, image_f, reference, result; /* Images */
+    char sigmas[256] = "1,2,4,8,16,32"; /* Standard deviations */
+    char *token; /* Current standard deviation */
+    double sigma; /* Standard deviation */
+    double fir_seconds, iir_seconds; /* Timing */
+    int size = 1024; /* Edge length of the synthetic image */
+    int threads = 0; /* Number of threads */
+    int failed = 0; /* Number of results out of tolerance */
+    int opt; /* Option */
+    int ret; /* Return value */
+
+    tol.max_mse = -1.0;
+    tol.min_psnr = 40.0;
+    tol.min_ssim = -1.0;
+    tol.max_abs = 4.0;
+
+    while ((opt = getopt(argc, argv, "s:g:t:p:a:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'g':
+                snprintf(sigmas, sizeof(sigmas), "%s", optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'p':
+                tol.min_psnr = atof(optarg);
+                break;
+            case 'a':
+                tol.max_abs = atof(optarg);
+                break;
+            default:
+                check_usage(argv[0]);
+                return ASI_EXIT_INVALID_ARG_COUNT;
+        }
+    }
+
+    ret = size > 0 ? bench_generate(&image, size, BENCH_TEXTURE)
+        : ASI_EXIT_INVALID_VALUE;
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error generating image: Error code %d\n", ret);
+        return ret;
+    }
+
+    image_init(&image_f, image.width, image.height, ASI_DTYPE_DOUBLE);
+    image_copy(image, image_f);
+    image_delete(&image);
+
+    ret = scheduler_init(&sched, threads);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error starting threads: Error code %d\n", ret);
+        return ret;
+    }
+
+    image_init(&reference, image.width, image.height, ASI_DTYPE_DOUBLE);
+    image_init(&result, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    printf("sigma,fir_seconds,iir_seconds,mse,psnr,max_abs,status\n");
+
+    for (token = strtok(sigmas, ","); token != NULL;
+            token = strtok(NULL, ","))
+    {
+        sigma = atof(token);
+
+        ret = kernel_init(&fir, ASI_GAUSSIAN, 2, sigma, CHECK_FIR_ACCURACY);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Error creating kernel: Error code %d\n", ret);
+            return ret;
+        }
+
+        ret = kernel_init(&iir, ASI_RECURSIVE_GAUSSIAN, 1, sigma);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Error creating kernel: Error code %d\n", ret);
+            return ret;
+        }
+
+        ret = check_smooth(image_f, reference, fir, &sched, &fir_seconds);
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = check_smooth(image_f, result, iir, &sched, &iir_seconds);
+        }
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Error during convolution: Error code %d\n", ret);
+            return ret;
+        }
+
+        kernel_delete(&fir);
+        kernel_delete(&iir);
+
+        ret = image_compare(reference, result, 255.0, tol, &report, &sched);
+
+        if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_OUT_OF_TOLERANCE)
+        {
+            fprintf(stderr, "Error during comparison: Error code %d\n", ret);
+            return ret;
+        }
+
+        printf("%g,%.6f,%.6f,%.6e,%.3f,%.6e,%s\n", sigma, fir_seconds,
+                iir_seconds, report.mse, report.psnr, report.max_abs,
+                ret == ASI_EXIT_SUCCESS ? "pass" : "fail");
+        failed += ret != ASI_EXIT_SUCCESS;
+    }
+
+    scheduler_delete(&sched);
+    image_delete(&image_f);
+    image_delete(&reference);
+    image_delete(&result);
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,683 @@
+#include "../src/asi_io.h"
+#include "../src/asi_mask.h"
+#include "../src/asi_maskopt.h"
+#include "../src/asi_convolution.h"
+#include "../src/asi_multigrid.h"
+#include "../src/asi_scheduler.h"
+#include "../src/asi_telemetry.h"
+#include "bench_images.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/* Largest number of values of a list option */
+#define BENCH_MAX_VALUES 16
+
+/* Mask selection strategies */
+typedef enum bench_mask
+{
+    BENCH_BELHACHMI, /* Dithered Laplacian magnitude */
+    BENCH_RANDOM, /* Uniformly random pixels */
+    BENCH_NUM_MASKS
+} bench_mask_enum;
+
+static const char *bench_pattern_names[] = {"gradient", "noise", "texture"};
+static const char *bench_mask_names[] = {"belhachmi", "random"};
+
+/* Command line options */
+typedef struct bench_options
+{
+    int sizes[BENCH_MAX_VALUES]; /* Edge lengths of the square images */
+    int num_sizes; /* Number of sizes */
+    double densities[BENCH_MAX_VALUES]; /* Mask densities */
+    int num_densities; /* Number of densities */
+    int patterns[BENCH_NUM_PATTERNS]; /* Flags of the selected patterns */
+    int num_threads; /* Threads of parallel stages, <= 0 for all cores */
+    int maskopt_size; /* Largest edge length of mask optimisation, 0 off */
+    telemetry_format_enum format; /* Output format */
+    const char *scratch_dir; /* Directory of the temporary PNM file */
+    FILE *out; /* Output stream */
+} bench_options_type;
+
+/* Measurement of one pipeline stage */
+typedef struct bench_row
+{
+    const char *pattern; /* Synthetic image */
+    int size; /* Edge length of the image */
+    const char *stage; /* Pipeline stage */
+    const char *mask; /* Mask strategy, NULL before mask selection */
+    double density; /* Mask density, negative before mask selection */
+    double seconds; /* Wall clock time */
+    int iterations; /* Solver iterations, -1 for other stages */
+    long accepted; /* Accepted pixel exchanges, -1 for other stages */
+    double mse; /* Error of the reconstruction, negative if not measured */
+} bench_row_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Peak resident set size of the process in kilobytes.
+ */
+static long bench_peak_rss(void)
+{
+    struct rusage usage; /* Resource usage of the process */
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Writes one measurement as CSV row or JSON object, with the throughput in
+ * megapixels per second and the peak resident set size so far. Accepted
+ * exchanges and the error are left empty (null) if not measured.
+ * @opts    [I/O] Options with the output stream
+ * @row     [ I ] Measurement
+ * @first   [ I ] Flag for the first row of the output
+ */
+static void bench_report(const bench_options_type *opts,
+        const bench_row_type *row, int first)
+{
+    double mpixels; /* Throughput */
+
+    mpixels = row->seconds > 0.0
+        ? (double) row->size * row->size / row->seconds * 1e-6 : 0.0;
+
+    if (opts->format == ASI_TELEMETRY_CSV)
+    {
+        fprintf(opts->out, "%s,%d,%s,", row->pattern, row->size, row->stage);
+
+        if (row->mask != NULL)
+        {
+            fprintf(opts->out, "%s,%g,", row->mask, row->density);
+        }
+        else
+        {
+            fprintf(opts->out, ",,");
+        }
+
+        fprintf(opts->out, "%.6f,%.3f,%d,%ld,", row->seconds, mpixels,
+                row->iterations, bench_peak_rss());
+
+        if (row->accepted >= 0)
+        {
+            fprintf(opts->out, "%ld", row->accepted);
+        }
+
+        if (row->mse >= 0.0)
+        {
+            fprintf(opts->out, ",%.6f\n", row->mse);
+        }
+        else
+        {
+            fprintf(opts->out, ",\n");
+        }
+    }
+    else
+    {
+        fprintf(opts->out, "%s\n  {\"image\": \"%s\", \"size\": %d, "
+                "\"stage\": \"%s\", \"mask\": ", first ? "" : ",",
+                row->pattern, row->size, row->stage);
+
+        if (row->mask != NULL)
+        {
+            fprintf(opts->out, "\"%s\", \"density\": %g, ", row->mask,
+                    row->density);
+        }
+        else
+        {
+            fprintf(opts->out, "null, \"density\": null, ");
+        }
+
+        fprintf(opts->out, "\"seconds\": %.6f, \"mpixel_per_s\": %.3f, "
+                "\"iterations\": %d, \"peak_rss_kb\": %ld, \"accepted\": ",
+                row->seconds, mpixels, row->iterations, bench_peak_rss());
+
+        if (row->accepted >= 0)
+        {
+            fprintf(opts->out, "%ld, \"mse\": ", row->accepted);
+        }
+        else
+        {
+            fprintf(opts->out, "null, \"mse\": ");
+        }
+
+        if (row->mse >= 0.0)
+        {
+            fprintf(opts->out, "%.6f}", row->mse);
+        }
+        else
+        {
+            fprintf(opts->out, "null}");
+        }
+    }
+
+    fflush(opts->out);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Runs the mask selection and inpainting stages of one image for every
+ * mask strategy and density.
+ * @opts    [I/O] Options
+ * @image   [ I ] Double-valued image
+ * @row     [I/O] Template of the measurements
+ * @first   [I/O] Flag for the first row of the output
+ */
+static int bench_masks(const bench_options_type *opts, const image_type image,
+        bench_row_type *row, int *first)
+{
+    multigrid_params_type params; /* Solver parameters */
+    solver_info_type info; /* Solver iterations */
+    image_type mask, u; /* Mask and reconstruction */
+    double start; /* Start time of a stage */
+    int k, d; /* Loop variables */
+    int ret; /* Return value */
+
+    multigrid_params_default(&params);
+
+    for (k = 0; k < BENCH_NUM_MASKS; k++)
+    {
+        for (d = 0; d < opts->num_densities; d++)
+        {
+            row->mask = bench_mask_names[k];
+            row->density = opts->densities[d];
+
+            start = telemetry_time();
+            ret = k == BENCH_BELHACHMI
+                ? mask_belhachmi_init(image, &mask, row->density)
+                : mask_random_init(image, &mask, row->density);
+
+            if (ret != ASI_EXIT_SUCCESS)
+            {
+                return ret;
+            }
+
+            row->stage = "mask";
+            row->seconds = telemetry_time() - start;
+            row->iterations = -1;
+            bench_report(opts, row, *first);
+            *first = 0;
+
+            ret = image_init(&u, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+            if (ret != ASI_EXIT_SUCCESS)
+            {
+                image_delete(&mask);
+                return ret;
+            }
+
+            start = telemetry_time();
+            ret = multigrid_inpainting(image, mask, u, params, &info);
+
+            image_delete(&mask);
+            image_delete(&u);
+
+            if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_NOT_CONVERGED)
+            {
+                return ret;
+            }
+
+            row->stage = "solve";
+            row->seconds = telemetry_time() - start;
+            row->iterations = info.iterations;
+            bench_report(opts, row, *first);
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Runs the mask optimisation stage of one image for every density: mask
+ * selection by probabilistic sparsification, followed by nonlocal pixel
+ * exchange on the selected mask. Reports one row per method with the error
+ * of its final reconstruction.
+ * @opts    [I/O] Options
+ * @image   [ I ] Double-valued image
+ * @row     [I/O] Template of the measurements
+ * @first   [I/O] Flag for the first row of the output
+ */
+static int bench_maskopt(const bench_options_type *opts,
+        const image_type image, bench_row_type *row, int *first)
+{
+    maskopt_params_type params; /* Optimisation parameters */
+    maskopt_info_type info; /* Progress of the optimisation */
+    image_type mask; /* Optimised mask */
+    double start; /* Start time of a stage */
+    int d; /* Loop variable */
+    int ret; /* Return value */
+
+    maskopt_params_default(&params);
+    params.num_threads = opts->num_threads;
+    row->stage = "maskopt";
+
+    for (d = 0; d < opts->num_densities; d++)
+    {
+        params.density = opts->densities[d];
+        row->density = params.density;
+
+        start = telemetry_time();
+        ret = mask_sparsification(image, &mask, params, &info);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            return ret;
+        }
+
+        row->mask = "sparsification";
+        row->seconds = telemetry_time() - start;
+        row->iterations = info.iterations;
+        row->mse = info.mse;
+        bench_report(opts, row, *first);
+        *first = 0;
+
+        start = telemetry_time();
+        ret = mask_pixel_exchange(image, mask, params, &info);
+        image_delete(&mask);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            return ret;
+        }
+
+        row->mask = "exchange";
+        row->seconds = telemetry_time() - start;
+        row->iterations = -1;
+        row->accepted = info.accepted;
+        row->mse = info.mse;
+        bench_report(opts, row, *first);
+
+        row->accepted = -1;
+        row->mse = -1.0;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Runs the whole pipeline on one synthetic image: writing and reading it as
+ * PNM file, conversion to double, Gaussian smoothing, dithering, mask
+ * selection followed by inpainting, and for small images mask optimisation.
+ * @opts    [I/O] Options
+ * @sched   [I/O] Scheduler of the parallel stages
+ * @pattern [ I ] Synthetic pattern
+ * @size    [ I ] Edge length
+ * @first   [I/O] Flag for the first row of the output
+ */
+static int bench_pipeline(const bench_options_type *opts,
+        scheduler_type *sched, bench_pattern_enum pattern, int size,
+        int *first)
+{
+    bench_row_type row; /* Measurement */
+    image_type image, image_f, smooth, dithered; /* Pipeline images */
+    kernel_type kernel; /* Gaussian kernel */
+    char path[4096]; /* Temporary PNM file */
+    double start; /* Start time of a stage */
+    int ret; /* Return value */
+
+    row.pattern = bench_pattern_names[pattern];
+    row.size = size;
+    row.mask = NULL;
+    row.density = -1.0;
+    row.iterations = -1;
+    row.accepted = -1;
+    row.mse = -1.0;
+
+    snprintf(path, sizeof(path), "%s/asi_bench_%ld.pgm", opts->scratch_dir,
+            (long) getpid());
+
+    start = telemetry_time();
+    ret = bench_generate(&image, size, pattern);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    row.stage = "generate";
+    row.seconds = telemetry_time() - start;
+    bench_report(opts, &row, *first);
+    *first = 0;
+
+    start = telemetry_time();
+    ret = image_write_pnm(image, path, 0);
+    image_delete(&image);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    row.stage = "write";
+    row.seconds = telemetry_time() - start;
+    bench_report(opts, &row, *first);
+
+    start = telemetry_time();
+    ret = image_read_pnm(&image, path);
+    remove(path);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    row.stage = "read";
+    row.seconds = telemetry_time() - start;
+    bench_report(opts, &row, *first);
+
+    start = telemetry_time();
+    ret = image_init(&image_f, size, size, ASI_DTYPE_DOUBLE);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = image_copy(image, image_f);
+    }
+
+    image_delete(&image);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    row.stage = "convert";
+    row.seconds = telemetry_time() - start;
+    bench_report(opts, &row, *first);
+
+    ret = image_init(&smooth, size, size, ASI_DTYPE_DOUBLE);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = image_copy(image_f, smooth);
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = kernel_init(&kernel, ASI_GAUSSIAN, 2, 1.0, 3.0);
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        start = telemetry_time();
+        ret = image_convolve_parallel(smooth, kernel, sched);
+        row.seconds = telemetry_time() - start;
+        kernel_delete(&kernel);
+    }
+
+    image_delete(&smooth);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&image_f);
+        return ret;
+    }
+
+    row.stage = "convolve";
+    bench_report(opts, &row, *first);
+
+    start = telemetry_time();
+    ret = floyd_steinberg_dithering_parallel(image_f, &dithered, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&image_f);
+        return ret;
+    }
+
+    row.stage = "dither";
+    row.seconds = telemetry_time() - start;
+    bench_report(opts, &row, *first);
+    image_delete(&dithered);
+
+    ret = bench_masks(opts, image_f, &row, first);
+
+    if (ret == ASI_EXIT_SUCCESS && size <= opts->maskopt_size)
+    {
+        ret = bench_maskopt(opts, image_f, &row, first);
+    }
+
+    image_delete(&image_f);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Parses a comma-separated list of numbers.
+ * @arg     [ I ] List
+ * @values  [ O ] Parsed values
+ * @count   [ O ] Number of values
+ */
+static int bench_parse_list(const char *arg, double *values, int *count)
+{
+    char *end; /* End of a parsed number */
+
+    *count = 0;
+
+    while (*arg != '\0' && *count < BENCH_MAX_VALUES)
+    {
+        values[(*count)++] = strtod(arg, &end);
+
+        if (end == arg || (*end != ',' && *end != '\0'))
+        {
+            return ASI_EXIT_INVALID_VALUE;
+        }
+
+        arg = *end == ',' ? end + 1 : end;
+    }
+
+    return *arg == '\0' && *count > 0 ? ASI_EXIT_SUCCESS
+        : ASI_EXIT_INVALID_VALUE;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Prints the command line usage.
+ * @name    [ I ] Program name
+ */
+static void bench_usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s sizes] [-d densities] [-p patterns] "
+            "[-t threads] [-m size] [-f csv|json] [-o file]\n"
+            "       [-w scratch_dir]\n"
+            "  -s  comma-separated edge lengths, default 256,512,1024,2048;\n"
+            "      up to 16384 (about 12 GB resident)\n"
+            "  -d  comma-separated mask densities, default 0.05,0.1\n"
+            "  -p  comma-separated subset of gradient,noise,texture\n"
+            "  -t  threads of convolution, dithering and mask optimisation,\n"
+            "      default all cores\n"
+            "  -m  largest edge length of the mask optimisation stage,\n"
+            "      default 512, 0 to disable\n"
+            "  -f  output format, default csv\n"
+            "  -o  output file, default standard output\n"
+            "  -w  directory of the temporary PNM file, default /tmp\n",
+            name);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * End-to-end benchmark of the image pipeline on synthetic images. Reports
+ * time, throughput in megapixels per second, solver iterations and peak
+ * resident memory of every stage in machine-readable form, and accepted
+ * exchanges and reconstruction error of mask optimisation.
+ */
+int main(int argc, char **argv)
+{
+    bench_options_type opts; /* Options */
+    scheduler_type sched; /* Scheduler of the parallel stages */
+    double values[BENCH_MAX_VALUES]; /* Parsed list */
+    char *token, *list; /* Parsed pattern names */
+    int first = 1; /* Flag for the first row of the output */
+    int opt, k, p, s; /* Option and loop variables */
+    int ret = ASI_EXIT_SUCCESS; /* Return value */
+
+    opts.sizes[0] = 256;
+    opts.sizes[1] = 512;
+    opts.sizes[2] = 1024;
+    opts.sizes[3] = 2048;
+    opts.num_sizes = 4;
+    opts.densities[0] = 0.05;
+    opts.densities[1] = 0.1;
+    opts.num_densities = 2;
+    opts.num_threads = 0;
+    opts.maskopt_size = 512;
+    opts.format = ASI_TELEMETRY_CSV;
+    opts.scratch_dir = "/tmp";
+    opts.out = stdout;
+
+    for (p = 0; p < BENCH_NUM_PATTERNS; p++)
+    {
+        opts.patterns[p] = 1;
+    }
+
+    while ((opt = getopt(argc, argv, "s:d:p:t:m:f:o:w:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                ret = bench_parse_list(optarg, values, &opts.num_sizes);
+
+                for (k = 0; k < opts.num_sizes; k++)
+                {
+                    opts.sizes[k] = (int) values[k];
+                    ret = opts.sizes[k] < 1 ? ASI_EXIT_INVALID_VALUE : ret;
+                }
+                break;
+            case 'd':
+                ret = bench_parse_list(optarg, opts.densities,
+                        &opts.num_densities);
+                break;
+            case 'p':
+                list = strdup(optarg);
+
+                for (p = 0; p < BENCH_NUM_PATTERNS; p++)
+                {
+                    opts.patterns[p] = 0;
+                }
+
+                for (token = strtok(list, ","); token != NULL
+                        && ret == ASI_EXIT_SUCCESS;
+                        token = strtok(NULL, ","))
+                {
+                    for (p = 0; p < BENCH_NUM_PATTERNS
+                            && strcmp(token, bench_pattern_names[p]) != 0;
+                            p++);
+
+                    if (p == BENCH_NUM_PATTERNS)
+                    {
+                        ret = ASI_EXIT_INVALID_VALUE;
+                    }
+                    else
+                    {
+                        opts.patterns[p] = 1;
+                    }
+                }
+
+                free(list);
+                break;
+            case 't':
+                opts.num_threads = atoi(optarg);
+                break;
+            case 'm':
+                opts.maskopt_size = atoi(optarg);
+                break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0)
+                {
+                    opts.format = ASI_TELEMETRY_JSON;
+                }
+                else if (strcmp(optarg, "csv") != 0)
+                {
+                    ret = ASI_EXIT_INVALID_VALUE;
+                }
+                break;
+            case 'o':
+                opts.out = fopen(optarg, "w");
+                ret = opts.out == NULL ? ASI_EXIT_FILE_OPEN_FAILED : ret;
+                break;
+            case 'w':
+                opts.scratch_dir = optarg;
+                break;
+            default:
+                ret = ASI_EXIT_INVALID_ARG_COUNT;
+                break;
+        }
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            bench_usage(argv[0]);
+            return ret;
+        }
+    }
+
+    ret = scheduler_init(&sched, opts.num_threads);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error starting threads: Error code %d\n", ret);
+        return ret;
+    }
+
+    if (opts.format == ASI_TELEMETRY_CSV)
+    {
+        fprintf(opts.out, "image,size,stage,mask,density,seconds,"
+                "mpixel_per_s,iterations,peak_rss_kb,accepted,mse\n");
+    }
+    else
+    {
+        fprintf(opts.out, "[");
+    }
+
+    for (s = 0; s < opts.num_sizes && ret == ASI_EXIT_SUCCESS; s++)
+    {
+        for (p = 0; p < BENCH_NUM_PATTERNS && ret == ASI_EXIT_SUCCESS; p++)
+        {
+            if (opts.patterns[p])
+            {
+                ret = bench_pipeline(&opts, &sched, (bench_pattern_enum) p,
+                        opts.sizes[s], &first);
+            }
+        }
+    }
+
+    if (opts.format == ASI_TELEMETRY_JSON)
+    {
+        fprintf(opts.out, "\n]\n");
+    }
+
+    if (opts.out != stdout)
+    {
+        fclose(opts.out);
+    }
+
+    scheduler_delete(&sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error during benchmark: Error code %d\n", ret);
+        return ret;
+    }
+
+    return 0;
+}
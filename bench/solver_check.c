@@ -0,0 +1,1073 @@
+#include "../src/asi_diffusion.h"
+#include "../src/asi_distributed.h"
+#include "../src/asi_incremental.h"
+#include "../src/asi_io.h"
+#include "../src/asi_mask.h"
+#include "../src/asi_metrics.h"
+#include "../src/asi_mixed.h"
+#include "../src/asi_multigrid.h"
+#include "../src/asi_schwarz.h"
+#include "../src/asi_scheduler.h"
+#include "../src/asi_sparse.h"
+#include "../src/asi_telemetry.h"
+#include "../src/asi_tiled.h"
+#include "bench_images.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Solvers checked against the reference */
+typedef enum check_solver
+{
+    CHECK_SCHWARZ_MULTIPLICATIVE, /* Coloured Schwarz with CG subdomains */
+    CHECK_SCHWARZ_ADDITIVE, /* Restricted additive Schwarz */
+    CHECK_SCHWARZ_CHOLESKY, /* Schwarz with cached Cholesky factors */
+    CHECK_SCHWARZ_LAZY, /* Schwarz with lazy subdomain updates */
+    CHECK_SCHWARZ_ADAPTIVE, /* Schwarz with mask-adaptive partition */
+    CHECK_DISTRIBUTED, /* Schwarz on processes over shared memory */
+    CHECK_MULTIGRID, /* Multigrid with default tolerance */
+    CHECK_MULTIGRID_STATIONARY, /* Multigrid cycles without Krylov method */
+    CHECK_REDUCED_CG, /* CG on the system of the unknown pixels */
+    CHECK_MIXED_CG, /* Single precision CG with double refinement */
+    CHECK_NUM_SOLVERS
+} check_solver_enum;
+
+/* Number of processes of the distributed solve */
+#define CHECK_PROCESSES 2
+
+/* Edge length of the Poisson check, its cells, each with a hole in the mask,
+   and spacing of the known pixels kept in every other hole */
+#define CHECK_POISSON_SIZE 256
+#define CHECK_POISSON_CELL 128
+#define CHECK_POISSON_HOLE 96
+#define CHECK_POISSON_GRID 32
+
+/* Memory budget of the tiled check in bytes per image pixel, small enough
+   to split the image into several tiles */
+#define CHECK_TILED_BYTES 16
+
+/* Iteration limit and relative residual tolerance of the CG solvers */
+#define CHECK_CG_ITER 100000
+#define CHECK_CG_EPS 1e-8
+
+/* Number of mask pixels toggled by the incremental check */
+#define CHECK_EDITS 4
+
+/* Tolerance of lazy subdomain updates in grey values */
+#define CHECK_LAZY_EPS 1e-2
+
+static const char *check_solver_names[] = {"schwarz_multiplicative",
+    "schwarz_additive", "schwarz_cholesky", "schwarz_lazy", "schwarz_adaptive",
+    "distributed", "multigrid", "multigrid_stationary", "reduced_cg",
+    "mixed_cg"};
+
+/* Preconditioners of the CG on the inpainting matrix in CDS format */
+static const precond_name_enum check_preconds[] = {ASI_PRECOND_NONE,
+    ASI_PRECOND_JACOBI, ASI_PRECOND_SSOR, ASI_PRECOND_IC0};
+static const char *check_precond_names[] = {"cds_cg", "pcg_jacobi",
+    "pcg_ssor", "pcg_ic0"};
+
+#define CHECK_NUM_PRECONDS \
+    ((int) (sizeof(check_preconds) / sizeof(check_preconds[0])))
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Runs one of the checked solvers from a zero initial guess.
+ * @solver  [ I ] Solver
+ * @image   [ I ] Double-valued image
+ * @mask    [ I ] Inpainting mask
+ * @u       [ O ] Reconstruction
+ * @threads [ I ] Number of threads, per process for distributed Schwarz
+ * @info    [ O ] Convergence information, zero unless Schwarz
+ */
+static int check_run(check_solver_enum solver, const image_type image,
+        const image_type mask, image_type u, int threads,
+        schwarz_info_type *info)
+{
+    schwarz_params_type params; /* Schwarz parameters */
+    multigrid_params_type mg; /* Multigrid parameters */
+    int ret; /* Return value */
+
+    memset(u.data, 0, (size_t) u.width * u.height * sizeof(double));
+    memset(info, 0, sizeof(*info));
+
+    if (solver == CHECK_MULTIGRID || solver == CHECK_MULTIGRID_STATIONARY)
+    {
+        multigrid_params_default(&mg);
+        mg.num_threads = threads;
+        mg.krylov = solver == CHECK_MULTIGRID;
+        ret = multigrid_inpainting(image, mask, u, mg, NULL);
+    }
+    else if (solver == CHECK_REDUCED_CG)
+    {
+        ret = diffusion_inpainting_reduced_cg(image, mask, u, CHECK_CG_ITER,
+                CHECK_CG_EPS);
+    }
+    else if (solver == CHECK_MIXED_CG)
+    {
+        ret = mixed_inpainting_cg(image, mask, u, CHECK_CG_ITER, CHECK_CG_EPS,
+                0.0, NULL);
+    }
+    else
+    {
+        schwarz_params_default(&params);
+        params.num_threads = threads;
+        params.max_sweeps = 1000;
+
+        if (solver == CHECK_SCHWARZ_ADDITIVE)
+        {
+            params.variant = ASI_SCHWARZ_ADDITIVE;
+        }
+        else if (solver == CHECK_SCHWARZ_CHOLESKY)
+        {
+            params.local_solver = ASI_SCHWARZ_LOCAL_CHOLESKY;
+            params.subdomains_x = params.subdomains_y = u.width / 32 + 1;
+        }
+        else if (solver == CHECK_SCHWARZ_LAZY)
+        {
+            params.lazy_eps = CHECK_LAZY_EPS;
+        }
+        else if (solver == CHECK_SCHWARZ_ADAPTIVE)
+        {
+            params.partition = ASI_PARTITION_ADAPTIVE;
+        }
+
+        ret = solver == CHECK_DISTRIBUTED
+            ? distributed_schwarz_processes(image, mask, u, params,
+                    CHECK_PROCESSES, info)
+            : schwarz_inpainting(image, mask, u, params, info);
+    }
+
+    /* Stationary cycles stop early when they diverge */
+    return ret == ASI_EXIT_NOT_CONVERGED && solver != CHECK_MULTIGRID_STATIONARY
+        ? ASI_EXIT_SUCCESS : ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Computes a reference solution by tightly converged multigrid.
+ * @image       [ I ] Double-valued image
+ * @mask        [ I ] Inpainting mask
+ * @reference   [ O ] Reference solution, initialised beforehand
+ */
+static int check_reference(const image_type image, const image_type mask,
+        image_type reference)
+{
+    multigrid_params_type mg; /* Parameters of the reference solve */
+
+    memset(reference.data, 0, (size_t) reference.width * reference.height
+            * sizeof(double));
+
+    multigrid_params_default(&mg);
+    mg.eps = 1e-10;
+    mg.max_cycles = 1000;
+
+    return multigrid_inpainting(image, mask, reference, mg, NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Compares the result of a solver with a reference and prints its CSV row.
+ * Returns 1 if the solver failed or is out of tolerance, 0 otherwise.
+ * @name        [ I ] Row name
+ * @ret         [ I ] Return value of the solver
+ * @seconds     [ I ] Time of the solver
+ * @reference   [ I ] Reference solution
+ * @u           [ I ] Result of the solver
+ * @tol         [ I ] Tolerances
+ * @sched       [I/O] Scheduler of the metrics
+ */
+static int check_compare(const char *name, int ret, double seconds,
+        const image_type reference, const image_type u,
+        const metrics_tolerance_type tol, scheduler_type *sched)
+{
+    metrics_report_type report; /* Metrics against the reference */
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = image_compare(reference, u, 255.0, tol, &report, sched);
+    }
+
+    if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_OUT_OF_TOLERANCE)
+    {
+        printf("%s,%.6f,,,,,,error %d\n", name, seconds, ret);
+        return 1;
+    }
+
+    printf("%s,%.6f,%.6e,%.3f,%.8f,%.6e,,%s\n", name, seconds, report.mse,
+            report.psnr, report.ssim, report.max_abs, ret == ASI_EXIT_SUCCESS
+            ? "pass" : "fail");
+
+    return ret != ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks Schwarz with fast Poisson subdomain solves on a synthetic image of
+ * fixed size. Holes are cut into the mask such that all paths of the local
+ * solver are taken: windows in the remaining mask fall back to conjugate
+ * gradients, windows in holes that keep a coarse grid of pixels use the
+ * capacitance correction, and windows in empty holes the direct solve.
+ * Prints one CSV row and returns the number of failed cases.
+ * @threads [ I ] Number of threads
+ * @density [ I ] Mask density outside the holes
+ * @tol     [ I ] Tolerances
+ * @sched   [I/O] Scheduler of the metrics
+ */
+static int check_poisson(int threads, double density,
+        const metrics_tolerance_type tol, scheduler_type *sched)
+{
+    schwarz_params_type params; /* Schwarz parameters */
+    image_type image, image_f, mask, thin; /* Image, mask and mask with holes */
+    image_type reference, u; /* Reference and reconstruction */
+    double start, seconds; /* Timing */
+    int i, j; /* Loop variables */
+    int hole, value; /* Flag for a pixel in a hole, mask value */
+    int failed, ret; /* Result of the row, return value */
+
+    ret = bench_generate(&image, CHECK_POISSON_SIZE, BENCH_TEXTURE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        printf("schwarz_poisson,,,,,,,error %d\n", ret);
+        return 1;
+    }
+
+    image_init(&image_f, image.width, image.height, ASI_DTYPE_DOUBLE);
+    image_copy(image, image_f);
+    image_delete(&image);
+
+    ret = mask_belhachmi_init(image_f, &mask, density);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        printf("schwarz_poisson,,,,,,,error %d\n", ret);
+        image_delete(&image_f);
+        return 1;
+    }
+
+    image_init(&thin, mask.width, mask.height, ASI_DTYPE_DOUBLE);
+    image_init(&reference, image_f.width, image_f.height, ASI_DTYPE_DOUBLE);
+    image_init(&u, image_f.width, image_f.height, ASI_DTYPE_DOUBLE);
+
+    for (i = 0; i < mask.height; i++)
+    {
+        for (j = 0; j < mask.width; j++)
+        {
+            hole = i % CHECK_POISSON_CELL < CHECK_POISSON_HOLE
+                && j % CHECK_POISSON_CELL < CHECK_POISSON_HOLE;
+
+            /* Every other hole keeps a coarse grid */
+            value = !hole ? mask_get(mask, i, j)
+                : (i / CHECK_POISSON_CELL + j / CHECK_POISSON_CELL) % 2 == 1
+                && i % CHECK_POISSON_GRID == CHECK_POISSON_GRID / 2
+                && j % CHECK_POISSON_GRID == CHECK_POISSON_GRID / 2;
+
+            image_fput(thin, (double) value, i, j);
+        }
+    }
+
+    ret = check_reference(image_f, thin, reference);
+
+    memset(u.data, 0, (size_t) u.width * u.height * sizeof(double));
+    schwarz_params_default(&params);
+    params.num_threads = threads;
+    params.max_sweeps = 1000;
+    params.local_solver = ASI_SCHWARZ_LOCAL_POISSON;
+
+    /* Windows small enough to fit into the holes */
+    params.subdomains_x = params.subdomains_y = u.width / 32 + 1;
+
+    start = telemetry_time();
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = schwarz_inpainting(image_f, thin, u, params, NULL);
+        ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+    }
+
+    seconds = telemetry_time() - start;
+    failed = check_compare("schwarz_poisson", ret, seconds, reference, u,
+            tol, sched);
+
+    image_delete(&image_f);
+    image_delete(&mask);
+    image_delete(&thin);
+    image_delete(&reference);
+    image_delete(&u);
+
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks that the comparison rejects a result containing NaN, as left by a
+ * diverged solver: once with a single NaN pixel and once with all pixels
+ * NaN. Prints one CSV row per case and returns the number of failed cases.
+ * @reference   [ I ] Reference solution
+ * @u           [I/O] Scratch image
+ * @tol         [ I ] Tolerances
+ * @sched       [I/O] Scheduler of the metrics
+ */
+static int check_nan(const image_type reference, image_type u,
+        const metrics_tolerance_type tol, scheduler_type *sched)
+{
+    metrics_report_type report; /* Metrics against the reference */
+    double *data = (double *) u.data; /* Pixels of the scratch image */
+    size_t n = (size_t) u.width * u.height; /* Number of pixels */
+    size_t k; /* Loop variable */
+    int failed = 0; /* Number of failed cases */
+    int c, ret; /* Case, return value */
+
+    for (c = 0; c < 2; c++)
+    {
+        image_copy(reference, u);
+
+        for (k = c == 0 ? n / 2 : 0; k < (c == 0 ? n / 2 + 1 : n); k++)
+        {
+            data[k] = NAN;
+        }
+
+        ret = image_compare(reference, u, 255.0, tol, &report, sched);
+
+        printf("%s,,%.6e,%.3f,%.8f,%.6e,,%s\n", c == 0 ? "nan_pixel"
+                : "nan_image", report.mse, report.psnr, report.ssim,
+                report.max_abs, ret == ASI_EXIT_OUT_OF_TOLERANCE
+                ? "pass" : "fail");
+        failed += ret != ASI_EXIT_OUT_OF_TOLERANCE;
+    }
+
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks that red-black SOR sweeps split into row bands on several threads
+ * give the same result as the serial sweeps. Prints one CSV row and returns
+ * the number of failed cases.
+ * @image   [ I ] Double-valued image
+ * @mask    [ I ] Inpainting mask
+ * @u       [I/O] Scratch image
+ * @threads [ I ] Number of threads, at least two are used
+ */
+static int check_sor(const image_type image, const image_type mask,
+        image_type u, int threads)
+{
+    metrics_tolerance_type tol; /* Bit-identical results */
+    metrics_report_type report; /* Threaded against serial sweeps */
+    diffusion_operator_type op; /* Inpainting operator */
+    scheduler_type sched; /* Scheduler of the threaded sweeps */
+    image_type serial; /* Result of the serial sweeps */
+    double start, seconds; /* Timing */
+    int ret; /* Return value */
+
+    tol.max_mse = tol.min_psnr = tol.min_ssim = -1.0;
+    tol.max_abs = 0.0;
+
+    ret = scheduler_init(&sched, threads > 1 ? threads : 4);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        printf("sor_threaded,,,,,,,error %d\n", ret);
+        return 1;
+    }
+
+    ret = diffusion_operator_init(&op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        scheduler_delete(&sched);
+        printf("sor_threaded,,,,,,,error %d\n", ret);
+        return 1;
+    }
+
+    image_init(&serial, image.width, image.height, ASI_DTYPE_DOUBLE);
+    image_copy(image, serial);
+    image_copy(image, u);
+
+    diffusion_sor_red_black(op, serial, NULL, 1.5, 20, 0, NULL);
+
+    start = telemetry_time();
+    ret = diffusion_sor_red_black(op, u, NULL, 1.5, 20, 0, &sched);
+    seconds = telemetry_time() - start;
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = image_compare(serial, u, 255.0, tol, &report, NULL);
+    }
+
+    if (ret == ASI_EXIT_SUCCESS || ret == ASI_EXIT_OUT_OF_TOLERANCE)
+    {
+        printf("sor_threaded,%.6f,%.6e,%.3f,%.8f,%.6e,,%s\n", seconds,
+                report.mse, report.psnr, report.ssim, report.max_abs,
+                ret == ASI_EXIT_SUCCESS ? "pass" : "fail");
+    }
+    else
+    {
+        printf("sor_threaded,,,,,,,error %d\n", ret);
+    }
+
+    scheduler_delete(&sched);
+    image_delete(&serial);
+    diffusion_operator_delete(&op);
+
+    return ret != ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks incremental re-inpainting: a few mask pixels are toggled and the
+ * reference is updated, once by local region solves and once through the
+ * fallback to a full solve. Both results must match a full solve for the
+ * edited mask within params.eps. Prints one CSV row per case and returns
+ * the number of failed cases.
+ * @image       [ I ] Double-valued image
+ * @mask        [ I ] Inpainting mask
+ * @reference   [ I ] Reference solution for the mask
+ * @u           [I/O] Scratch image
+ */
+static int check_incremental(const image_type image, const image_type mask,
+        const image_type reference, image_type u)
+{
+    incremental_params_type params; /* Incremental parameters */
+    incremental_info_type info; /* Work done by the update */
+    metrics_tolerance_type tol; /* Largest difference of params.eps */
+    metrics_report_type report; /* Update against the full solve */
+    multigrid_params_type mg; /* Parameters of the full solve */
+    mask_edit_type edits[CHECK_EDITS]; /* Toggled pixels */
+    image_type edited, solution; /* Edited mask and its full solve */
+    double start, seconds; /* Timing */
+    int failed = 0; /* Number of failed cases */
+    int c, k, ret; /* Case, loop variable, return value */
+
+    edits[0].i = u.height / 4;
+    edits[0].j = u.width / 4;
+    edits[1].i = u.height / 4 + 1;
+    edits[1].j = u.width / 4;
+    edits[2].i = u.height / 2;
+    edits[2].j = 3 * u.width / 4;
+    edits[3].i = 3 * u.height / 4;
+    edits[3].j = u.width / 2;
+
+    image_init(&edited, mask.width, mask.height, ASI_DTYPE_DOUBLE);
+    image_init(&solution, u.width, u.height, ASI_DTYPE_DOUBLE);
+    image_copy(mask, edited);
+
+    for (k = 0; k < CHECK_EDITS; k++)
+    {
+        image_fput(edited, image_fget(edited, edits[k].i, edits[k].j) > 0.0
+                ? 0.0 : 1.0, edits[k].i, edits[k].j);
+    }
+
+    multigrid_params_default(&mg);
+    mg.eps = 1e-10;
+    mg.max_cycles = 1000;
+    ret = multigrid_inpainting(image, edited, solution, mg, NULL);
+
+    for (c = 0; c < 2 && ret == ASI_EXIT_SUCCESS; c++)
+    {
+        incremental_params_default(&params);
+
+        /* Regions never or always exceed the limit of a full solve */
+        params.max_fraction = c == 0 ? 1.0 : 0.0;
+
+        tol.max_mse = tol.min_psnr = tol.min_ssim = -1.0;
+        tol.max_abs = params.eps;
+
+        image_copy(reference, u);
+
+        start = telemetry_time();
+        ret = incremental_inpainting(image, edited, u, edits, CHECK_EDITS,
+                params, &info);
+        seconds = telemetry_time() - start;
+
+        if (ret == ASI_EXIT_NOT_CONVERGED)
+        {
+            ret = ASI_EXIT_SUCCESS;
+        }
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = image_compare(solution, u, 255.0, tol, &report, NULL);
+        }
+
+        if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_OUT_OF_TOLERANCE)
+        {
+            break;
+        }
+
+        /* The case must take the path it is meant to check */
+        if (info.full_solve != c)
+        {
+            ret = ASI_EXIT_FAILURE;
+        }
+
+        printf("%s,%.6f,%.6e,%.3f,%.8f,%.6e,,%s\n", c == 0 ? "incremental"
+                : "incremental_full", seconds, report.mse, report.psnr,
+                report.ssim, report.max_abs, ret == ASI_EXIT_SUCCESS
+                ? "pass" : "fail");
+        failed += ret != ASI_EXIT_SUCCESS;
+        ret = ASI_EXIT_SUCCESS;
+    }
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        printf("incremental,,,,,,,error %d\n", ret);
+        failed++;
+    }
+
+    image_delete(&edited);
+    image_delete(&solution);
+
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Creates a scratch file name in the system temporary directory.
+ * @path    [ O ] File name of at least 32 characters
+ */
+static int check_scratch(char *path)
+{
+    int fd; /* File descriptor */
+
+    strcpy(path, "/tmp/asi_check_XXXXXX");
+    fd = mkstemp(path);
+
+    if (fd < 0)
+    {
+        path[0] = '\0';
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    close(fd);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Streams a double-valued image row by row to a P5 file, with grey values
+ * rounded after scaling.
+ * @image   [ I ] Double-valued image
+ * @scale   [ I ] Factor of the grey values
+ * @path    [ I ] File name
+ */
+static int check_write(const image_type image, double scale, const char *path)
+{
+    pnm_stream_type stream; /* Output stream */
+    int *row; /* Row of rounded values */
+    int i, j; /* Loop variables */
+    int ret; /* Return value */
+
+    row = (int *) malloc((size_t) image.width * sizeof(int));
+
+    if (row == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    ret = pnm_stream_create(&stream, path, image.width, image.height, 255, 1);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        free(row);
+        return ret;
+    }
+
+    for (i = 0; ret == ASI_EXIT_SUCCESS && i < image.height; i++)
+    {
+        for (j = 0; j < image.width; j++)
+        {
+            row[j] = (int) floor(scale * image_fget(image, i, j) + 0.5);
+        }
+
+        ret = pnm_stream_write_rows(&stream, row, 1);
+    }
+
+    if (pnm_stream_close(&stream) != ASI_EXIT_SUCCESS
+            && ret == ASI_EXIT_SUCCESS)
+    {
+        ret = ASI_EXIT_FAILURE;
+    }
+
+    free(row);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reads a P5 file row by row into a double-valued image.
+ * @image   [ O ] Double-valued image of the size of the file
+ * @path    [ I ] File name
+ */
+static int check_read(image_type image, const char *path)
+{
+    pnm_stream_type stream; /* Input stream */
+    int *row; /* Row of grey values */
+    int i, j; /* Loop variables */
+    int ret; /* Return value */
+
+    ret = pnm_stream_open(&stream, path);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    row = (int *) malloc((size_t) image.width * sizeof(int));
+
+    if (stream.header.width != image.width
+            || stream.header.height != image.height)
+    {
+        ret = ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+    else if (row == NULL)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (i = 0; ret == ASI_EXIT_SUCCESS && i < image.height; i++)
+    {
+        ret = pnm_stream_read_rows(&stream, row, 1);
+
+        for (j = 0; ret == ASI_EXIT_SUCCESS && j < image.width; j++)
+        {
+            image_fput(image, (double) row[j], i, j);
+        }
+    }
+
+    pnm_stream_close(&stream);
+    free(row);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks out-of-core tiled inpainting. Image and mask are streamed to
+ * scratch files and solved with a memory budget that forces several tiles.
+ * The result is read back and compared with the rounded in-core reference,
+ * so that quantisation of the output file does not count against the
+ * tolerance. Prints one CSV row and returns the number of failed cases.
+ * @image     [ I ] Double-valued image
+ * @mask      [ I ] Inpainting mask
+ * @reference [ I ] Reference solution
+ * @u         [I/O] Scratch image
+ * @tol       [ I ] Tolerances
+ * @sched     [I/O] Scheduler of the metrics
+ */
+static int check_tiled(const image_type image, const image_type mask,
+        const image_type reference, image_type u,
+        const metrics_tolerance_type tol, scheduler_type *sched)
+{
+    tiled_params_type params; /* Tiled parameters */
+    tiled_info_type info; /* Tile grid of the solve */
+    image_type rounded; /* Rounded reference */
+    char image_file[32], mask_file[32], output_file[32]; /* Scratch files */
+    double start, seconds; /* Timing */
+    double value; /* Grey value */
+    int i, j; /* Loop variables */
+    int failed, ret; /* Result of the row, return value */
+
+    image_init(&rounded, reference.width, reference.height, ASI_DTYPE_DOUBLE);
+
+    for (i = 0; i < reference.height; i++)
+    {
+        for (j = 0; j < reference.width; j++)
+        {
+            value = floor(image_fget(reference, i, j) + 0.5);
+            image_fput(rounded, value < 0.0 ? 0.0 : value > 255.0 ? 255.0
+                    : value, i, j);
+        }
+    }
+
+    ret = check_scratch(image_file);
+    check_scratch(mask_file);
+    check_scratch(output_file);
+
+    if (ret == ASI_EXIT_SUCCESS && (mask_file[0] == '\0'
+                || output_file[0] == '\0'))
+    {
+        ret = ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = check_write(image, 1.0, image_file);
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = check_write(mask, 255.0, mask_file);
+    }
+
+    tiled_params_default(&params);
+    params.memory_bytes = (size_t) u.width * u.height * CHECK_TILED_BYTES;
+
+    /* Overlap of the defaults at 512 pixels, such that small images keep
+       tiles within the budget */
+    params.overlap = u.width < u.height ? u.width / 32 : u.height / 32;
+
+    start = telemetry_time();
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = tiled_inpainting(image_file, mask_file, output_file, params,
+                &info);
+    }
+
+    seconds = telemetry_time() - start;
+
+    /* A single tile does not test the out-of-core sweeps */
+    if (ret == ASI_EXIT_SUCCESS && info.num_tiles < 2)
+    {
+        ret = ASI_EXIT_INVALID_VALUE;
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = check_read(u, output_file);
+    }
+
+    failed = check_compare("tiled", ret, seconds, rounded, u, tol, sched);
+
+    remove(image_file);
+    remove(mask_file);
+    remove(output_file);
+    image_delete(&rounded);
+
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks the lockstep CG of RGB images. The channels are affine maps of the
+ * grey values, so by linearity of the inpainting their solutions are the
+ * same maps of the reference. Prints one CSV row and returns the number of
+ * failed cases.
+ * @image     [ I ] Double-valued image
+ * @mask      [ I ] Inpainting mask
+ * @reference [ I ] Reference solution
+ * @tol       [ I ] Tolerances
+ * @sched     [I/O] Scheduler of the metrics
+ */
+static int check_rgb(const image_type image, const image_type mask,
+        const image_type reference, const metrics_tolerance_type tol,
+        scheduler_type *sched)
+{
+    image_type rgb, expected, u; /* Colour image, its solution and result */
+    double start, seconds; /* Timing */
+    double v, w; /* Grey values of the image and the reference */
+    double *p, *q; /* Pixels of the colour images */
+    int i, j; /* Loop variables */
+    int ret; /* Return value */
+
+    image_init(&rgb, image.width, image.height, ASI_DTYPE_DOUBLE_RGB);
+    image_init(&expected, image.width, image.height, ASI_DTYPE_DOUBLE_RGB);
+    ret = image_init(&u, image.width, image.height, ASI_DTYPE_DOUBLE_RGB);
+
+    if (ret == ASI_EXIT_SUCCESS && (rgb.data == NULL
+                || expected.data == NULL))
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (i = 0; ret == ASI_EXIT_SUCCESS && i < image.height; i++)
+    {
+        for (j = 0; j < image.width; j++)
+        {
+            v = image_fget(image, i, j);
+            w = image_fget(reference, i, j);
+            p = image_fget_rgb(rgb, i, j);
+            q = image_fget_rgb(expected, i, j);
+
+            p[0] = v;
+            p[1] = 255.0 - v;
+            p[2] = 0.5 * v + 64.0;
+            q[0] = w;
+            q[1] = 255.0 - w;
+            q[2] = 0.5 * w + 64.0;
+        }
+    }
+
+    start = telemetry_time();
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = diffusion_inpainting_rgb_cg(rgb, mask, u, CHECK_CG_ITER,
+                CHECK_CG_EPS);
+        ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+    }
+
+    seconds = telemetry_time() - start;
+    ret = check_compare("rgb_cg", ret, seconds, expected, u, tol, sched);
+
+    image_delete(&rgb);
+    image_delete(&expected);
+    image_delete(&u);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks the conjugate gradient method on the inpainting matrix in CDS
+ * format with each preconditioner. Prints one CSV row per preconditioner
+ * and returns the number of failed cases.
+ * @image     [ I ] Double-valued image
+ * @mask      [ I ] Inpainting mask
+ * @reference [ I ] Reference solution
+ * @u         [I/O] Scratch image
+ * @tol       [ I ] Tolerances
+ * @sched     [I/O] Scheduler of the metrics
+ */
+static int check_cds(const image_type image, const image_type mask,
+        const image_type reference, image_type u,
+        const metrics_tolerance_type tol, scheduler_type *sched)
+{
+    cds_sparse_mat_type mat; /* Inpainting matrix */
+    preconditioner_type pc; /* Preconditioner */
+    double *b; /* Right-hand side */
+    double start, seconds; /* Timing */
+    int failed = 0; /* Number of failed cases */
+    int k, ret; /* Loop variable, return value */
+
+    memset(&mat, 0, sizeof(mat));
+    b = (double *) malloc((size_t) u.width * u.height * sizeof(double));
+    ret = b == NULL ? ASI_EXIT_FAILED_ALLOC
+        : cds_init_inpainting_matrix(&mat, mask);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = cds_inpainting_rhs(image, mask, b);
+    }
+
+    for (k = 0; k < CHECK_NUM_PRECONDS; k++)
+    {
+        memset(u.data, 0, (size_t) u.width * u.height * sizeof(double));
+        start = telemetry_time();
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = precond_init(&pc, &mat, check_preconds[k], 0);
+        }
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = cds_preconditioned_conjugate_gradient(mat, &pc, b,
+                    (double *) u.data, CHECK_CG_ITER, CHECK_CG_EPS, NULL);
+            ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+            precond_delete(&pc);
+        }
+
+        seconds = telemetry_time() - start;
+        failed += check_compare(check_precond_names[k], ret, seconds,
+                reference, u, tol, sched);
+    }
+
+    cds_delete(&mat);
+    free(b);
+
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Prints the command line usage.
+ * @name    [ I ] Program name
+ */
+static void check_usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-i image.pgm | -s size] [-d density] "
+            "[-t threads] [-p min_psnr] [-m min_ssim] [-a max_abs]\n"
+            "  -i  greyscale PNM image, default a synthetic texture\n"
+            "  -s  edge length of the synthetic texture, default 512\n"
+            "  -d  density of the Belhachmi mask, default 0.05\n"
+            "  -t  number of threads, default all cores\n"
+            "  -p, -m, -a  tolerances of PSNR, SSIM and largest difference\n"
+            "      against the reference, negative to disable\n", name);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Regression check of the inpainting solvers: every solver reconstructs
+ * the same image, and its result is compared with a reference solution of
+ * tightly converged multigrid. Prints one CSV row per solver with the
+ * metrics against the reference and against the original image, and exits
+ * with a non-zero status if any solver is out of tolerance. Further rows
+ * check that results containing NaN are rejected and that threaded SOR
+ * sweeps match serial ones, and that incremental re-inpainting after a few
+ * mask edits matches a full solve. The lazy Schwarz row also fails if no
+ * subdomain solve was skipped.
+ */
+int main(int argc, char **argv)
+{
+    metrics_tolerance_type tol; /* Tolerances */
+    metrics_report_type report; /* Metrics against the reference */
+    schwarz_info_type info; /* Convergence information of Schwarz solves */
+    multigrid_params_type mg; /* Parameters of the reference solve */
+    scheduler_type sched; /* Scheduler of the metrics */
+    image_type image, image_f, mask, reference, u; /* Images */
+    const char *file = NULL; /* Input image */
+    double density = 0.05; /* Mask density */
+    double psnr; /* PSNR against the original */
+    double start, seconds; /* Timing */
+    int size = 512; /* Edge length of the synthetic image */
+    int threads = 0; /* Number of threads */
+    int failed = 0; /* Number of solvers out of tolerance */
+    int opt, k; /* Option and loop variable */
+    int ret; /* Return value */
+
+    metrics_tolerance_default(&tol);
+
+    while ((opt = getopt(argc, argv, "i:s:d:t:p:m:a:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                file = optarg;
+                break;
+            case 's':
+                size = atoi(optarg);
+                break;
+            case 'd':
+                density = atof(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'p':
+                tol.min_psnr = atof(optarg);
+                break;
+            case 'm':
+                tol.min_ssim = atof(optarg);
+                break;
+            case 'a':
+                tol.max_abs = atof(optarg);
+                break;
+            default:
+                check_usage(argv[0]);
+                return ASI_EXIT_INVALID_ARG_COUNT;
+        }
+    }
+
+    ret = file != NULL ? image_read_pnm(&image, file)
+        : size > 0 ? bench_generate(&image, size, BENCH_TEXTURE)
+        : ASI_EXIT_INVALID_VALUE;
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error loading image: Error code %d\n", ret);
+        return ret;
+    }
+
+    image_init(&image_f, image.width, image.height, ASI_DTYPE_DOUBLE);
+    image_copy(image, image_f);
+    image_delete(&image);
+
+    ret = mask_belhachmi_init(image_f, &mask, density);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error during mask creation: Error code %d\n", ret);
+        return ret;
+    }
+
+    ret = scheduler_init(&sched, threads);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error starting threads: Error code %d\n", ret);
+        return ret;
+    }
+
+    image_init(&reference, image_f.width, image_f.height, ASI_DTYPE_DOUBLE);
+    image_init(&u, image_f.width, image_f.height, ASI_DTYPE_DOUBLE);
+
+    multigrid_params_default(&mg);
+    mg.eps = 1e-10;
+    mg.max_cycles = 1000;
+    ret = multigrid_inpainting(image_f, mask, reference, mg, NULL);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Error during reference solve: Error code %d\n", ret);
+        return ret;
+    }
+
+    printf("solver,seconds,mse,psnr,ssim,max_abs,psnr_original,status\n");
+
+    for (k = 0; k < CHECK_NUM_SOLVERS; k++)
+    {
+        start = telemetry_time();
+        ret = check_run((check_solver_enum) k, image_f, mask, u, threads,
+                &info);
+        seconds = telemetry_time() - start;
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            printf("%s,%.6f,,,,,,error %d\n", check_solver_names[k], seconds,
+                    ret);
+            failed++;
+            continue;
+        }
+
+        ret = image_compare(reference, u, 255.0, tol, &report, &sched);
+
+        if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_OUT_OF_TOLERANCE)
+        {
+            fprintf(stderr, "Error during comparison: Error code %d\n", ret);
+            return ret;
+        }
+
+        image_psnr(image_f, u, 255.0, &psnr, &sched);
+
+        /* Lazy updates that never skip a subdomain are not tested */
+        if (k == CHECK_SCHWARZ_LAZY && info.skipped == 0)
+        {
+            ret = ASI_EXIT_NOT_CONVERGED;
+        }
+
+        printf("%s,%.6f,%.6e,%.3f,%.8f,%.6e,%.3f,%s\n", check_solver_names[k],
+                seconds, report.mse, report.psnr, report.ssim, report.max_abs,
+                psnr, ret == ASI_EXIT_SUCCESS ? "pass" : "fail");
+        failed += ret != ASI_EXIT_SUCCESS;
+    }
+
+    failed += check_nan(reference, u, tol, &sched);
+    failed += check_sor(image_f, mask, u, threads);
+    failed += check_incremental(image_f, mask, reference, u);
+    failed += check_poisson(threads, density, tol, &sched);
+    failed += check_tiled(image_f, mask, reference, u, tol, &sched);
+    failed += check_rgb(image_f, mask, reference, tol, &sched);
+    failed += check_cds(image_f, mask, reference, u, tol, &sched);
+
+    scheduler_delete(&sched);
+    image_delete(&image_f);
+    image_delete(&mask);
+    image_delete(&reference);
+    image_delete(&u);
+
+    return failed > 0 ? 1 : 0;
+}
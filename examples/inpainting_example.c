@@ -1,6 +1,9 @@
 #include "../src/asi_io.h"
 #include "../src/asi_mask.h"
 #include "../src/asi_convolution.h"
+#include "../src/asi_schwarz.h"
+#include "../src/asi_pyramid.h"
+#include "../src/asi_distributed.h"
 #include <stdio.h>
 #include <math.h>
 
@@ -10,6 +13,10 @@ int main()
     image_type image_f;
     int return_code;
 
+#ifdef ASI_USE_MPI
+    MPI_Init(NULL, NULL);
+#endif
+
     // Load image
     return_code = image_read_pnm(&image, "examples/pinguin_256.pgm");
 
@@ -59,6 +66,69 @@ int main()
     return_code = image_write_pnm(image_export, "examples/belhachmi_mask.pgm", 0);
     printf("Return code: %d\n", return_code);
 
+    // Inpainting with the alternating Schwarz method
+    image_type image_inpainted;
+    schwarz_params_type params;
+    schwarz_info_type info;
+
+    image_init(&image_inpainted, image_f.width, image_f.height,
+            ASI_DTYPE_DOUBLE);
+
+    // Warm start by push-pull interpolation
+    return_code = pyramid_push_pull(image_f, mask, image_inpainted);
+
+    if (return_code != ASI_EXIT_SUCCESS)
+    {
+        printf("Error during push-pull interpolation: Error code %d\n",
+                return_code);
+        return return_code;
+    }
+
+    schwarz_params_default(&params);
+    return_code = schwarz_inpainting(image_f, mask, image_inpainted, params,
+            &info);
+
+    if (return_code != ASI_EXIT_SUCCESS)
+    {
+        printf("Error during inpainting: Error code %d\n", return_code);
+        return return_code;
+    }
+
+    printf("Schwarz sweeps: %d, Residual: %g\n", info.sweeps, info.residual);
+
+    image_copy(image_inpainted, image_export);
+
+    return_code = image_write_pnm(image_export, "examples/inpainting.pgm", 0);
+    printf("Return code: %d\n", return_code);
+
+#ifdef ASI_USE_MPI
+    // Distributed inpainting, one band of rows per rank (mpirun -np N)
+    transport_type transport;
+    image_type band;
+    int row_start, row_end;
+
+    transport_init_mpi(&transport, MPI_COMM_WORLD);
+    distributed_band(image_f.height, transport.rank, transport.size,
+            &row_start, &row_end);
+
+    pyramid_push_pull(image_f, mask, image_inpainted);
+    band = distributed_band_view(image_inpainted, row_start, row_end);
+
+    return_code = distributed_schwarz_inpainting(&transport,
+            distributed_band_view(image_f, row_start, row_end),
+            distributed_band_view(mask, row_start, row_end), band, params,
+            &info);
+
+    if (transport.rank == 0)
+    {
+        printf("Distributed sweeps on %d ranks: %d, Residual: %g, "
+                "Return code: %d\n", transport.size, info.sweeps,
+                info.residual, return_code);
+    }
+
+    transport_delete(&transport);
+    MPI_Finalize();
+#endif
 
     return 0;
 }
@@ -0,0 +1,632 @@
+#include "asi_cholesky.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Dot product of two contiguous vectors with four partial sums.
+ * @x       [ I ] First vector
+ * @y       [ I ] Second vector
+ * @n       [ I ] Length
+ */
+static double cholesky_dot(const double *x, const double *y, int n)
+{
+    double s0, s1, s2, s3; /* Partial sums */
+    int k; /* Loop variable */
+
+    s0 = s1 = s2 = s3 = 0.0;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        s0 += x[k] * y[k];
+        s1 += x[k + 1] * y[k + 1];
+        s2 += x[k + 2] * y[k + 2];
+        s3 += x[k + 3] * y[k + 3];
+    }
+
+    for (; k < n; k++)
+    {
+        s0 += x[k] * y[k];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates the envelope of a factor once the first column of every row is
+ * known. The values are zero-initialised.
+ * @chol    [I/O] Factor with n and first set
+ */
+static int cholesky_alloc_values(banded_cholesky_type *chol)
+{
+    int i; /* Loop variable */
+
+    chol->bandwidth = 0;
+    chol->row_start[0] = 0;
+
+    for (i = 0; i < chol->n; i++)
+    {
+        chol->row_start[i + 1] = chol->row_start[i] + (i - chol->first[i] + 1);
+
+        if (i - chol->first[i] > chol->bandwidth)
+        {
+            chol->bandwidth = i - chol->first[i];
+        }
+    }
+
+    chol->values = (double *) calloc(chol->row_start[chol->n],
+            sizeof(double));
+
+    return chol->values == NULL ? ASI_EXIT_FAILED_ALLOC : ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates the row structure of a factor of dimension n.
+ * @chol    [ O ] Factor
+ * @n       [ I ] Matrix dimension
+ * @permute [ I ] Flag to allocate a permutation
+ */
+static int cholesky_alloc(banded_cholesky_type *chol, int n, int permute)
+{
+    memset(chol, 0, sizeof(banded_cholesky_type));
+
+    chol->n = n;
+    chol->row_start = (size_t *) malloc((n + 1) * sizeof(size_t));
+    chol->first = (int *) malloc(n * sizeof(int));
+
+    if (permute)
+    {
+        chol->perm = (int *) malloc(n * sizeof(int));
+    }
+
+    if (chol->row_start == NULL || chol->first == NULL
+            || (permute && chol->perm == NULL))
+    {
+        banded_cholesky_delete(chol);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Overwrites the lower triangle of A held in the envelope of a factor with
+ * its Cholesky factor L, row by row. Entry (i, j) is the lower triangle
+ * entry minus the inner product of rows i and j of L over their common
+ * envelope.
+ * @chol    [I/O] Lower triangle of A on input, factor L on output
+ */
+static int cholesky_factor(banded_cholesky_type *chol)
+{
+    double *li, *lj; /* Rows of L, indexed by column relative to first */
+    double s; /* Reduced entry */
+    int i, j; /* Loop variables */
+    int k0; /* First column of the common envelope */
+
+    for (i = 0; i < chol->n; i++)
+    {
+        li = chol->values + chol->row_start[i];
+
+        for (j = chol->first[i]; j <= i; j++)
+        {
+            lj = chol->values + chol->row_start[j];
+            k0 = chol->first[i] > chol->first[j]
+                ? chol->first[i] : chol->first[j];
+
+            s = li[j - chol->first[i]] - cholesky_dot(li + k0 - chol->first[i],
+                    lj + k0 - chol->first[j], j - k0);
+
+            if (j < i)
+            {
+                li[j - chol->first[i]] = s / lj[j - chol->first[j]];
+            }
+            else if (s > 0.0)
+            {
+                li[i - chol->first[i]] = sqrt(s);
+            }
+            else
+            {
+                /* Matrix is not positive definite */
+                return ASI_EXIT_INVALID_VALUE;
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Computes the Cholesky factor of a symmetric positive definite matrix in
+ * compressed diagonal storage. Only diagonals with non-positive offsets are
+ * read; the envelope of each row starts at its first non-zero entry.
+ * @chol    [ O ] Factor
+ * @mat     [ I ] Symmetric positive definite matrix
+ */
+int banded_cholesky_init(banded_cholesky_type *chol,
+        const cds_sparse_mat_type mat)
+{
+    int i, d; /* Loop variables */
+    int ret; /* Return value */
+
+    ret = cholesky_alloc(chol, mat.n, 0);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < mat.n; i++)
+    {
+        chol->first[i] = i;
+
+        for (d = 0; d < mat.num_diags; d++)
+        {
+            if (mat.ioff[d] < 0 && i + mat.ioff[d] >= 0
+                    && mat.a[d][i] != 0.0 && i + mat.ioff[d] < chol->first[i])
+            {
+                chol->first[i] = i + mat.ioff[d];
+            }
+        }
+    }
+
+    ret = cholesky_alloc_values(chol);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        banded_cholesky_delete(chol);
+        return ret;
+    }
+
+    for (i = 0; i < mat.n; i++)
+    {
+        for (d = 0; d < mat.num_diags; d++)
+        {
+            if (mat.ioff[d] <= 0 && i + mat.ioff[d] >= chol->first[i])
+            {
+                chol->values[chol->row_start[i] + i + mat.ioff[d]
+                    - chol->first[i]] = mat.a[d][i];
+            }
+        }
+    }
+
+    ret = cholesky_factor(chol);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        banded_cholesky_delete(chol);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Computes the Cholesky factor of an inpainting operator. Pixels are
+ * numbered row by row, or column by column if the operator is wider than
+ * high, so the bandwidth is the shorter side. Known pixels are identity rows
+ * and do not couple to unknown ones.
+ * @chol    [ O ] Factor
+ * @op      [ I ] Inpainting operator
+ */
+int banded_cholesky_init_operator(banded_cholesky_type *chol,
+        const diffusion_operator_type op)
+{
+    int transposed; /* Flag for column-major numbering */
+    int stride_n, stride_w; /* Index distance of northern, western pixel */
+    int q, p, i, j; /* Unknown and pixel index, coordinates */
+    unsigned char flags; /* Stencil flags of a pixel */
+    double *row; /* Row of the lower triangle */
+    int ret; /* Return value */
+
+    transposed = op.height < op.width;
+
+    ret = cholesky_alloc(chol, op.n, transposed);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    stride_n = transposed ? 1 : op.width;
+    stride_w = transposed ? op.height : 1;
+
+    for (q = 0; q < op.n; q++)
+    {
+        if (transposed)
+        {
+            i = q % op.height;
+            j = q / op.height;
+            p = i * op.width + j;
+            chol->perm[q] = p;
+        }
+        else
+        {
+            p = q;
+        }
+
+        flags = op.flags[p];
+        chol->first[q] = q;
+
+        if (flags & ASI_STENCIL_W)
+        {
+            chol->first[q] = q - stride_w;
+        }
+        if ((flags & ASI_STENCIL_N) && q - stride_n < chol->first[q])
+        {
+            chol->first[q] = q - stride_n;
+        }
+    }
+
+    ret = cholesky_alloc_values(chol);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        banded_cholesky_delete(chol);
+        return ret;
+    }
+
+    for (q = 0; q < op.n; q++)
+    {
+        flags = op.flags[transposed ? chol->perm[q] : q];
+        row = chol->values + chol->row_start[q + 1] - 1;
+
+        /* The row ends with its diagonal entry */
+        if (flags & ASI_STENCIL_KNOWN)
+        {
+            row[0] = 1.0;
+            continue;
+        }
+
+        row[0] = (double) (flags >> ASI_STENCIL_DEG_SHIFT);
+
+        if (flags & ASI_STENCIL_N)
+        {
+            row[-stride_n] = -1.0;
+        }
+        if (flags & ASI_STENCIL_W)
+        {
+            row[-stride_w] = -1.0;
+        }
+    }
+
+    ret = cholesky_factor(chol);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        banded_cholesky_delete(chol);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees the memory of a factor.
+ * @chol    [I/O] Factor
+ */
+void banded_cholesky_delete(banded_cholesky_type *chol)
+{
+    free(chol->values);
+    free(chol->row_start);
+    free(chol->first);
+    free(chol->perm);
+
+    chol->values = NULL;
+    chol->row_start = NULL;
+    chol->first = NULL;
+    chol->perm = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Memory used by a factor in bytes.
+ * @chol    [ I ] Factor
+ */
+size_t banded_cholesky_bytes(const banded_cholesky_type *chol)
+{
+    size_t bytes;
+
+    bytes = chol->row_start[chol->n] * sizeof(double)
+        + (chol->n + 1) * sizeof(size_t) + chol->n * sizeof(int);
+
+    if (chol->perm != NULL)
+    {
+        bytes += chol->n * sizeof(int);
+    }
+
+    return bytes;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves A x = b with the factor A = L L^T: forward substitution with L row
+ * by row, backward substitution with L^T column by column. The factor is
+ * not modified, so one factor can serve several threads.
+ * @chol    [ I ] Factor
+ * @b       [ I ] Right-hand side
+ * @x       [ O ] Solution, may be the same array as b
+ */
+int banded_cholesky_solve(const banded_cholesky_type *chol, const double *b,
+        double *x)
+{
+    const double *li; /* Row of L */
+    double *y; /* Solution in factor numbering */
+    double xi; /* Solution component */
+    int i, k; /* Loop variables */
+
+    if (chol->perm != NULL)
+    {
+        y = (double *) malloc(chol->n * sizeof(double));
+
+        if (y == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        for (i = 0; i < chol->n; i++)
+        {
+            y[i] = b[chol->perm[i]];
+        }
+    }
+    else
+    {
+        y = x;
+
+        if (x != b)
+        {
+            memcpy(x, b, chol->n * sizeof(double));
+        }
+    }
+
+    /* Forward substitution L z = b */
+    for (i = 0; i < chol->n; i++)
+    {
+        li = chol->values + chol->row_start[i];
+        y[i] = (y[i] - cholesky_dot(li, y + chol->first[i],
+                    i - chol->first[i])) / li[i - chol->first[i]];
+    }
+
+    /* Backward substitution L^T x = z */
+    for (i = chol->n - 1; i >= 0; i--)
+    {
+        li = chol->values + chol->row_start[i];
+        xi = y[i] / li[i - chol->first[i]];
+        y[i] = xi;
+
+        for (k = 0; k < i - chol->first[i]; k++)
+        {
+            y[chol->first[i] + k] -= li[k] * xi;
+        }
+    }
+
+    if (chol->perm != NULL)
+    {
+        for (i = 0; i < chol->n; i++)
+        {
+            x[chol->perm[i]] = y[i];
+        }
+
+        free(y);
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises an empty factor cache.
+ * @cache     [ O ] Cache
+ * @max_bytes [ I ] Memory budget of the cached factors, 0 for no limit
+ */
+int cholesky_cache_init(cholesky_cache_type *cache, size_t max_bytes)
+{
+    memset(cache, 0, sizeof(cholesky_cache_type));
+    cache->max_bytes = max_bytes;
+
+    if (pthread_mutex_init(&cache->lock, NULL) != 0)
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees all cached factors.
+ * @cache   [I/O] Cache
+ */
+void cholesky_cache_delete(cholesky_cache_type *cache)
+{
+    cholesky_cache_entry_type *entry, *next;
+
+    for (entry = cache->entries; entry != NULL; entry = next)
+    {
+        next = entry->next;
+        banded_cholesky_delete(&entry->factor);
+        free(entry->flags);
+        free(entry);
+    }
+
+    cache->entries = NULL;
+    cache->bytes = 0;
+    pthread_mutex_destroy(&cache->lock);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * FNV-1a hash of the stencil flags of an operator.
+ * @op      [ I ] Inpainting operator
+ */
+static unsigned long cholesky_hash(const diffusion_operator_type op)
+{
+    unsigned long hash = 2166136261UL;
+    int k; /* Loop variable */
+
+    for (k = 0; k < op.n; k++)
+    {
+        hash = ((hash ^ op.flags[k]) * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Finds the entry of a window, the cache must be locked.
+ * @cache   [ I ] Cache
+ * @op      [ I ] Window operator
+ * @x0, y0  [ I ] Image coordinates of the window origin
+ * @hash    [ I ] Hash of the stencil flags
+ */
+static cholesky_cache_entry_type *cholesky_cache_find(
+        const cholesky_cache_type *cache, const diffusion_operator_type op,
+        int x0, int y0, unsigned long hash)
+{
+    cholesky_cache_entry_type *entry;
+
+    for (entry = cache->entries; entry != NULL; entry = entry->next)
+    {
+        if (entry->hash == hash && entry->x0 == x0 && entry->y0 == y0
+                && entry->width == op.width && entry->height == op.height
+                && memcmp(entry->flags, op.flags, op.n) == 0)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Returns the factor of a window operator. A cached factor is reused if the
+ * window position, size and stencil flags match, i.e. the same subdomain of
+ * the same mask. Otherwise the operator is factored into local and the
+ * factor is moved into the cache if it fits the memory budget. If the
+ * returned factor is local, the caller owns it and frees it after use.
+ * Cached factors remain valid until the cache is deleted.
+ * @cache   [I/O] Cache
+ * @op      [ I ] Window operator
+ * @x0, y0  [ I ] Image coordinates of the window origin
+ * @local   [ O ] Storage of an uncached factor
+ * @factor  [ O ] Factor of the operator, either cached or local
+ */
+int cholesky_cache_get(cholesky_cache_type *cache,
+        const diffusion_operator_type op, int x0, int y0,
+        banded_cholesky_type *local, const banded_cholesky_type **factor)
+{
+    cholesky_cache_entry_type *entry; /* Cache entry */
+    unsigned long hash; /* Hash of the stencil flags */
+    size_t bytes; /* Memory of a new entry */
+    int ret; /* Return value */
+
+    hash = cholesky_hash(op);
+
+    pthread_mutex_lock(&cache->lock);
+    entry = cholesky_cache_find(cache, op, x0, y0, hash);
+
+    if (entry != NULL)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (entry != NULL)
+    {
+        *factor = &entry->factor;
+        return ASI_EXIT_SUCCESS;
+    }
+
+    /* Factor outside the lock, other windows may be factored meanwhile */
+    ret = banded_cholesky_init_operator(local, op);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    *factor = local;
+    bytes = banded_cholesky_bytes(local) + op.n
+        + sizeof(cholesky_cache_entry_type);
+
+    pthread_mutex_lock(&cache->lock);
+
+    /* Another thread may have inserted the same window */
+    entry = cholesky_cache_find(cache, op, x0, y0, hash);
+
+    if (entry == NULL && (cache->max_bytes == 0
+                || cache->bytes + bytes <= cache->max_bytes))
+    {
+        entry = (cholesky_cache_entry_type *) malloc(
+                sizeof(cholesky_cache_entry_type));
+
+        if (entry != NULL)
+        {
+            entry->flags = (unsigned char *) malloc(op.n);
+
+            if (entry->flags == NULL)
+            {
+                free(entry);
+                entry = NULL;
+            }
+        }
+
+        /* Without memory for the entry, the factor stays local */
+        if (entry != NULL)
+        {
+            memcpy(entry->flags, op.flags, op.n);
+            entry->factor = *local;
+            entry->hash = hash;
+            entry->x0 = x0;
+            entry->y0 = y0;
+            entry->width = op.width;
+            entry->height = op.height;
+            entry->next = cache->entries;
+            cache->entries = entry;
+            cache->bytes += bytes;
+
+            memset(local, 0, sizeof(banded_cholesky_type));
+        }
+    }
+    else if (entry != NULL)
+    {
+        banded_cholesky_delete(local);
+    }
+
+    if (entry != NULL)
+    {
+        *factor = &entry->factor;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return ASI_EXIT_SUCCESS;
+}
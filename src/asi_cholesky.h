@@ -0,0 +1,82 @@
+#ifndef _ASI_CHOLESKY_H_
+#define _ASI_CHOLESKY_H_
+
+#include <stddef.h>
+#include <pthread.h>
+#include "asi_sparse.h"
+#include "asi_diffusion.h"
+
+/*
+ * Cholesky factor A = L L^T of a symmetric positive definite band matrix in
+ * envelope storage: row i of L holds the entries from its first non-zero
+ * column up to the diagonal. Cholesky creates no fill-in left of the first
+ * non-zero of a row, so identity rows of known pixels cost a single entry
+ * and rows of unknown pixels at most the bandwidth plus one.
+ */
+typedef struct banded_cholesky
+{
+    double *values; /* Rows of L, each ending with its diagonal entry */
+    size_t *row_start; /* Offset of each row within values, n + 1 entries */
+    int *first; /* Column of the first stored entry of each row */
+    int *perm; /* Pixel index of each unknown, NULL for the identity */
+    int n; /* Matrix dimension */
+    int bandwidth; /* Largest distance of an entry from the diagonal */
+} banded_cholesky_type;
+
+/* Cached factor of one subdomain */
+typedef struct cholesky_cache_entry
+{
+    banded_cholesky_type factor; /* Factor of the local operator */
+    unsigned char *flags; /* Stencil flags the factor was computed for */
+    unsigned long hash; /* Hash of the stencil flags */
+    int x0, y0; /* Image coordinates of the window origin */
+    int width, height; /* Window size */
+    struct cholesky_cache_entry *next; /* Next entry */
+} cholesky_cache_entry_type;
+
+/*
+ * Cache of subdomain factors keyed by window position and inpainting mask.
+ * Factors are kept until the cache is deleted; once the memory budget is
+ * exhausted, new factors are handed to the caller uncached. The cache can be
+ * shared between threads and reused across solves with the same mask.
+ */
+typedef struct cholesky_cache
+{
+    cholesky_cache_entry_type *entries; /* List of cached factors */
+    size_t max_bytes; /* Memory budget, 0 for no limit */
+    size_t bytes; /* Memory used by cached factors */
+    long hits; /* Number of lookups served from the cache */
+    long misses; /* Number of factorisations */
+    pthread_mutex_t lock; /* Lock protecting the entry list */
+} cholesky_cache_type;
+
+/* Factor a symmetric positive definite CDS matrix */
+int banded_cholesky_init(banded_cholesky_type *chol,
+        const cds_sparse_mat_type mat);
+
+/* Factor an inpainting operator, ordered along its shorter side */
+int banded_cholesky_init_operator(banded_cholesky_type *chol,
+        const diffusion_operator_type op);
+
+/* Free memory */
+void banded_cholesky_delete(banded_cholesky_type *chol);
+
+/* Memory used by a factor in bytes */
+size_t banded_cholesky_bytes(const banded_cholesky_type *chol);
+
+/* Solve A x = b with forward and backward substitution, x may equal b */
+int banded_cholesky_solve(const banded_cholesky_type *chol, const double *b,
+        double *x);
+
+/* Initialise an empty cache with a memory budget in bytes */
+int cholesky_cache_init(cholesky_cache_type *cache, size_t max_bytes);
+
+/* Free all cached factors */
+void cholesky_cache_delete(cholesky_cache_type *cache);
+
+/* Look up the factor of a window operator, factor it on a miss */
+int cholesky_cache_get(cholesky_cache_type *cache,
+        const diffusion_operator_type op, int x0, int y0,
+        banded_cholesky_type *local, const banded_cholesky_type **factor);
+
+#endif
@@ -1,8 +1,46 @@
 #include "asi_convolution.h"
+#include "asi_simd.h"
 #include <stdarg.h>
 #include <math.h>
 #include <stdlib.h>
 
+#ifdef ASI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Number of row bands per thread of a parallel convolution */
+#define CONVOLUTION_BANDS_PER_THREAD 4
+
+/* Number of columns per block of the y pass, sized for the L1 cache */
+#define CONVOLUTION_BLOCK_COLS 512
+
+/* Number of lines filtered side by side by the recursive Gaussian */
+#define CONVOLUTION_LANES 16
+
+/* Length of the mirrored extension of a line in standard deviations */
+#define CONVOLUTION_WARMUP_SIGMAS 4.0
+
+/* Shared state of a convolution in row bands, handed to the scheduler tasks */
+typedef struct convolution_context
+{
+    image_type src; /* Source image */
+    image_type tmp; /* Intermediate result */
+    image_type target; /* Target image */
+    const kernel_type *kernel; /* Convolution kernel */
+    int num_bands; /* Number of row bands */
+    double *lines; /* Line buffers of the recursive Gaussian, one per band */
+    int warmup; /* Length of the mirrored extension of a line */
+    int line_len; /* Length of a line buffer per lane */
+} convolution_context_type;
+
+/* Kernel correlating a row with 1D weights, see convolution_fir_scalar */
+typedef void (*convolution_fir_fn)(const double *, const double *, int,
+        double *, int);
+
+/* Kernel summing weighted rows, see convolution_columns_scalar */
+typedef void (*convolution_columns_fn)(const double *const *, const double *,
+        int, double *, int);
+
 /*----------------------------------------------------------------------------*/
 
 /*
@@ -18,6 +56,8 @@ int kernel_init(kernel_type *kernel, kernel_name_enum name, int argc, ...)
     va_list args;
     va_start(args, argc);
 
+    kernel->sigma = 0.0;
+
     /* Case: Kernel is a Gaussian */
     if (name == ASI_GAUSSIAN)
     {
@@ -42,9 +82,12 @@ int kernel_init(kernel_type *kernel, kernel_name_enum name, int argc, ...)
         /* Otherwise, return error code */
         else
         {
+            va_end(args);
             return ASI_EXIT_INVALID_ARG_COUNT;
         }
 
+        kernel->sigma = sigma;
+
         /* Size of kernel: Gaussian is separable so a 1D Gaussian suffices */
         int h_size = (int) round(sigma * accuracy);
         kernel->width = 2 * h_size + 1;
@@ -126,11 +169,65 @@ int kernel_init(kernel_type *kernel, kernel_name_enum name, int argc, ...)
         kernel->weights[5] = 1.0;
         kernel->weights[7] = 1.0;
     }
+    /* Case: Kernel is a recursive approximation of a Gaussian */
+    else if (name == ASI_RECURSIVE_GAUSSIAN)
+    {
+        double sigma; /* Standard deviation */
+        double q, b0, b1, b2, b3; /* Recursion parameters */
+
+        if (argc != 1)
+        {
+            va_end(args);
+            return ASI_EXIT_INVALID_ARG_COUNT;
+        }
+
+        sigma = va_arg(args, double);
+
+        /* The fitted parameters are only valid from sigma = 0.5 on */
+        if (sigma < 0.5)
+        {
+            va_end(args);
+            return ASI_EXIT_INVALID_VALUE;
+        }
+
+        /* Young and van Vliet (1995): Recursive implementation of the
+         * Gaussian filter. Signal Processing 44(2), pp. 139--151. */
+        q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330
+            : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+        b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+        b1 = 2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q;
+        b2 = -(1.4281 * q * q + 1.26661 * q * q * q);
+        b3 = 0.422205 * q * q * q;
+
+        kernel->width = 4;
+        kernel->height = 1;
+        kernel->name = name;
+        kernel->sigma = sigma;
+
+        kernel->weights = (double *) calloc (kernel->width * kernel->height,
+                sizeof(double));
+
+        if (kernel->weights == NULL)
+        {
+            va_end(args);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        /* w[n] = B x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3], B + sum a = 1 */
+        kernel->weights[1] = b1 / b0;
+        kernel->weights[2] = b2 / b0;
+        kernel->weights[3] = b3 / b0;
+        kernel->weights[0] = 1.0 - kernel->weights[1] - kernel->weights[2]
+            - kernel->weights[3];
+    }
     else
     {
+        va_end(args);
         return ASI_NOT_IMPLEMENTED_YET;
     }
 
+    va_end(args);
+
     return ASI_EXIT_SUCCESS;
 }
 
@@ -150,14 +247,14 @@ void kernel_delete(kernel_type *kernel)
 /*----------------------------------------------------------------------------*/
 
 /*
- * Non-destructive 2D convolution of an image with a convolution kernel.
+ * 2D convolution of a range of rows of an image.
  * @src     [ I ] Source image
  * @target  [ O ] Target image, needs to be initialised beforehand
  * @kernel  [ I ] 2D convolution kernel
+ * @i0, i1  [ I ] Half-open range of rows to be computed
  */
-// TODO incorporate different datatypes
-void image_convolution_2d(const image_type src, image_type target, 
-        const kernel_type kernel)
+static void convolution_2d_rows(const image_type src, image_type target,
+        const kernel_type kernel, int i0, int i1)
 {
     int i, j, k, l; /* Loop variables */
     int i_shifted, j_shifted; /* Loop variables shifted by convolution */
@@ -170,7 +267,7 @@ void image_convolution_2d(const image_type src, image_type target,
     half_h = (int) floor(kernel.height / 2.0);
 
     /* Loop over image */
-    for (i = 0; i < src.height; i++)
+    for (i = i0; i < i1; i++)
     {
         for (j = 0; j < src.width; j++)
         {
@@ -208,86 +305,184 @@ void image_convolution_2d(const image_type src, image_type target,
 /*----------------------------------------------------------------------------*/
 
 /*
- * Non-destructive 2D convolution leveraging the fact that some convolution
- * kernels can be seperated in two 1D convolutions (in x and y direction, 
- * respectively) which gives some speed-up over the standard 2D convolution.
- * @src     [ I ] Source image
- * @target  [ O ] Target image, needs to be initialised beforehand
- * @kernel  [ I ] 1D convolution kernel
+ * Correlation of a row with a 1D kernel without boundary handling:
+ * out[j] = sum_k w[k] in[j + k].
+ * @in      [ I ] Input row, n + taps - 1 values
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of output values
  */
-//TODO incorporate different datatypes
-void image_convolution_2d_seperable(const image_type src, image_type target,
-        const kernel_type kernel)
+static void convolution_fir_scalar(const double *in, const double *w,
+        int taps, double *out, int n)
 {
-    int i, j, k; /* Loop variables */
-    int i_shifted, j_shifted; /* Loop variables shifted by convolution */
-    int half_w; /* Half width and height of kernel */
-    double conv_sum; /* Convolution integrand */
-    double img_val; /* Pixel value */
-    double k_val; /* Kernel weight value */
-    image_type tmp; /* Image to store intermediate convolution result */
+    double s; /* Weighted sum */
+    int j, k; /* Loop variables */
 
-    half_w = (int) floor(kernel.width / 2.0);
+    for (j = 0; j < n; j++)
+    {
+        s = 0.0;
 
-    /* Initialise temporary image */
-    image_init(&tmp, src.width, src.height, ASI_DTYPE_DOUBLE);
+        for (k = 0; k < taps; k++)
+        {
+            s += w[k] * in[j + k];
+        }
+
+        out[j] = s;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Weighted sum of rows, i.e. a 1D convolution in y direction of n columns:
+ * out[j] = sum_k w[k] rows[k][j].
+ * @rows    [ I ] Input rows, one per weight
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of columns
+ */
+static void convolution_columns_scalar(const double *const *rows,
+        const double *w, int taps, double *out, int n)
+{
+    int j, k; /* Loop variables */
 
-    /* Convolve in x direction first */
-    for (i = 0; i < src.height; i++)
+    for (j = 0; j < n; j++)
     {
-        for (j = 0; j < src.width; j++)
+        out[j] = 0.0;
+    }
+
+    for (k = 0; k < taps; k++)
+    {
+        for (j = 0; j < n; j++)
         {
-            conv_sum = 0.0;
-            double k_sum = 0.0;
+            out[j] += w[k] * rows[k][j];
+        }
+    }
 
-            for (k = -half_w; k <= half_w; k++)
-            {
-                /* Mirror shifted x coordinate if necessary */
-                j_shifted = image_mirror_boundary_x(src, j+k);
+    return;
+}
 
-                /* Evaluate convolution at position (i, j+k) */
-                img_val = (double) image_fget(src, i, j_shifted);
-                k_val = (double) kernel.weights[k + half_w];
+#ifdef ASI_SIMD_X86
 
-                /* Add integrand to convolution sum */
-                conv_sum += img_val * k_val;
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of convolution_fir_scalar.
+ * @in      [ I ] Input row, n + taps - 1 values
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of output values
+ */
+ASI_TARGET_AVX2
+static void convolution_fir_avx2(const double *in, const double *w,
+        int taps, double *out, int n)
+{
+    __m256d s0, s1, wk; /* Weighted sums, broadcast weight */
+    int j, k; /* Loop variables */
 
-                k_sum += k_val;
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        s0 = s1 = _mm256_setzero_pd();
 
-            }
-            
-            /* Add convolution result to pixel at location (i,j) */
-            image_fput(tmp, conv_sum, i, j);
+        for (k = 0; k < taps; k++)
+        {
+            wk = _mm256_set1_pd(w[k]);
+            s0 = _mm256_fmadd_pd(wk, _mm256_loadu_pd(in + j + k), s0);
+            s1 = _mm256_fmadd_pd(wk, _mm256_loadu_pd(in + j + k + 4), s1);
         }
+
+        _mm256_storeu_pd(out + j, s0);
+        _mm256_storeu_pd(out + j + 4, s1);
     }
 
-    /* Convolve in y direction */
-    for (i = 0; i < src.height; i++)
+    convolution_fir_scalar(in + j, w, taps, out + j, n - j);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel of convolution_fir_scalar.
+ * @in      [ I ] Input row, n + taps - 1 values
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of output values
+ */
+ASI_TARGET_AVX512
+static void convolution_fir_avx512(const double *in, const double *w,
+        int taps, double *out, int n)
+{
+    __m512d s0, s1, wk; /* Weighted sums, broadcast weight */
+    int j, k; /* Loop variables */
+
+    for (j = 0; j + 16 <= n; j += 16)
     {
-        for (j = 0; j < src.width; j++)
+        s0 = s1 = _mm512_setzero_pd();
+
+        for (k = 0; k < taps; k++)
         {
-            conv_sum = 0.0;
+            wk = _mm512_set1_pd(w[k]);
+            s0 = _mm512_fmadd_pd(wk, _mm512_loadu_pd(in + j + k), s0);
+            s1 = _mm512_fmadd_pd(wk, _mm512_loadu_pd(in + j + k + 8), s1);
+        }
 
-            for (k = -half_w; k <= half_w; k++)
-            {
-                /* Mirror shifted y coordinate if necessary */
-                i_shifted = image_mirror_boundary_y(tmp, i+k);
+        _mm512_storeu_pd(out + j, s0);
+        _mm512_storeu_pd(out + j + 8, s1);
+    }
 
-                /* Evaluate convolution at position (i, j+k) */
-                img_val = (double) image_fget(tmp, i_shifted, j);
-                k_val = (double) kernel.weights[k + half_w];
+    convolution_fir_scalar(in + j, w, taps, out + j, n - j);
 
-                /* Add integrand to convolution sum */
-                conv_sum += img_val * k_val;
-            }
-            
-            /* Add convolution result to pixel at location (i,j) */
-            image_fput(target, conv_sum, i, j);
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of convolution_columns_scalar.
+ * @rows    [ I ] Input rows, one per weight
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of columns
+ */
+ASI_TARGET_AVX2
+static void convolution_columns_avx2(const double *const *rows,
+        const double *w, int taps, double *out, int n)
+{
+    __m256d s0, s1, wk; /* Weighted sums, broadcast weight */
+    int j, k; /* Loop variables */
+
+    for (j = 0; j + 8 <= n; j += 8)
+    {
+        s0 = s1 = _mm256_setzero_pd();
+
+        for (k = 0; k < taps; k++)
+        {
+            wk = _mm256_set1_pd(w[k]);
+            s0 = _mm256_fmadd_pd(wk, _mm256_loadu_pd(rows[k] + j), s0);
+            s1 = _mm256_fmadd_pd(wk, _mm256_loadu_pd(rows[k] + j + 4), s1);
         }
+
+        _mm256_storeu_pd(out + j, s0);
+        _mm256_storeu_pd(out + j + 4, s1);
     }
 
-    /* Remove temporary image */
-    image_delete(&tmp);
+    for (; j < n; j++)
+    {
+        out[j] = 0.0;
+
+        for (k = 0; k < taps; k++)
+        {
+            out[j] += w[k] * rows[k][j];
+        }
+    }
 
     return;
 }
@@ -295,48 +490,953 @@ void image_convolution_2d_seperable(const image_type src, image_type target,
 /*----------------------------------------------------------------------------*/
 
 /*
- *  Destructive convolution (original image does not get preserved) of an image 
- *  with a convolution kernel. Chooses the correct convolution procedure 
- *  depending on provided convolution kernel. 
- *  @image  [I/O] Image to be convolved 
- *  @kernel [ I ] Convolution kernel
+ * AVX-512 kernel of convolution_columns_scalar.
+ * @rows    [ I ] Input rows, one per weight
+ * @w       [ I ] Kernel weights
+ * @taps    [ I ] Number of weights
+ * @out     [ O ] Output row
+ * @n       [ I ] Number of columns
  */
-int image_convolve(image_type image, const kernel_type kernel)
+ASI_TARGET_AVX512
+static void convolution_columns_avx512(const double *const *rows,
+        const double *w, int taps, double *out, int n)
 {
-    int i, j; /* Loop variables */
-    image_type result; /* Temporary image for holding convolution results */
-    
-    /* Check that the input is double-valued */
-    if (image.dtype != ASI_DTYPE_DOUBLE)
+    __m512d s0, s1, wk; /* Weighted sums, broadcast weight */
+    int j, k; /* Loop variables */
+
+    for (j = 0; j + 16 <= n; j += 16)
     {
-        return ASI_EXIT_INVALID_DTYPE;
+        s0 = s1 = _mm512_setzero_pd();
+
+        for (k = 0; k < taps; k++)
+        {
+            wk = _mm512_set1_pd(w[k]);
+            s0 = _mm512_fmadd_pd(wk, _mm512_loadu_pd(rows[k] + j), s0);
+            s1 = _mm512_fmadd_pd(wk, _mm512_loadu_pd(rows[k] + j + 8), s1);
+        }
+
+        _mm512_storeu_pd(out + j, s0);
+        _mm512_storeu_pd(out + j + 8, s1);
     }
-    
-    /* Initialise temporary image by zeros */
-    image_init(&result, image.width, image.height, ASI_DTYPE_DOUBLE);
 
-    /* Check if kernel is a Gaussian (seperable in two 1D convolutions) */
-    if (kernel.name == ASI_GAUSSIAN)
+    for (; j < n; j++)
     {
-        image_convolution_2d_seperable(image, result, kernel);
+        out[j] = 0.0;
+
+        for (k = 0; k < taps; k++)
+        {
+            out[j] += w[k] * rows[k][j];
+        }
     }
-    else
+
+    return;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Selects the best row correlation kernel supported by the CPU.
+ */
+static convolution_fir_fn convolution_fir_kernel(void)
+{
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        return convolution_fir_avx512;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        return convolution_fir_avx2;
+    }
+#endif
+
+    return convolution_fir_scalar;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Selects the best row summation kernel supported by the CPU.
+ */
+static convolution_columns_fn convolution_columns_kernel(void)
+{
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        return convolution_columns_avx512;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        return convolution_columns_avx2;
+    }
+#endif
+
+    return convolution_columns_scalar;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * 1D convolution in x direction of a single row with mirrored boundaries.
+ * Columns whose kernel support lies inside the row are computed by a
+ * branch-free SIMD kernel directly on the row, and only the few columns
+ * near the borders read mirrored values.
+ * @src     [ I ] Source row
+ * @target  [ O ] Target row, different from the source
+ * @width   [ I ] Number of columns
+ * @kernel  [ I ] 1D convolution kernel
+ */
+void convolution_row_x(const double *src, double *target, int width,
+        const kernel_type kernel)
+{
+    double conv_sum; /* Convolution integrand */
+    int j, k; /* Loop variables */
+    int half_w; /* Half width of kernel */
+
+    half_w = kernel.width / 2;
+
+    /* Interior: the kernel support of column j starts at j - half_w */
+    if (width > 2 * half_w)
     {
-        image_convolution_2d(image, result, kernel);
+        convolution_fir_kernel()(src, kernel.weights, kernel.width,
+                target + half_w, width - 2 * half_w);
     }
 
-    //TODO create function for image_copy (without allocation)
-    for (i = 0; i < image.height; i++)
+    for (j = 0; j < width; j++)
     {
-        for (j = 0; j < image.width; j++)
+        /* Skip the interior done above */
+        if (j == half_w && width > 2 * half_w)
         {
-            double value = image_fget(result, i, j);
-            image_fput(image, value, i, j);
+            j = width - half_w - 1;
+            continue;
         }
+
+        conv_sum = 0.0;
+
+        for (k = -half_w; k <= half_w; k++)
+        {
+            conv_sum += kernel.weights[k + half_w]
+                * src[image_mirror_index(j + k, width)];
+        }
+
+        target[j] = conv_sum;
     }
 
-    /* Remove result image */
-    image_delete(&result);
-    
-    return ASI_EXIT_SUCCESS;
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * 1D convolution in y direction of a single row, given the source rows
+ * under the kernel with the boundary already mirrored.
+ * @rows    [ I ] Source rows, one per kernel weight
+ * @target  [ O ] Target row
+ * @width   [ I ] Number of columns
+ * @kernel  [ I ] 1D convolution kernel
+ */
+void convolution_row_y(const double *const *rows, double *target, int width,
+        const kernel_type kernel)
+{
+    convolution_columns_kernel()(rows, kernel.weights, kernel.width, target,
+            width);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * 1D convolution in x direction of a range of rows of an image.
+ * Double-valued images use convolution_row_x.
+ * @src     [ I ] Source image
+ * @target  [ O ] Target image, needs to be initialised beforehand
+ * @kernel  [ I ] 1D convolution kernel
+ * @i0, i1  [ I ] Half-open range of rows to be computed
+ */
+static void convolution_x_rows(const image_type src, image_type target,
+        const kernel_type kernel, int i0, int i1)
+{
+    double conv_sum; /* Convolution integrand */
+    int i, j, k; /* Loop variables */
+    int half_w; /* Half width of kernel */
+
+    half_w = kernel.width / 2;
+
+    if (src.dtype == ASI_DTYPE_DOUBLE && target.dtype == ASI_DTYPE_DOUBLE)
+    {
+        for (i = i0; i < i1; i++)
+        {
+            convolution_row_x((const double *) src.data + (size_t) i
+                    * src.width, (double *) target.data + (size_t) i
+                    * target.width, src.width, kernel);
+        }
+
+        return;
+    }
+
+    /* Generic path for other data types */
+    for (i = i0; i < i1; i++)
+    {
+        for (j = 0; j < src.width; j++)
+        {
+            conv_sum = 0.0;
+
+            for (k = -half_w; k <= half_w; k++)
+            {
+                conv_sum += kernel.weights[k + half_w] * image_fget(src, i,
+                        image_mirror_index(j + k, src.width));
+            }
+
+            image_fput(target, conv_sum, i, j);
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * 1D convolution in y direction of a range of rows of an image. For
+ * double-valued images, the mirrored source rows of an output row are
+ * looked up once, and a branch-free SIMD kernel sums them over blocks of
+ * columns small enough for the rows to stay in the L1 cache.
+ * @src     [ I ] Source image
+ * @target  [ O ] Target image, needs to be initialised beforehand
+ * @kernel  [ I ] 1D convolution kernel
+ * @i0, i1  [ I ] Half-open range of rows to be computed
+ */
+static void convolution_y_rows(const image_type src, image_type target,
+        const kernel_type kernel, int i0, int i1)
+{
+    convolution_columns_fn columns; /* Row summation kernel */
+    const double **rows = NULL; /* Mirrored source rows of an output row */
+    double conv_sum; /* Convolution integrand */
+    int i, j, k; /* Loop variables */
+    int j0, n; /* First column and width of a block */
+    int half_w; /* Half width of kernel */
+
+    half_w = kernel.width / 2;
+
+    if (src.dtype == ASI_DTYPE_DOUBLE && target.dtype == ASI_DTYPE_DOUBLE)
+    {
+        rows = (const double **) malloc(kernel.width * sizeof(double *));
+    }
+
+    /* Generic path for other data types */
+    if (rows == NULL)
+    {
+        for (i = i0; i < i1; i++)
+        {
+            for (j = 0; j < src.width; j++)
+            {
+                conv_sum = 0.0;
+
+                for (k = -half_w; k <= half_w; k++)
+                {
+                    conv_sum += kernel.weights[k + half_w] * image_fget(src,
+                            image_mirror_index(i + k, src.height), j);
+                }
+
+                image_fput(target, conv_sum, i, j);
+            }
+        }
+
+        return;
+    }
+
+    columns = convolution_columns_kernel();
+
+    for (j0 = 0; j0 < src.width; j0 += CONVOLUTION_BLOCK_COLS)
+    {
+        n = src.width - j0 < CONVOLUTION_BLOCK_COLS
+            ? src.width - j0 : CONVOLUTION_BLOCK_COLS;
+
+        for (i = i0; i < i1; i++)
+        {
+            for (k = 0; k < kernel.width; k++)
+            {
+                rows[k] = (const double *) src.data + (size_t)
+                    image_mirror_index(i + k - half_w, src.height)
+                    * src.width + j0;
+            }
+
+            columns(rows, kernel.weights, kernel.width, (double *)
+                    target.data + (size_t) i * target.width + j0, n);
+        }
+    }
+
+    free(rows);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Non-destructive 2D convolution of an image with a convolution kernel.
+ * @src     [ I ] Source image
+ * @target  [ O ] Target image, needs to be initialised beforehand
+ * @kernel  [ I ] 2D convolution kernel
+ */
+// TODO incorporate different datatypes
+void image_convolution_2d(const image_type src, image_type target, 
+        const kernel_type kernel)
+{
+    convolution_2d_rows(src, target, kernel, 0, src.height);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Non-destructive 2D convolution leveraging the fact that some convolution
+ * kernels can be seperated in two 1D convolutions (in x and y direction, 
+ * respectively) which gives some speed-up over the standard 2D convolution.
+ * @src     [ I ] Source image
+ * @target  [ O ] Target image, needs to be initialised beforehand
+ * @kernel  [ I ] 1D convolution kernel
+ */
+//TODO incorporate different datatypes
+void image_convolution_2d_seperable(const image_type src, image_type target,
+        const kernel_type kernel)
+{
+    image_type tmp; /* Image to store intermediate convolution result */
+
+    /* Initialise temporary image */
+    image_init(&tmp, src.width, src.height, ASI_DTYPE_DOUBLE);
+
+    /* Convolve in x direction first, then in y direction */
+    convolution_x_rows(src, tmp, kernel, 0, src.height);
+    convolution_y_rows(tmp, target, kernel, 0, src.height);
+
+    /* Remove temporary image */
+    image_delete(&tmp);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Row range of a band of a parallel convolution.
+ * @ctx     [ I ] Convolution context
+ * @index   [ I ] Band index
+ * @i0, i1  [ O ] Half-open range of rows
+ */
+static void convolution_band(const convolution_context_type *ctx, int index,
+        int *i0, int *i1)
+{
+    *i0 = (int) ((long) index * ctx->src.height / ctx->num_bands);
+    *i1 = (int) ((long) (index + 1) * ctx->src.height / ctx->num_bands);
+
+    return;
+}
+
+/*
+ * Task computing a band of a 2D convolution.
+ * @arg     [I/O] Convolution context
+ * @index   [ I ] Band index
+ */
+static void convolution_2d_task(void *arg, int index)
+{
+    convolution_context_type *ctx = (convolution_context_type *) arg;
+    int i0, i1; /* Row range */
+
+    convolution_band(ctx, index, &i0, &i1);
+    convolution_2d_rows(ctx->src, ctx->target, *ctx->kernel, i0, i1);
+
+    return;
+}
+
+/*
+ * Task computing a band of the x pass of a separable convolution.
+ * @arg     [I/O] Convolution context
+ * @index   [ I ] Band index
+ */
+static void convolution_x_task(void *arg, int index)
+{
+    convolution_context_type *ctx = (convolution_context_type *) arg;
+    int i0, i1; /* Row range */
+
+    convolution_band(ctx, index, &i0, &i1);
+    convolution_x_rows(ctx->src, ctx->tmp, *ctx->kernel, i0, i1);
+
+    return;
+}
+
+/*
+ * Task computing a band of the y pass of a separable convolution.
+ * @arg     [I/O] Convolution context
+ * @index   [ I ] Band index
+ */
+static void convolution_y_task(void *arg, int index)
+{
+    convolution_context_type *ctx = (convolution_context_type *) arg;
+    int i0, i1; /* Row range */
+
+    convolution_band(ctx, index, &i0, &i1);
+    convolution_y_rows(ctx->tmp, ctx->target, *ctx->kernel, i0, i1);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Separable convolution as a task graph on row bands. A band of the y pass
+ * starts as soon as the bands of the x pass it reads from are done, so there
+ * is no barrier between the passes. Since the x pass of a band only reads
+ * its own rows, the y pass writes to the image directly.
+ * @ctx     [I/O] Convolution context with source and temporary image
+ * @sched   [I/O] Task scheduler
+ */
+static int convolution_seperable_tasks(convolution_context_type *ctx,
+        scheduler_type *sched)
+{
+    scheduler_task_type *tasks; /* Bands of the x pass, then of the y pass */
+    int half_w; /* Half width of kernel */
+    int b, c; /* Loop variables */
+    int i0, i1, k0, k1; /* Row ranges */
+    int ret = ASI_EXIT_SUCCESS; /* Return value */
+
+    tasks = (scheduler_task_type *) malloc(2 * ctx->num_bands
+            * sizeof(scheduler_task_type));
+
+    if (tasks == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    half_w = (int) floor(ctx->kernel->width / 2.0);
+
+    for (b = 0; b < ctx->num_bands; b++)
+    {
+        scheduler_task_init(&tasks[b], convolution_x_task, ctx, b);
+        scheduler_task_init(&tasks[ctx->num_bands + b], convolution_y_task,
+                ctx, b);
+    }
+
+    /* Mirrored rows near the border stay within the kernel reach */
+    for (b = 0; b < ctx->num_bands && ret == ASI_EXIT_SUCCESS; b++)
+    {
+        convolution_band(ctx, b, &i0, &i1);
+
+        for (c = 0; c < ctx->num_bands && ret == ASI_EXIT_SUCCESS; c++)
+        {
+            convolution_band(ctx, c, &k0, &k1);
+
+            if (k1 > i0 - half_w && k0 < i1 + half_w)
+            {
+                ret = scheduler_task_depend(&tasks[ctx->num_bands + b],
+                        &tasks[c]);
+            }
+        }
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        for (b = 2 * ctx->num_bands - 1; b >= 0; b--)
+        {
+            scheduler_submit(sched, &tasks[b]);
+        }
+
+        scheduler_wait(sched);
+    }
+
+    for (b = 0; b < 2 * ctx->num_bands; b++)
+    {
+        scheduler_task_delete(&tasks[b]);
+    }
+
+    free(tasks);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Forward and backward recursion of the recursive Gaussian over
+ * CONVOLUTION_LANES lines stored side by side. Both directions start from
+ * the steady state of their first value, i.e. as if the line continued
+ * constantly; the mirrored extension of the lines moves this assumption
+ * far enough away from the image.
+ * @buf     [I/O] Lines, element l of position p at p * CONVOLUTION_LANES + l
+ * @len     [ I ] Number of positions
+ * @c       [ I ] Recursion coefficients B, a1, a2, a3
+ */
+static void convolution_recursive_scalar(double *buf, int len,
+        const double *c)
+{
+    double w1, w2, w3; /* Previous positions */
+    double *x; /* Current position */
+    int p, l; /* Loop variables */
+
+    for (l = 0; l < CONVOLUTION_LANES; l++)
+    {
+        w1 = w2 = w3 = buf[l];
+
+        for (p = 1; p < len; p++)
+        {
+            x = buf + (size_t) p * CONVOLUTION_LANES + l;
+            *x = c[0] * *x + c[3] * w3 + c[2] * w2 + c[1] * w1;
+            w3 = w2;
+            w2 = w1;
+            w1 = *x;
+        }
+
+        w2 = w3 = w1;
+
+        for (p = len - 2; p >= 0; p--)
+        {
+            x = buf + (size_t) p * CONVOLUTION_LANES + l;
+            *x = c[0] * *x + c[3] * w3 + c[2] * w2 + c[1] * w1;
+            w3 = w2;
+            w2 = w1;
+            w1 = *x;
+        }
+    }
+
+    return;
+}
+
+#ifdef ASI_SIMD_X86
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of convolution_recursive_scalar. The three previous positions
+ * stay in registers, so only the newest one is on the critical path.
+ * @buf     [I/O] Lines, element l of position p at p * CONVOLUTION_LANES + l
+ * @len     [ I ] Number of positions
+ * @c       [ I ] Recursion coefficients B, a1, a2, a3
+ */
+ASI_TARGET_AVX2
+static void convolution_recursive_avx2(double *buf, int len, const double *c)
+{
+    __m256d c0, c1, c2, c3; /* Broadcast coefficients */
+    __m256d w1[4], w2[4], w3[4], w; /* Previous positions, new value */
+    double *x; /* Current position */
+    int p, v; /* Loop variables */
+
+    c0 = _mm256_set1_pd(c[0]);
+    c1 = _mm256_set1_pd(c[1]);
+    c2 = _mm256_set1_pd(c[2]);
+    c3 = _mm256_set1_pd(c[3]);
+
+    for (v = 0; v < 4; v++)
+    {
+        w1[v] = w2[v] = w3[v] = _mm256_loadu_pd(buf + 4 * v);
+    }
+
+    for (p = 1; p < len; p++)
+    {
+        x = buf + (size_t) p * CONVOLUTION_LANES;
+
+        for (v = 0; v < 4; v++)
+        {
+            w = _mm256_mul_pd(c0, _mm256_loadu_pd(x + 4 * v));
+            w = _mm256_fmadd_pd(c3, w3[v], w);
+            w = _mm256_fmadd_pd(c2, w2[v], w);
+            w = _mm256_fmadd_pd(c1, w1[v], w);
+            _mm256_storeu_pd(x + 4 * v, w);
+            w3[v] = w2[v];
+            w2[v] = w1[v];
+            w1[v] = w;
+        }
+    }
+
+    for (v = 0; v < 4; v++)
+    {
+        w2[v] = w3[v] = w1[v];
+    }
+
+    for (p = len - 2; p >= 0; p--)
+    {
+        x = buf + (size_t) p * CONVOLUTION_LANES;
+
+        for (v = 0; v < 4; v++)
+        {
+            w = _mm256_mul_pd(c0, _mm256_loadu_pd(x + 4 * v));
+            w = _mm256_fmadd_pd(c3, w3[v], w);
+            w = _mm256_fmadd_pd(c2, w2[v], w);
+            w = _mm256_fmadd_pd(c1, w1[v], w);
+            _mm256_storeu_pd(x + 4 * v, w);
+            w3[v] = w2[v];
+            w2[v] = w1[v];
+            w1[v] = w;
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel of convolution_recursive_scalar.
+ * @buf     [I/O] Lines, element l of position p at p * CONVOLUTION_LANES + l
+ * @len     [ I ] Number of positions
+ * @c       [ I ] Recursion coefficients B, a1, a2, a3
+ */
+ASI_TARGET_AVX512
+static void convolution_recursive_avx512(double *buf, int len,
+        const double *c)
+{
+    __m512d c0, c1, c2, c3; /* Broadcast coefficients */
+    __m512d w1[2], w2[2], w3[2], w; /* Previous positions, new value */
+    double *x; /* Current position */
+    int p, v; /* Loop variables */
+
+    c0 = _mm512_set1_pd(c[0]);
+    c1 = _mm512_set1_pd(c[1]);
+    c2 = _mm512_set1_pd(c[2]);
+    c3 = _mm512_set1_pd(c[3]);
+
+    for (v = 0; v < 2; v++)
+    {
+        w1[v] = w2[v] = w3[v] = _mm512_loadu_pd(buf + 8 * v);
+    }
+
+    for (p = 1; p < len; p++)
+    {
+        x = buf + (size_t) p * CONVOLUTION_LANES;
+
+        for (v = 0; v < 2; v++)
+        {
+            w = _mm512_mul_pd(c0, _mm512_loadu_pd(x + 8 * v));
+            w = _mm512_fmadd_pd(c3, w3[v], w);
+            w = _mm512_fmadd_pd(c2, w2[v], w);
+            w = _mm512_fmadd_pd(c1, w1[v], w);
+            _mm512_storeu_pd(x + 8 * v, w);
+            w3[v] = w2[v];
+            w2[v] = w1[v];
+            w1[v] = w;
+        }
+    }
+
+    for (v = 0; v < 2; v++)
+    {
+        w2[v] = w3[v] = w1[v];
+    }
+
+    for (p = len - 2; p >= 0; p--)
+    {
+        x = buf + (size_t) p * CONVOLUTION_LANES;
+
+        for (v = 0; v < 2; v++)
+        {
+            w = _mm512_mul_pd(c0, _mm512_loadu_pd(x + 8 * v));
+            w = _mm512_fmadd_pd(c3, w3[v], w);
+            w = _mm512_fmadd_pd(c2, w2[v], w);
+            w = _mm512_fmadd_pd(c1, w1[v], w);
+            _mm512_storeu_pd(x + 8 * v, w);
+            w3[v] = w2[v];
+            w2[v] = w1[v];
+            w1[v] = w;
+        }
+    }
+
+    return;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Runs the recursion of the recursive Gaussian on a line buffer with the
+ * best kernel supported by the CPU.
+ * @buf     [I/O] Lines, element l of position p at p * CONVOLUTION_LANES + l
+ * @len     [ I ] Number of positions
+ * @c       [ I ] Recursion coefficients B, a1, a2, a3
+ */
+static void convolution_recursive_lines(double *buf, int len, const double *c)
+{
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        convolution_recursive_avx512(buf, len, c);
+        return;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        convolution_recursive_avx2(buf, len, c);
+        return;
+    }
+#endif
+
+    convolution_recursive_scalar(buf, len, c);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task of the x pass of a recursive Gaussian: the rows of a band are
+ * transposed in groups of CONVOLUTION_LANES into the line buffer of the
+ * band, extended by mirrored values on both ends, filtered and written back.
+ * @arg     [I/O] Convolution context
+ * @index   [ I ] Band index
+ */
+static void convolution_recursive_x_task(void *arg, int index)
+{
+    convolution_context_type *ctx = (convolution_context_type *) arg;
+    image_type image = ctx->target; /* Filtered image */
+    double *buf; /* Line buffer of the band */
+    double *row; /* Row of the image */
+    int i0, i1; /* Row range */
+    int r, n; /* First row and number of rows of a group */
+    int p, j, l; /* Loop variables */
+
+    convolution_band(ctx, index, &i0, &i1);
+    buf = ctx->lines + (size_t) index * ctx->line_len * CONVOLUTION_LANES;
+
+    for (r = i0; r < i1; r += CONVOLUTION_LANES)
+    {
+        n = i1 - r < CONVOLUTION_LANES ? i1 - r : CONVOLUTION_LANES;
+
+        for (l = 0; l < n; l++)
+        {
+            row = (double *) image.data + (size_t) (r + l) * image.width;
+
+            for (p = 0; p < image.width + 2 * ctx->warmup; p++)
+            {
+                buf[(size_t) p * CONVOLUTION_LANES + l] =
+                    row[image_mirror_index(p - ctx->warmup, image.width)];
+            }
+        }
+
+        convolution_recursive_lines(buf, image.width + 2 * ctx->warmup,
+                ctx->kernel->weights);
+
+        for (l = 0; l < n; l++)
+        {
+            row = (double *) image.data + (size_t) (r + l) * image.width;
+
+            for (j = 0; j < image.width; j++)
+            {
+                row[j] = buf[(size_t) (j + ctx->warmup) * CONVOLUTION_LANES
+                    + l];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task of the y pass of a recursive Gaussian: the columns of a band are
+ * filtered in groups of CONVOLUTION_LANES, whose rows are contiguous in
+ * the image and copied as a whole.
+ * @arg     [I/O] Convolution context
+ * @index   [ I ] Band index
+ */
+static void convolution_recursive_y_task(void *arg, int index)
+{
+    convolution_context_type *ctx = (convolution_context_type *) arg;
+    image_type image = ctx->target; /* Filtered image */
+    double *buf; /* Line buffer of the band */
+    double *row; /* Row of the image */
+    int j0, j1; /* Column range */
+    int c, n; /* First column and number of columns of a group */
+    int p, i, l; /* Loop variables */
+
+    j0 = (int) ((long) index * image.width / ctx->num_bands);
+    j1 = (int) ((long) (index + 1) * image.width / ctx->num_bands);
+    buf = ctx->lines + (size_t) index * ctx->line_len * CONVOLUTION_LANES;
+
+    for (c = j0; c < j1; c += CONVOLUTION_LANES)
+    {
+        n = j1 - c < CONVOLUTION_LANES ? j1 - c : CONVOLUTION_LANES;
+
+        for (p = 0; p < image.height + 2 * ctx->warmup; p++)
+        {
+            row = (double *) image.data + (size_t) image_mirror_index(p
+                    - ctx->warmup, image.height) * image.width + c;
+
+            for (l = 0; l < n; l++)
+            {
+                buf[(size_t) p * CONVOLUTION_LANES + l] = row[l];
+            }
+        }
+
+        convolution_recursive_lines(buf, image.height + 2 * ctx->warmup,
+                ctx->kernel->weights);
+
+        for (i = 0; i < image.height; i++)
+        {
+            row = (double *) image.data + (size_t) i * image.width + c;
+
+            for (l = 0; l < n; l++)
+            {
+                row[l] = buf[(size_t) (i + ctx->warmup) * CONVOLUTION_LANES
+                    + l];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * In-place recursive Gaussian, first along the rows, then along the columns.
+ * The cost per pixel does not depend on the standard deviation; only the
+ * mirrored extension of each line grows with it.
+ * @ctx     [I/O] Convolution context with the image as target
+ * @sched   [I/O] Task scheduler, NULL for serial execution
+ */
+static int convolution_recursive(convolution_context_type *ctx,
+        scheduler_type *sched)
+{
+    image_type image = ctx->target; /* Filtered image */
+    int b; /* Loop variable */
+
+    ctx->warmup = (int) ceil(CONVOLUTION_WARMUP_SIGMAS * ctx->kernel->sigma)
+        + 3;
+    ctx->line_len = (image.width > image.height ? image.width : image.height)
+        + 2 * ctx->warmup;
+    ctx->num_bands = ctx->num_bands > image.width
+        ? image.width : ctx->num_bands;
+
+    /* Lanes of partial groups hold stale but finite values */
+    ctx->lines = (double *) simd_calloc((size_t) ctx->num_bands
+            * ctx->line_len * CONVOLUTION_LANES, sizeof(double));
+
+    if (ctx->lines == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (sched == NULL)
+    {
+        for (b = 0; b < ctx->num_bands; b++)
+        {
+            convolution_recursive_x_task(ctx, b);
+        }
+
+        for (b = 0; b < ctx->num_bands; b++)
+        {
+            convolution_recursive_y_task(ctx, b);
+        }
+    }
+    else
+    {
+        scheduler_parallel_for(sched, ctx->num_bands,
+                convolution_recursive_x_task, ctx);
+        scheduler_parallel_for(sched, ctx->num_bands,
+                convolution_recursive_y_task, ctx);
+    }
+
+    free(ctx->lines);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  Destructive convolution (original image does not get preserved) of an image 
+ *  with a convolution kernel. Chooses the correct convolution procedure 
+ *  depending on provided convolution kernel. 
+ *  @image  [I/O] Image to be convolved 
+ *  @kernel [ I ] Convolution kernel
+ */
+int image_convolve(image_type image, const kernel_type kernel)
+{
+    return image_convolve_parallel(image, kernel, NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ *  Destructive convolution of an image with a convolution kernel, computed in
+ *  row bands by the tasks of a scheduler. The result equals the one of
+ *  image_convolve.
+ *  @image  [I/O] Image to be convolved 
+ *  @kernel [ I ] Convolution kernel
+ *  @sched  [I/O] Task scheduler, NULL for serial execution
+ */
+int image_convolve_parallel(image_type image, const kernel_type kernel,
+        scheduler_type *sched)
+{
+    int ret = ASI_EXIT_SUCCESS; /* Return value */
+    image_type result; /* Temporary image for holding convolution results */
+    convolution_context_type ctx; /* Shared state of the band tasks */
+    
+    /* Check that the input is double-valued */
+    if (image.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+    
+    ctx.src = image;
+    ctx.target = image;
+    ctx.kernel = &kernel;
+    ctx.num_bands = sched == NULL ? 1
+        : sched->num_threads * CONVOLUTION_BANDS_PER_THREAD;
+    ctx.num_bands = ctx.num_bands > image.height
+        ? image.height : ctx.num_bands;
+
+    /* Lines of the recursive Gaussian are filtered in place */
+    if (kernel.name == ASI_RECURSIVE_GAUSSIAN)
+    {
+        return convolution_recursive(&ctx, sched);
+    }
+
+    /* Initialise temporary image by zeros */
+    ret = image_init(&result, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ctx.tmp = result;
+
+    if (ctx.num_bands > 1 && kernel.name == ASI_GAUSSIAN)
+    {
+        /* Bands of the y pass write back to the image */
+        ret = convolution_seperable_tasks(&ctx, sched);
+    }
+    else
+    {
+        /* Check if kernel is a Gaussian (seperable in two 1D convolutions) */
+        if (kernel.name == ASI_GAUSSIAN)
+        {
+            /* The y pass writes back to the image, no copy needed */
+            convolution_x_rows(image, result, kernel, 0, image.height);
+            convolution_y_rows(result, image, kernel, 0, image.height);
+        }
+        else
+        {
+            if (ctx.num_bands > 1)
+            {
+                ctx.target = result;
+                scheduler_parallel_for(sched, ctx.num_bands,
+                        convolution_2d_task, &ctx);
+            }
+            else
+            {
+                image_convolution_2d(image, result, kernel);
+            }
+
+            ret = image_copy(result, image);
+        }
+    }
+
+    /* Remove result image */
+    image_delete(&result);
+
+    return ret;
 }
@@ -2,6 +2,7 @@
 #define _ASI_CONVOLUTION_H_
 
 #include "asi_image.h"
+#include "asi_scheduler.h"
 
 /* Supported kernel types */
 typedef enum kernel_name
@@ -9,7 +10,8 @@ typedef enum kernel_name
     ASI_GAUSSIAN,
     ASI_SOBEL_X,
     ASI_SOBEL_Y,
-    ASI_LAPLACIAN
+    ASI_LAPLACIAN,
+    ASI_RECURSIVE_GAUSSIAN /* IIR approximation, weights hold coefficients */
 } kernel_name_enum;
 
 /* Kernel struct */
@@ -19,6 +21,7 @@ typedef struct kernel
     kernel_name_enum name;
     int width;
     int height;
+    double sigma; /* Standard deviation of Gaussian kernels */
 } kernel_type;
 
 /* Initialisations of a kernel */
@@ -27,7 +30,19 @@ int kernel_init(kernel_type *kernel, kernel_name_enum name, int argc, ...);
 /* Memory deallocation of a kernel */
 void kernel_delete(kernel_type *kernel);
 
+/* 1D convolution of a single row with mirrored boundaries */
+void convolution_row_x(const double *src, double *target, int width,
+        const kernel_type kernel);
+
+/* 1D convolution in y direction of a single row from its source rows */
+void convolution_row_y(const double *const *rows, double *target, int width,
+        const kernel_type kernel);
+
 /* Convolution of an image with a kernel */
 int image_convolve(image_type image, kernel_type kernel);
 
+/* Convolution of an image with a kernel in parallel row bands */
+int image_convolve_parallel(image_type image, kernel_type kernel,
+        scheduler_type *sched);
+
 #endif
@@ -0,0 +1,740 @@
+#include "asi_dct.h"
+#include "asi_image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Largest prime radix of the mixed-radix FFT, beyond Bluestein is used */
+#define FFT_MAX_RADIX 31
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Splits the length of the mixed-radix transform into radices, preferring
+ * radix 4, then 2 and ascending odd primes. Returns the largest prime factor.
+ * @plan    [I/O] FFT plan receiving the factors of plan->m
+ */
+static int fft_factorise(fft_plan_type *plan)
+{
+    int m = plan->m;
+    int p; /* Candidate prime */
+    int largest = 1; /* Largest prime factor */
+
+    plan->num_factors = 0;
+
+    while (m % 4 == 0)
+    {
+        plan->factors[plan->num_factors++] = 4;
+        m /= 4;
+        largest = 2;
+    }
+
+    if (m % 2 == 0)
+    {
+        plan->factors[plan->num_factors++] = 2;
+        m /= 2;
+        largest = 2;
+    }
+
+    for (p = 3; m > 1; p += 2)
+    {
+        if ((long) p * p > m)
+        {
+            p = m;
+        }
+
+        while (m % p == 0)
+        {
+            plan->factors[plan->num_factors++] = p;
+            m /= p;
+            largest = p;
+        }
+    }
+
+    return largest;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Multiplies the inputs of a butterfly by their twiddle factors,
+ * a_q = w_(q-1) x_(q r + k) for 0 < q <= count.
+ * @w       [ I ] Twiddle factors of the group
+ * @xs      [ I ] Inputs of the group
+ * @r       [ I ] Distance of the butterfly inputs in complex numbers
+ * @k       [ I ] Index of the butterfly
+ * @count   [ I ] Number of twiddled inputs, radix - 1
+ * @a       [ O ] Twiddled inputs, starting at a[2]
+ */
+static inline void fft_twiddle(const double *w, const double *xs, int r,
+        int k, int count, double *a)
+{
+    int q; /* Loop variable */
+    double vr, vi; /* Input */
+
+    for (q = 1; q <= count; q++)
+    {
+        vr = xs[2 * (q * r + k)];
+        vi = xs[2 * (q * r + k) + 1];
+        a[2 * q] = w[2 * q - 2] * vr - w[2 * q - 1] * vi;
+        a[2 * q + 1] = w[2 * q - 2] * vi + w[2 * q - 1] * vr;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * One pass of the self-sorting Stockham FFT over all radices. Before the pass
+ * of radix p, x holds transforms of length ls interleaved with stride
+ * r p = m / ls. Each group of p of them is combined into a transform of length
+ * l = ls p by radix-p butterflies
+ * y_(j + t ls, k) = sum_q w_l^(j q) x_(j, q r + k) w_p^(t q),
+ * whose innermost loop over k runs over contiguous memory. Radices 2, 3, 4
+ * and 5 are unrolled, others evaluated naively. Returns the buffer holding
+ * the result, the other one is overwritten.
+ * @plan    [ I ] FFT plan providing radices and twiddle factors
+ * @x       [I/O] Input of m complex numbers, work memory
+ * @y       [ O ] Work memory of m complex numbers
+ */
+static double *fft_stockham(const fft_plan_type *plan, double *x, double *y)
+{
+    const double c3 = 0.86602540378443864676; /* sin(2 pi / 3) */
+    const double c51 = 0.30901699437494742410; /* cos(2 pi / 5) */
+    const double c52 = -0.80901699437494742410; /* cos(4 pi / 5) */
+    const double s51 = 0.95105651629515357212; /* sin(2 pi / 5) */
+    const double s52 = 0.58778525229247312917; /* sin(4 pi / 5) */
+    int f, j, k, q, t; /* Loop variables */
+    int p, ls, r; /* Radix, length of the input transforms, stride */
+    int lr; /* Distance of the butterfly outputs */
+    int m = plan->m;
+    int idx; /* Exponent of a root of unity modulo p */
+    const double *w; /* Twiddle factors w_l^(j q) of the current group */
+    const double *xs; /* Inputs of the current group */
+    double *ys, *swap; /* Outputs of the current group */
+    double a[2 * FFT_MAX_RADIX]; /* Twiddled butterfly inputs */
+    double sr, si, dr, di, s2r, s2i, d2r, d2i; /* Symmetric sums */
+    double ar, ai, br, bi, zr, zi, vr, vi; /* Partial results */
+
+    w = plan->twiddle;
+    ls = 1;
+
+    for (f = 0; f < plan->num_factors; f++)
+    {
+        p = plan->factors[f];
+        r = m / (ls * p);
+        lr = ls * r;
+
+        for (j = 0; j < ls; j++, w += 2 * (p - 1))
+        {
+            xs = x + 2 * j * r * p;
+            ys = y + 2 * j * r;
+
+            switch (p)
+            {
+                case 2:
+                    for (k = 0; k < r; k++)
+                    {
+                        fft_twiddle(w, xs, r, k, 1, a);
+                        ys[2 * k] = xs[2 * k] + a[2];
+                        ys[2 * k + 1] = xs[2 * k + 1] + a[3];
+                        ys[2 * (lr + k)] = xs[2 * k] - a[2];
+                        ys[2 * (lr + k) + 1] = xs[2 * k + 1] - a[3];
+                    }
+                    break;
+
+                case 3:
+                    for (k = 0; k < r; k++)
+                    {
+                        fft_twiddle(w, xs, r, k, 2, a);
+                        sr = a[2] + a[4];
+                        si = a[3] + a[5];
+                        dr = c3 * (a[2] - a[4]);
+                        di = c3 * (a[3] - a[5]);
+                        ar = xs[2 * k] - 0.5 * sr;
+                        ai = xs[2 * k + 1] - 0.5 * si;
+                        ys[2 * k] = xs[2 * k] + sr;
+                        ys[2 * k + 1] = xs[2 * k + 1] + si;
+                        ys[2 * (lr + k)] = ar + di;
+                        ys[2 * (lr + k) + 1] = ai - dr;
+                        ys[2 * (2 * lr + k)] = ar - di;
+                        ys[2 * (2 * lr + k) + 1] = ai + dr;
+                    }
+                    break;
+
+                case 4:
+                    /* Four-point DFT with w_4 = -i */
+                    for (k = 0; k < r; k++)
+                    {
+                        fft_twiddle(w, xs, r, k, 3, a);
+                        sr = xs[2 * k] + a[4];
+                        si = xs[2 * k + 1] + a[5];
+                        dr = xs[2 * k] - a[4];
+                        di = xs[2 * k + 1] - a[5];
+                        s2r = a[2] + a[6];
+                        s2i = a[3] + a[7];
+                        d2r = a[2] - a[6];
+                        d2i = a[3] - a[7];
+                        ys[2 * k] = sr + s2r;
+                        ys[2 * k + 1] = si + s2i;
+                        ys[2 * (lr + k)] = dr + d2i;
+                        ys[2 * (lr + k) + 1] = di - d2r;
+                        ys[2 * (2 * lr + k)] = sr - s2r;
+                        ys[2 * (2 * lr + k) + 1] = si - s2i;
+                        ys[2 * (3 * lr + k)] = dr - d2i;
+                        ys[2 * (3 * lr + k) + 1] = di + d2r;
+                    }
+                    break;
+
+                case 5:
+                    for (k = 0; k < r; k++)
+                    {
+                        fft_twiddle(w, xs, r, k, 4, a);
+                        sr = a[2] + a[8];
+                        si = a[3] + a[9];
+                        dr = a[2] - a[8];
+                        di = a[3] - a[9];
+                        s2r = a[4] + a[6];
+                        s2i = a[5] + a[7];
+                        d2r = a[4] - a[6];
+                        d2i = a[5] - a[7];
+                        ar = xs[2 * k] + c51 * sr + c52 * s2r;
+                        ai = xs[2 * k + 1] + c51 * si + c52 * s2i;
+                        br = xs[2 * k] + c52 * sr + c51 * s2r;
+                        bi = xs[2 * k + 1] + c52 * si + c51 * s2i;
+                        zr = s51 * dr + s52 * d2r;
+                        zi = s51 * di + s52 * d2i;
+                        vr = s52 * dr - s51 * d2r;
+                        vi = s52 * di - s51 * d2i;
+                        ys[2 * k] = xs[2 * k] + sr + s2r;
+                        ys[2 * k + 1] = xs[2 * k + 1] + si + s2i;
+                        ys[2 * (lr + k)] = ar + zi;
+                        ys[2 * (lr + k) + 1] = ai - zr;
+                        ys[2 * (2 * lr + k)] = br + vi;
+                        ys[2 * (2 * lr + k) + 1] = bi - vr;
+                        ys[2 * (3 * lr + k)] = br - vi;
+                        ys[2 * (3 * lr + k) + 1] = bi + vr;
+                        ys[2 * (4 * lr + k)] = ar - zi;
+                        ys[2 * (4 * lr + k) + 1] = ai + zr;
+                    }
+                    break;
+
+                default:
+                    /* Roots w_p^(t q) = w_m^(t q m / p), the exponent t q
+                     * is kept modulo p incrementally */
+                    for (k = 0; k < r; k++)
+                    {
+                        fft_twiddle(w, xs, r, k, p - 1, a);
+
+                        for (t = 0; t < p; t++)
+                        {
+                            sr = xs[2 * k];
+                            si = xs[2 * k + 1];
+                            idx = 0;
+
+                            for (q = 1; q < p; q++)
+                            {
+                                idx += t;
+                                idx -= idx >= p ? p : 0;
+                                vr = plan->roots[2 * idx * (m / p)];
+                                vi = plan->roots[2 * idx * (m / p) + 1];
+                                sr += vr * a[2 * q] - vi * a[2 * q + 1];
+                                si += vr * a[2 * q + 1] + vi * a[2 * q];
+                            }
+
+                            ys[2 * (t * lr + k)] = sr;
+                            ys[2 * (t * lr + k) + 1] = si;
+                        }
+                    }
+                    break;
+            }
+        }
+
+        ls *= p;
+        swap = x;
+        x = y;
+        y = swap;
+    }
+
+    return x;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a complex FFT of arbitrary length.
+ * @plan    [ O ] FFT plan
+ * @n       [ I ] Transform length
+ */
+int fft_plan_init(fft_plan_type *plan, int n)
+{
+    int f, j, k, q; /* Loop variables */
+    int p, ls; /* Radix, length of the input transforms of a pass */
+    long long t; /* Chirp index t^2 modulo 2n */
+    double angle; /* Angle of a root of unity */
+    double *w; /* Twiddle factors of the current pass */
+    double *res; /* Transformed chirp filter */
+
+    if (n < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->n = n;
+    plan->m = n;
+
+    /* Bluestein needs a cyclic convolution of length at least 2n - 1,
+     * choose the shortest one with radices up to 5 */
+    if (fft_factorise(plan) > FFT_MAX_RADIX)
+    {
+        plan->m = 2 * n - 1;
+
+        while (fft_factorise(plan) > 5)
+        {
+            plan->m++;
+        }
+    }
+
+    plan->twiddle = (double *) malloc(2 * plan->m * sizeof(double));
+    plan->roots = (double *) malloc(2 * plan->m * sizeof(double));
+    plan->work = (double *) malloc(2 * plan->m * sizeof(double));
+
+    if (plan->twiddle == NULL || plan->roots == NULL || plan->work == NULL)
+    {
+        fft_plan_delete(plan);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (k = 0; k < plan->m; k++)
+    {
+        angle = -2.0 * M_PI * k / plan->m;
+        plan->roots[2 * k] = cos(angle);
+        plan->roots[2 * k + 1] = sin(angle);
+    }
+
+    /* Twiddle factors w_l^(j q), 0 < q < p, of each pass in the order of
+     * use, m - 1 in total */
+    w = plan->twiddle;
+    ls = 1;
+
+    for (f = 0; f < plan->num_factors; f++)
+    {
+        p = plan->factors[f];
+
+        for (j = 0; j < ls; j++)
+        {
+            for (q = 1; q < p; q++, w += 2)
+            {
+                angle = -2.0 * M_PI * j * q / (ls * p);
+                w[0] = cos(angle);
+                w[1] = sin(angle);
+            }
+        }
+
+        ls *= p;
+    }
+
+    if (plan->m == n)
+    {
+        return ASI_EXIT_SUCCESS;
+    }
+
+    plan->chirp = (double *) malloc(2 * n * sizeof(double));
+    plan->chirp_fft = (double *) malloc(2 * plan->m * sizeof(double));
+    plan->scratch = (double *) malloc(2 * plan->m * sizeof(double));
+
+    if (plan->chirp == NULL || plan->chirp_fft == NULL
+            || plan->scratch == NULL)
+    {
+        fft_plan_delete(plan);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Chirp and its conjugate filter at offsets -(n-1), ..., n-1, stored
+     * cyclically */
+    memset(plan->work, 0, 2 * plan->m * sizeof(double));
+
+    for (k = 0; k < n; k++)
+    {
+        /* Reduce k^2 modulo 2n to keep the angle accurate */
+        t = ((long long) k * k) % (2LL * n);
+        angle = -M_PI * (double) t / n;
+        plan->chirp[2 * k] = cos(angle);
+        plan->chirp[2 * k + 1] = sin(angle);
+        plan->work[2 * k] = cos(angle);
+        plan->work[2 * k + 1] = -sin(angle);
+
+        if (k > 0)
+        {
+            plan->work[2 * (plan->m - k)] = cos(angle);
+            plan->work[2 * (plan->m - k) + 1] = -sin(angle);
+        }
+    }
+
+    res = fft_stockham(plan, plan->work, plan->scratch);
+    memcpy(plan->chirp_fft, res, 2 * plan->m * sizeof(double));
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of an FFT plan
+ * @plan    [ I ] Plan to be deleted
+ */
+void fft_plan_delete(fft_plan_type *plan)
+{
+    free(plan->twiddle);
+    free(plan->roots);
+    free(plan->chirp);
+    free(plan->chirp_fft);
+    free(plan->work);
+    free(plan->scratch);
+    plan->twiddle = plan->roots = plan->chirp = plan->chirp_fft = NULL;
+    plan->work = plan->scratch = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * In-place forward FFT X_k = sum_j x_j exp(-2 pi i j k / n). Lengths with a
+ * large prime factor are evaluated as the convolution
+ * X_k = w_k sum_j (x_j w_j) conj(w_(k-j)) with the chirp w_t, computed by
+ * transforms of a length with small radices. The inverse is obtained via
+ * conjugation. Uses the work memory of the plan, so a plan must not be shared
+ * between threads.
+ * @plan    [ I ] FFT plan
+ * @data    [I/O] n interleaved complex numbers
+ */
+void fft_forward(const fft_plan_type *plan, double *data)
+{
+    int k; /* Loop variable */
+    int n = plan->n, m = plan->m;
+    double *work = plan->work, *scratch = plan->scratch;
+    const double *w = plan->chirp, *h = plan->chirp_fft;
+    double *res; /* Buffer holding a transform */
+    double re, im; /* Temporaries */
+
+    if (n == m)
+    {
+        res = fft_stockham(plan, data, work);
+
+        if (res != data)
+        {
+            memcpy(data, res, 2 * n * sizeof(double));
+        }
+        return;
+    }
+
+    /* a_j = x_j w_j, zero-padded */
+    for (k = 0; k < n; k++)
+    {
+        work[2 * k] = data[2 * k] * w[2 * k] - data[2 * k + 1] * w[2 * k + 1];
+        work[2 * k + 1] = data[2 * k] * w[2 * k + 1]
+            + data[2 * k + 1] * w[2 * k];
+    }
+    memset(work + 2 * n, 0, 2 * (m - n) * sizeof(double));
+
+    res = fft_stockham(plan, work, scratch);
+
+    /* Pointwise product with the filter, conjugated for the inverse FFT */
+    for (k = 0; k < m; k++)
+    {
+        re = res[2 * k] * h[2 * k] - res[2 * k + 1] * h[2 * k + 1];
+        im = res[2 * k] * h[2 * k + 1] + res[2 * k + 1] * h[2 * k];
+        res[2 * k] = re;
+        res[2 * k + 1] = -im;
+    }
+
+    res = fft_stockham(plan, res, res == work ? scratch : work);
+
+    /* Undo the conjugation, scale and multiply by the chirp */
+    for (k = 0; k < n; k++)
+    {
+        re = res[2 * k] / m;
+        im = -res[2 * k + 1] / m;
+        data[2 * k] = re * w[2 * k] - im * w[2 * k + 1];
+        data[2 * k + 1] = re * w[2 * k + 1] + im * w[2 * k];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises real trigonometric transforms of length n. The cosine family
+ * uses Makhoul's reordering onto an FFT of length n, the sine family the odd
+ * extension to length 2n + 2.
+ * @plan    [ O ] Transform plan
+ * @n       [ I ] Transform length
+ * @family  [ I ] Transform family
+ */
+int dct_plan_init(dct_plan_type *plan, int n, dct_family_enum family)
+{
+    int k; /* Loop variable */
+    int len; /* FFT length */
+    int ret; /* Return value */
+
+    if (n < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    plan->n = n;
+    plan->family = family;
+    plan->cos_table = NULL;
+    plan->sin_table = NULL;
+    plan->buffer = NULL;
+
+    len = family == ASI_DCT_COSINE ? n : 2 * n + 2;
+    ret = fft_plan_init(&plan->fft, len);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    plan->buffer = (double *) malloc(2 * len * sizeof(double));
+
+    if (plan->buffer == NULL)
+    {
+        dct_plan_delete(plan);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (family == ASI_DCT_COSINE)
+    {
+        plan->cos_table = (double *) malloc(n * sizeof(double));
+        plan->sin_table = (double *) malloc(n * sizeof(double));
+
+        if (plan->cos_table == NULL || plan->sin_table == NULL)
+        {
+            dct_plan_delete(plan);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        for (k = 0; k < n; k++)
+        {
+            plan->cos_table[k] = cos(M_PI * k / (2.0 * n));
+            plan->sin_table[k] = sin(M_PI * k / (2.0 * n));
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of a transform plan
+ * @plan    [ I ] Plan to be deleted
+ */
+void dct_plan_delete(dct_plan_type *plan)
+{
+    fft_plan_delete(&plan->fft);
+    free(plan->buffer);
+    free(plan->cos_table);
+    free(plan->sin_table);
+    plan->buffer = plan->cos_table = plan->sin_table = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Position of the j-th element of Makhoul's reordering
+ * (x_0, x_2, x_4, ..., x_5, x_3, x_1).
+ * @j       [ I ] Index within the reordered sequence
+ * @n       [ I ] Sequence length
+ */
+static int dct_makhoul_index(int j, int n)
+{
+    return 2 * j < n ? 2 * j : 2 * (n - 1 - j) + 1;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * DCT-II y_k = sum_j x_j cos(pi k (j + 1/2) / n) of count rows of length n.
+ * With the FFT V of the reordered row v_j = x_(makhoul(j)), the coefficients
+ * are y_k = Re(exp(-i pi k / 2n) V_k). Two rows are transformed at once as
+ * real and imaginary part, separated by the Hermitian symmetry of real
+ * spectra. In-place operation (x == y) is allowed.
+ * @plan    [ I ] Plan of the cosine family
+ * @x       [ I ] Signals, row-major
+ * @y       [ O ] Coefficients, row-major
+ * @count   [ I ] Number of rows
+ */
+void dct_ii(const dct_plan_type *plan, const double *x, double *y,
+        int count)
+{
+    int j, k, r; /* Loop variables */
+    int n = plan->n;
+    int nk; /* Index of the mirrored frequency */
+    double *buf = plan->buffer;
+    const double *xa, *xb; /* Rows of a pair */
+    double *ya, *yb;
+    double zr, zi, vr, vi; /* Spectrum at k and n - k */
+    double c, s; /* Phase shift */
+
+    for (r = 0; r < count; r += 2)
+    {
+        xa = x + r * n;
+        xb = r + 1 < count ? xa + n : NULL;
+        ya = y + r * n;
+        yb = ya + n;
+
+        for (j = 0; j < n; j++)
+        {
+            buf[2 * j] = xa[dct_makhoul_index(j, n)];
+            buf[2 * j + 1] = xb != NULL ? xb[dct_makhoul_index(j, n)] : 0.0;
+        }
+
+        fft_forward(&plan->fft, buf);
+
+        for (k = 0; k < n; k++)
+        {
+            nk = k > 0 ? n - k : 0;
+            zr = buf[2 * k];
+            zi = buf[2 * k + 1];
+            vr = buf[2 * nk];
+            vi = buf[2 * nk + 1];
+            c = plan->cos_table[k];
+            s = plan->sin_table[k];
+
+            /* First row (Z_k + conj Z_(n-k)) / 2, second row
+             * (Z_k - conj Z_(n-k)) / 2i */
+            ya[k] = 0.5 * (c * (zr + vr) + s * (zi - vi));
+
+            if (xb != NULL)
+            {
+                yb[k] = 0.5 * (c * (zi + vi) - s * (zr - vr));
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * DCT-III y_j = x_0 / 2 + sum_(k>0) x_k cos(pi k (j + 1/2) / n) of count rows,
+ * the inverse of the DCT-II up to the factor n / 2. The Hermitian spectrum
+ * V_k = exp(i pi k / 2n) (x_k - i x_(n-k)) is transformed back and the
+ * Makhoul reordering undone. Two rows are transformed at once as real and
+ * imaginary part. In-place operation (x == y) is allowed.
+ * @plan    [ I ] Plan of the cosine family
+ * @x       [ I ] Coefficients, row-major
+ * @y       [ O ] Signals, row-major
+ * @count   [ I ] Number of rows
+ */
+void dct_iii(const dct_plan_type *plan, const double *x, double *y,
+        int count)
+{
+    int j, k, r; /* Loop variables */
+    int n = plan->n;
+    double *buf = plan->buffer;
+    const double *xa, *xb; /* Rows of a pair */
+    double *ya, *yb;
+    double pa, qa, pb, qb; /* Coefficients at k and n - k */
+    double c, s; /* Phase shift */
+
+    for (r = 0; r < count; r += 2)
+    {
+        xa = x + r * n;
+        xb = r + 1 < count ? xa + n : NULL;
+        ya = y + r * n;
+        yb = ya + n;
+
+        for (k = 0; k < n; k++)
+        {
+            c = plan->cos_table[k];
+            s = plan->sin_table[k];
+            pa = xa[k];
+            qa = k > 0 ? xa[n - k] : 0.0;
+            pb = xb != NULL ? xb[k] : 0.0;
+            qb = xb != NULL && k > 0 ? xb[n - k] : 0.0;
+
+            /* Conjugate of V_a + i V_b for the inverse via a forward FFT */
+            buf[2 * k] = c * pa + s * qa - (s * pb - c * qb);
+            buf[2 * k + 1] = -(s * pa - c * qa) - (c * pb + s * qb);
+        }
+
+        fft_forward(&plan->fft, buf);
+
+        for (j = 0; j < n; j++)
+        {
+            ya[dct_makhoul_index(j, n)] = 0.5 * buf[2 * j];
+
+            if (xb != NULL)
+            {
+                yb[dct_makhoul_index(j, n)] = -0.5 * buf[2 * j + 1];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * DST-I y_k = sum_j x_j sin(pi (j + 1) (k + 1) / (n + 1)) of count rows, its
+ * own inverse up to the factor (n + 1) / 2. The odd extension
+ * (0, x_0, ..., x_(n-1), 0, -x_(n-1), ..., -x_0) has the purely imaginary
+ * FFT Y_(k+1) = -2 i y_k, so two rows are packed into real and imaginary
+ * part without interference. In-place operation (x == y) is allowed.
+ * @plan    [ I ] Plan of the sine family
+ * @x       [ I ] Signals, row-major
+ * @y       [ O ] Coefficients, row-major
+ * @count   [ I ] Number of rows
+ */
+void dst_i(const dct_plan_type *plan, const double *x, double *y, int count)
+{
+    int j, k, r; /* Loop variables */
+    int n = plan->n;
+    double *buf = plan->buffer;
+    const double *xa, *xb; /* Rows of a pair */
+    double *ya, *yb;
+
+    for (r = 0; r < count; r += 2)
+    {
+        xa = x + r * n;
+        xb = r + 1 < count ? xa + n : NULL;
+        ya = y + r * n;
+        yb = ya + n;
+
+        buf[0] = buf[1] = 0.0;
+        buf[2 * (n + 1)] = buf[2 * (n + 1) + 1] = 0.0;
+
+        for (j = 0; j < n; j++)
+        {
+            buf[2 * (j + 1)] = xa[j];
+            buf[2 * (2 * n + 1 - j)] = -xa[j];
+            buf[2 * (j + 1) + 1] = xb != NULL ? xb[j] : 0.0;
+            buf[2 * (2 * n + 1 - j) + 1] = xb != NULL ? -xb[j] : 0.0;
+        }
+
+        fft_forward(&plan->fft, buf);
+
+        for (k = 0; k < n; k++)
+        {
+            ya[k] = -0.5 * buf[2 * (k + 1) + 1];
+
+            if (xb != NULL)
+            {
+                yb[k] = 0.5 * buf[2 * (k + 1)];
+            }
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,75 @@
+#ifndef _ASI_DCT_H_
+#define _ASI_DCT_H_
+
+/* Maximum number of prime factors of an FFT length */
+#define ASI_FFT_MAX_FACTORS 32
+
+/* Families of real trigonometric transforms */
+typedef enum dct_family
+{
+    ASI_DCT_COSINE, /* DCT-II and its inverse DCT-III */
+    ASI_DCT_SINE /* DST-I, its own inverse */
+} dct_family_enum;
+
+/*
+ * Complex FFT of arbitrary length. Lengths with small prime factors use a
+ * mixed-radix Stockham transform, lengths with a large prime factor are
+ * mapped onto one with radices up to 5 via Bluestein's algorithm. Complex
+ * numbers are stored as interleaved real and imaginary parts.
+ */
+typedef struct fft_plan
+{
+    int n; /* Transform length */
+    int m; /* Length of the mixed-radix transform */
+    int factors[ASI_FFT_MAX_FACTORS]; /* Radices of m */
+    int num_factors; /* Number of radices */
+    double *twiddle; /* Twiddle factors of the radix passes */
+    double *roots; /* Roots of unity exp(-2 pi i k / m), k < m */
+    double *chirp; /* Bluestein chirp exp(-pi i k^2 / n), NULL if n == m */
+    double *chirp_fft; /* FFT of the conjugate chirp filter */
+    double *work; /* Work memory of m complex numbers */
+    double *scratch; /* Work memory of Bluestein's convolution */
+} fft_plan_type;
+
+/*
+ * Plan of real trigonometric transforms of a fixed length. Rows are
+ * transformed in pairs packed into the real and imaginary part of one
+ * complex FFT.
+ */
+typedef struct dct_plan
+{
+    int n; /* Transform length */
+    dct_family_enum family; /* Transform family */
+    fft_plan_type fft; /* FFT of length n (cosine) or 2n + 2 (sine) */
+    double *cos_table; /* cos(pi k / 2n) for the cosine family */
+    double *sin_table; /* sin(pi k / 2n) for the cosine family */
+    double *buffer; /* Packed complex signal */
+} dct_plan_type;
+
+/* Initialise a complex FFT of length n */
+int fft_plan_init(fft_plan_type *plan, int n);
+
+/* Free memory */
+void fft_plan_delete(fft_plan_type *plan);
+
+/* In-place forward FFT of n interleaved complex numbers */
+void fft_forward(const fft_plan_type *plan, double *data);
+
+/* Initialise transforms of length n */
+int dct_plan_init(dct_plan_type *plan, int n, dct_family_enum family);
+
+/* Free memory */
+void dct_plan_delete(dct_plan_type *plan);
+
+/* DCT-II of count rows: y_k = sum_j x_j cos(pi k (j + 1/2) / n) */
+void dct_ii(const dct_plan_type *plan, const double *x, double *y,
+        int count);
+
+/* DCT-III of count rows: y_j = x_0 / 2 + sum_k x_k cos(pi k (j + 1/2) / n) */
+void dct_iii(const dct_plan_type *plan, const double *x, double *y,
+        int count);
+
+/* DST-I of count rows: y_k = sum_j x_j sin(pi (j + 1) (k + 1) / (n + 1)) */
+void dst_i(const dct_plan_type *plan, const double *x, double *y, int count);
+
+#endif
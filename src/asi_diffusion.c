@@ -0,0 +1,1763 @@
+#include "asi_diffusion.h"
+#include "asi_mask.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+
+#ifdef ASI_SIMD_X86
+#include <immintrin.h>
+#include <string.h>
+#endif
+
+/* Entries of interleaved RGB vectors processed at once, multiple of 3 */
+#define DIFFUSION_RGB_BLOCK 12
+
+/* Default relaxation parameter of SOR, i.e. Gauss-Seidel */
+#define SOR_OMEGA_DEFAULT 1.0
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Completes the stencil flags of an operator whose flags only mark known
+ * pixels so far: adds degrees and couplings to unknown neighbours.
+ * @op      [I/O] Inpainting operator
+ */
+static void diffusion_operator_build(diffusion_operator_type *op)
+{
+    int i, j, k; /* Loop variables */
+    int w = op->width, h = op->height;
+    int deg; /* Number of neighbours inside the image */
+    unsigned char flag; /* Stencil flags of a pixel */
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+            deg = (i > 0) + (i < h - 1) + (j > 0) + (j < w - 1);
+            flag = op->flags[k]
+                | (unsigned char) (deg << ASI_STENCIL_DEG_SHIFT);
+
+            if (!(flag & ASI_STENCIL_KNOWN))
+            {
+                if (i > 0 && !(op->flags[k - w] & ASI_STENCIL_KNOWN))
+                {
+                    flag |= ASI_STENCIL_N;
+                }
+                if (i < h - 1 && !(op->flags[k + w] & ASI_STENCIL_KNOWN))
+                {
+                    flag |= ASI_STENCIL_S;
+                }
+                if (j > 0 && !(op->flags[k - 1] & ASI_STENCIL_KNOWN))
+                {
+                    flag |= ASI_STENCIL_W;
+                }
+                if (j < w - 1 && !(op->flags[k + 1] & ASI_STENCIL_KNOWN))
+                {
+                    flag |= ASI_STENCIL_E;
+                }
+            }
+
+            op->flags[k] = flag;
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises the matrix-free inpainting operator. Instead of five diagonals
+ * of doubles only one byte per pixel is stored, which encodes whether the
+ * pixel is known, its couplings to unknown neighbours and its degree.
+ * @op      [ O ] Inpainting operator
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ */
+int diffusion_operator_init(diffusion_operator_type *op,
+        const image_type mask)
+{
+    int i, j; /* Loop variables */
+
+    if (mask.width < 1 || mask.height < 1)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    op->width = mask.width;
+    op->height = mask.height;
+    op->n = op->width * op->height;
+    op->flags = (unsigned char *) malloc((size_t) op->n);
+
+    if (op->flags == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (i = 0; i < op->height; i++)
+    {
+        for (j = 0; j < op->width; j++)
+        {
+            op->flags[i * op->width + j]
+                = mask_get(mask, i, j) ? ASI_STENCIL_KNOWN : 0;
+        }
+    }
+
+    diffusion_operator_build(op);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises the inpainting operator of the window [x0,x1) x [y0,y1) of a
+ * larger image, extended by a ring of one pixel wherever the image continues.
+ * Ring pixels are marked as known, so they carry Dirichlet data taken from
+ * the surrounding image, while the image boundary keeps its mirrored
+ * boundary conditions. The local problem is hence an ordinary inpainting
+ * problem that any solver of this library can be applied to.
+ * @op      [ O ] Inpainting operator of the extended window
+ * @global  [ I ] Inpainting operator of the whole image
+ * @x0, x1  [ I ] Column range of the window
+ * @y0, y1  [ I ] Row range of the window
+ * @wx0     [ O ] First image column of the extended window
+ * @wy0     [ O ] First image row of the extended window
+ */
+int diffusion_operator_init_window(diffusion_operator_type *op,
+        const diffusion_operator_type global, int x0, int x1, int y0, int y1,
+        int *wx0, int *wy0)
+{
+    int i, j; /* Loop variables */
+    int gi, gj; /* Global coordinates */
+
+    *wx0 = x0 > 0 ? x0 - 1 : 0;
+    *wy0 = y0 > 0 ? y0 - 1 : 0;
+
+    op->width = (x1 < global.width ? x1 + 1 : x1) - *wx0;
+    op->height = (y1 < global.height ? y1 + 1 : y1) - *wy0;
+    op->n = op->width * op->height;
+    op->flags = (unsigned char *) malloc((size_t) op->n);
+
+    if (op->flags == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (i = 0; i < op->height; i++)
+    {
+        gi = *wy0 + i;
+
+        for (j = 0; j < op->width; j++)
+        {
+            gj = *wx0 + j;
+
+            if (gi < y0 || gi >= y1 || gj < x0 || gj >= x1)
+            {
+                op->flags[i * op->width + j] = ASI_STENCIL_KNOWN;
+            }
+            else
+            {
+                op->flags[i * op->width + j]
+                    = global.flags[gi * global.width + gj] & ASI_STENCIL_KNOWN;
+            }
+        }
+    }
+
+    diffusion_operator_build(op);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises the inpainting operator of a window like
+ * diffusion_operator_init_window, but reads the mask directly, so the cost
+ * scales with the window instead of the image.
+ * @op      [ O ] Inpainting operator of the extended window
+ * @mask    [ I ] Inpainting mask of the whole image
+ * @x0, x1  [ I ] Column range of the window
+ * @y0, y1  [ I ] Row range of the window
+ * @wx0     [ O ] First image column of the extended window
+ * @wy0     [ O ] First image row of the extended window
+ */
+int diffusion_operator_init_mask_window(diffusion_operator_type *op,
+        const image_type mask, int x0, int x1, int y0, int y1, int *wx0,
+        int *wy0)
+{
+    int i, j; /* Loop variables */
+    int gi, gj; /* Global coordinates */
+
+    *wx0 = x0 > 0 ? x0 - 1 : 0;
+    *wy0 = y0 > 0 ? y0 - 1 : 0;
+
+    op->width = (x1 < mask.width ? x1 + 1 : x1) - *wx0;
+    op->height = (y1 < mask.height ? y1 + 1 : y1) - *wy0;
+    op->n = op->width * op->height;
+    op->flags = (unsigned char *) malloc((size_t) op->n);
+
+    if (op->flags == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (i = 0; i < op->height; i++)
+    {
+        gi = *wy0 + i;
+
+        for (j = 0; j < op->width; j++)
+        {
+            gj = *wx0 + j;
+
+            if (gi < y0 || gi >= y1 || gj < x0 || gj >= x1
+                    || mask_get(mask, gi, gj))
+            {
+                op->flags[i * op->width + j] = ASI_STENCIL_KNOWN;
+            }
+            else
+            {
+                op->flags[i * op->width + j] = 0;
+            }
+        }
+    }
+
+    diffusion_operator_build(op);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of the inpainting operator
+ * @op      [ I ] Operator to be deleted
+ */
+void diffusion_operator_delete(diffusion_operator_type *op)
+{
+    free(op->flags);
+    op->flags = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Applies the stencil at a single pixel, checking all couplings. Used on the
+ * image boundary where neighbours may not exist.
+ * @flag    [ I ] Stencil flags of the pixel
+ * @x       [ I ] Vector x
+ * @k       [ I ] Pixel index
+ * @w       [ I ] Image width
+ */
+static double diffusion_stencil_checked(unsigned char flag, const double *x,
+        int k, int w)
+{
+    double value; /* Stencil result */
+
+    if (flag & ASI_STENCIL_KNOWN)
+    {
+        return x[k];
+    }
+
+    value = (flag >> ASI_STENCIL_DEG_SHIFT) * x[k];
+
+    if (flag & ASI_STENCIL_N)
+    {
+        value -= x[k - w];
+    }
+    if (flag & ASI_STENCIL_S)
+    {
+        value -= x[k + w];
+    }
+    if (flag & ASI_STENCIL_W)
+    {
+        value -= x[k - 1];
+    }
+    if (flag & ASI_STENCIL_E)
+    {
+        value -= x[k + 1];
+    }
+
+    return value;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Matrix-free operator vector product b = A x. Away from the image boundary
+ * all four neighbours exist, so couplings are applied branch-free as 0 / 1
+ * weights taken from the stencil flags.
+ * @op      [ I ] Inpainting operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+void diffusion_operator_product(const diffusion_operator_type op,
+        const double *x, double *b)
+{
+    int i, j, k; /* Loop variables */
+    int w = op.width, h = op.height;
+    const unsigned char *flags = op.flags;
+    unsigned int f; /* Stencil flags of a pixel */
+    double value; /* Stencil result */
+
+    for (i = 0; i < h; i++)
+    {
+        /* Boundary rows */
+        if (i == 0 || i == h - 1 || w < 3)
+        {
+            for (j = 0; j < w; j++)
+            {
+                k = i * w + j;
+                b[k] = diffusion_stencil_checked(flags[k], x, k, w);
+            }
+
+            continue;
+        }
+
+        k = i * w;
+        b[k] = diffusion_stencil_checked(flags[k], x, k, w);
+
+        /* Interior pixels */
+        for (j = 1; j < w - 1; j++)
+        {
+            k = i * w + j;
+            f = flags[k];
+
+            value = (double) (f >> ASI_STENCIL_DEG_SHIFT) * x[k]
+                - (double) ((f >> 1) & 1) * x[k - w]
+                - (double) ((f >> 2) & 1) * x[k + w]
+                - (double) ((f >> 3) & 1) * x[k - 1]
+                - (double) ((f >> 4) & 1) * x[k + 1];
+
+            b[k] = (f & ASI_STENCIL_KNOWN) ? x[k] : value;
+        }
+
+        k = i * w + w - 1;
+        b[k] = diffusion_stencil_checked(flags[k], x, k, w);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Applies the stencil to the three channels of a single pixel, checking all
+ * couplings. Used on the image boundary where neighbours may not exist.
+ * @flag    [ I ] Stencil flags of the pixel
+ * @x       [ I ] Interleaved vector x
+ * @b       [ O ] Interleaved result vector b
+ * @k       [ I ] Pixel index
+ * @w       [ I ] Image width
+ */
+static void diffusion_stencil_checked_rgb(unsigned char flag, const double *x,
+        double *b, int k, int w)
+{
+    int c; /* Channel */
+    double deg; /* Degree of the pixel */
+
+    for (c = 0; c < 3; c++)
+    {
+        if (flag & ASI_STENCIL_KNOWN)
+        {
+            b[3 * k + c] = x[3 * k + c];
+            continue;
+        }
+
+        deg = flag >> ASI_STENCIL_DEG_SHIFT;
+        b[3 * k + c] = deg * x[3 * k + c];
+
+        if (flag & ASI_STENCIL_N)
+        {
+            b[3 * k + c] -= x[3 * (k - w) + c];
+        }
+        if (flag & ASI_STENCIL_S)
+        {
+            b[3 * k + c] -= x[3 * (k + w) + c];
+        }
+        if (flag & ASI_STENCIL_W)
+        {
+            b[3 * k + c] -= x[3 * (k - 1) + c];
+        }
+        if (flag & ASI_STENCIL_E)
+        {
+            b[3 * k + c] -= x[3 * (k + 1) + c];
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Matrix-free operator vector product b = A x for three channels stored
+ * interleaved (RGB). The stencil flags of a pixel are decoded once and
+ * applied to all channels, which are contiguous in memory.
+ * @op      [ I ] Inpainting operator
+ * @x       [ I ] Interleaved vector x of length 3 n
+ * @b       [ O ] Interleaved result vector b of length 3 n
+ */
+void diffusion_operator_product_rgb(const diffusion_operator_type op,
+        const double *x, double *b)
+{
+    int i, j, k; /* Loop variables */
+    int w = op.width, h = op.height;
+    unsigned int f; /* Stencil flags of a pixel */
+    double deg, wn, ws, ww, we; /* Stencil weights */
+    const double *xk; /* Channels of the current pixel */
+
+    for (i = 0; i < h; i++)
+    {
+        /* Boundary rows */
+        if (i == 0 || i == h - 1 || w < 3)
+        {
+            for (j = 0; j < w; j++)
+            {
+                diffusion_stencil_checked_rgb(op.flags[i * w + j], x, b,
+                        i * w + j, w);
+            }
+
+            continue;
+        }
+
+        diffusion_stencil_checked_rgb(op.flags[i * w], x, b, i * w, w);
+
+        /* Interior pixels, known pixels have weight 1 and no couplings */
+        for (j = 1; j < w - 1; j++)
+        {
+            k = i * w + j;
+            f = op.flags[k];
+            xk = x + 3 * k;
+
+            deg = (f & ASI_STENCIL_KNOWN) ? 1.0
+                : (double) (f >> ASI_STENCIL_DEG_SHIFT);
+            wn = (double) ((f >> 1) & 1);
+            ws = (double) ((f >> 2) & 1);
+            ww = (double) ((f >> 3) & 1);
+            we = (double) ((f >> 4) & 1);
+
+            b[3 * k] = deg * xk[0] - wn * xk[-3 * w] - ws * xk[3 * w]
+                - ww * xk[-3] - we * xk[3];
+            b[3 * k + 1] = deg * xk[1] - wn * xk[1 - 3 * w]
+                - ws * xk[1 + 3 * w] - ww * xk[-2] - we * xk[4];
+            b[3 * k + 2] = deg * xk[2] - wn * xk[2 - 3 * w]
+                - ws * xk[2 + 3 * w] - ww * xk[-1] - we * xk[5];
+        }
+
+        k = i * w + w - 1;
+        diffusion_stencil_checked_rgb(op.flags[k], x, b, k, w);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Adapter evaluating the matrix-free product through the generic linear
+ * operator interface.
+ * @data    [ I ] Inpainting operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+static void diffusion_linear_operator_product(const void *data,
+        const double *x, double *b)
+{
+    diffusion_operator_product(*(const diffusion_operator_type *) data, x, b);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Wraps the inpainting operator as a generic linear operator, e.g. to be
+ * passed to conjugate_gradient. The operator needs to outlive the wrapper.
+ * @op      [ I ] Inpainting operator
+ */
+linear_operator_type diffusion_linear_operator(
+        const diffusion_operator_type *op)
+{
+    linear_operator_type lin_op;
+
+    lin_op.product = diffusion_linear_operator_product;
+    lin_op.data = op;
+    lin_op.n = op->n;
+
+    return lin_op;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Right-hand side of the inpainting system: known values at known pixels,
+ * the sum of known neighbouring values at unknown pixels.
+ * @op      [ I ] Inpainting operator
+ * @f       [ I ] Image providing the known values
+ * @b       [ O ] Right-hand side
+ */
+void diffusion_operator_rhs(const diffusion_operator_type op,
+        const double *f, double *b)
+{
+    int i, j, k; /* Loop variables */
+    int w = op.width, h = op.height;
+    const unsigned char *flags = op.flags;
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+
+            if (flags[k] & ASI_STENCIL_KNOWN)
+            {
+                b[k] = f[k];
+                continue;
+            }
+
+            b[k] = 0.0;
+
+            if (i > 0 && (flags[k - w] & ASI_STENCIL_KNOWN))
+            {
+                b[k] += f[k - w];
+            }
+            if (i < h - 1 && (flags[k + w] & ASI_STENCIL_KNOWN))
+            {
+                b[k] += f[k + w];
+            }
+            if (j > 0 && (flags[k - 1] & ASI_STENCIL_KNOWN))
+            {
+                b[k] += f[k - 1];
+            }
+            if (j < w - 1 && (flags[k + 1] & ASI_STENCIL_KNOWN))
+            {
+                b[k] += f[k + 1];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Residual r = -[(I-C)(-Laplace)u + C(u-f)] of the inpainting equation on a
+ * range of rows, with C the mask and mirrored boundaries. Equals b - A u
+ * whenever u coincides with f at known pixels.
+ * @op          [ I ] Inpainting operator
+ * @f           [ I ] Image providing the known values
+ * @u           [ I ] Current iterate
+ * @r           [ O ] Residual, may be NULL if only its norm is needed
+ * @row_start   [ I ] First row
+ * @row_end     [ I ] Row after the last row
+ */
+double diffusion_operator_residual(const diffusion_operator_type op,
+        const double *f, const double *u, double *r, int row_start,
+        int row_end)
+{
+    int i, j, k; /* Loop variables */
+    int w = op.width, h = op.height;
+    const unsigned char *flags = op.flags;
+    double value; /* Residual at a pixel */
+    double sum; /* Squared residual norm */
+
+    sum = 0.0;
+    for (i = row_start; i < row_end; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+
+            if (flags[k] & ASI_STENCIL_KNOWN)
+            {
+                value = f[k] - u[k];
+            }
+            else if (i > 0 && i < h - 1 && j > 0 && j < w - 1)
+            {
+                value = u[k - w] + u[k + w] + u[k - 1] + u[k + 1]
+                    - 4.0 * u[k];
+            }
+            else
+            {
+                value = -(flags[k] >> ASI_STENCIL_DEG_SHIFT) * u[k];
+
+                if (i > 0)
+                {
+                    value += u[k - w];
+                }
+                if (i < h - 1)
+                {
+                    value += u[k + w];
+                }
+                if (j > 0)
+                {
+                    value += u[k - 1];
+                }
+                if (j < w - 1)
+                {
+                    value += u[k + 1];
+                }
+            }
+
+            if (r != NULL)
+            {
+                r[k] = value;
+            }
+
+            sum += value * value;
+        }
+    }
+
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Arguments of the row band tasks of a threaded SOR half-sweep
+ */
+typedef struct diffusion_sor_context
+{
+    diffusion_operator_type op; /* Inpainting operator */
+    double *u; /* Iterate */
+    const double *b; /* Right-hand side, may be NULL */
+    double omega; /* Relaxation parameter */
+    int color; /* Colour updated by the current half-sweep */
+    int num_bands; /* Number of row bands */
+    double *tmp; /* Scratch rows, one per band */
+} diffusion_sor_context_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * SOR update of a single pixel, checking all neighbours. Used on the image
+ * boundary where neighbours may not exist.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Iterate
+ * @b       [ I ] Right-hand side, may be NULL
+ * @i, j    [ I ] Pixel coordinates
+ * @omega   [ I ] Relaxation parameter
+ */
+static void diffusion_sor_checked(const diffusion_operator_type op, double *u,
+        const double *b, int i, int j, double omega)
+{
+    int w = op.width, h = op.height;
+    int k = i * w + j;
+    double sum; /* Right-hand side plus neighbouring values */
+
+    if (op.flags[k] & ASI_STENCIL_KNOWN)
+    {
+        return;
+    }
+
+    sum = b != NULL ? b[k] : 0.0;
+
+    if (i > 0)
+    {
+        sum += u[k - w];
+    }
+    if (i < h - 1)
+    {
+        sum += u[k + w];
+    }
+    if (j > 0)
+    {
+        sum += u[k - 1];
+    }
+    if (j < w - 1)
+    {
+        sum += u[k + 1];
+    }
+
+    u[k] += omega * (sum / (op.flags[k] >> ASI_STENCIL_DEG_SHIFT) - u[k]);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Scalar SOR update of the interior pixels of one colour in row i, starting
+ * at column first and skipping every other column.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Iterate
+ * @b       [ I ] Right-hand side, may be NULL
+ * @i       [ I ] Row, neither the first nor the last one
+ * @first   [ I ] First interior column of the colour, 1 or 2
+ * @j_end   [ I ] Column after the last interior column to be processed
+ * @omega   [ I ] Relaxation parameter
+ */
+static void diffusion_sor_interior_scalar(const diffusion_operator_type op,
+        double *u, const double *b, int i, int first, int j_end, double omega)
+{
+    int j, k; /* Loop variables */
+    int w = op.width;
+    double sum; /* Right-hand side plus neighbouring values */
+
+    for (j = first; j < j_end; j += 2)
+    {
+        k = i * w + j;
+
+        if (op.flags[k] & ASI_STENCIL_KNOWN)
+        {
+            continue;
+        }
+
+        sum = u[k - w] + u[k + w] + u[k - 1] + u[k + 1];
+
+        if (b != NULL)
+        {
+            sum += b[k];
+        }
+
+        u[k] += omega * (0.25 * sum - u[k]);
+    }
+
+    return;
+}
+
+#ifdef ASI_SIMD_X86
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 SOR update of the interior pixels of one colour in row i. The update
+ * is first evaluated for all columns into a scratch row, which only reads the
+ * iterate, and then stored with a mask selecting unknown pixels of the
+ * current colour. Separating both passes keeps loads of neighbouring values
+ * from waiting on overlapping masked stores.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Iterate
+ * @b       [ I ] Right-hand side, may be NULL
+ * @tmp     [ - ] Scratch row of the image width
+ * @i       [ I ] Row, neither the first nor the last one
+ * @first   [ I ] First interior column of the colour, 1 or 2
+ * @omega   [ I ] Relaxation parameter
+ */
+ASI_TARGET_AVX2
+static void diffusion_sor_interior_avx2(const diffusion_operator_type op,
+        double *u, const double *b, double *tmp, int i, int first,
+        double omega)
+{
+    int j, j_end; /* Loop variables */
+    int w = op.width;
+    double *row = u + (size_t) i * w;
+    const double *up = row - w, *down = row + w;
+    const double *b_row = b != NULL ? b + (size_t) i * w : NULL;
+    const unsigned char *flags = op.flags + (size_t) i * w;
+    unsigned int f4; /* Flags of four pixels */
+    __m256d v_omega = _mm256_set1_pd(omega);
+    __m256d v_quarter = _mm256_set1_pd(0.25);
+    __m256d x, sum; /* Current values and sums of neighbours */
+    __m256i v_one = _mm256_set1_epi64x(1);
+    __m256i known; /* Lanes of known pixels */
+    __m256i color = first == 1 ? _mm256_setr_epi64x(-1, 0, -1, 0)
+        : _mm256_setr_epi64x(0, -1, 0, -1);
+
+    j_end = 1 + ((w - 2) / 4) * 4;
+
+    for (j = 1; j < j_end; j += 4)
+    {
+        x = _mm256_loadu_pd(row + j);
+        sum = _mm256_add_pd(_mm256_add_pd(_mm256_loadu_pd(up + j),
+                    _mm256_loadu_pd(down + j)),
+                _mm256_add_pd(_mm256_loadu_pd(row + j - 1),
+                    _mm256_loadu_pd(row + j + 1)));
+
+        if (b_row != NULL)
+        {
+            sum = _mm256_add_pd(sum, _mm256_loadu_pd(b_row + j));
+        }
+
+        _mm256_storeu_pd(tmp + j, _mm256_fmadd_pd(v_omega,
+                    _mm256_fmsub_pd(v_quarter, sum, x), x));
+    }
+
+    for (j = 1; j < j_end; j += 4)
+    {
+        memcpy(&f4, flags + j, sizeof(f4));
+        known = _mm256_cmpeq_epi64(_mm256_and_si256(
+                    _mm256_cvtepu8_epi64(_mm_cvtsi32_si128((int) f4)), v_one),
+                v_one);
+        _mm256_maskstore_pd(row + j, _mm256_andnot_si256(known, color),
+                _mm256_loadu_pd(tmp + j));
+    }
+
+    diffusion_sor_interior_scalar(op, u, b, i, j_end + ((j_end - first) & 1),
+            w - 1, omega);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 SOR update of the interior pixels of one colour in row i, see
+ * diffusion_sor_interior_avx2.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Iterate
+ * @b       [ I ] Right-hand side, may be NULL
+ * @tmp     [ - ] Scratch row of the image width
+ * @i       [ I ] Row, neither the first nor the last one
+ * @first   [ I ] First interior column of the colour, 1 or 2
+ * @omega   [ I ] Relaxation parameter
+ */
+ASI_TARGET_AVX512
+static void diffusion_sor_interior_avx512(const diffusion_operator_type op,
+        double *u, const double *b, double *tmp, int i, int first,
+        double omega)
+{
+    int j, j_end; /* Loop variables */
+    int w = op.width;
+    double *row = u + (size_t) i * w;
+    const double *up = row - w, *down = row + w;
+    const double *b_row = b != NULL ? b + (size_t) i * w : NULL;
+    const unsigned char *flags = op.flags + (size_t) i * w;
+    long long f8; /* Flags of eight pixels */
+    __m512d v_omega = _mm512_set1_pd(omega);
+    __m512d v_quarter = _mm512_set1_pd(0.25);
+    __m512d x, sum; /* Current values and sums of neighbours */
+    __m512i v_one = _mm512_set1_epi64(1);
+    __mmask8 known; /* Lanes of known pixels */
+    __mmask8 color = first == 1 ? 0x55 : 0xAA;
+
+    j_end = 1 + ((w - 2) / 8) * 8;
+
+    for (j = 1; j < j_end; j += 8)
+    {
+        x = _mm512_loadu_pd(row + j);
+        sum = _mm512_add_pd(_mm512_add_pd(_mm512_loadu_pd(up + j),
+                    _mm512_loadu_pd(down + j)),
+                _mm512_add_pd(_mm512_loadu_pd(row + j - 1),
+                    _mm512_loadu_pd(row + j + 1)));
+
+        if (b_row != NULL)
+        {
+            sum = _mm512_add_pd(sum, _mm512_loadu_pd(b_row + j));
+        }
+
+        _mm512_storeu_pd(tmp + j, _mm512_fmadd_pd(v_omega,
+                    _mm512_fmsub_pd(v_quarter, sum, x), x));
+    }
+
+    for (j = 1; j < j_end; j += 8)
+    {
+        memcpy(&f8, flags + j, sizeof(f8));
+        known = _mm512_test_epi64_mask(
+                _mm512_cvtepu8_epi64(_mm_cvtsi64_si128(f8)), v_one);
+        _mm512_mask_storeu_pd(row + j, color & (__mmask8) ~known,
+                _mm512_loadu_pd(tmp + j));
+    }
+
+    diffusion_sor_interior_scalar(op, u, b, i, j_end + ((j_end - first) & 1),
+            w - 1, omega);
+
+    return;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * SOR update of all pixels of one colour in row i. Pixel (i, j) is red for
+ * colour 0 if i + j is even and black for colour 1 otherwise.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Iterate
+ * @b       [ I ] Right-hand side, may be NULL
+ * @tmp     [ - ] Scratch row of the image width
+ * @i       [ I ] Row
+ * @color   [ I ] Colour to be updated
+ * @omega   [ I ] Relaxation parameter
+ */
+static void diffusion_sor_row(const diffusion_operator_type op, double *u,
+        const double *b, double *tmp, int i, int color, double omega)
+{
+    int j; /* Loop variable */
+    int w = op.width, h = op.height;
+    int first = (i + color) & 1; /* First column of the colour */
+
+    /* Boundary rows */
+    if (i == 0 || i == h - 1 || w < 3)
+    {
+        for (j = first; j < w; j += 2)
+        {
+            diffusion_sor_checked(op, u, b, i, j, omega);
+        }
+
+        return;
+    }
+
+    if (first == 0)
+    {
+        diffusion_sor_checked(op, u, b, i, 0, omega);
+    }
+    if (((w - 1 - first) & 1) == 0)
+    {
+        diffusion_sor_checked(op, u, b, i, w - 1, omega);
+    }
+
+    first = first == 0 ? 2 : 1;
+
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        diffusion_sor_interior_avx512(op, u, b, tmp, i, first, omega);
+        return;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        diffusion_sor_interior_avx2(op, u, b, tmp, i, first, omega);
+        return;
+    }
+#endif
+
+    diffusion_sor_interior_scalar(op, u, b, i, first, w - 1, omega);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task updating one colour on a band of rows in a threaded half-sweep.
+ * @arg     [I/O] SOR context
+ * @index   [ I ] Band index
+ */
+static void diffusion_sor_band(void *arg, int index)
+{
+    diffusion_sor_context_type *ctx = (diffusion_sor_context_type *) arg;
+    int i; /* Loop variable */
+    int h = ctx->op.height;
+    int row_start = (int) ((long long) h * index / ctx->num_bands);
+    int row_end = (int) ((long long) h * (index + 1) / ctx->num_bands);
+    double *tmp = ctx->tmp + (size_t) index * ctx->op.width; /* Scratch */
+
+    for (i = row_start; i < row_end; i++)
+    {
+        diffusion_sor_row(ctx->op, ctx->u, ctx->b, tmp, i, ctx->color,
+                ctx->omega);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * In-place red-black successive over-relaxation for the inpainting system
+ * A u = b. Known pixels are left untouched and enter the update of their
+ * unknown neighbours with their current value, so for b = NULL the sweeps
+ * solve the homogeneous diffusion equation with u providing the known data.
+ * A right-hand side b is added at unknown pixels, which allows to smooth
+ * residual equations whose known pixels hold zero.
+ *
+ * Single-threaded sweeps are fused into one wavefront over the rows: row i
+ * of the first colour is followed by row i - 1 of the second colour, and
+ * sweep s + 1 trails sweep s by two rows. All sweeps thus pass over the
+ * image in a window of about 2 * sweeps rows that stays in cache, while the
+ * result is identical to sweeping the whole image colour by colour. With a
+ * scheduler of several threads, every half-sweep is split into row bands
+ * instead, which gives the same result since pixels of one colour do not
+ * depend on each other.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Double-valued image, initial guess with known values on
+ *                input and result on output
+ * @b       [ I ] Right-hand side at unknown pixels, may be NULL for zero
+ * @omega   [ I ] Relaxation parameter in (0, 2), <= 0 for Gauss-Seidel
+ * @sweeps  [ I ] Number of sweeps
+ * @reverse [ I ] Flag to update black pixels before red ones
+ * @sched   [I/O] Task scheduler, may be NULL for a single thread
+ */
+int diffusion_sor_red_black(const diffusion_operator_type op, image_type u,
+        const double *b, double omega, int sweeps, int reverse,
+        scheduler_type *sched)
+{
+    int t, s, c; /* Loop variables */
+    int h = op.height;
+    int row; /* Row of the wavefront */
+    double *ud = (double *) u.data;
+    double *tmp; /* Scratch row */
+    diffusion_sor_context_type ctx; /* Arguments of threaded half-sweeps */
+
+    if (u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (u.width != op.width || u.height != op.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (omega >= 2.0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    if (omega <= 0.0)
+    {
+        omega = SOR_OMEGA_DEFAULT;
+    }
+
+    reverse = reverse ? 1 : 0;
+
+    if (sched != NULL && sched->num_threads > 1 && h > 1)
+    {
+        ctx.op = op;
+        ctx.u = ud;
+        ctx.b = b;
+        ctx.omega = omega;
+        ctx.num_bands = 4 * sched->num_threads < h
+            ? 4 * sched->num_threads : h;
+        ctx.tmp = (double *) malloc((size_t) ctx.num_bands * op.width
+                * sizeof(double));
+
+        if (ctx.tmp == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        for (s = 0; s < sweeps; s++)
+        {
+            for (c = 0; c < 2; c++)
+            {
+                ctx.color = c ^ reverse;
+                scheduler_parallel_for(sched, ctx.num_bands,
+                        diffusion_sor_band, &ctx);
+            }
+        }
+
+        free(ctx.tmp);
+
+        return ASI_EXIT_SUCCESS;
+    }
+
+    tmp = (double *) malloc(op.width * sizeof(double));
+
+    if (tmp == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (t = 0; t < h + 2 * sweeps - 1; t++)
+    {
+        for (s = 0; s < sweeps; s++)
+        {
+            row = t - 2 * s;
+
+            if (row >= 0 && row < h)
+            {
+                diffusion_sor_row(op, ud, b, tmp, row, reverse, omega);
+            }
+            if (row - 1 >= 0 && row - 1 < h)
+            {
+                diffusion_sor_row(op, ud, b, tmp, row - 1, 1 - reverse, omega);
+            }
+        }
+    }
+
+    free(tmp);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Builds the reduced system over the unknown pixels. Northern and southern
+ * neighbours are matched by merging the unknowns of adjacent rows, which are
+ * sorted by column, so no index map of the whole image is needed.
+ * @red     [ O ] Reduced operator
+ * @op      [ I ] Inpainting operator of the whole image
+ */
+int diffusion_reduced_init(diffusion_reduced_type *red,
+        const diffusion_operator_type op)
+{
+    int i, j, k, p; /* Loop variables */
+    int w = op.width, h = op.height;
+    int *row_start; /* First unknown of each row */
+
+    red->width = w;
+    red->height = h;
+    red->n = 0;
+
+    for (p = 0; p < op.n; p++)
+    {
+        red->n += !(op.flags[p] & ASI_STENCIL_KNOWN);
+    }
+
+    red->pixel = (int *) malloc((red->n + 1) * sizeof(int));
+    red->north = (int *) malloc((red->n + 1) * sizeof(int));
+    red->south = (int *) malloc((red->n + 1) * sizeof(int));
+    red->flags = (unsigned char *) malloc(red->n + 1);
+    row_start = (int *) malloc((h + 1) * sizeof(int));
+
+    if (red->pixel == NULL || red->north == NULL || red->south == NULL
+            || red->flags == NULL || row_start == NULL)
+    {
+        free(row_start);
+        diffusion_reduced_delete(red);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Number unknowns in row-major order */
+    k = 0;
+    for (i = 0; i < h; i++)
+    {
+        row_start[i] = k;
+
+        for (j = 0; j < w; j++)
+        {
+            p = i * w + j;
+
+            if (!(op.flags[p] & ASI_STENCIL_KNOWN))
+            {
+                red->pixel[k] = p;
+                red->flags[k] = op.flags[p];
+                red->north[k] = k;
+                red->south[k] = k;
+                k++;
+            }
+        }
+    }
+    row_start[h] = k;
+
+    /* Match vertical neighbours of adjacent rows */
+    for (i = 1; i < h; i++)
+    {
+        p = row_start[i - 1];
+
+        for (k = row_start[i]; k < row_start[i + 1]; k++)
+        {
+            if (!(red->flags[k] & ASI_STENCIL_N))
+            {
+                continue;
+            }
+
+            while (red->pixel[p] < red->pixel[k] - w)
+            {
+                p++;
+            }
+
+            red->north[k] = p;
+            red->south[p] = k;
+        }
+    }
+
+    free(row_start);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of the reduced operator
+ * @red     [ I ] Reduced operator to be deleted
+ */
+void diffusion_reduced_delete(diffusion_reduced_type *red)
+{
+    free(red->pixel);
+    free(red->north);
+    free(red->south);
+    free(red->flags);
+    red->pixel = red->north = red->south = NULL;
+    red->flags = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reduced operator vector product b = A x. Couplings are applied branch-free
+ * as 0 / 1 weights; uncoupled neighbours point to the unknown itself.
+ * @red     [ I ] Reduced operator
+ * @x       [ I ] Vector x over the unknowns
+ * @b       [ O ] Result vector b over the unknowns
+ */
+void diffusion_reduced_product(const diffusion_reduced_type red,
+        const double *x, double *b)
+{
+    int k; /* Loop variable */
+    unsigned int f; /* Stencil flags of an unknown */
+    const int *north = red.north, *south = red.south;
+    const unsigned char *flags = red.flags;
+
+    for (k = 0; k < red.n; k++)
+    {
+        f = flags[k];
+
+        b[k] = (double) (f >> ASI_STENCIL_DEG_SHIFT) * x[k]
+            - (double) ((f >> 1) & 1) * x[north[k]]
+            - (double) ((f >> 2) & 1) * x[south[k]]
+            - (double) ((f >> 3) & 1) * x[k - ((f >> 3) & 1)]
+            - (double) ((f >> 4) & 1) * x[k + ((f >> 4) & 1)];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Adapter evaluating the reduced product through the generic linear
+ * operator interface.
+ * @data    [ I ] Reduced operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+static void diffusion_reduced_linear_product(const void *data,
+        const double *x, double *b)
+{
+    diffusion_reduced_product(*(const diffusion_reduced_type *) data, x, b);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Wraps the reduced operator as a generic linear operator. The operator
+ * needs to outlive the wrapper.
+ * @red     [ I ] Reduced operator
+ */
+linear_operator_type diffusion_reduced_linear_operator(
+        const diffusion_reduced_type *red)
+{
+    linear_operator_type lin_op;
+
+    lin_op.product = diffusion_reduced_linear_product;
+    lin_op.data = red;
+    lin_op.n = red->n;
+
+    return lin_op;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Right-hand side of the reduced system: the sum of known neighbouring
+ * values of each unknown. Neighbours inside the image that are not coupled
+ * are known.
+ * @red     [ I ] Reduced operator
+ * @f       [ I ] Image providing the known values
+ * @b       [ O ] Right-hand side over the unknowns
+ */
+void diffusion_reduced_rhs(const diffusion_reduced_type red,
+        const double *f, double *b)
+{
+    int i, j, k, p; /* Loop variables */
+    int w = red.width, h = red.height;
+    unsigned char flag; /* Stencil flags of an unknown */
+
+    for (k = 0; k < red.n; k++)
+    {
+        p = red.pixel[k];
+        i = p / w;
+        j = p - i * w;
+        flag = red.flags[k];
+
+        b[k] = 0.0;
+
+        if (i > 0 && !(flag & ASI_STENCIL_N))
+        {
+            b[k] += f[p - w];
+        }
+        if (i < h - 1 && !(flag & ASI_STENCIL_S))
+        {
+            b[k] += f[p + w];
+        }
+        if (j > 0 && !(flag & ASI_STENCIL_W))
+        {
+            b[k] += f[p - 1];
+        }
+        if (j < w - 1 && !(flag & ASI_STENCIL_E))
+        {
+            b[k] += f[p + 1];
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Copies the unknown pixels of an image into a reduced vector.
+ * @red     [ I ] Reduced operator
+ * @u       [ I ] Image data
+ * @x       [ O ] Vector over the unknowns
+ */
+void diffusion_reduced_gather(const diffusion_reduced_type red,
+        const double *u, double *x)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k < red.n; k++)
+    {
+        x[k] = u[red.pixel[k]];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Copies a reduced vector into the unknown pixels of an image.
+ * @red     [ I ] Reduced operator
+ * @x       [ I ] Vector over the unknowns
+ * @u       [I/O] Image data, known pixels are left untouched
+ */
+void diffusion_reduced_scatter(const diffusion_reduced_type red,
+        const double *x, double *u)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k < red.n; k++)
+    {
+        u[red.pixel[k]] = x[k];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting on the whole image with the conjugate
+ * gradient method applied to the matrix-free inpainting operator.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ */
+int diffusion_inpainting_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps)
+{
+    diffusion_operator_type op; /* Inpainting operator */
+    double *b; /* Right-hand side */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    ret = diffusion_operator_init(&op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    b = (double *) malloc(op.n * sizeof(double));
+
+    if (b == NULL)
+    {
+        diffusion_operator_delete(&op);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    diffusion_operator_rhs(op, (const double *) image.data, b);
+
+    ret = conjugate_gradient(diffusion_linear_operator(&op), b,
+            (double *) u.data, iter, eps);
+
+    free(b);
+    diffusion_operator_delete(&op);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Per-channel scalar products of two interleaved RGB vectors. Blocks of
+ * DIFFUSION_RGB_BLOCK entries are accumulated lane by lane, which keeps the
+ * channel of every lane fixed and lets the loop be vectorised.
+ * @a, b    [ I ] Interleaved vectors of length 3 n
+ * @n       [ I ] Number of pixels
+ * @dot     [ O ] Scalar products of the three channels
+ */
+static void diffusion_rgb_dot(const double *a, const double *b, int n,
+        double *dot)
+{
+    int k, l; /* Loop variables */
+    int len = 3 * n; /* Vector length */
+    double acc[DIFFUSION_RGB_BLOCK] = {0.0}; /* Lane accumulators */
+
+    for (k = 0; k + DIFFUSION_RGB_BLOCK <= len; k += DIFFUSION_RGB_BLOCK)
+    {
+        for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+        {
+            acc[l] += a[k + l] * b[k + l];
+        }
+    }
+
+    for (l = 0; k + l < len; l++)
+    {
+        acc[l] += a[k + l] * b[k + l];
+    }
+
+    dot[0] = dot[1] = dot[2] = 0.0;
+    for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+    {
+        dot[l % 3] += acc[l];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Per-channel CG update x += alpha p, r -= alpha q on interleaved RGB vectors.
+ * Returns the squared residual norms of the three channels in rr.
+ * @x, r    [I/O] Solution and residual
+ * @p, q    [ I ] Search direction and A times p
+ * @alpha   [ I ] Step sizes of the three channels
+ * @n       [ I ] Number of pixels
+ * @rr      [ O ] Squared residual norms of the three channels
+ */
+static void diffusion_rgb_update(double *x, double *r, const double *p,
+        const double *q, const double *alpha, int n, double *rr)
+{
+    int k, l; /* Loop variables */
+    int len = 3 * n; /* Vector length */
+    double a[DIFFUSION_RGB_BLOCK]; /* Step sizes per lane */
+    double acc[DIFFUSION_RGB_BLOCK] = {0.0}; /* Lane accumulators */
+
+    for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+    {
+        a[l] = alpha[l % 3];
+    }
+
+    for (k = 0; k + DIFFUSION_RGB_BLOCK <= len; k += DIFFUSION_RGB_BLOCK)
+    {
+        for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+        {
+            x[k + l] += a[l] * p[k + l];
+            r[k + l] -= a[l] * q[k + l];
+            acc[l] += r[k + l] * r[k + l];
+        }
+    }
+
+    for (l = 0; k + l < len; l++)
+    {
+        x[k + l] += a[l] * p[k + l];
+        r[k + l] -= a[l] * q[k + l];
+        acc[l] += r[k + l] * r[k + l];
+    }
+
+    rr[0] = rr[1] = rr[2] = 0.0;
+    for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+    {
+        rr[l % 3] += acc[l];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Per-channel search direction update p = gamma r + beta p on interleaved
+ * RGB vectors.
+ * @p       [I/O] Search direction
+ * @r       [ I ] Residual
+ * @gamma   [ I ] Weights of the residual of the three channels
+ * @beta    [ I ] Weights of the old direction of the three channels
+ * @n       [ I ] Number of pixels
+ */
+static void diffusion_rgb_direction(double *p, const double *r,
+        const double *gamma, const double *beta, int n)
+{
+    int k, l; /* Loop variables */
+    int len = 3 * n; /* Vector length */
+    double g[DIFFUSION_RGB_BLOCK], b[DIFFUSION_RGB_BLOCK]; /* Per lane */
+
+    for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+    {
+        g[l] = gamma[l % 3];
+        b[l] = beta[l % 3];
+    }
+
+    for (k = 0; k + DIFFUSION_RGB_BLOCK <= len; k += DIFFUSION_RGB_BLOCK)
+    {
+        for (l = 0; l < DIFFUSION_RGB_BLOCK; l++)
+        {
+            p[k + l] = g[l] * r[k + l] + b[l] * p[k + l];
+        }
+    }
+
+    for (l = 0; k + l < len; l++)
+    {
+        p[k + l] = g[l] * r[k + l] + b[l] * p[k + l];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting of an RGB image. The operator only
+ * depends on the mask, so the three channels are solved by conjugate
+ * gradients in lockstep: every iteration performs a single operator
+ * application on interleaved data, while step sizes are kept per channel.
+ * Channels that reached the tolerance or broke down are frozen by zero step
+ * sizes; the solve only succeeds if every channel reached the tolerance.
+ * @image   [ I ] Double-valued RGB image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction on output (RGB)
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance of each channel
+ */
+int diffusion_inpainting_rgb_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps)
+{
+    diffusion_operator_type op; /* Inpainting operator */
+    const double *f = (const double *) image.data;
+    double *x = (double *) u.data;
+    double *r, *p, *q; /* Residual, search direction, A times p */
+    double rr[3], rr_0[3], rr_new[3], pq[3]; /* Scalar products */
+    double alpha[3], beta[3]; /* Step sizes */
+    double gamma[3]; /* Weight of the residual in the new direction */
+    int i, j, k, c, n, it; /* Loop variables, number of pixels */
+    int active; /* Number of channels that did not converge yet */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE_RGB || u.dtype != ASI_DTYPE_DOUBLE_RGB)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    ret = diffusion_operator_init(&op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    n = op.n;
+    r = (double *) simd_calloc(3 * (size_t) n, sizeof(double));
+    p = (double *) simd_calloc(3 * (size_t) n, sizeof(double));
+    q = (double *) simd_calloc(3 * (size_t) n, sizeof(double));
+
+    if (r == NULL || p == NULL || q == NULL)
+    {
+        free(r);
+        free(p);
+        free(q);
+        diffusion_operator_delete(&op);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Right-hand side, stored in p: known values or known neighbour sums */
+    for (i = 0; i < op.height; i++)
+    {
+        for (j = 0; j < op.width; j++)
+        {
+            k = i * op.width + j;
+
+            for (c = 0; c < 3; c++)
+            {
+                if (op.flags[k] & ASI_STENCIL_KNOWN)
+                {
+                    p[3 * k + c] = f[3 * k + c];
+                    continue;
+                }
+
+                p[3 * k + c] = 0.0;
+
+                if (i > 0 && (op.flags[k - op.width] & ASI_STENCIL_KNOWN))
+                {
+                    p[3 * k + c] += f[3 * (k - op.width) + c];
+                }
+                if (i < op.height - 1
+                        && (op.flags[k + op.width] & ASI_STENCIL_KNOWN))
+                {
+                    p[3 * k + c] += f[3 * (k + op.width) + c];
+                }
+                if (j > 0 && (op.flags[k - 1] & ASI_STENCIL_KNOWN))
+                {
+                    p[3 * k + c] += f[3 * (k - 1) + c];
+                }
+                if (j < op.width - 1 && (op.flags[k + 1] & ASI_STENCIL_KNOWN))
+                {
+                    p[3 * k + c] += f[3 * (k + 1) + c];
+                }
+            }
+        }
+    }
+
+    /* Initial residual r = b - A x */
+    diffusion_operator_product_rgb(op, x, q);
+
+    rr[0] = rr[1] = rr[2] = 0.0;
+    for (k = 0; k < n; k++)
+    {
+        for (c = 0; c < 3; c++)
+        {
+            r[3 * k + c] = p[3 * k + c] - q[3 * k + c];
+            p[3 * k + c] = r[3 * k + c];
+            rr[c] += r[3 * k + c] * r[3 * k + c];
+        }
+    }
+
+    active = 0;
+    for (c = 0; c < 3; c++)
+    {
+        rr_0[c] = rr[c];
+        active += rr[c] > eps * eps * rr_0[c];
+    }
+
+    for (it = 0; it < iter && active > 0; it++)
+    {
+        diffusion_operator_product_rgb(op, p, q);
+
+        diffusion_rgb_dot(p, q, n, pq);
+
+        /* Converged or broken down channels keep their iterate */
+        for (c = 0; c < 3; c++)
+        {
+            alpha[c] = rr[c] > eps * eps * rr_0[c] && pq[c] > 0.0
+                ? rr[c] / pq[c] : 0.0;
+        }
+
+        diffusion_rgb_update(x, r, p, q, alpha, n, rr_new);
+
+        active = 0;
+        for (c = 0; c < 3; c++)
+        {
+            gamma[c] = alpha[c] != 0.0 ? 1.0 : 0.0;
+            beta[c] = alpha[c] != 0.0 ? rr_new[c] / rr[c] : 1.0;
+            rr[c] = rr_new[c];
+            active += alpha[c] != 0.0 && rr[c] > eps * eps * rr_0[c];
+        }
+
+        diffusion_rgb_direction(p, r, gamma, beta, n);
+    }
+
+    /* Broken down channels left the loop without reaching the tolerance */
+    active = 0;
+    for (c = 0; c < 3; c++)
+    {
+        active += rr[c] > eps * eps * rr_0[c];
+    }
+
+    free(r);
+    free(p);
+    free(q);
+    diffusion_operator_delete(&op);
+
+    return active > 0 ? ASI_EXIT_NOT_CONVERGED : ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting with the conjugate gradient method on the
+ * reduced system: known pixels are eliminated entirely, so memory and work
+ * per iteration scale with the number of unknowns. Pays off for dense masks,
+ * where most rows of the full system are identity rows.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ */
+int diffusion_inpainting_reduced_cg(const image_type image,
+        const image_type mask, image_type u, int iter, double eps)
+{
+    diffusion_operator_type op; /* Inpainting operator */
+    diffusion_reduced_type red; /* Reduced operator */
+    double *b, *x; /* Reduced right-hand side and solution */
+    const double *f = (const double *) image.data;
+    double *ud = (double *) u.data;
+    int k; /* Loop variable */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    ret = diffusion_operator_init(&op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = diffusion_reduced_init(&red, op);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        diffusion_operator_delete(&op);
+        return ret;
+    }
+
+    /* Known pixels are copied, the full-size flags are no longer needed */
+    for (k = 0; k < op.n; k++)
+    {
+        if (op.flags[k] & ASI_STENCIL_KNOWN)
+        {
+            ud[k] = f[k];
+        }
+    }
+
+    diffusion_operator_delete(&op);
+
+    b = (double *) malloc((red.n + 1) * sizeof(double));
+    x = (double *) malloc((red.n + 1) * sizeof(double));
+
+    if (b == NULL || x == NULL)
+    {
+        free(b);
+        free(x);
+        diffusion_reduced_delete(&red);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    diffusion_reduced_rhs(red, f, b);
+    diffusion_reduced_gather(red, ud, x);
+
+    ret = red.n > 0
+        ? conjugate_gradient(diffusion_reduced_linear_operator(&red), b, x,
+                iter, eps)
+        : ASI_EXIT_SUCCESS;
+
+    diffusion_reduced_scatter(red, x, ud);
+
+    free(b);
+    free(x);
+    diffusion_reduced_delete(&red);
+
+    return ret;
+}
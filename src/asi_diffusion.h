@@ -0,0 +1,129 @@
+#ifndef _ASI_DIFFUSION_H_
+#define _ASI_DIFFUSION_H_
+
+#include "asi_image.h"
+#include "asi_sparse.h"
+#include "asi_scheduler.h"
+
+/* Bits of the per-pixel stencil flags */
+#define ASI_STENCIL_KNOWN 1 /* Pixel is known (identity row) */
+#define ASI_STENCIL_N 2 /* Coupled to unknown northern neighbour */
+#define ASI_STENCIL_S 4 /* Coupled to unknown southern neighbour */
+#define ASI_STENCIL_W 8 /* Coupled to unknown western neighbour */
+#define ASI_STENCIL_E 16 /* Coupled to unknown eastern neighbour */
+#define ASI_STENCIL_DEG_SHIFT 5 /* Number of neighbours inside the image */
+
+/*
+ * Matrix-free five-point inpainting operator. Known pixels are identity rows,
+ * unknown pixels carry the negative Laplacian with mirrored boundaries where
+ * couplings to known pixels are moved to the right-hand side, so the
+ * operator is symmetric positive definite.
+ */
+typedef struct diffusion_operator
+{
+    unsigned char *flags; /* Stencil flags, one byte per pixel */
+    int width; /* Image width */
+    int height; /* Image height */
+    int n; /* Number of pixels */
+} diffusion_operator_type;
+
+/*
+ * Inpainting operator restricted to the unknown pixels. Unknowns are numbered
+ * in row-major order, so western and eastern neighbours are adjacent, while
+ * northern and southern ones are found through index arrays. Memory scales
+ * with the number of unknowns instead of the number of pixels.
+ */
+typedef struct diffusion_reduced
+{
+    int *pixel; /* Pixel index of each unknown */
+    int *north; /* Index of the northern unknown, own index if not coupled */
+    int *south; /* Index of the southern unknown, own index if not coupled */
+    unsigned char *flags; /* Stencil flags of each unknown */
+    int width; /* Image width */
+    int height; /* Image height */
+    int n; /* Number of unknowns */
+} diffusion_reduced_type;
+
+/* Initialise the operator from an inpainting mask */
+int diffusion_operator_init(diffusion_operator_type *op,
+        const image_type mask);
+
+/* Initialise the operator of a window with fixed boundary ring */
+int diffusion_operator_init_window(diffusion_operator_type *op,
+        const diffusion_operator_type global, int x0, int x1, int y0, int y1,
+        int *wx0, int *wy0);
+
+/* Initialise the operator of a window directly from the mask */
+int diffusion_operator_init_mask_window(diffusion_operator_type *op,
+        const image_type mask, int x0, int x1, int y0, int y1, int *wx0,
+        int *wy0);
+
+/* Free memory */
+void diffusion_operator_delete(diffusion_operator_type *op);
+
+/* Operator vector product b = A x */
+void diffusion_operator_product(const diffusion_operator_type op,
+        const double *x, double *b);
+
+/* Operator vector product for three interleaved channels */
+void diffusion_operator_product_rgb(const diffusion_operator_type op,
+        const double *x, double *b);
+
+/* Wrap the operator as a generic linear operator */
+linear_operator_type diffusion_linear_operator(
+        const diffusion_operator_type *op);
+
+/* Right-hand side of the inpainting system for known values f */
+void diffusion_operator_rhs(const diffusion_operator_type op,
+        const double *f, double *b);
+
+/* Inpainting residual on a range of rows, returns its squared norm */
+double diffusion_operator_residual(const diffusion_operator_type op,
+        const double *f, const double *u, double *r, int row_start,
+        int row_end);
+
+/* In-place red-black SOR sweeps for A u = b */
+int diffusion_sor_red_black(const diffusion_operator_type op, image_type u,
+        const double *b, double omega, int sweeps, int reverse,
+        scheduler_type *sched);
+
+/* Build the reduced system over the unknown pixels of an operator */
+int diffusion_reduced_init(diffusion_reduced_type *red,
+        const diffusion_operator_type op);
+
+/* Free memory */
+void diffusion_reduced_delete(diffusion_reduced_type *red);
+
+/* Reduced operator vector product b = A x */
+void diffusion_reduced_product(const diffusion_reduced_type red,
+        const double *x, double *b);
+
+/* Wrap the reduced operator as a generic linear operator */
+linear_operator_type diffusion_reduced_linear_operator(
+        const diffusion_reduced_type *red);
+
+/* Right-hand side of the reduced system for known values f */
+void diffusion_reduced_rhs(const diffusion_reduced_type red,
+        const double *f, double *b);
+
+/* Copy the unknown pixels of an image into a reduced vector */
+void diffusion_reduced_gather(const diffusion_reduced_type red,
+        const double *u, double *x);
+
+/* Copy a reduced vector into the unknown pixels of an image */
+void diffusion_reduced_scatter(const diffusion_reduced_type red,
+        const double *x, double *u);
+
+/* Homogeneous diffusion inpainting with the conjugate gradient method */
+int diffusion_inpainting_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps);
+
+/* Conjugate gradient inpainting of an RGB image, channels in lockstep */
+int diffusion_inpainting_rgb_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps);
+
+/* Conjugate gradient inpainting on the reduced system */
+int diffusion_inpainting_reduced_cg(const image_type image,
+        const image_type mask, image_type u, int iter, double eps);
+
+#endif
@@ -0,0 +1,655 @@
+#include "asi_distributed.h"
+#include "asi_diffusion.h"
+#include "asi_mask.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+/* Memory budget of the factor cache owned by one process in bytes */
+#define DISTRIBUTED_CACHE_BYTES ((size_t) 256 << 20)
+
+/* Outcome of the solve of one forked process */
+typedef struct distributed_result
+{
+    int status; /* Return value */
+    int sweeps; /* Number of performed sweeps */
+    double residual; /* Final relative residual */
+} distributed_result_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Splits the image rows evenly into one band per rank.
+ * @height    [ I ] Image height
+ * @rank      [ I ] Rank
+ * @size      [ I ] Number of ranks
+ * @row_start [ O ] First row of the band
+ * @row_end   [ O ] Row after the band
+ */
+void distributed_band(int height, int rank, int size, int *row_start,
+        int *row_end)
+{
+    *row_start = (int) ((long) rank * height / size);
+    *row_end = (int) ((long) (rank + 1) * height / size);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Returns an image of a range of rows pointing into the data of another
+ * image. The view must not be deleted.
+ * @image     [ I ] Image
+ * @row_start [ I ] First row
+ * @row_end   [ I ] Row after the range
+ */
+image_type distributed_band_view(const image_type image, int row_start,
+        int row_end)
+{
+    image_type view = image;
+    size_t pixel; /* Bytes per pixel */
+
+    switch (image.dtype)
+    {
+        case ASI_DTYPE_DOUBLE:
+            pixel = sizeof(double);
+            break;
+        case ASI_DTYPE_DOUBLE_RGB:
+            pixel = 3 * sizeof(double);
+            break;
+        case ASI_DTYPE_INT_RGB:
+            pixel = 3 * sizeof(int);
+            break;
+        default:
+            pixel = sizeof(int);
+            break;
+    }
+
+    view.data = (char *) image.data
+        + (size_t) row_start * image.width * pixel;
+    view.height = row_end - row_start;
+
+    return view;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Exchanges the halo rows of a band with the neighbouring ranks: the first
+ * and last halo rows owned by this rank are sent, the rows beyond the band
+ * are received.
+ * @t       [ I ] Transport
+ * @data    [I/O] Band including halo rows
+ * @width   [ I ] Image width
+ * @top     [ I ] Number of halo rows above the band
+ * @rows    [ I ] Number of owned rows
+ * @halo    [ I ] Number of exchanged rows
+ */
+static int distributed_halo(const transport_type *t, double *data, int width,
+        int top, int rows, int halo)
+{
+    return t->exchange(t, data + (size_t) top * width, data,
+            data + (size_t) (top + rows - halo) * width,
+            data + (size_t) (top + rows) * width, halo * width);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Squared inpainting residual over the owned rows of all ranks together with
+ * a failure flag, so that all ranks leave the solve at the same time.
+ * @t       [ I ] Transport
+ * @op      [ I ] Inpainting operator of the band including halo rows
+ * @u       [ I ] Iterate of the band
+ * @top     [ I ] Number of halo rows above the band
+ * @rows    [ I ] Number of owned rows
+ * @failed  [I/O] Local failure flag on input, global one on output
+ * @res     [ O ] Global residual norm
+ */
+static int distributed_residual(const transport_type *t,
+        const diffusion_operator_type op, const double *u, int top, int rows,
+        int *failed, double *res)
+{
+    double values[2]; /* Squared residual and failure flag */
+    int ret; /* Return value */
+
+    values[0] = *failed ? 0.0
+        : diffusion_operator_residual(op, u, u, NULL, top, top + rows);
+    values[1] = *failed ? 1.0 : 0.0;
+
+    ret = t->allreduce(t, values, 2, ASI_REDUCE_SUM);
+
+    *failed = values[1] > 0.0;
+    *res = sqrt(values[0]);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reports a timed phase of a sweep of this process to a telemetry sink.
+ * @telemetry   [I/O] Telemetry sink, may be NULL
+ * @t           [ I ] Transport, the rank is reported as subdomain
+ * @sweep       [ I ] Current sweep
+ * @phase       [ I ] Phase name
+ * @start       [ I ] Start time of the phase
+ * @bytes       [ I ] Estimated memory or network traffic of the phase
+ */
+static void distributed_phase(telemetry_type *telemetry,
+        const transport_type *t, int sweep, const char *phase, double start,
+        double bytes)
+{
+    telemetry_record_type record; /* Phase record */
+
+    if (telemetry == NULL)
+    {
+        return;
+    }
+
+    record = telemetry_record(ASI_TELEMETRY_PHASE, "distributed");
+    record.phase = phase;
+    record.iteration = sweep;
+    record.subdomain = t->rank;
+    record.seconds = telemetry_time() - start;
+    record.bytes = bytes;
+    telemetry_emit(telemetry, &record);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Schwarz inpainting of an image split into horizontal bands across
+ * processes. Every process holds its band plus halo rows of the overlap and
+ * one ring row towards each neighbour. A sweep solves the band with the
+ * threaded Schwarz method, the ring rows acting as known boundary data, and
+ * exchanges the halo rows afterwards. Between processes this is restricted
+ * additive Schwarz with the same overlap as between subdomains. Memory per
+ * process scales with the band, and all processes have to call collectively.
+ * @t       [ I ] Transport connecting the processes in band order
+ * @image   [ I ] Double-valued band providing the known pixel values
+ * @mask    [ I ] Inpainting mask of the band, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction of the band on output
+ * @params  [ I ] Solver parameters, subdomains_y refers to the whole image
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int distributed_schwarz_inpainting(const transport_type *t,
+        const image_type image, const image_type mask, image_type u,
+        const schwarz_params_type params, schwarz_info_type *info)
+{
+    schwarz_params_type inner; /* Parameters of the band solves */
+    cholesky_cache_type cache; /* Factor cache of this process */
+    diffusion_operator_type op; /* Inpainting operator of the band */
+    image_type m_l, u_l; /* Mask and iterate of the band with halo rows */
+    image_type f_s, m_s; /* Boundary data and mask of the band solves */
+    double geometry[3]; /* Negated smallest band height, width, -width */
+    double height; /* Image height */
+    double flag; /* Global failure flag */
+    double res, res_0; /* Residual norms */
+    double start, sweep_start; /* Start times of a phase and a sweep */
+    telemetry_record_type record; /* Telemetry record */
+    double *m, *x; /* Data of the band with halo rows */
+    int w, rows, top, bottom, halo, local; /* Band geometry */
+    int overlap; /* Overlap between processes */
+    int i, j, k, sweep; /* Loop variables */
+    int failed; /* Local failure flag */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    w = image.width;
+    rows = image.height;
+
+    /* Common geometry of all bands */
+    height = rows;
+    geometry[0] = -rows;
+    geometry[1] = w;
+    geometry[2] = -w;
+
+    if (t->allreduce(t, &height, 1, ASI_REDUCE_SUM) != ASI_EXIT_SUCCESS
+            || t->allreduce(t, geometry, 3, ASI_REDUCE_MAX)
+            != ASI_EXIT_SUCCESS)
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    if (geometry[1] != -geometry[2])
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (geometry[0] > -1.0 || params.overlap < 0 || params.subdomains_y < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    /* Halo rows must be owned by the neighbouring rank */
+    overlap = params.overlap < -geometry[0] - 1.0
+        ? params.overlap : (int) -geometry[0] - 1;
+    halo = overlap + 1;
+    top = t->rank > 0 ? halo : 0;
+    bottom = t->rank < t->size - 1 ? halo : 0;
+    local = top + rows + bottom;
+
+    memset(&op, 0, sizeof(op));
+    m_l.data = u_l.data = f_s.data = m_s.data = NULL;
+
+    ret = ASI_EXIT_SUCCESS;
+
+    if (image_init(&m_l, w, local, ASI_DTYPE_DOUBLE) != ASI_EXIT_SUCCESS
+            || image_init(&u_l, w, local, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS
+            || image_init(&f_s, w, local, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS
+            || image_init(&m_s, w, local, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Without a cache from the caller, factors are reused across sweeps */
+    inner = params;
+
+    if (ret == ASI_EXIT_SUCCESS
+            && params.local_solver == ASI_SCHWARZ_LOCAL_CHOLESKY
+            && params.cache == NULL)
+    {
+        ret = cholesky_cache_init(&cache, DISTRIBUTED_CACHE_BYTES);
+        inner.cache = ret == ASI_EXIT_SUCCESS ? &cache : NULL;
+    }
+
+    /* All ranks have to agree before the first exchange */
+    flag = ret != ASI_EXIT_SUCCESS;
+
+    if (t->allreduce(t, &flag, 1, ASI_REDUCE_MAX) != ASI_EXIT_SUCCESS
+            || flag > 0.0)
+    {
+        ret = ret == ASI_EXIT_SUCCESS ? ASI_EXIT_FAILURE : ret;
+        goto cleanup;
+    }
+
+    m = (double *) m_l.data;
+    x = (double *) u_l.data;
+
+    /* Owned rows of the mask and the initial guess with known values */
+    for (i = 0; i < rows; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = (top + i) * w + j;
+            m[k] = mask_get(mask, i, j) ? 1.0 : 0.0;
+            x[k] = m[k] > 0.0 ? ((const double *) image.data)[i * w + j]
+                : ((const double *) u.data)[i * w + j];
+        }
+    }
+
+    if (distributed_halo(t, m, w, top, rows, halo) != ASI_EXIT_SUCCESS
+            || distributed_halo(t, x, w, top, rows, halo)
+            != ASI_EXIT_SUCCESS)
+    {
+        ret = ASI_EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    /* Band solves treat the outermost halo rows as known */
+    memcpy(m_s.data, m, (size_t) local * w * sizeof(double));
+
+    for (j = 0; j < w; j++)
+    {
+        if (top > 0)
+        {
+            ((double *) m_s.data)[j] = 1.0;
+        }
+        if (bottom > 0)
+        {
+            ((double *) m_s.data)[(size_t) (local - 1) * w + j] = 1.0;
+        }
+    }
+
+    inner.max_sweeps = 1;
+    inner.telemetry = NULL;
+    inner.subdomains_y = (int) (params.subdomains_y * local / height + 0.5);
+    inner.subdomains_y = inner.subdomains_y < 1 ? 1 : inner.subdomains_y;
+
+    ret = diffusion_operator_init(&op, m_l);
+    failed = ret != ASI_EXIT_SUCCESS;
+
+    if (distributed_residual(t, op, x, top, rows, &failed, &res_0)
+            != ASI_EXIT_SUCCESS || failed)
+    {
+        ret = ret == ASI_EXIT_SUCCESS ? ASI_EXIT_FAILURE : ret;
+        goto cleanup;
+    }
+
+    res = res_0 > 0.0 ? 1.0 : 0.0;
+
+    for (sweep = 0; sweep < params.max_sweeps && res > params.eps; sweep++)
+    {
+        sweep_start = telemetry_time();
+
+        /* Known values and the neighbours' halo rows as boundary data */
+        memcpy(f_s.data, x, (size_t) local * w * sizeof(double));
+
+        ret = schwarz_inpainting(f_s, m_s, u_l, inner, NULL);
+        failed = ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_NOT_CONVERGED;
+
+        distributed_phase(params.telemetry, t, sweep + 1, "band", sweep_start,
+                -1.0);
+        start = telemetry_time();
+
+        if (distributed_halo(t, x, w, top, rows, halo) != ASI_EXIT_SUCCESS
+                || distributed_residual(t, op, x, top, rows, &failed, &res)
+                != ASI_EXIT_SUCCESS)
+        {
+            failed = 1;
+        }
+
+        if (failed)
+        {
+            ret = ret == ASI_EXIT_SUCCESS || ret == ASI_EXIT_NOT_CONVERGED
+                ? ASI_EXIT_FAILURE : ret;
+            goto cleanup;
+        }
+
+        res /= res_0;
+
+        /* Each halo row is sent and received once per neighbour */
+        distributed_phase(params.telemetry, t, sweep + 1, "exchange", start,
+                2.0 * (top + bottom) * w * sizeof(double));
+
+        if (params.telemetry != NULL)
+        {
+            record = telemetry_record(ASI_TELEMETRY_ITERATION, "distributed");
+            record.iteration = sweep + 1;
+            record.subdomain = t->rank;
+            record.residual = res;
+            record.seconds = telemetry_time() - sweep_start;
+            telemetry_emit(params.telemetry, &record);
+        }
+    }
+
+    for (i = 0; i < rows; i++)
+    {
+        memcpy((double *) u.data + (size_t) i * w, x + (size_t) (top + i) * w,
+                w * sizeof(double));
+    }
+
+    if (info != NULL)
+    {
+        info->sweeps = sweep;
+        info->residual = res;
+        info->skipped = 0;
+    }
+
+    ret = res > params.eps ? ASI_EXIT_NOT_CONVERGED : ASI_EXIT_SUCCESS;
+
+cleanup:
+    if (inner.cache == &cache)
+    {
+        cholesky_cache_delete(&cache);
+    }
+
+    diffusion_operator_delete(&op);
+    image_delete(&m_l);
+    image_delete(&u_l);
+    image_delete(&f_s);
+    image_delete(&m_s);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves the band of one forked process and records the outcome.
+ * @name    [ I ] Name of the shared-memory segment
+ * @rank    [ I ] Rank of the process
+ * @size    [ I ] Number of processes
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask
+ * @u       [I/O] Shared iterate of the whole image
+ * @params  [ I ] Solver parameters
+ * @result  [ O ] Outcome of the process
+ */
+static void distributed_child(const char *name, int rank, int size,
+        const image_type image, const image_type mask, image_type u,
+        const schwarz_params_type params, distributed_result_type *result)
+{
+    transport_type t; /* Transport */
+    schwarz_info_type info; /* Convergence information */
+    int r0, r1; /* Owned rows */
+
+    result->status = transport_init_shm(&t, name, rank);
+
+    if (result->status != ASI_EXIT_SUCCESS)
+    {
+        return;
+    }
+
+    distributed_band(image.height, rank, size, &r0, &r1);
+
+    info.sweeps = 0;
+    info.residual = 0.0;
+
+    result->status = distributed_schwarz_inpainting(&t,
+            distributed_band_view(image, r0, r1),
+            distributed_band_view(mask, r0, r1),
+            distributed_band_view(u, r0, r1), params, &info);
+    result->sweeps = info.sweeps;
+    result->residual = info.residual;
+
+    transport_delete(&t);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Schwarz inpainting with one forked process per band on one machine. The
+ * processes communicate through a POSIX shared-memory transport and write
+ * their bands into a shared copy of the iterate. If a process fails, the
+ * remaining ones are terminated since they would wait for it forever.
+ * @image     [ I ] Double-valued image providing the known pixel values
+ * @mask      [ I ] Inpainting mask, non-zero for known pixels
+ * @u         [I/O] Initial guess on input, reconstruction on output
+ * @params    [ I ] Solver parameters, num_threads per process
+ * @num_procs [ I ] Number of processes
+ * @info      [ O ] Convergence information, may be NULL
+ */
+int distributed_schwarz_processes(const image_type image,
+        const image_type mask, image_type u, const schwarz_params_type params,
+        int num_procs, schwarz_info_type *info)
+{
+    static int counter = 0; /* Distinguishes segments of one process */
+    schwarz_params_type child; /* Parameters of the processes */
+    distributed_result_type *results; /* Outcome per process */
+    image_type shared; /* Shared iterate */
+    char name[64]; /* Name of the shared-memory segment */
+    pid_t *pids; /* Process ids */
+    pid_t pid; /* Terminated process */
+    size_t bytes; /* Size of the shared mapping */
+    long cores; /* Number of online cores */
+    int r, alive; /* Loop variable, number of running processes */
+    int status; /* Exit status of a process */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE
+            || mask.dtype == ASI_DTYPE_INT_RGB
+            || mask.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (num_procs < 1 || params.overlap < 0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    num_procs = num_procs > image.height ? image.height : num_procs;
+
+    /* Share the cores between the processes, whose records could not reach
+       the sink of the caller */
+    child = params;
+    child.telemetry = NULL;
+
+    if (child.num_threads <= 0)
+    {
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        child.num_threads = cores / num_procs > 1 ? cores / num_procs : 1;
+    }
+
+    snprintf(name, sizeof(name), "/asi_schwarz_%ld_%d", (long) getpid(),
+            counter++);
+
+    ret = transport_shm_create(name, num_procs,
+            (params.overlap + 1) * image.width);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    bytes = (size_t) image.width * image.height * sizeof(double)
+        + num_procs * sizeof(distributed_result_type);
+    shared = u;
+    shared.data = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pids = (pid_t *) malloc(num_procs * sizeof(pid_t));
+
+    if (shared.data == MAP_FAILED || pids == NULL)
+    {
+        if (shared.data != MAP_FAILED)
+        {
+            munmap(shared.data, bytes);
+        }
+
+        free(pids);
+        transport_shm_unlink(name);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    results = (distributed_result_type *) ((double *) shared.data
+            + (size_t) image.width * image.height);
+    memcpy(shared.data, u.data, (size_t) image.width * image.height
+            * sizeof(double));
+
+    ret = ASI_EXIT_SUCCESS;
+
+    for (r = 0; r < num_procs; r++)
+    {
+        results[r].status = ASI_EXIT_FAILURE;
+        pids[r] = fork();
+
+        if (pids[r] == 0)
+        {
+            distributed_child(name, r, num_procs, image, mask, shared, child,
+                    &results[r]);
+            _exit(0);
+        }
+
+        if (pids[r] < 0)
+        {
+            ret = ASI_EXIT_FAILURE;
+            break;
+        }
+    }
+
+    alive = r;
+
+    /* Processes started before a failed fork would wait forever */
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        for (r = 0; r < alive; r++)
+        {
+            kill(pids[r], SIGKILL);
+        }
+    }
+
+    while (alive > 0)
+    {
+        pid = wait(&status);
+
+        if (pid < 0)
+        {
+            break;
+        }
+
+        alive--;
+
+        for (r = 0; r < num_procs && pids[r] != pid; r++)
+        {
+        }
+
+        if (r == num_procs)
+        {
+            alive++;
+            continue;
+        }
+
+        pids[r] = 0;
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0
+                || (results[r].status != ASI_EXIT_SUCCESS
+                    && results[r].status != ASI_EXIT_NOT_CONVERGED))
+        {
+            if (ret == ASI_EXIT_SUCCESS)
+            {
+                ret = results[r].status != ASI_EXIT_SUCCESS
+                    ? results[r].status : ASI_EXIT_FAILURE;
+            }
+
+            for (r = 0; r < num_procs; r++)
+            {
+                if (pids[r] > 0)
+                {
+                    kill(pids[r], SIGKILL);
+                }
+            }
+        }
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        memcpy(u.data, shared.data, (size_t) image.width * image.height
+                * sizeof(double));
+
+        if (info != NULL)
+        {
+            info->sweeps = results[0].sweeps;
+            info->residual = results[0].residual;
+            info->skipped = 0;
+        }
+
+        ret = results[0].status;
+    }
+
+    munmap(shared.data, bytes);
+    free(pids);
+    transport_shm_unlink(name);
+
+    return ret;
+}
@@ -0,0 +1,26 @@
+#ifndef _ASI_DISTRIBUTED_H_
+#define _ASI_DISTRIBUTED_H_
+
+#include "asi_image.h"
+#include "asi_schwarz.h"
+#include "asi_transport.h"
+
+/* Rows owned by a rank when the image rows are split evenly */
+void distributed_band(int height, int rank, int size, int *row_start,
+        int *row_end);
+
+/* View of a range of image rows sharing the image data */
+image_type distributed_band_view(const image_type image, int row_start,
+        int row_end);
+
+/* Schwarz inpainting of the band of rows owned by this process */
+int distributed_schwarz_inpainting(const transport_type *t,
+        const image_type image, const image_type mask, image_type u,
+        const schwarz_params_type params, schwarz_info_type *info);
+
+/* Schwarz inpainting split across forked processes on one machine */
+int distributed_schwarz_processes(const image_type image,
+        const image_type mask, image_type u, const schwarz_params_type params,
+        int num_procs, schwarz_info_type *info);
+
+#endif
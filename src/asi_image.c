@@ -95,23 +95,59 @@ void image_delete (image_type *image)
  */
 int image_copy (const image_type src, image_type target)
 {
-    int i, j; /* Iteration variables */
+    int i, j, c; /* Iteration variables */
     int dval; /* Integer value */
     double fval; /* Double value */
 
-    // TODO right now only for greyscale images 
-    if (src.dtype == ASI_DTYPE_INT_RGB 
-            || src.dtype == ASI_DTYPE_DOUBLE_RGB) 
-    {
-        return ASI_NOT_IMPLEMENTED_YET;
-    }
-
     /* Check if image dimensions and datatype match of src and target */
     if (src.width != target.width || src.height != target.height)
     {
         return ASI_EXIT_IMG_DIM_MISMATCH;
     }
 
+    /* RGB images only convert between integer and double channels */
+    if (src.dtype == ASI_DTYPE_INT_RGB || src.dtype == ASI_DTYPE_DOUBLE_RGB
+            || target.dtype == ASI_DTYPE_INT_RGB
+            || target.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        if ((src.dtype != ASI_DTYPE_INT_RGB
+                    && src.dtype != ASI_DTYPE_DOUBLE_RGB)
+                || (target.dtype != ASI_DTYPE_INT_RGB
+                    && target.dtype != ASI_DTYPE_DOUBLE_RGB))
+        {
+            return ASI_EXIT_IMG_DTYPE_MISMATCH;
+        }
+
+        for (i = 0; i < src.height; i++)
+        {
+            for (j = 0; j < src.width; j++)
+            {
+                for (c = 0; c < 3; c++)
+                {
+                    if (src.dtype == ASI_DTYPE_INT_RGB)
+                    {
+                        fval = (double) image_get_rgb(src, i, j)[c];
+                    }
+                    else
+                    {
+                        fval = image_fget_rgb(src, i, j)[c];
+                    }
+
+                    if (target.dtype == ASI_DTYPE_INT_RGB)
+                    {
+                        image_get_rgb(target, i, j)[c] = (int) round(fval);
+                    }
+                    else
+                    {
+                        image_fget_rgb(target, i, j)[c] = fval;
+                    }
+                }
+            }
+        }
+
+        return ASI_EXIT_SUCCESS;
+    }
+
     //TODO accomodate other dtypes
     /* Copy int-valued image */
     if ((src.dtype == ASI_DTYPE_INT || src.dtype == ASI_DTYPE_BOOLEAN) 
@@ -187,6 +223,20 @@ int image_get(image_type image, int i, int j)
 
 /*----------------------------------------------------------------------------*/
 
+/*
+ * Returns a pointer to the three interleaved channels of an integer-valued
+ * RGB pixel. 'Quick 'n dirty' accessing, no sanity checks
+ * @image   [ I ] Image
+ * @i       [ I ] y coordinate (row number)
+ * @j       [ I ] x coordinate (column number)
+ */
+int * image_get_rgb(image_type image, int i, int j)
+{
+    return (int*) image.data + 3 * (i * image.width + j);
+}
+
+/*----------------------------------------------------------------------------*/
+
 /*
  * Puts an integer at a given location in an image. 'Quick 'n dirty' 
  * accessing, no sanity checks
@@ -218,6 +268,20 @@ double image_fget(image_type image, int i, int j)
 
 /*----------------------------------------------------------------------------*/
 
+/*
+ * Returns a pointer to the three interleaved channels of a double-valued
+ * RGB pixel. 'Quick 'n dirty' accessing, no sanity checks
+ * @image   [ I ] Image
+ * @i       [ I ] y coordinate (row number)
+ * @j       [ I ] x coordinate (column number)
+ */
+double * image_fget_rgb(image_type image, int i, int j)
+{
+    return (double*) image.data + 3 * (i * image.width + j);
+}
+
+/*----------------------------------------------------------------------------*/
+
 /*
  * Puts a double at a given location in an image. 'Quick 'n dirty' 
  * accessing, no sanity checks
@@ -293,6 +357,25 @@ int image_mirror_boundary_y(image_type image, int i)
 
 /*----------------------------------------------------------------------------*/
 
+/*
+ * Mirrors an index into [0, n) by repeated half-sample reflection. Unlike
+ * image_mirror_boundary_x/y, indices any distance outside are supported,
+ * e.g. for kernels wider than the image.
+ * @k       [ I ] Index
+ * @n       [ I ] Number of indices
+ */
+int image_mirror_index(int k, int n)
+{
+    while (k < 0 || k >= n)
+    {
+        k = k < 0 ? -k - 1 : 2 * n - k - 1;
+    }
+
+    return k;
+}
+
+/*----------------------------------------------------------------------------*/
+
 /*
  * Finds maximum pixel value of an integer-valued image.
  * @image   [ I ] Image
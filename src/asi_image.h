@@ -15,6 +15,8 @@
 #define ASI_EXIT_INVALID_ARG_COUNT 109
 #define ASI_EXIT_IMG_DIM_MISMATCH 110
 #define ASI_EXIT_IMG_DTYPE_MISMATCH 111
+#define ASI_EXIT_NOT_CONVERGED 112
+#define ASI_EXIT_OUT_OF_TOLERANCE 113
 #define ASI_EXIT_OUT_OF_BOUNDS -99
 #define ASI_NOT_IMPLEMENTED_YET 999
 
@@ -65,6 +67,7 @@ void image_fput(image_type image, double value, int i, int j);
 /* Boundary handling for indices */
 int image_mirror_boundary_x(image_type image, int j);
 int image_mirror_boundary_y(image_type image, int i);
+int image_mirror_index(int k, int n);
 
 
 /* Image statistics */
@@ -0,0 +1,371 @@
+#include "asi_incremental.h"
+#include "asi_diffusion.h"
+#include "asi_mask.h"
+#include "asi_sparse.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Rectangular region of the image, ranges are half-open */
+typedef struct incremental_region
+{
+    int x0, x1, y0, y1; /* Column and row range */
+} incremental_region_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets default parameters of incremental re-inpainting.
+ * @params  [ O ] Parameters
+ */
+void incremental_params_default(incremental_params_type *params)
+{
+    params->margin = 16;
+    params->eps = 1e-3;
+    params->max_fraction = 0.25;
+    params->local_iter = 5000;
+    params->local_eps = 1e-8;
+    schwarz_params_default(&params->full);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Merges overlapping or touching regions until all regions are disjoint.
+ * @regions [I/O] Regions
+ * @n       [I/O] Number of regions
+ */
+static void incremental_merge(incremental_region_type *regions, int *n)
+{
+    incremental_region_type *a, *b; /* Pair of regions */
+    int k, l; /* Loop variables */
+    int merged; /* Flag for a merge in the last pass */
+
+    do
+    {
+        merged = 0;
+
+        for (k = 0; k < *n; k++)
+        {
+            a = &regions[k];
+
+            for (l = k + 1; l < *n; l++)
+            {
+                b = &regions[l];
+
+                if (a->x0 > b->x1 || b->x0 > a->x1 || a->y0 > b->y1
+                        || b->y0 > a->y1)
+                {
+                    continue;
+                }
+
+                a->x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+                a->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+                a->y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+                a->y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+
+                regions[l--] = regions[--(*n)];
+                merged = 1;
+            }
+        }
+    }
+    while (merged);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves the inpainting problem on a region with Dirichlet data from the
+ * current solution around it, starting from the current solution, and
+ * writes the result back. Reports the largest change along each side of the
+ * region that does not lie on the image boundary and over the whole region.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask
+ * @u       [I/O] Current solution
+ * @region  [ I ] Region to be solved
+ * @params  [ I ] Parameters
+ * @change  [ O ] Largest change on the western, eastern, northern and
+ *                southern side, and over the whole region
+ */
+static int incremental_solve_region(const image_type image,
+        const image_type mask, image_type u,
+        const incremental_region_type *region,
+        const incremental_params_type *params, double change[5])
+{
+    diffusion_operator_type op; /* Operator of the region and its ring */
+    double *x, *x_old, *b; /* Local solution, initial guess, right side */
+    double d; /* Change of a pixel */
+    int ox, oy; /* Image coordinates of the window origin */
+    int i, j, k; /* Loop variables */
+    int gi, gj; /* Global coordinates */
+    int ret; /* Return value */
+
+    change[0] = change[1] = change[2] = change[3] = change[4] = 0.0;
+
+    ret = diffusion_operator_init_mask_window(&op, mask, region->x0,
+            region->x1, region->y0, region->y1, &ox, &oy);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    x = (double *) malloc(3 * (size_t) op.n * sizeof(double));
+
+    if (x == NULL)
+    {
+        diffusion_operator_delete(&op);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    x_old = x + op.n;
+    b = x_old + op.n;
+
+    /* Known pixels of the region carry the image, all others the solution */
+    for (i = 0; i < op.height; i++)
+    {
+        gi = oy + i;
+
+        for (j = 0; j < op.width; j++)
+        {
+            gj = ox + j;
+            k = i * op.width + j;
+
+            x[k] = gi >= region->y0 && gi < region->y1 && gj >= region->x0
+                && gj < region->x1 && mask_get(mask, gi, gj)
+                ? image_fget(image, gi, gj) : image_fget(u, gi, gj);
+        }
+    }
+
+    memcpy(x_old, x, op.n * sizeof(double));
+    diffusion_operator_rhs(op, x, b);
+
+    ret = conjugate_gradient(diffusion_linear_operator(&op), b, x,
+            params->local_iter, params->local_eps);
+
+    /* An inexact solve still improves the old solution */
+    ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+
+    for (gi = region->y0; gi < region->y1 && ret == ASI_EXIT_SUCCESS; gi++)
+    {
+        for (gj = region->x0; gj < region->x1; gj++)
+        {
+            k = (gi - oy) * op.width + gj - ox;
+            d = fabs(x[k] - x_old[k]);
+
+            if (gj == region->x0 && gj > 0 && d > change[0])
+            {
+                change[0] = d;
+            }
+            if (gj == region->x1 - 1 && gj < u.width - 1 && d > change[1])
+            {
+                change[1] = d;
+            }
+            if (gi == region->y0 && gi > 0 && d > change[2])
+            {
+                change[2] = d;
+            }
+            if (gi == region->y1 - 1 && gi < u.height - 1 && d > change[3])
+            {
+                change[3] = d;
+            }
+            if (d > change[4])
+            {
+                change[4] = d;
+            }
+
+            image_fput(u, x[k], gi, gj);
+        }
+    }
+
+    free(x);
+    diffusion_operator_delete(&op);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Updates a homogeneous diffusion inpainting solution after the mask state
+ * of a few pixels changed. The influence of an edit decays with the
+ * distance, so each cluster of edits is re-solved on a surrounding region
+ * with the old solution as Dirichlet data and initial guess. A region grows
+ * on every side along which the solution still changed by more than
+ * params.eps, and on all sides while a solve changed any pixel by more than
+ * params.eps, until the change has died out. The result then matches a
+ * full solve within about params.eps. The cost hence scales with
+ * the extent of the edit; once the regions cover more than
+ * params.max_fraction of the image, the whole image is solved instead.
+ * @image       [ I ] Double-valued image providing the known pixel values
+ * @mask        [ I ] Inpainting mask after the edits
+ * @u           [I/O] Solution for the mask before the edits on input,
+ *                    solution for the edited mask on output
+ * @edits       [ I ] Pixels whose mask state changed
+ * @num_edits   [ I ] Number of edited pixels
+ * @params      [ I ] Parameters
+ * @info        [ O ] Work done, may be NULL
+ */
+int incremental_inpainting(const image_type image, const image_type mask,
+        image_type u, const mask_edit_type *edits, int num_edits,
+        const incremental_params_type params, incremental_info_type *info)
+{
+    incremental_region_type *regions; /* Regions around clusters of edits */
+    incremental_region_type *r; /* Current region */
+    double change[5]; /* Largest change along each side and overall */
+    double limit; /* Largest number of pixels of a region */
+    long area; /* Number of pixels of the current region */
+    int n; /* Number of regions */
+    int margin; /* Margin a region grows by */
+    int grow; /* Flag for a region that needs to grow */
+    int full = 0; /* Flag for a change that is not local */
+    int k, m; /* Loop variable, number of remaining regions */
+    int ret = ASI_EXIT_SUCCESS; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (num_edits < 0 || params.margin < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    if (info != NULL)
+    {
+        info->regions = 0;
+        info->pixels = 0;
+        info->full_solve = 0;
+    }
+
+    if (num_edits == 0)
+    {
+        return ASI_EXIT_SUCCESS;
+    }
+
+    regions = (incremental_region_type *) malloc(num_edits
+            * sizeof(incremental_region_type));
+
+    if (regions == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (k = 0; k < num_edits; k++)
+    {
+        if (edits[k].i < 0 || edits[k].i >= u.height || edits[k].j < 0
+                || edits[k].j >= u.width)
+        {
+            free(regions);
+            return ASI_EXIT_INVALID_VALUE;
+        }
+
+        regions[k].x0 = edits[k].j - params.margin;
+        regions[k].x1 = edits[k].j + params.margin + 1;
+        regions[k].y0 = edits[k].i - params.margin;
+        regions[k].y1 = edits[k].i + params.margin + 1;
+    }
+
+    n = num_edits;
+    limit = params.max_fraction * u.width * u.height;
+
+    for (k = 0; k < n && ret == ASI_EXIT_SUCCESS && !full; k++)
+    {
+        /* Clusters that grew into each other are solved together */
+        m = n - k;
+        incremental_merge(regions + k, &m);
+        n = k + m;
+        r = &regions[k];
+        margin = params.margin;
+
+        do
+        {
+            r->x0 = r->x0 < 0 ? 0 : r->x0;
+            r->x1 = r->x1 > u.width ? u.width : r->x1;
+            r->y0 = r->y0 < 0 ? 0 : r->y0;
+            r->y1 = r->y1 > u.height ? u.height : r->y1;
+
+            area = (long) (r->x1 - r->x0) * (r->y1 - r->y0);
+
+            if (area > limit)
+            {
+                full = 1;
+                break;
+            }
+
+            ret = incremental_solve_region(image, mask, u, r, &params,
+                    change);
+
+            if (info != NULL)
+            {
+                info->regions += 1;
+                info->pixels += area;
+            }
+
+            grow = 0;
+
+            if (change[0] > params.eps)
+            {
+                r->x0 -= margin;
+                grow = 1;
+            }
+            if (change[1] > params.eps)
+            {
+                r->x1 += margin;
+                grow = 1;
+            }
+            if (change[2] > params.eps)
+            {
+                r->y0 -= margin;
+                grow = 1;
+            }
+            if (change[3] > params.eps)
+            {
+                r->y1 += margin;
+                grow = 1;
+            }
+
+            /* The old solution on the ring is off by about as much as the
+               solve moved it, so a region that changed by more than
+               params.eps is verified on a larger one */
+            if (!grow && change[4] > params.eps
+                    && area < (long) u.width * u.height)
+            {
+                r->x0 -= margin;
+                r->x1 += margin;
+                r->y0 -= margin;
+                r->y1 += margin;
+                grow = 1;
+            }
+
+            margin *= 2;
+        }
+        while (grow && ret == ASI_EXIT_SUCCESS);
+    }
+
+    free(regions);
+
+    /* Global change: solve everything, warm started by the partial update */
+    if (full)
+    {
+        if (info != NULL)
+        {
+            info->full_solve = 1;
+        }
+
+        ret = schwarz_inpainting(image, mask, u, params.full, NULL);
+    }
+
+    return ret;
+}
@@ -0,0 +1,41 @@
+#ifndef _ASI_INCREMENTAL_H_
+#define _ASI_INCREMENTAL_H_
+
+#include "asi_image.h"
+#include "asi_schwarz.h"
+
+/* Pixel whose mask state changed */
+typedef struct mask_edit
+{
+    int i; /* Row */
+    int j; /* Column */
+} mask_edit_type;
+
+/* Parameters of incremental re-inpainting */
+typedef struct incremental_params
+{
+    int margin; /* Initial margin of a region around edited pixels */
+    double eps; /* Largest change at a region border in grey values */
+    double max_fraction; /* Share of the image above which all is solved */
+    int local_iter; /* Maximum number of iterations per region solve */
+    double local_eps; /* Relative residual tolerance of region solves */
+    schwarz_params_type full; /* Solver of a fallback to a full solve */
+} incremental_params_type;
+
+/* Work done by an incremental re-inpainting */
+typedef struct incremental_info
+{
+    int regions; /* Number of solved regions */
+    long pixels; /* Number of pixels covered by region solves */
+    int full_solve; /* Flag for a fallback to a full solve */
+} incremental_info_type;
+
+/* Default parameters */
+void incremental_params_default(incremental_params_type *params);
+
+/* Update an inpainting solution after changes of a few mask pixels */
+int incremental_inpainting(const image_type image, const image_type mask,
+        image_type u, const mask_edit_type *edits, int num_edits,
+        const incremental_params_type params, incremental_info_type *info);
+
+#endif
@@ -401,3 +401,365 @@ int image_write_pnm(image_type image, char* filename, int binary_mode)
     return ASI_EXIT_SUCCESS;
 }
 
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reads the next decimal number of a PNM file, skipping whitespace and
+ * comments. The single character following the number is consumed, which
+ * for the last header entry is the whitespace before binary data.
+ * @file    [I/O] Open file
+ * @value   [ O ] Parsed number
+ */
+static int pnm_read_number(FILE *file, int *value)
+{
+    int c; /* Current character */
+
+    c = fgetc(file);
+
+    while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+            {
+                c = fgetc(file);
+            }
+        }
+
+        c = fgetc(file);
+    }
+
+    if (c < '0' || c > '9')
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    *value = 0;
+
+    while (c >= '0' && c <= '9')
+    {
+        *value = 10 * *value + (c - '0');
+        c = fgetc(file);
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Opens a greyscale PNM file for reading it row by row, so that images
+ * larger than memory can be processed in bands.
+ * @stream   [ O ] Stream
+ * @filename [ I ] File name
+ */
+int pnm_stream_open(pnm_stream_type *stream, const char *filename)
+{
+    pnm_header_type *header = &stream->header;
+    int magic[2]; /* Magic number */
+    size_t row_bytes; /* Bytes per row of binary data */
+
+    memset(stream, 0, sizeof(pnm_stream_type));
+
+    stream->file = fopen(filename, "rb");
+
+    if (stream->file == NULL)
+    {
+        return ASI_EXIT_FILE_NOT_FOUND;
+    }
+
+    magic[0] = fgetc(stream->file);
+    magic[1] = fgetc(stream->file);
+
+    if (magic[0] != 'P' || magic[1] < '1' || magic[1] > '6'
+            || magic[1] == '3' || magic[1] == '6')
+    {
+        fclose(stream->file);
+        return ASI_EXIT_INVALID_FTYPE;
+    }
+
+    header->ftype = (pnm_ftype_enum) (PNM_P1 + magic[1] - '1');
+    header->data_depth = 1;
+    header->header_length = 0;
+
+    if (pnm_read_number(stream->file, &header->width) != ASI_EXIT_SUCCESS
+            || pnm_read_number(stream->file, &header->height)
+            != ASI_EXIT_SUCCESS
+            || ((header->ftype == PNM_P2 || header->ftype == PNM_P5)
+                && pnm_read_number(stream->file, &header->data_depth)
+                != ASI_EXIT_SUCCESS))
+    {
+        fclose(stream->file);
+        return ASI_EXIT_INVALID_FTYPE;
+    }
+
+    if (header->width < 1 || header->height < 1)
+    {
+        fclose(stream->file);
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    if (header->data_depth < 1 || header->data_depth > 65535)
+    {
+        fclose(stream->file);
+        return ASI_EXIT_INVALID_DDEPTH;
+    }
+
+    /* Row buffer of binary formats */
+    row_bytes = 0;
+
+    if (header->ftype == PNM_P4)
+    {
+        row_bytes = (header->width + 7) / 8;
+    }
+    else if (header->ftype == PNM_P5)
+    {
+        row_bytes = (size_t) header->width * (header->data_depth > 255 ? 2 : 1);
+    }
+
+    if (row_bytes > 0)
+    {
+        stream->buffer = (unsigned char *) malloc(row_bytes);
+
+        if (stream->buffer == NULL)
+        {
+            fclose(stream->file);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Creates a greyscale PNM file to be written row by row: P5 in binary mode,
+ * P2 otherwise.
+ * @stream      [ O ] Stream
+ * @filename    [ I ] File name
+ * @width       [ I ] Image width
+ * @height      [ I ] Image height
+ * @data_depth  [ I ] Maximum value, at most 65535
+ * @binary_mode [ I ] Flag for binary data
+ */
+int pnm_stream_create(pnm_stream_type *stream, const char *filename,
+        int width, int height, int data_depth, int binary_mode)
+{
+    pnm_header_type *header = &stream->header;
+
+    memset(stream, 0, sizeof(pnm_stream_type));
+
+    if (width < 1 || height < 1)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    if (data_depth < 1 || data_depth > 65535)
+    {
+        return ASI_EXIT_INVALID_DDEPTH;
+    }
+
+    header->ftype = binary_mode ? PNM_P5 : PNM_P2;
+    header->width = width;
+    header->height = height;
+    header->data_depth = data_depth;
+
+    if (binary_mode)
+    {
+        stream->buffer = (unsigned char *) malloc((size_t) width
+                * (data_depth > 255 ? 2 : 1));
+
+        if (stream->buffer == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+    }
+
+    stream->file = fopen(filename, binary_mode ? "wb" : "w");
+
+    if (stream->file == NULL)
+    {
+        free(stream->buffer);
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    fprintf(stream->file, "P%d\n%d %d\n%d\n", binary_mode ? 5 : 2, width,
+            height, data_depth);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reads the next rows of a stream. Bitmaps yield 1 for black pixels.
+ * @stream  [I/O] Stream opened for reading
+ * @data    [ O ] Pixel values of rows * width pixels
+ * @rows    [ I ] Number of rows
+ */
+int pnm_stream_read_rows(pnm_stream_type *stream, int *data, int rows)
+{
+    const pnm_header_type *header = &stream->header;
+    int w = header->width;
+    int i, j, c; /* Loop variables, character */
+    int wide; /* Flag for two bytes per value */
+
+    if (rows < 0 || stream->row + rows > header->height)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    wide = header->data_depth > 255;
+
+    for (i = 0; i < rows; i++, data += w)
+    {
+        if (header->ftype == PNM_P2)
+        {
+            for (j = 0; j < w; j++)
+            {
+                if (pnm_read_number(stream->file, &data[j])
+                        != ASI_EXIT_SUCCESS)
+                {
+                    return ASI_EXIT_FAILURE;
+                }
+            }
+        }
+        else if (header->ftype == PNM_P1)
+        {
+            /* Bits need not be separated by whitespace */
+            for (j = 0; j < w; j++)
+            {
+                c = fgetc(stream->file);
+
+                while (c != '0' && c != '1' && c != EOF)
+                {
+                    if (c == '#')
+                    {
+                        while (c != '\n' && c != EOF)
+                        {
+                            c = fgetc(stream->file);
+                        }
+                    }
+
+                    c = fgetc(stream->file);
+                }
+
+                if (c == EOF)
+                {
+                    return ASI_EXIT_FAILURE;
+                }
+
+                data[j] = c - '0';
+            }
+        }
+        else if (header->ftype == PNM_P4)
+        {
+            if (fread(stream->buffer, (w + 7) / 8, 1, stream->file) != 1)
+            {
+                return ASI_EXIT_FAILURE;
+            }
+
+            for (j = 0; j < w; j++)
+            {
+                data[j] = (stream->buffer[j / 8] >> (7 - j % 8)) & 1;
+            }
+        }
+        else
+        {
+            if (fread(stream->buffer, (size_t) w * (wide ? 2 : 1), 1,
+                        stream->file) != 1)
+            {
+                return ASI_EXIT_FAILURE;
+            }
+
+            /* Two-byte values are big-endian */
+            for (j = 0; j < w; j++)
+            {
+                data[j] = wide ? (stream->buffer[2 * j] << 8)
+                    | stream->buffer[2 * j + 1] : stream->buffer[j];
+            }
+        }
+
+        stream->row++;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Appends rows to a stream created for writing. Values are clamped to the
+ * range of the file.
+ * @stream  [I/O] Stream created for writing
+ * @data    [ I ] Pixel values of rows * width pixels
+ * @rows    [ I ] Number of rows
+ */
+int pnm_stream_write_rows(pnm_stream_type *stream, const int *data, int rows)
+{
+    const pnm_header_type *header = &stream->header;
+    int w = header->width;
+    int i, j, value; /* Loop variables, clamped value */
+    int wide; /* Flag for two bytes per value */
+
+    if (rows < 0 || stream->row + rows > header->height)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    wide = header->data_depth > 255;
+
+    for (i = 0; i < rows; i++, data += w)
+    {
+        for (j = 0; j < w; j++)
+        {
+            value = data[j] < 0 ? 0 : data[j];
+            value = value > header->data_depth ? header->data_depth : value;
+
+            if (header->ftype == PNM_P2)
+            {
+                fprintf(stream->file, "%d\n", value);
+            }
+            else if (wide)
+            {
+                stream->buffer[2 * j] = (unsigned char) (value >> 8);
+                stream->buffer[2 * j + 1] = (unsigned char) (value & 255);
+            }
+            else
+            {
+                stream->buffer[j] = (unsigned char) value;
+            }
+        }
+
+        if (header->ftype == PNM_P5 && fwrite(stream->buffer,
+                    (size_t) w * (wide ? 2 : 1), 1, stream->file) != 1)
+        {
+            return ASI_EXIT_FAILURE;
+        }
+
+        stream->row++;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Closes a stream.
+ * @stream  [I/O] Stream
+ */
+int pnm_stream_close(pnm_stream_type *stream)
+{
+    int ret; /* Return value */
+
+    ret = fclose(stream->file) == 0 ? ASI_EXIT_SUCCESS : ASI_EXIT_FAILURE;
+    free(stream->buffer);
+
+    stream->file = NULL;
+    stream->buffer = NULL;
+
+    return ret;
+}
@@ -2,6 +2,7 @@
 #define _ASI_IO_H_
 
 #include "asi_image.h"
+#include <stdio.h>
 
 typedef enum pnm_ftype
 {
@@ -22,6 +23,15 @@ typedef struct pnm_header
     int header_length;
 } pnm_header_type;
 
+/* Sequential row access to a greyscale PNM file (P1, P2, P4, P5) */
+typedef struct pnm_stream
+{
+    FILE *file; /* Open file */
+    pnm_header_type header; /* File type, dimensions and maximum value */
+    int row; /* Index of the next row to be read or written */
+    unsigned char *buffer; /* Row of binary data */
+} pnm_stream_type;
+
 /* Import */
 int image_read_pnm_header(pnm_header_type *header, const char* filename);
 int image_read_pnm_body(image_type *image, const char* filename,
@@ -33,4 +43,13 @@ int image_init_pnm_header(image_type image, pnm_header_type *header,
         int binary_mode);
 int image_write_pnm(image_type image, char* filename, int binary_mode);
 
+/* Streaming in bands of rows */
+int pnm_stream_open(pnm_stream_type *stream, const char *filename);
+int pnm_stream_create(pnm_stream_type *stream, const char *filename,
+        int width, int height, int data_depth, int binary_mode);
+int pnm_stream_read_rows(pnm_stream_type *stream, int *data, int rows);
+int pnm_stream_write_rows(pnm_stream_type *stream, const int *data,
+        int rows);
+int pnm_stream_close(pnm_stream_type *stream);
+
 #endif
@@ -1,6 +1,93 @@
 #include "asi_mask.h"
 #include "asi_convolution.h"
 #include <math.h>
+#include <stdlib.h>
+
+/* Smallest number of columns of a block of a parallel dithering */
+#define DITHERING_MIN_BLOCK 64
+
+/* Shared state of a parallel dithering, handed to the scheduler tasks */
+typedef struct dithering_context
+{
+    image_type result; /* Working copy of the image */
+    int num_blocks; /* Number of column blocks per row */
+} dithering_context_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Floyd-Steinberg dithering of a block of columns of one row. Quantises the
+ * pixels and diffuses the error to the right and to the next row.
+ * @result  [I/O] Working copy of the image
+ * @i       [ I ] Row index
+ * @j0, j1  [ I ] Half-open range of columns
+ */
+static void floyd_steinberg_block(image_type result, int i, int j0, int j1)
+{
+    int j; /* Iteration variable */
+    double value_old, value_new; /* Temporary pixel values */
+    double error; /* Quantisation error */
+    double *row, *next; /* Current and next row, NULL in the last row */
+
+    row = (double *) result.data + (size_t) i * result.width;
+    next = i < result.height - 1 ? row + result.width : NULL;
+
+    for (j = j0; j < j1; j++)
+    {
+        value_old = row[j];
+
+        /* Put new value depending on if it is closer to 0 or 255 */
+        value_new = value_old > 127.5 ? 255.0 : 0.0;
+        row[j] = value_new;
+
+        /* Compute error */
+        error = value_old - value_new;
+
+        /* Propagate error */
+        if (j < result.width-1)
+        {
+            row[j+1] += error * 7.0 / 16.0;
+        }
+        if (next != NULL)
+        {
+            next[j] += error * 5.0 / 16.0;
+
+            if (j > 0)
+            {
+                next[j-1] += error * 3.0 / 16.0;
+            }
+            if (j < result.width-1)
+            {
+                next[j+1] += error * 1.0 / 16.0;
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task dithering one block of columns of one row.
+ * @arg     [I/O] Dithering context
+ * @index   [ I ] Row index times number of blocks plus block index
+ */
+static void floyd_steinberg_task(void *arg, int index)
+{
+    dithering_context_type *ctx = (dithering_context_type *) arg;
+    int i, b; /* Row and block index */
+    int j0, j1; /* Column range */
+
+    i = index / ctx->num_blocks;
+    b = index % ctx->num_blocks;
+    j0 = (int) ((long) b * ctx->result.width / ctx->num_blocks);
+    j1 = (int) ((long) (b + 1) * ctx->result.width / ctx->num_blocks);
+
+    floyd_steinberg_block(ctx->result, i, j0, j1);
+
+    return;
+}
 
 /*----------------------------------------------------------------------------*/
 
@@ -11,11 +98,29 @@
  */
 int floyd_steinberg_dithering(const image_type image, image_type *result)
 {
-    int i, j; /* Iteration variables */
+    return floyd_steinberg_dithering_parallel(image, result, NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Floyd-Steinberg dithering as a wavefront of tasks. Rows are split into
+ * blocks of columns; a block may start once the block to its left and the
+ * block above right of it are done, since then all error contributions to
+ * its pixels have arrived in the same order as in the serial sweep. The
+ * result is therefore identical to the one of floyd_steinberg_dithering.
+ * @image   [ I ] 8-bit integer valued input image
+ * @result  [ O ] Dithered image
+ * @sched   [I/O] Task scheduler, NULL for serial execution
+ */
+int floyd_steinberg_dithering_parallel(const image_type image,
+        image_type *result, scheduler_type *sched)
+{
+    dithering_context_type ctx; /* Shared state of the block tasks */
+    scheduler_task_type *tasks; /* One task per block of a row */
+    int i, b, k; /* Loop variables */
+    int num_tasks; /* Number of tasks */
     int ret; /* Return value */
-    double value_old, value_new; /* Temporary pixel values */
-    double value; /* Pixel value of neighbouring pixels */
-    double error; /* Quantisation error */
 
     //TODO implement Floyd-Steinberg for colour images
     /* Make sure image is of double type */
@@ -39,63 +144,115 @@ int floyd_steinberg_dithering(const image_type image, image_type *result)
         return ret;
     }
 
+    /* Rows in flight grow with half the number of blocks */
+    ctx.result = *result;
+    ctx.num_blocks = sched == NULL ? 1 : 2 * sched->num_threads;
+    if (ctx.num_blocks > image.width / DITHERING_MIN_BLOCK)
+    {
+        ctx.num_blocks = image.width / DITHERING_MIN_BLOCK;
+    }
+
+    tasks = NULL;
+    num_tasks = image.height * ctx.num_blocks;
+
+    if (ctx.num_blocks > 1 && sched->num_threads > 1)
+    {
+        tasks = (scheduler_task_type *) malloc(num_tasks
+                * sizeof(scheduler_task_type));
+    }
+
     /* Proceed through image starting from the top left */
-    for (i = 0; i < image.height; i++)
+    if (tasks == NULL)
     {
-        for (j = 0; j < image.width; j++)
+        for (i = 0; i < image.height; i++)
         {
-            value_old = image_fget(*result, i, j);
+            floyd_steinberg_block(*result, i, 0, image.width);
+        }
 
-            /* Put new value depending on if it is closer to 0 or 255 */
-            if (value_old > 127.5)
-            {
-                value_new = 255.0; 
-            }
-            else
-            {
-                value_new = 0.0;
-            }
+        return ASI_EXIT_SUCCESS;
+    }
 
-            image_fput(*result, value_new, i, j);
+    for (k = 0; k < num_tasks; k++)
+    {
+        scheduler_task_init(&tasks[k], floyd_steinberg_task, &ctx, k);
+    }
 
-            /* Compute error */
-            error = value_old - value_new;
+    for (i = 0; i < image.height && ret == ASI_EXIT_SUCCESS; i++)
+    {
+        for (b = 0; b < ctx.num_blocks && ret == ASI_EXIT_SUCCESS; b++)
+        {
+            k = i * ctx.num_blocks + b;
 
-            /* Propagate error */
-            // TODO Since images are int-valued, error will be slightly different
-            // compared to real-valued images
-            if (j < image.width-1)
-            {
-                value = image_fget(*result, i, j+1);
-                image_fput(*result, 
-                        value + error * 7.0 / 16.0, 
-                        i, j+1);
-            }
-            if (i < image.height-1)
-            {
-                value = image_fget(*result, i+1, j);
-                image_fput(*result, 
-                        value + error * 5.0 / 16.0, 
-                        i+1, j);
-            }
-            if (j > 0 && i < image.height-1)
+            if (b > 0)
             {
-                
-                value = image_fget(*result, i+1, j-1);
-                image_fput(*result, 
-                        value + error * 3.0 / 16.0, 
-                        i+1, j-1);
+                ret = scheduler_task_depend(&tasks[k], &tasks[k - 1]);
             }
-            if (j < image.width-1 && i < image.height-1)
+            if (i > 0 && ret == ASI_EXIT_SUCCESS)
             {
-                value = image_fget(*result, i+1, j+1);
-                image_fput(*result, value + error * 1.0 / 16.0, 
-                        i+1, j+1);
+                ret = scheduler_task_depend(&tasks[k], 
+                        &tasks[k - ctx.num_blocks
+                        + (b < ctx.num_blocks - 1 ? 1 : 0)]);
             }
         }
     }
 
-    return ASI_EXIT_SUCCESS;
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        for (k = num_tasks - 1; k >= 0; k--)
+        {
+            scheduler_submit(sched, &tasks[k]);
+        }
+
+        scheduler_wait(sched);
+    }
+
+    for (k = 0; k < num_tasks; k++)
+    {
+        scheduler_task_delete(&tasks[k]);
+    }
+
+    free(tasks);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Absolute value of the 5-point Laplacian of a row of the smoothed image
+ * with mirrored boundaries. The terms are summed in the order of
+ * image_convolve with the ASI_LAPLACIAN kernel.
+ * @up, mid, down   [ I ] Smoothed rows above, at and below the row
+ * @target          [ O ] Absolute values of the Laplacian
+ * @width           [ I ] Number of columns
+ */
+static double mask_laplacian_row(const double *up, const double *mid,
+        const double *down, double *target, int width)
+{
+    double sum = 0.0; /* Sum of the absolute values */
+    int j; /* Loop variable */
+
+    if (width == 1)
+    {
+        target[0] = fabs(up[0] + mid[0] - 4.0 * mid[0] + mid[0] + down[0]);
+        return target[0];
+    }
+
+    target[0] = fabs(up[0] + mid[0] - 4.0 * mid[0] + mid[1] + down[0]);
+    sum += target[0];
+
+    for (j = 1; j < width - 1; j++)
+    {
+        target[j] = fabs(up[j] + mid[j-1] - 4.0 * mid[j] + mid[j+1]
+                + down[j]);
+        sum += target[j];
+    }
+
+    target[width-1] = fabs(up[width-1] + mid[width-2] - 4.0 * mid[width-1]
+            + mid[width-1] + down[width-1]);
+    sum += target[width-1];
+
+    return sum;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -105,6 +262,15 @@ int floyd_steinberg_dithering(const image_type image, image_type *result)
  * Laplacian followed by Floyd-Steinberg dithering. Methology by Belhachmi et
  * al. (2009): How to choose interpolation data in images. SIAM Journal on
  * Applied Mathematics 70(1), pp. 333--352.
+ *
+ * The image is streamed once in rows: each input row is smoothed in x
+ * direction into a ring of as many rows as the Gaussian has weights, the
+ * y direction is summed into a ring of three smoothed rows, and the
+ * absolute Laplacian of the middle row goes straight into the mask while
+ * its mean is accumulated. Dithering then scales each row by lambda just
+ * before the errors of the row above reach it, so the mask is the only
+ * full-size buffer and is passed over twice. The result equals the one of
+ * smoothing, filtering and dithering whole images.
  * @image               [ I ] Input image
  * @mask                [ O ] Inpainting mask
  * @compression_ratio   [ I ] Compression ratio
@@ -114,15 +280,27 @@ int mask_belhachmi_init(const image_type image, image_type
 {
     double abs_mean; /* Average grey value */
     double lambda; /* Factor to enforce compression ratio */
-    double fval; /* Pixel value */
-    int i, j; /* Loop variables */
+    double *input = NULL; /* Input row converted to double */
+    double *smooth_x = NULL; /* Ring of rows smoothed in x direction */
+    double *smooth = NULL; /* Ring of three smoothed rows */
+    double *row; /* Row of the mask */
+    const double *src; /* Input row */
+    const double **rows = NULL; /* Rows under the Gaussian in y direction */
+    int i, j, k; /* Loop variables */
+    int next_x, next_s; /* Next rows to be smoothed in x and y direction */
+    int half_w; /* Half width of the Gaussian */
+    int width, height; /* Image dimensions */
     int ret_val; /* Return value */
-    kernel_type kernel_gauss, kernel_lapl; /* Convolution kernels */
-    image_type image_f; /* Double valued copy of the input image */
+    kernel_type kernel_gauss; /* Convolution kernel */
+
+    width = image.width;
+    height = image.height;
 
-    /* Initialise an double-valued copy of the input image */
-    image_init(&image_f, image.width, image.height, ASI_DTYPE_DOUBLE);
-    image_copy(image, image_f);
+    if (image.dtype == ASI_DTYPE_INT_RGB
+            || image.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
 
     /* Initialise Gaussian convolution kernel with sigma = 1.0 */
     ret_val = kernel_init(&kernel_gauss, ASI_GAUSSIAN, 2, 1.0, 3.0);
@@ -131,64 +309,191 @@ int mask_belhachmi_init(const image_type image, image_type
     {
         return ret_val;
     }
-    
-    /* Do Gaussian smoothing */
-    ret_val = image_convolve(image_f, kernel_gauss);
 
-    if (ret_val != ASI_EXIT_SUCCESS)
-    {
-        return ret_val;
-    }
-    
-    /* Initialise Laplacian convolution kernel */
-    ret_val = kernel_init(&kernel_lapl, ASI_LAPLACIAN, 0);
+    half_w = kernel_gauss.width / 2;
+
+    ret_val = image_init(mask, width, height, ASI_DTYPE_DOUBLE);
 
     if (ret_val != ASI_EXIT_SUCCESS)
     {
+        kernel_delete(&kernel_gauss);
         return ret_val;
     }
 
-    /* Apply Laplace filter */
-    ret_val = image_convolve(image_f, kernel_lapl);
-    
-    if (ret_val != ASI_EXIT_SUCCESS)
+    input = (double *) malloc((size_t) width * sizeof(double));
+    smooth_x = (double *) malloc((size_t) kernel_gauss.width * width
+            * sizeof(double));
+    smooth = (double *) malloc((size_t) 3 * width * sizeof(double));
+    rows = (const double **) malloc(kernel_gauss.width * sizeof(double *));
+
+    if (input == NULL || smooth_x == NULL || smooth == NULL || rows == NULL)
     {
-        return ret_val;
+        ret_val = ASI_EXIT_FAILED_ALLOC;
     }
 
-    /* Convert Laplace-filtered image to absolute values and compute its mean */
+    /* The rows under a kernel lie within as many consecutive rows as it
+     * has weights, so ring slots indexed by row modulo size never collide */
+    next_x = next_s = 0;
     abs_mean = 0.0;
-    for (i = 0; i < image_f.height; i++)
+
+    for (i = 0; i < height && ret_val == ASI_EXIT_SUCCESS; i++)
     {
-        for (j = 0; j < image_f.width; j++)
+        for (; next_s <= i + 1 && next_s < height; next_s++)
         {
-            fval = fabs(image_fget(image_f, i, j));
-            image_fput(image_f, fval, i, j); 
-            abs_mean += fval;
+            for (; next_x <= next_s + half_w && next_x < height; next_x++)
+            {
+                if (image.dtype == ASI_DTYPE_DOUBLE)
+                {
+                    src = (const double *) image.data + (size_t) next_x
+                        * width;
+                }
+                else
+                {
+                    for (j = 0; j < width; j++)
+                    {
+                        input[j] = image_get(image, next_x, j);
+                    }
+
+                    src = input;
+                }
+
+                convolution_row_x(src, smooth_x + (size_t) (next_x
+                            % kernel_gauss.width) * width, width,
+                        kernel_gauss);
+            }
+
+            for (k = 0; k < kernel_gauss.width; k++)
+            {
+                rows[k] = smooth_x + (size_t) (image_mirror_index(next_s + k
+                            - half_w, height) % kernel_gauss.width) * width;
+            }
+
+            convolution_row_y(rows, smooth + (size_t) (next_s % 3) * width,
+                    width, kernel_gauss);
         }
+
+        abs_mean += mask_laplacian_row(smooth + (size_t)
+                (image_mirror_index(i - 1, height) % 3) * width,
+                smooth + (size_t) (i % 3) * width, smooth + (size_t)
+                (image_mirror_index(i + 1, height) % 3) * width,
+                (double *) mask->data + (size_t) i * width, width);
+    }
+
+    free(input);
+    free(smooth_x);
+    free(smooth);
+    free(rows);
+    kernel_delete(&kernel_gauss);
+
+    if (ret_val != ASI_EXIT_SUCCESS)
+    {
+        image_delete(mask);
+        return ret_val;
     }
 
-    abs_mean /= (image_f.height * image_f.width);
+    abs_mean /= (height * width);
 
-    /* Compute Lambda and multiply it pointwise with the image */
+    /* Compute Lambda */
     lambda = compression_ratio * 255.0 / abs_mean;
 
-    for (i = 0; i < image_f.height; i++)
+    /* Apply Floyd-Steinberg dithering to the scaled image, each row is
+     * scaled before the errors of the row above are diffused into it */
+    for (i = 0; i < height; i++)
     {
-        for (j = 0; j < image_f.width; j++)
+        for (k = i == 0 ? 0 : 1; k < 2 && i + k < height; k++)
         {
-            fval = image_fget(image_f, i, j);
-            image_fput(image_f, fval * lambda, i, j);
+            row = (double *) mask->data + (size_t) (i + k) * width;
+
+            for (j = 0; j < width; j++)
+            {
+                row[j] *= lambda;
+            }
         }
+
+        floyd_steinberg_block(*mask, i, 0, width);
     }
-    
-    /* Apply Floyd-Steinberg dithering to preprocessed image */
-    ret_val = floyd_steinberg_dithering(image_f, mask);
 
-    if (ret_val != ASI_EXIT_SUCCESS)
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Prepares an inpainting mask of uniformly distributed random pixels. The
+ * number of known pixels is the compression ratio times the number of
+ * pixels. Uses rand(), so srand() selects the pattern.
+ * @image               [ I ] Input image
+ * @mask                [ O ] Inpainting mask (0 / 255)
+ * @compression_ratio   [ I ] Fraction of known pixels
+ */
+int mask_random_init(const image_type image, image_type *mask,
+        double compression_ratio)
+{
+    int *pixels; /* Pixel indices, the first ones are selected */
+    int n, num_known; /* Number of pixels and of known pixels */
+    int k, r, tmp; /* Loop variable, random position, swap variable */
+    int ret; /* Return value */
+
+    if (compression_ratio < 0.0 || compression_ratio > 1.0)
     {
-        return ret_val;
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    ret = image_init(mask, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    n = image.width * image.height;
+    num_known = (int) (compression_ratio * n + 0.5);
+    pixels = (int *) malloc(n * sizeof(int));
+
+    if (pixels == NULL)
+    {
+        image_delete(mask);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (k = 0; k < n; k++)
+    {
+        pixels[k] = k;
     }
 
+    /* Partial Fisher-Yates shuffle */
+    for (k = 0; k < num_known; k++)
+    {
+        r = k + (int) ((double) rand() / ((double) RAND_MAX + 1.0) * (n - k));
+        tmp = pixels[k];
+        pixels[k] = pixels[r];
+        pixels[r] = tmp;
+
+        image_fput(*mask, 255.0, pixels[k] / image.width,
+                pixels[k] % image.width);
+    }
+
+    free(pixels);
+
     return ASI_EXIT_SUCCESS;
 }
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Returns 1 if the pixel at a given location is marked as known in an
+ * inpainting mask and 0 otherwise. Accepts boolean / integer masks as well as
+ * the double-valued masks (0 / 255) produced by mask_belhachmi_init.
+ * @mask    [ I ] Inpainting mask
+ * @i       [ I ] y coordinate (row number)
+ * @j       [ I ] x coordinate (column number)
+ */
+int mask_get(const image_type mask, int i, int j)
+{
+    if (mask.dtype == ASI_DTYPE_DOUBLE)
+    {
+        return image_fget(mask, i, j) > 0.0;
+    }
+
+    return image_get(mask, i, j) != 0;
+}
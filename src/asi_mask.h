@@ -2,11 +2,16 @@
 #define _ASI_MASK_H_
 
 #include "asi_image.h"
+#include "asi_scheduler.h"
 
 /* Dithering with the Floyd-Steinberg algorithm */
 int floyd_steinberg_dithering(const image_type image, image_type 
         *result);
 
+/* Floyd-Steinberg dithering as a wavefront of parallel tasks */
+int floyd_steinberg_dithering_parallel(const image_type image,
+        image_type *result, scheduler_type *sched);
+
 int mask_belhachmi_init(const image_type image, image_type
         *mask, double compression_ratio);
 
@@ -14,4 +19,7 @@ int mask_belhachmi_init(const image_type image, image_type
 int mask_random_init(const image_type image, image_type
         *mask, double compression_ratio);
 
+/* Query whether a pixel is marked as known in an inpainting mask */
+int mask_get(const image_type mask, int i, int j);
+
 #endif
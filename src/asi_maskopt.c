@@ -0,0 +1,846 @@
+#include "asi_maskopt.h"
+#include "asi_diffusion.h"
+#include "asi_mask.h"
+#include "asi_scheduler.h"
+#include "asi_sparse.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Rectangular window of the image, ranges are half-open */
+typedef struct maskopt_window
+{
+    int x0, x1, y0, y1; /* Column and row range */
+} maskopt_window_type;
+
+/* Known and unknown pixels in two lists for uniform random selection */
+typedef struct maskopt_pixels
+{
+    int *known; /* Known pixel indices */
+    int num_known; /* Number of known pixels */
+    int *unknown; /* Unknown pixel indices */
+    int num_unknown; /* Number of unknown pixels */
+    int *position; /* Position of each pixel within its list */
+} maskopt_pixels_type;
+
+/* Exchange of a known and an unknown pixel, evaluated on local windows */
+typedef struct maskopt_proposal
+{
+    int known; /* Pixel becoming unknown */
+    int unknown; /* Pixel becoming known */
+    maskopt_window_type windows[2]; /* Windows around both pixels */
+    int num_windows; /* One window if both pixels are close */
+    double delta; /* Change of the squared error within the windows */
+    int status; /* Error code of the evaluation */
+} maskopt_proposal_type;
+
+/* Shared state of a batch of exchanges, handed to the scheduler tasks */
+typedef struct maskopt_context
+{
+    const maskopt_params_type *params; /* Parameters */
+    image_type image; /* Original image */
+    image_type mask; /* Current mask */
+    image_type u; /* Current reconstruction */
+    maskopt_proposal_type *proposals; /* Proposals of the batch */
+} maskopt_context_type;
+
+/* Pair of squared error and pixel index for sorting */
+typedef struct maskopt_error
+{
+    double error; /* Squared error */
+    int pixel; /* Pixel index */
+} maskopt_error_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets default parameters of the mask optimisation.
+ * @params  [ O ] Parameters
+ */
+void maskopt_params_default(maskopt_params_type *params)
+{
+    params->density = 0.1;
+    params->ps_fraction = 0.1;
+    params->ps_keep = 0.1;
+    params->nlpe_cycles = 2;
+    params->nlpe_candidates = 30;
+    params->nlpe_batch = 64;
+    params->radius = 8;
+    params->local_iter = 200;
+    params->local_eps = 1e-3;
+    params->num_threads = 0;
+    params->seed = 1;
+    multigrid_params_default(&params->solver);
+    params->solver.eps = 1e-5;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Draws a random number below n with a xorshift generator.
+ * @state   [I/O] Generator state, non-zero
+ * @n       [ I ] Upper bound
+ */
+static int maskopt_random(unsigned int *state, int n)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return (int) (*state % (unsigned int) n);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sorts the known and unknown pixels of a mask into lists.
+ * @pixels  [ O ] Pixel lists
+ * @mask    [ I ] Inpainting mask
+ */
+static int maskopt_pixels_init(maskopt_pixels_type *pixels,
+        const image_type mask)
+{
+    int n; /* Number of pixels */
+    int k; /* Loop variable */
+
+    n = mask.width * mask.height;
+    pixels->known = (int *) malloc(n * sizeof(int));
+    pixels->unknown = (int *) malloc(n * sizeof(int));
+    pixels->position = (int *) malloc(n * sizeof(int));
+
+    if (pixels->known == NULL || pixels->unknown == NULL
+            || pixels->position == NULL)
+    {
+        free(pixels->known);
+        free(pixels->unknown);
+        free(pixels->position);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    pixels->num_known = 0;
+    pixels->num_unknown = 0;
+
+    for (k = 0; k < n; k++)
+    {
+        if (mask_get(mask, k / mask.width, k % mask.width))
+        {
+            pixels->position[k] = pixels->num_known;
+            pixels->known[pixels->num_known++] = k;
+        }
+        else
+        {
+            pixels->position[k] = pixels->num_unknown;
+            pixels->unknown[pixels->num_unknown++] = k;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of pixel lists.
+ * @pixels  [I/O] Pixel lists
+ */
+static void maskopt_pixels_delete(maskopt_pixels_type *pixels)
+{
+    free(pixels->known);
+    free(pixels->unknown);
+    free(pixels->position);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Moves a pixel from one list to the other.
+ * @pixels  [I/O] Pixel lists
+ * @k       [ I ] Pixel index
+ * @known   [ I ] Flag to move the pixel to the known list
+ */
+static void maskopt_pixels_move(maskopt_pixels_type *pixels, int k,
+        int known)
+{
+    int *from, *to; /* Source and destination list */
+    int *num_from, *num_to; /* Lengths of the lists */
+    int last; /* Pixel moved into the gap */
+
+    from = known ? pixels->unknown : pixels->known;
+    num_from = known ? &pixels->num_unknown : &pixels->num_known;
+    to = known ? pixels->known : pixels->unknown;
+    num_to = known ? &pixels->num_known : &pixels->num_unknown;
+
+    last = from[--(*num_from)];
+    from[pixels->position[k]] = last;
+    pixels->position[last] = pixels->position[k];
+
+    pixels->position[k] = *num_to;
+    to[(*num_to)++] = k;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Inpaints the whole image, starting from the current reconstruction.
+ * @image   [ I ] Original image
+ * @mask    [ I ] Inpainting mask
+ * @u       [I/O] Reconstruction
+ * @params  [ I ] Parameters
+ * @info    [I/O] Progress
+ */
+static int maskopt_solve(const image_type image, const image_type mask,
+        image_type u, const maskopt_params_type *params,
+        maskopt_info_type *info)
+{
+    int ret; /* Return value */
+
+    ret = multigrid_inpainting(image, mask, u, params->solver, NULL);
+    info->global_solves++;
+
+    return ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Mean squared error of a reconstruction.
+ * @image   [ I ] Original image
+ * @u       [ I ] Reconstruction
+ */
+static double maskopt_mse(const image_type image, const image_type u)
+{
+    const double *f = (const double *) image.data;
+    const double *x = (const double *) u.data;
+    double sum; /* Sum of squared errors */
+    int k; /* Loop variable */
+
+    sum = 0.0;
+    for (k = 0; k < image.width * image.height; k++)
+    {
+        sum += (x[k] - f[k]) * (x[k] - f[k]);
+    }
+
+    return sum / (image.width * image.height);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Compares squared errors in descending order.
+ * @a, b    [ I ] Errors to be compared
+ */
+static int maskopt_compare(const void *a, const void *b)
+{
+    double ea = ((const maskopt_error_type *) a)->error;
+    double eb = ((const maskopt_error_type *) b)->error;
+
+    return (ea < eb) - (ea > eb);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Selects an inpainting mask by probabilistic sparsification (Mainberger et
+ * al. 2011): starting from all pixels, a random fraction of the known pixels
+ * is removed, the image is inpainted, and the removed pixels with the
+ * largest error are put back. Each inpainting is warm started from the
+ * previous reconstruction, which only changed around the removed pixels.
+ * @image   [ I ] Double-valued image
+ * @mask    [ O ] Inpainting mask (0 / 255)
+ * @params  [ I ] Parameters
+ * @info    [ O ] Progress, may be NULL
+ */
+int mask_sparsification(const image_type image, image_type *mask,
+        const maskopt_params_type params, maskopt_info_type *info)
+{
+    maskopt_info_type progress; /* Progress */
+    maskopt_pixels_type pixels; /* Known and unknown pixels */
+    maskopt_error_type *errors = NULL; /* Errors of removed pixels */
+    image_type u; /* Reconstruction */
+    unsigned int state; /* Random generator state */
+    int n, target; /* Number of pixels and of known pixels to reach */
+    int removed, kept; /* Pixels removed and put back per iteration */
+    int k, r, p; /* Loop variables */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (params.density <= 0.0 || params.density > 1.0
+            || params.ps_fraction <= 0.0 || params.ps_fraction > 1.0
+            || params.ps_keep < 0.0 || params.ps_keep >= 1.0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    memset(&progress, 0, sizeof(progress));
+    n = image.width * image.height;
+    target = (int) (params.density * n + 0.5);
+    state = params.seed != 0 ? params.seed : 1;
+
+    ret = image_init(mask, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = image_init(&u, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(mask);
+        return ret;
+    }
+
+    /* All pixels known, reconstruction exact */
+    for (k = 0; k < n; k++)
+    {
+        ((double *) mask->data)[k] = 255.0;
+    }
+    image_copy(image, u);
+
+    ret = maskopt_pixels_init(&pixels, *mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&u);
+        image_delete(mask);
+        return ret;
+    }
+
+    errors = (maskopt_error_type *) malloc(n * sizeof(maskopt_error_type));
+    ret = errors == NULL ? ASI_EXIT_FAILED_ALLOC : ASI_EXIT_SUCCESS;
+
+    while (pixels.num_known > target && ret == ASI_EXIT_SUCCESS)
+    {
+        removed = (int) ceil(params.ps_fraction * pixels.num_known);
+        kept = (int) (params.ps_keep * removed);
+
+        /* Do not remove more than needed to reach the target */
+        if (pixels.num_known - (removed - kept) < target)
+        {
+            removed = (int) ceil((pixels.num_known - target)
+                    / (1.0 - params.ps_keep));
+            removed = removed > pixels.num_known
+                ? pixels.num_known : removed;
+            kept = removed - (pixels.num_known - target);
+            kept = kept < 0 ? 0 : kept;
+        }
+
+        /* Random candidates: partial shuffle of the known list */
+        for (k = 0; k < removed; k++)
+        {
+            r = k + maskopt_random(&state, pixels.num_known - k);
+            p = pixels.known[r];
+            pixels.known[r] = pixels.known[k];
+            pixels.position[pixels.known[r]] = r;
+            pixels.known[k] = p;
+            pixels.position[p] = k;
+
+            errors[k].pixel = p;
+            ((double *) mask->data)[p] = 0.0;
+        }
+
+        ret = maskopt_solve(image, *mask, u, &params, &progress);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            break;
+        }
+
+        /* Local error at the candidates decides which ones are kept */
+        for (k = 0; k < removed; k++)
+        {
+            p = errors[k].pixel;
+            errors[k].error = (((double *) u.data)[p]
+                    - ((double *) image.data)[p])
+                * (((double *) u.data)[p] - ((double *) image.data)[p]);
+        }
+
+        qsort(errors, removed, sizeof(maskopt_error_type), maskopt_compare);
+
+        for (k = 0; k < removed; k++)
+        {
+            p = errors[k].pixel;
+
+            if (k < kept)
+            {
+                ((double *) mask->data)[p] = 255.0;
+                ((double *) u.data)[p] = ((double *) image.data)[p];
+            }
+            else
+            {
+                maskopt_pixels_move(&pixels, p, 0);
+            }
+        }
+
+        progress.iterations++;
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = maskopt_solve(image, *mask, u, &params, &progress);
+        progress.mse = maskopt_mse(image, u);
+    }
+
+    if (info != NULL)
+    {
+        *info = progress;
+    }
+
+    free(errors);
+    maskopt_pixels_delete(&pixels);
+    image_delete(&u);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(mask);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Window of the local evaluation around a pixel.
+ * @image   [ I ] Image
+ * @k       [ I ] Pixel index
+ * @radius  [ I ] Half edge length
+ */
+static maskopt_window_type maskopt_window(const image_type image, int k,
+        int radius)
+{
+    maskopt_window_type win; /* Window */
+    int i, j; /* Pixel coordinates */
+
+    i = k / image.width;
+    j = k % image.width;
+
+    win.x0 = j - radius < 0 ? 0 : j - radius;
+    win.x1 = j + radius + 1 > image.width ? image.width : j + radius + 1;
+    win.y0 = i - radius < 0 ? 0 : i - radius;
+    win.y1 = i + radius + 1 > image.height ? image.height : i + radius + 1;
+
+    return win;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks whether one window or its boundary ring meets another window.
+ * @a, b    [ I ] Windows
+ */
+static int maskopt_conflict(const maskopt_window_type *a,
+        const maskopt_window_type *b)
+{
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1
+        && b->y0 <= a->y1;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves the inpainting problem on a window with the current reconstruction
+ * as boundary data and initial guess, and returns the change of the squared
+ * error within the window.
+ * @ctx     [ I ] Batch context
+ * @win     [ I ] Window
+ * @op      [ O ] Operator of the window and its ring
+ * @x       [ O ] Local solution, allocated here
+ * @ox, oy  [ O ] Image coordinates of the local origin
+ * @delta   [I/O] Accumulated change of the squared error
+ */
+static int maskopt_window_solve(const maskopt_context_type *ctx,
+        const maskopt_window_type *win, diffusion_operator_type *op,
+        double **x, int *ox, int *oy, double *delta)
+{
+    const double *f = (const double *) ctx->image.data;
+    const double *u = (const double *) ctx->u.data;
+    double *b; /* Right-hand side */
+    int i, j, k, g; /* Loop variables, local and global index */
+    int inside; /* Flag for pixels of the window itself */
+    int ret; /* Return value */
+
+    *x = NULL;
+
+    ret = diffusion_operator_init_mask_window(op, ctx->mask, win->x0,
+            win->x1, win->y0, win->y1, ox, oy);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    *x = (double *) malloc(2 * (size_t) op->n * sizeof(double));
+
+    if (*x == NULL)
+    {
+        diffusion_operator_delete(op);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    b = *x + op->n;
+
+    for (i = 0; i < op->height; i++)
+    {
+        for (j = 0; j < op->width; j++)
+        {
+            k = i * op->width + j;
+            g = (*oy + i) * ctx->image.width + *ox + j;
+            inside = *oy + i >= win->y0 && *oy + i < win->y1
+                && *ox + j >= win->x0 && *ox + j < win->x1;
+
+            (*x)[k] = inside && (op->flags[k] & ASI_STENCIL_KNOWN)
+                ? f[g] : u[g];
+        }
+    }
+
+    diffusion_operator_rhs(*op, *x, b);
+    ret = conjugate_gradient(diffusion_linear_operator(op), b, *x,
+            ctx->params->local_iter, ctx->params->local_eps);
+    ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+
+    for (i = win->y0; i < win->y1; i++)
+    {
+        for (j = win->x0; j < win->x1; j++)
+        {
+            k = (i - *oy) * op->width + j - *ox;
+            g = i * ctx->image.width + j;
+
+            *delta += ((*x)[k] - f[g]) * ((*x)[k] - f[g])
+                - (u[g] - f[g]) * (u[g] - f[g]);
+        }
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Evaluates a pixel exchange on its windows and applies it if it lowers the
+ * error. Windows of a batch are disjoint including their boundary rings, so
+ * the proposals of a batch do not interact.
+ * @arg     [I/O] Batch context
+ * @index   [ I ] Proposal index
+ */
+static void maskopt_exchange_task(void *arg, int index)
+{
+    maskopt_context_type *ctx = (maskopt_context_type *) arg;
+    maskopt_proposal_type *prop = &ctx->proposals[index];
+    diffusion_operator_type op[2]; /* Operators of the windows */
+    double *x[2] = {NULL, NULL}; /* Local solutions */
+    int ox[2], oy[2]; /* Local origins */
+    int w, i, j; /* Loop variables */
+    int solved; /* Number of solved windows */
+
+    ((double *) ctx->mask.data)[prop->known] = 0.0;
+    ((double *) ctx->mask.data)[prop->unknown] = 255.0;
+
+    prop->delta = 0.0;
+    prop->status = ASI_EXIT_SUCCESS;
+
+    for (solved = 0; solved < prop->num_windows; solved++)
+    {
+        prop->status = maskopt_window_solve(ctx, &prop->windows[solved],
+                &op[solved], &x[solved], &ox[solved], &oy[solved],
+                &prop->delta);
+
+        if (prop->status != ASI_EXIT_SUCCESS)
+        {
+            if (x[solved] != NULL)
+            {
+                free(x[solved]);
+                diffusion_operator_delete(&op[solved]);
+            }
+            break;
+        }
+    }
+
+    if (prop->status != ASI_EXIT_SUCCESS || prop->delta >= 0.0)
+    {
+        /* Reject: restore the mask */
+        ((double *) ctx->mask.data)[prop->known] = 255.0;
+        ((double *) ctx->mask.data)[prop->unknown] = 0.0;
+    }
+
+    for (w = 0; w < solved; w++)
+    {
+        if (prop->status == ASI_EXIT_SUCCESS && prop->delta < 0.0)
+        {
+            for (i = prop->windows[w].y0; i < prop->windows[w].y1; i++)
+            {
+                for (j = prop->windows[w].x0; j < prop->windows[w].x1; j++)
+                {
+                    image_fput(ctx->u, x[w][(i - oy[w]) * op[w].width + j
+                            - ox[w]], i, j);
+                }
+            }
+        }
+
+        free(x[w]);
+        diffusion_operator_delete(&op[w]);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Draws a pixel exchange: a random known pixel and, among a few random
+ * unknown pixels, the one with the largest error.
+ * @ctx     [ I ] Batch context
+ * @pixels  [ I ] Known and unknown pixels
+ * @state   [I/O] Random generator state
+ * @prop    [ O ] Proposal
+ */
+static void maskopt_propose(const maskopt_context_type *ctx,
+        const maskopt_pixels_type *pixels, unsigned int *state,
+        maskopt_proposal_type *prop)
+{
+    const double *f = (const double *) ctx->image.data;
+    const double *u = (const double *) ctx->u.data;
+    double error, best; /* Squared errors */
+    int c, k; /* Candidate, loop variable */
+    maskopt_window_type *a, *b; /* Windows of both pixels */
+
+    prop->known = pixels->known[maskopt_random(state, pixels->num_known)];
+    prop->unknown = -1;
+    best = -1.0;
+
+    for (k = 0; k < ctx->params->nlpe_candidates; k++)
+    {
+        c = pixels->unknown[maskopt_random(state, pixels->num_unknown)];
+        error = (u[c] - f[c]) * (u[c] - f[c]);
+
+        if (error > best)
+        {
+            best = error;
+            prop->unknown = c;
+        }
+    }
+
+    a = &prop->windows[0];
+    b = &prop->windows[1];
+    *a = maskopt_window(ctx->image, prop->known, ctx->params->radius);
+    *b = maskopt_window(ctx->image, prop->unknown, ctx->params->radius);
+    prop->num_windows = 2;
+
+    /* Nearby pixels share one window */
+    if (maskopt_conflict(a, b))
+    {
+        a->x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+        a->x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+        a->y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+        a->y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+        prop->num_windows = 1;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Improves an inpainting mask by nonlocal pixel exchange (Mainberger et al.
+ * 2011): a known pixel is swapped with a badly reconstructed unknown one,
+ * and the swap is kept if the error decreases. An exchange only changes
+ * the reconstruction near both pixels, so it is evaluated by solves on
+ * small windows around them, warm started from the current reconstruction.
+ * Batches of exchanges with disjoint windows are evaluated in parallel.
+ * After each cycle the whole image is inpainted again to remove the
+ * truncation error of the local solves.
+ * @image   [ I ] Double-valued image
+ * @mask    [I/O] Inpainting mask (0 / 255 or boolean), improved in place
+ * @params  [ I ] Parameters
+ * @info    [ O ] Progress, may be NULL
+ */
+int mask_pixel_exchange(const image_type image, image_type mask,
+        const maskopt_params_type params, maskopt_info_type *info)
+{
+    maskopt_info_type progress; /* Progress */
+    maskopt_context_type ctx; /* Shared state of a batch */
+    maskopt_pixels_type pixels; /* Known and unknown pixels */
+    maskopt_proposal_type *prop; /* Current proposal */
+    scheduler_type sched; /* Task scheduler */
+    image_type mask_d; /* Double-valued working copy of the mask */
+    unsigned int state; /* Random generator state */
+    int cycle; /* Loop variable */
+    int remaining; /* Proposals left in the current cycle */
+    int num, attempts; /* Proposals and attempts of a batch */
+    int k, l, w, v; /* Loop variables */
+    int conflict; /* Flag for overlapping windows */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (params.nlpe_batch < 1 || params.nlpe_candidates < 1
+            || params.radius < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    memset(&progress, 0, sizeof(progress));
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.params = &params;
+    ctx.image = image;
+    state = params.seed != 0 ? params.seed : 1;
+
+    ret = image_init(&mask_d, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = image_init(&ctx.u, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&mask_d);
+        return ret;
+    }
+
+    for (k = 0; k < image.width * image.height; k++)
+    {
+        ((double *) mask_d.data)[k] = mask_get(mask, k / image.width,
+                k % image.width) ? 255.0 : 0.0;
+    }
+
+    ctx.mask = mask_d;
+    image_copy(image, ctx.u);
+
+    ret = maskopt_pixels_init(&pixels, mask_d);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&ctx.u);
+        image_delete(&mask_d);
+        return ret;
+    }
+
+    ctx.proposals = (maskopt_proposal_type *) malloc(params.nlpe_batch
+            * sizeof(maskopt_proposal_type));
+    ret = ctx.proposals == NULL ? ASI_EXIT_FAILED_ALLOC
+        : scheduler_init(&sched, params.num_threads);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        free(ctx.proposals);
+        maskopt_pixels_delete(&pixels);
+        image_delete(&ctx.u);
+        image_delete(&mask_d);
+        return ret;
+    }
+
+    ret = maskopt_solve(image, mask_d, ctx.u, &params, &progress);
+
+    for (cycle = 0; cycle < params.nlpe_cycles && ret == ASI_EXIT_SUCCESS
+            && pixels.num_known > 0 && pixels.num_unknown > 0; cycle++)
+    {
+        remaining = pixels.num_known;
+
+        while (remaining > 0 && ret == ASI_EXIT_SUCCESS)
+        {
+            /* Draw proposals whose windows keep apart from each other */
+            num = 0;
+            for (attempts = 0; num < params.nlpe_batch && num < remaining
+                    && attempts < 4 * params.nlpe_batch; attempts++)
+            {
+                prop = &ctx.proposals[num];
+                maskopt_propose(&ctx, &pixels, &state, prop);
+
+                conflict = 0;
+                for (l = 0; l < num && !conflict; l++)
+                {
+                    for (w = 0; w < prop->num_windows; w++)
+                    {
+                        for (v = 0; v < ctx.proposals[l].num_windows; v++)
+                        {
+                            conflict |= maskopt_conflict(&prop->windows[w],
+                                    &ctx.proposals[l].windows[v]);
+                        }
+                    }
+                }
+
+                num += !conflict;
+            }
+
+            scheduler_parallel_for(&sched, num, maskopt_exchange_task, &ctx);
+
+            for (l = 0; l < num; l++)
+            {
+                prop = &ctx.proposals[l];
+
+                if (prop->status != ASI_EXIT_SUCCESS)
+                {
+                    ret = prop->status;
+                }
+                else if (prop->delta < 0.0)
+                {
+                    maskopt_pixels_move(&pixels, prop->known, 0);
+                    maskopt_pixels_move(&pixels, prop->unknown, 1);
+                    progress.accepted++;
+                }
+            }
+
+            progress.proposals += num;
+            remaining -= num;
+        }
+
+        /* Remove the truncation error of the window solves */
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = maskopt_solve(image, mask_d, ctx.u, &params, &progress);
+        }
+    }
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        progress.mse = maskopt_mse(image, ctx.u);
+
+        for (k = 0; k < image.width * image.height; k++)
+        {
+            if (mask.dtype == ASI_DTYPE_DOUBLE)
+            {
+                ((double *) mask.data)[k] = ((double *) mask_d.data)[k];
+            }
+            else
+            {
+                ((int *) mask.data)[k] = ((double *) mask_d.data)[k] > 0.0;
+            }
+        }
+    }
+
+    if (info != NULL)
+    {
+        *info = progress;
+    }
+
+    scheduler_delete(&sched);
+    free(ctx.proposals);
+    maskopt_pixels_delete(&pixels);
+    image_delete(&ctx.u);
+    image_delete(&mask_d);
+
+    return ret;
+}
@@ -0,0 +1,45 @@
+#ifndef _ASI_MASKOPT_H_
+#define _ASI_MASKOPT_H_
+
+#include "asi_image.h"
+#include "asi_multigrid.h"
+
+/* Parameters of the mask optimisation */
+typedef struct maskopt_params
+{
+    double density; /* Target fraction of known pixels */
+    double ps_fraction; /* Fraction of known pixels removed per iteration */
+    double ps_keep; /* Fraction of removed pixels with largest error kept */
+    int nlpe_cycles; /* Exchange cycles, one proposal per known pixel each */
+    int nlpe_candidates; /* Unknown pixels competing for an exchange */
+    int nlpe_batch; /* Proposals evaluated in parallel */
+    int radius; /* Half edge length of local evaluation windows */
+    int local_iter; /* Maximum number of iterations of a local solve */
+    double local_eps; /* Relative residual tolerance of local solves */
+    int num_threads; /* Number of threads, <= 0 uses all online cores */
+    unsigned int seed; /* Seed of the random selections */
+    multigrid_params_type solver; /* Solver of the whole image */
+} maskopt_params_type;
+
+/* Progress of a mask optimisation */
+typedef struct maskopt_info
+{
+    int iterations; /* Sparsification iterations */
+    long proposals; /* Evaluated pixel exchanges */
+    long accepted; /* Accepted pixel exchanges */
+    int global_solves; /* Inpaintings of the whole image */
+    double mse; /* Mean squared error of the final reconstruction */
+} maskopt_info_type;
+
+/* Default parameters */
+void maskopt_params_default(maskopt_params_type *params);
+
+/* Mask selection by probabilistic sparsification */
+int mask_sparsification(const image_type image, image_type *mask,
+        const maskopt_params_type params, maskopt_info_type *info);
+
+/* Mask improvement by nonlocal pixel exchange */
+int mask_pixel_exchange(const image_type image, image_type mask,
+        const maskopt_params_type params, maskopt_info_type *info);
+
+#endif
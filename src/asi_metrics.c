@@ -0,0 +1,1008 @@
+#include "asi_metrics.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#ifdef ASI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Number of rows per task; fixed so results do not depend on the threads */
+#define METRICS_BAND_ROWS 32
+
+/* Number of columns per block of the SSIM filters, sized for the L2 cache */
+#define METRICS_BLOCK_COLS 256
+
+/* Radius and number of taps of the Gaussian SSIM window */
+#define METRICS_RADIUS 5
+#define METRICS_TAPS (2 * METRICS_RADIUS + 1)
+
+/* Standard deviation of the Gaussian SSIM window */
+#define METRICS_SIGMA 1.5
+
+/* Local statistics filtered for SSIM: a, b, a^2, b^2 and a b */
+#define METRICS_MAPS 5
+
+/* Shared state of a metric evaluation, handed to the band tasks */
+typedef struct metrics_context
+{
+    image_type a, b; /* Compared images */
+    int channels; /* Number of channels, 1 or 3 */
+    int length; /* Number of values per row */
+    double c1, c2; /* Stabilising constants of SSIM */
+    double weights[METRICS_TAPS]; /* Gaussian window */
+    double *partial; /* Two partial results per band */
+    atomic_int status; /* First error code raised by a task */
+} metrics_context_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Records an error raised by a band task. Bands run concurrently, the first
+ * error is kept and later ones are dropped.
+ * @ctx     [I/O] Metrics context
+ * @ret     [ I ] Error code
+ */
+static void metrics_fail(metrics_context_type *ctx, int ret)
+{
+    int expected = ASI_EXIT_SUCCESS; /* Status before the first error */
+
+    atomic_compare_exchange_strong(&ctx->status, &expected, ret);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Number of interleaved channels of an image data type.
+ * @dtype   [ I ] Data type
+ */
+static int metrics_channels(dtype_enum dtype)
+{
+    return dtype == ASI_DTYPE_INT_RGB || dtype == ASI_DTYPE_DOUBLE_RGB
+        ? 3 : 1;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Returns the values of an image row as doubles: a pointer into the image for
+ * double-valued images, the converted row in a buffer otherwise.
+ * @image   [ I ] Image
+ * @length  [ I ] Number of values per row
+ * @i       [ I ] Row index
+ * @buffer  [ O ] Row buffer of integer-valued images
+ */
+static const double *metrics_row(const image_type image, int length, int i,
+        double *buffer)
+{
+    const int *src; /* Integer row */
+    int k; /* Loop variable */
+
+    if (image.dtype == ASI_DTYPE_DOUBLE || image.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        return (const double *) image.data + (size_t) i * length;
+    }
+
+    src = (const int *) image.data + (size_t) i * length;
+
+    for (k = 0; k < length; k++)
+    {
+        buffer[k] = src[k];
+    }
+
+    return buffer;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Accumulates the squared differences and the largest absolute difference of
+ * two arrays.
+ * @a, b    [ I ] Arrays
+ * @n       [ I ] Number of entries
+ * @sum     [I/O] Sum of squared differences
+ * @max     [I/O] Largest absolute difference
+ */
+static void metrics_diff_scalar(const double *a, const double *b, int n,
+        double *sum, double *max)
+{
+    double d, s = 0.0; /* Difference, partial sum */
+    int k; /* Loop variable */
+
+    for (k = 0; k < n; k++)
+    {
+        d = a[k] - b[k];
+        s += d * d;
+        *max = fabs(d) > *max ? fabs(d) : *max;
+    }
+
+    *sum += s;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Correlation of a padded row with the Gaussian window:
+ * out[x] = sum_k w[k] in[x + k].
+ * @in      [ I ] Row padded by METRICS_RADIUS values on both sides
+ * @w       [ I ] Window weights
+ * @out     [ O ] Filtered row
+ * @n       [ I ] Number of output values
+ */
+static void metrics_fir_scalar(const double *in, const double *w, double *out,
+        int n)
+{
+    double s; /* Weighted sum */
+    int x, k; /* Loop variables */
+
+    for (x = 0; x < n; x++)
+    {
+        s = 0.0;
+
+        for (k = 0; k < METRICS_TAPS; k++)
+        {
+            s += w[k] * in[x + k];
+        }
+
+        out[x] = s;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sums the SSIM index of columns x0, ..., n-1 of one output row, filtering
+ * the horizontally filtered statistics vertically on the fly.
+ * @rows    [ I ] Rows of the statistics, METRICS_TAPS per map
+ * @w       [ I ] Window weights
+ * @x0      [ I ] First column
+ * @n       [ I ] Number of columns
+ * @c1, c2  [ I ] Stabilising constants
+ */
+static double metrics_ssim_scalar(const double *const *rows, const double *w,
+        int x0, int n, double c1, double c2)
+{
+    double s[METRICS_MAPS]; /* Local statistics */
+    double cov, var; /* Covariance and sum of variances */
+    double sum = 0.0; /* Sum of the SSIM index */
+    int x, k, m; /* Loop variables */
+
+    for (x = x0; x < n; x++)
+    {
+        for (m = 0; m < METRICS_MAPS; m++)
+        {
+            s[m] = 0.0;
+
+            for (k = 0; k < METRICS_TAPS; k++)
+            {
+                s[m] += w[k] * rows[m * METRICS_TAPS + k][x];
+            }
+        }
+
+        cov = s[4] - s[0] * s[1];
+        var = s[2] - s[0] * s[0] + s[3] - s[1] * s[1];
+
+        sum += (2.0 * s[0] * s[1] + c1) * (2.0 * cov + c2)
+            / ((s[0] * s[0] + s[1] * s[1] + c1) * (var + c2));
+    }
+
+    return sum;
+}
+
+#ifdef ASI_SIMD_X86
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of metrics_diff_scalar.
+ * @a, b    [ I ] Arrays
+ * @n       [ I ] Number of entries
+ * @sum     [I/O] Sum of squared differences
+ * @max     [I/O] Largest absolute difference
+ */
+ASI_TARGET_AVX2
+static void metrics_diff_avx2(const double *a, const double *b, int n,
+        double *sum, double *max)
+{
+    __m256d s0, s1, m, d0, d1; /* Partial sums, maximum, differences */
+    __m256d sign; /* Sign bit of every lane */
+    double acc[4], mx[4]; /* Lanes of the partial results */
+    int k, l; /* Loop variables */
+
+    s0 = s1 = m = _mm256_setzero_pd();
+    sign = _mm256_set1_pd(-0.0);
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        d0 = _mm256_sub_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k));
+        d1 = _mm256_sub_pd(_mm256_loadu_pd(a + k + 4),
+                _mm256_loadu_pd(b + k + 4));
+        s0 = _mm256_fmadd_pd(d0, d0, s0);
+        s1 = _mm256_fmadd_pd(d1, d1, s1);
+        m = _mm256_max_pd(m, _mm256_andnot_pd(sign, d0));
+        m = _mm256_max_pd(m, _mm256_andnot_pd(sign, d1));
+    }
+
+    _mm256_storeu_pd(acc, _mm256_add_pd(s0, s1));
+    _mm256_storeu_pd(mx, m);
+
+    *sum += (acc[0] + acc[1]) + (acc[2] + acc[3]);
+
+    for (l = 0; l < 4; l++)
+    {
+        *max = mx[l] > *max ? mx[l] : *max;
+    }
+
+    metrics_diff_scalar(a + k, b + k, n - k, sum, max);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel of metrics_diff_scalar.
+ * @a, b    [ I ] Arrays
+ * @n       [ I ] Number of entries
+ * @sum     [I/O] Sum of squared differences
+ * @max     [I/O] Largest absolute difference
+ */
+ASI_TARGET_AVX512
+static void metrics_diff_avx512(const double *a, const double *b, int n,
+        double *sum, double *max)
+{
+    __m512d s, m, d; /* Partial sums, maximum, differences */
+    double mx; /* Largest lane of the maximum */
+    int k; /* Loop variable */
+
+    s = m = _mm512_setzero_pd();
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        d = _mm512_sub_pd(_mm512_loadu_pd(a + k), _mm512_loadu_pd(b + k));
+        s = _mm512_fmadd_pd(d, d, s);
+        m = _mm512_max_pd(m, _mm512_abs_pd(d));
+    }
+
+    *sum += _mm512_reduce_add_pd(s);
+    mx = _mm512_reduce_max_pd(m);
+    *max = mx > *max ? mx : *max;
+
+    metrics_diff_scalar(a + k, b + k, n - k, sum, max);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of metrics_fir_scalar.
+ * @in      [ I ] Row padded by METRICS_RADIUS values on both sides
+ * @w       [ I ] Window weights
+ * @out     [ O ] Filtered row
+ * @n       [ I ] Number of output values
+ */
+ASI_TARGET_AVX2
+static void metrics_fir_avx2(const double *in, const double *w, double *out,
+        int n)
+{
+    __m256d s; /* Weighted sums */
+    int x, k; /* Loop variables */
+
+    for (x = 0; x + 4 <= n; x += 4)
+    {
+        s = _mm256_setzero_pd();
+
+        for (k = 0; k < METRICS_TAPS; k++)
+        {
+            s = _mm256_fmadd_pd(_mm256_set1_pd(w[k]),
+                    _mm256_loadu_pd(in + x + k), s);
+        }
+
+        _mm256_storeu_pd(out + x, s);
+    }
+
+    metrics_fir_scalar(in + x, w, out + x, n - x);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel of metrics_fir_scalar.
+ * @in      [ I ] Row padded by METRICS_RADIUS values on both sides
+ * @w       [ I ] Window weights
+ * @out     [ O ] Filtered row
+ * @n       [ I ] Number of output values
+ */
+ASI_TARGET_AVX512
+static void metrics_fir_avx512(const double *in, const double *w, double *out,
+        int n)
+{
+    __m512d s; /* Weighted sums */
+    int x, k; /* Loop variables */
+
+    for (x = 0; x + 8 <= n; x += 8)
+    {
+        s = _mm512_setzero_pd();
+
+        for (k = 0; k < METRICS_TAPS; k++)
+        {
+            s = _mm512_fmadd_pd(_mm512_set1_pd(w[k]),
+                    _mm512_loadu_pd(in + x + k), s);
+        }
+
+        _mm512_storeu_pd(out + x, s);
+    }
+
+    metrics_fir_scalar(in + x, w, out + x, n - x);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel of metrics_ssim_scalar.
+ * @rows    [ I ] Rows of the statistics, METRICS_TAPS per map
+ * @w       [ I ] Window weights
+ * @x0      [ I ] First column
+ * @n       [ I ] Number of columns
+ * @c1, c2  [ I ] Stabilising constants
+ */
+ASI_TARGET_AVX2
+static double metrics_ssim_avx2(const double *const *rows, const double *w,
+        int x0, int n, double c1, double c2)
+{
+    __m256d s[METRICS_MAPS]; /* Local statistics */
+    __m256d wk, two, vc1, vc2, num, den, sum; /* Temporaries */
+    double acc[4]; /* Lanes of the sum */
+    int x, k, m; /* Loop variables */
+
+    two = _mm256_set1_pd(2.0);
+    vc1 = _mm256_set1_pd(c1);
+    vc2 = _mm256_set1_pd(c2);
+    sum = _mm256_setzero_pd();
+
+    for (x = x0; x + 4 <= n; x += 4)
+    {
+        for (m = 0; m < METRICS_MAPS; m++)
+        {
+            s[m] = _mm256_setzero_pd();
+        }
+
+        for (k = 0; k < METRICS_TAPS; k++)
+        {
+            wk = _mm256_set1_pd(w[k]);
+
+            for (m = 0; m < METRICS_MAPS; m++)
+            {
+                s[m] = _mm256_fmadd_pd(wk,
+                        _mm256_loadu_pd(rows[m * METRICS_TAPS + k] + x), s[m]);
+            }
+        }
+
+        /* (2 mu_a mu_b + c1) (2 cov + c2) */
+        num = _mm256_mul_pd(
+                _mm256_fmadd_pd(two, _mm256_mul_pd(s[0], s[1]), vc1),
+                _mm256_fmadd_pd(two, _mm256_fnmadd_pd(s[0], s[1], s[4]),
+                    vc2));
+
+        /* (mu_a^2 + mu_b^2 + c1) (var_a + var_b + c2) */
+        den = _mm256_fmadd_pd(s[0], s[0], _mm256_fmadd_pd(s[1], s[1], vc1));
+        den = _mm256_mul_pd(den, _mm256_add_pd(_mm256_sub_pd(
+                        _mm256_add_pd(s[2], s[3]), den), _mm256_add_pd(vc1,
+                        vc2)));
+
+        sum = _mm256_add_pd(sum, _mm256_div_pd(num, den));
+    }
+
+    _mm256_storeu_pd(acc, sum);
+
+    return (acc[0] + acc[1]) + (acc[2] + acc[3])
+        + metrics_ssim_scalar(rows, w, x, n, c1, c2);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel of metrics_ssim_scalar.
+ * @rows    [ I ] Rows of the statistics, METRICS_TAPS per map
+ * @w       [ I ] Window weights
+ * @x0      [ I ] First column
+ * @n       [ I ] Number of columns
+ * @c1, c2  [ I ] Stabilising constants
+ */
+ASI_TARGET_AVX512
+static double metrics_ssim_avx512(const double *const *rows, const double *w,
+        int x0, int n, double c1, double c2)
+{
+    __m512d s[METRICS_MAPS]; /* Local statistics */
+    __m512d wk, two, vc1, vc2, num, den, sum; /* Temporaries */
+    int x, k, m; /* Loop variables */
+
+    two = _mm512_set1_pd(2.0);
+    vc1 = _mm512_set1_pd(c1);
+    vc2 = _mm512_set1_pd(c2);
+    sum = _mm512_setzero_pd();
+
+    for (x = x0; x + 8 <= n; x += 8)
+    {
+        for (m = 0; m < METRICS_MAPS; m++)
+        {
+            s[m] = _mm512_setzero_pd();
+        }
+
+        for (k = 0; k < METRICS_TAPS; k++)
+        {
+            wk = _mm512_set1_pd(w[k]);
+
+            for (m = 0; m < METRICS_MAPS; m++)
+            {
+                s[m] = _mm512_fmadd_pd(wk,
+                        _mm512_loadu_pd(rows[m * METRICS_TAPS + k] + x), s[m]);
+            }
+        }
+
+        num = _mm512_mul_pd(
+                _mm512_fmadd_pd(two, _mm512_mul_pd(s[0], s[1]), vc1),
+                _mm512_fmadd_pd(two, _mm512_fnmadd_pd(s[0], s[1], s[4]),
+                    vc2));
+
+        den = _mm512_fmadd_pd(s[0], s[0], _mm512_fmadd_pd(s[1], s[1], vc1));
+        den = _mm512_mul_pd(den, _mm512_add_pd(_mm512_sub_pd(
+                        _mm512_add_pd(s[2], s[3]), den), _mm512_add_pd(vc1,
+                        vc2)));
+
+        sum = _mm512_add_pd(sum, _mm512_div_pd(num, den));
+    }
+
+    return _mm512_reduce_add_pd(sum) + metrics_ssim_scalar(rows, w, x, n, c1,
+            c2);
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task computing the squared differences and the largest absolute difference
+ * of a band of rows.
+ * @arg     [I/O] Metrics context
+ * @index   [ I ] Band index
+ */
+static void metrics_diff_band(void *arg, int index)
+{
+    metrics_context_type *ctx = (metrics_context_type *) arg;
+    void (*kernel)(const double *, const double *, int, double *, double *);
+    const double *ra, *rb; /* Rows of both images */
+    double *buffer; /* Converted rows */
+    double sum = 0.0, max = 0.0; /* Partial results */
+    int i, i1; /* Loop variable, end of the band */
+
+    kernel = metrics_diff_scalar;
+
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        kernel = metrics_diff_avx512;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        kernel = metrics_diff_avx2;
+    }
+#endif
+
+    buffer = (double *) malloc(2 * (size_t) ctx->length * sizeof(double));
+
+    if (buffer == NULL)
+    {
+        metrics_fail(ctx, ASI_EXIT_FAILED_ALLOC);
+        return;
+    }
+
+    i1 = (index + 1) * METRICS_BAND_ROWS < ctx->a.height
+        ? (index + 1) * METRICS_BAND_ROWS : ctx->a.height;
+
+    for (i = index * METRICS_BAND_ROWS; i < i1; i++)
+    {
+        ra = metrics_row(ctx->a, ctx->length, i, buffer);
+        rb = metrics_row(ctx->b, ctx->length, i, buffer + ctx->length);
+        kernel(ra, rb, ctx->length, &sum, &max);
+    }
+
+    ctx->partial[2 * index] = sum;
+    ctx->partial[2 * index + 1] = max;
+
+    free(buffer);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Loads a segment of one channel of an image row with mirrored columns.
+ * @image       [ I ] Image
+ * @channels    [ I ] Number of channels
+ * @c           [ I ] Channel
+ * @i           [ I ] Row index
+ * @j0          [ I ] First column, may lie outside the image
+ * @n           [ I ] Number of values
+ * @out         [ O ] Values
+ */
+static void metrics_load(const image_type image, int channels, int c, int i,
+        int j0, int n, double *out)
+{
+    const double *fsrc; /* Row of a double-valued image */
+    const int *src; /* Row of an integer-valued image */
+    int j; /* Loop variable */
+
+    if (image.dtype == ASI_DTYPE_DOUBLE || image.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        fsrc = (const double *) image.data + (size_t) i * image.width
+            * channels + c;
+
+        for (j = 0; j < n; j++)
+        {
+            out[j] = fsrc[image_mirror_index(j0 + j, image.width) * channels];
+        }
+    }
+    else
+    {
+        src = (const int *) image.data + (size_t) i * image.width
+            * channels + c;
+
+        for (j = 0; j < n; j++)
+        {
+            out[j] = src[image_mirror_index(j0 + j, image.width) * channels];
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Task summing the SSIM index over a band of rows and all channels. The
+ * band is processed in blocks of METRICS_BLOCK_COLS columns. Rows of a
+ * block and a halo of METRICS_RADIUS rows are filtered horizontally into a
+ * ring buffer of METRICS_TAPS rows per statistic, from which every output
+ * row is filtered vertically. The ring of a block stays in cache, and no
+ * full-size intermediate maps are needed. Boundaries are mirrored.
+ * @arg     [I/O] Metrics context
+ * @index   [ I ] Band index
+ */
+static void metrics_ssim_band(void *arg, int index)
+{
+    metrics_context_type *ctx = (metrics_context_type *) arg;
+    void (*fir)(const double *, const double *, double *, int);
+    double (*ssim)(const double *const *, const double *, int, int, double,
+            double);
+    const double *rows[METRICS_MAPS * METRICS_TAPS]; /* Window of rows */
+    double *work; /* Work memory */
+    double *pad[METRICS_MAPS]; /* Padded rows of the statistics */
+    double *ring; /* Horizontally filtered rows */
+    double sum = 0.0; /* Sum of the SSIM index */
+    int padded; /* Length of padded rows */
+    int i0, i1, r, o; /* Band and row indices */
+    int x0, n; /* First column and width of a block */
+    int c, j, k, m; /* Loop variables */
+
+    fir = metrics_fir_scalar;
+    ssim = metrics_ssim_scalar;
+
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        fir = metrics_fir_avx512;
+        ssim = metrics_ssim_avx512;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        fir = metrics_fir_avx2;
+        ssim = metrics_ssim_avx2;
+    }
+#endif
+
+    padded = METRICS_BLOCK_COLS + 2 * METRICS_RADIUS;
+
+    work = (double *) malloc(((size_t) METRICS_MAPS * padded
+                + (size_t) METRICS_MAPS * METRICS_TAPS * METRICS_BLOCK_COLS)
+            * sizeof(double));
+
+    if (work == NULL)
+    {
+        metrics_fail(ctx, ASI_EXIT_FAILED_ALLOC);
+        return;
+    }
+
+    for (m = 0; m < METRICS_MAPS; m++)
+    {
+        pad[m] = work + (size_t) m * padded;
+    }
+
+    ring = work + (size_t) METRICS_MAPS * padded;
+
+    i0 = index * METRICS_BAND_ROWS;
+    i1 = i0 + METRICS_BAND_ROWS < ctx->a.height
+        ? i0 + METRICS_BAND_ROWS : ctx->a.height;
+
+    for (c = 0; c < ctx->channels; c++)
+    {
+        for (x0 = 0; x0 < ctx->a.width; x0 += METRICS_BLOCK_COLS)
+        {
+            n = x0 + METRICS_BLOCK_COLS < ctx->a.width
+                ? METRICS_BLOCK_COLS : ctx->a.width - x0;
+
+            for (r = i0 - METRICS_RADIUS; r < i1 + METRICS_RADIUS; r++)
+            {
+                k = image_mirror_index(r, ctx->a.height);
+                metrics_load(ctx->a, ctx->channels, c, k,
+                        x0 - METRICS_RADIUS, n + 2 * METRICS_RADIUS, pad[0]);
+                metrics_load(ctx->b, ctx->channels, c, k,
+                        x0 - METRICS_RADIUS, n + 2 * METRICS_RADIUS, pad[1]);
+
+                for (j = 0; j < n + 2 * METRICS_RADIUS; j++)
+                {
+                    pad[2][j] = pad[0][j] * pad[0][j];
+                    pad[3][j] = pad[1][j] * pad[1][j];
+                    pad[4][j] = pad[0][j] * pad[1][j];
+                }
+
+                /* Slot of row r in the ring */
+                k = (r - i0 + METRICS_RADIUS) % METRICS_TAPS;
+
+                for (m = 0; m < METRICS_MAPS; m++)
+                {
+                    fir(pad[m], ctx->weights, ring + ((size_t) m
+                                * METRICS_TAPS + k) * METRICS_BLOCK_COLS, n);
+                }
+
+                /* Output row whose window is complete */
+                o = r - METRICS_RADIUS;
+
+                if (o < i0)
+                {
+                    continue;
+                }
+
+                for (m = 0; m < METRICS_MAPS; m++)
+                {
+                    for (k = 0; k < METRICS_TAPS; k++)
+                    {
+                        rows[m * METRICS_TAPS + k] = ring + ((size_t) m
+                                * METRICS_TAPS + (o - i0 + k) % METRICS_TAPS)
+                            * METRICS_BLOCK_COLS;
+                    }
+                }
+
+                sum += ssim(rows, ctx->weights, 0, n, ctx->c1, ctx->c2);
+            }
+        }
+    }
+
+    ctx->partial[2 * index] = sum;
+    ctx->partial[2 * index + 1] = 0.0;
+
+    free(work);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks two images for comparability and runs a band task over them.
+ * Partial results per band are combined by the caller in a fixed order.
+ * @ctx     [ O ] Metrics context, partial results on success
+ * @a, b    [ I ] Compared images
+ * @fn      [ I ] Band task
+ * @sched   [I/O] Scheduler, NULL for serial execution
+ */
+static int metrics_run(metrics_context_type *ctx, const image_type a,
+        const image_type b, scheduler_task_fn fn, scheduler_type *sched)
+{
+    int num_bands; /* Number of row bands */
+    int b_index; /* Loop variable */
+
+    if (a.width != b.width || a.height != b.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (metrics_channels(a.dtype) != metrics_channels(b.dtype))
+    {
+        return ASI_EXIT_IMG_DTYPE_MISMATCH;
+    }
+
+    if (a.width < 1 || a.height < 1)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    ctx->a = a;
+    ctx->b = b;
+    ctx->channels = metrics_channels(a.dtype);
+    ctx->length = a.width * ctx->channels;
+    atomic_init(&ctx->status, ASI_EXIT_SUCCESS);
+
+    num_bands = (a.height + METRICS_BAND_ROWS - 1) / METRICS_BAND_ROWS;
+    ctx->partial = (double *) malloc(2 * (size_t) num_bands
+            * sizeof(double));
+
+    if (ctx->partial == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (sched != NULL)
+    {
+        scheduler_parallel_for(sched, num_bands, fn, ctx);
+    }
+    else
+    {
+        for (b_index = 0; b_index < num_bands; b_index++)
+        {
+            fn(ctx, b_index);
+        }
+    }
+
+    if (atomic_load(&ctx->status) != ASI_EXIT_SUCCESS)
+    {
+        free(ctx->partial);
+        return atomic_load(&ctx->status);
+    }
+
+    /* Combine the bands in order */
+    for (b_index = 1; b_index < num_bands; b_index++)
+    {
+        ctx->partial[0] += ctx->partial[2 * b_index];
+        ctx->partial[1] = ctx->partial[2 * b_index + 1] > ctx->partial[1]
+            ? ctx->partial[2 * b_index + 1] : ctx->partial[1];
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Squared differences and largest absolute difference of two images.
+ * @a, b    [ I ] Compared images
+ * @mse     [ O ] Mean squared error
+ * @max_abs [ O ] Largest absolute difference, may be NULL
+ * @sched   [I/O] Scheduler, NULL for serial execution
+ */
+static int metrics_diff(const image_type a, const image_type b, double *mse,
+        double *max_abs, scheduler_type *sched)
+{
+    metrics_context_type ctx; /* Shared state of the band tasks */
+    int ret; /* Return value */
+
+    ret = metrics_run(&ctx, a, b, metrics_diff_band, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    *mse = ctx.partial[0] / ((double) ctx.length * a.height);
+
+    /* Maxima drop NaN differences, which the sum keeps */
+    if (max_abs != NULL)
+    {
+        *max_abs = isnan(*mse) ? NAN : ctx.partial[1];
+    }
+
+    free(ctx.partial);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Peak signal-to-noise ratio of a mean squared error: infinite for zero,
+ * NaN for NaN.
+ * @mse     [ I ] Mean squared error
+ * @peak    [ I ] Largest grey value
+ */
+static double metrics_psnr(double mse, double peak)
+{
+    if (isnan(mse))
+    {
+        return NAN;
+    }
+
+    return mse > 0.0 ? 10.0 * log10(peak * peak / mse) : INFINITY;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Mean squared error of two images over all pixels and channels. Integer
+ * and double-valued images of the same number of channels can be mixed.
+ * Row bands are processed in parallel with SIMD kernels, and the result
+ * does not depend on the number of threads.
+ * @a, b    [ I ] Compared images
+ * @mse     [ O ] Mean squared error
+ * @sched   [I/O] Scheduler, NULL for serial execution
+ */
+int image_mse(const image_type a, const image_type b, double *mse,
+        scheduler_type *sched)
+{
+    return metrics_diff(a, b, mse, NULL, sched);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Peak signal-to-noise ratio of two images, infinite for equal images and
+ * NaN if an image contains NaN.
+ * @a, b    [ I ] Compared images
+ * @peak    [ I ] Largest grey value, e.g. 255
+ * @psnr    [ O ] Peak signal-to-noise ratio in dB
+ * @sched   [I/O] Scheduler, NULL for serial execution
+ */
+int image_psnr(const image_type a, const image_type b, double peak,
+        double *psnr, scheduler_type *sched)
+{
+    double mse; /* Mean squared error */
+    int ret; /* Return value */
+
+    if (peak <= 0.0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    ret = metrics_diff(a, b, &mse, NULL, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    *psnr = metrics_psnr(mse, peak);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Mean structural similarity (SSIM) of two images after Wang et al. with a
+ * Gaussian window of standard deviation 1.5 truncated to 11x11 pixels,
+ * mirrored boundaries, and the constants (0.01 peak)^2 and (0.03 peak)^2.
+ * Colour images are compared per channel and averaged.
+ * @a, b    [ I ] Compared images
+ * @peak    [ I ] Largest grey value, e.g. 255
+ * @ssim    [ O ] Mean SSIM index, 1 for equal images
+ * @sched   [I/O] Scheduler, NULL for serial execution
+ */
+int image_ssim(const image_type a, const image_type b, double peak,
+        double *ssim, scheduler_type *sched)
+{
+    metrics_context_type ctx; /* Shared state of the band tasks */
+    double norm = 0.0; /* Sum of the window weights */
+    int k; /* Loop variable */
+    int ret; /* Return value */
+
+    if (peak <= 0.0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    for (k = 0; k < METRICS_TAPS; k++)
+    {
+        ctx.weights[k] = exp(-(k - METRICS_RADIUS) * (k - METRICS_RADIUS)
+                / (2.0 * METRICS_SIGMA * METRICS_SIGMA));
+        norm += ctx.weights[k];
+    }
+
+    for (k = 0; k < METRICS_TAPS; k++)
+    {
+        ctx.weights[k] /= norm;
+    }
+
+    ctx.c1 = 0.01 * peak * 0.01 * peak;
+    ctx.c2 = 0.03 * peak * 0.03 * peak;
+
+    ret = metrics_run(&ctx, a, b, metrics_ssim_band, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    *ssim = ctx.partial[0] / ((double) ctx.length * a.height);
+    free(ctx.partial);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets tolerances for comparing two solutions of the same inpainting
+ * problem on 8-bit data: at most one grey value apart, 50 dB and an SSIM of
+ * 0.999, the MSE bound being implied.
+ * @tol     [ O ] Tolerances
+ */
+void metrics_tolerance_default(metrics_tolerance_type *tol)
+{
+    tol->max_mse = -1.0;
+    tol->min_psnr = 50.0;
+    tol->min_ssim = 0.999;
+    tol->max_abs = 1.0;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Compares a result, e.g. of a new solver, with a reference and checks all
+ * enabled tolerances. Returns ASI_EXIT_OUT_OF_TOLERANCE if a tolerance is
+ * violated or a metric is not finite; the report is filled in either case.
+ * @reference   [ I ] Reference image
+ * @result      [ I ] Compared image
+ * @peak        [ I ] Largest grey value, e.g. 255
+ * @tol         [ I ] Tolerances
+ * @report      [ O ] Metrics, may be NULL
+ * @sched       [I/O] Scheduler, NULL for serial execution
+ */
+int image_compare(const image_type reference, const image_type result,
+        double peak, const metrics_tolerance_type tol,
+        metrics_report_type *report, scheduler_type *sched)
+{
+    metrics_report_type r; /* Metrics */
+    int ret; /* Return value */
+
+    if (peak <= 0.0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    ret = metrics_diff(reference, result, &r.mse, &r.max_abs, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    r.psnr = metrics_psnr(r.mse, peak);
+
+    ret = image_ssim(reference, result, peak, &r.ssim, sched);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    if (report != NULL)
+    {
+        *report = r;
+    }
+
+    /* Non-finite metrics, e.g. of a diverged solver, are never tolerated */
+    if (!isfinite(r.mse) || !isfinite(r.ssim) || !isfinite(r.max_abs)
+            || (tol.max_mse >= 0.0 && r.mse > tol.max_mse)
+            || (tol.min_psnr >= 0.0 && r.psnr < tol.min_psnr)
+            || (tol.min_ssim >= 0.0 && r.ssim < tol.min_ssim)
+            || (tol.max_abs >= 0.0 && r.max_abs > tol.max_abs))
+    {
+        return ASI_EXIT_OUT_OF_TOLERANCE;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
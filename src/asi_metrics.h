@@ -0,0 +1,45 @@
+#ifndef _ASI_METRICS_H_
+#define _ASI_METRICS_H_
+
+#include "asi_image.h"
+#include "asi_scheduler.h"
+
+/* Tolerances of a comparison with a reference, negative values disable */
+typedef struct metrics_tolerance
+{
+    double max_mse; /* Largest mean squared error */
+    double min_psnr; /* Smallest peak signal-to-noise ratio in dB */
+    double min_ssim; /* Smallest mean structural similarity */
+    double max_abs; /* Largest absolute difference of a pixel */
+} metrics_tolerance_type;
+
+/* Outcome of a comparison with a reference */
+typedef struct metrics_report
+{
+    double mse; /* Mean squared error */
+    double psnr; /* Peak signal-to-noise ratio in dB, infinite if equal */
+    double ssim; /* Mean structural similarity */
+    double max_abs; /* Largest absolute difference of a pixel */
+} metrics_report_type;
+
+/* Mean squared error over all pixels and channels */
+int image_mse(const image_type a, const image_type b, double *mse,
+        scheduler_type *sched);
+
+/* Peak signal-to-noise ratio in dB for grey values in [0, peak] */
+int image_psnr(const image_type a, const image_type b, double peak,
+        double *psnr, scheduler_type *sched);
+
+/* Mean structural similarity with an 11x11 Gaussian window */
+int image_ssim(const image_type a, const image_type b, double peak,
+        double *ssim, scheduler_type *sched);
+
+/* Default tolerances for comparing two solutions of the same problem */
+void metrics_tolerance_default(metrics_tolerance_type *tol);
+
+/* Compare a result with a reference and check the tolerances */
+int image_compare(const image_type reference, const image_type result,
+        double peak, const metrics_tolerance_type tol,
+        metrics_report_type *report, scheduler_type *sched);
+
+#endif
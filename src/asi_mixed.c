@@ -0,0 +1,590 @@
+#include "asi_mixed.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+#include <math.h>
+
+#ifdef ASI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Default relative tolerance of the inner single precision solves */
+#define MIXED_INNER_EPS 1e-3
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Applies the stencil at a single pixel in single precision, checking all
+ * couplings. Used on the image boundary where neighbours may not exist.
+ * @flag    [ I ] Stencil flags of the pixel
+ * @x       [ I ] Vector x
+ * @k       [ I ] Pixel index
+ * @w       [ I ] Image width
+ */
+static float mixed_stencil_checked(unsigned char flag, const float *x, int k,
+        int w)
+{
+    float value; /* Stencil result */
+
+    if (flag & ASI_STENCIL_KNOWN)
+    {
+        return x[k];
+    }
+
+    value = (float) (flag >> ASI_STENCIL_DEG_SHIFT) * x[k];
+
+    if (flag & ASI_STENCIL_N)
+    {
+        value -= x[k - w];
+    }
+    if (flag & ASI_STENCIL_S)
+    {
+        value -= x[k + w];
+    }
+    if (flag & ASI_STENCIL_W)
+    {
+        value -= x[k - 1];
+    }
+    if (flag & ASI_STENCIL_E)
+    {
+        value -= x[k + 1];
+    }
+
+    return value;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Scalar stencil on the interior pixels j = j_start, ..., w - 2 of row i.
+ * @op      [ I ] Inpainting operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ * @i       [ I ] Row, neither the first nor the last one
+ * @j_start [ I ] First column
+ */
+static void mixed_interior_scalar(const diffusion_operator_type op,
+        const float *x, float *b, int i, int j_start)
+{
+    int j, k; /* Loop variables */
+    int w = op.width;
+    unsigned int f; /* Stencil flags of a pixel */
+    float value; /* Stencil result */
+
+    for (j = j_start; j < w - 1; j++)
+    {
+        k = i * w + j;
+        f = op.flags[k];
+
+        value = (float) (f >> ASI_STENCIL_DEG_SHIFT) * x[k]
+            - (float) ((f >> 1) & 1) * x[k - w]
+            - (float) ((f >> 2) & 1) * x[k + w]
+            - (float) ((f >> 3) & 1) * x[k - 1]
+            - (float) ((f >> 4) & 1) * x[k + 1];
+
+        b[k] = (f & ASI_STENCIL_KNOWN) ? x[k] : value;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Scalar scalar product of single precision vectors, accumulated in double
+ * precision.
+ * @a, b    [ I ] Vectors
+ * @n       [ I ] Vector length
+ */
+static double mixed_dot_scalar(const float *a, const float *b, int n)
+{
+    int k; /* Loop variable */
+    double sum; /* Scalar product */
+
+    sum = 0.0;
+    for (k = 0; k < n; k++)
+    {
+        sum += (double) a[k] * b[k];
+    }
+
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Scalar CG update x += alpha p, r -= alpha q. Returns the squared norm of
+ * the updated residual, accumulated in double precision.
+ * @x, r    [I/O] Solution and residual
+ * @p, q    [ I ] Search direction and A times p
+ * @alpha   [ I ] Step size
+ * @n       [ I ] Vector length
+ */
+static double mixed_update_scalar(float *x, float *r, const float *p,
+        const float *q, float alpha, int n)
+{
+    int k; /* Loop variable */
+    double sum; /* Squared residual norm */
+
+    sum = 0.0;
+    for (k = 0; k < n; k++)
+    {
+        x[k] += alpha * p[k];
+        r[k] -= alpha * q[k];
+        sum += (double) r[k] * r[k];
+    }
+
+    return sum;
+}
+
+#ifdef ASI_SIMD_X86
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 stencil on the interior pixels of row i, eight pixels at once.
+ * Couplings are turned into lane masks from the stencil flags.
+ * @op      [ I ] Inpainting operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ * @i       [ I ] Row, neither the first nor the last one
+ */
+ASI_TARGET_AVX2
+static void mixed_interior_avx2(const diffusion_operator_type op,
+        const float *x, float *b, int i)
+{
+    int j, k; /* Loop variables */
+    int w = op.width;
+    __m256i f; /* Stencil flags of eight pixels */
+    __m256i zero = _mm256_setzero_si256();
+    __m256 xc, v; /* Centre values and stencil result */
+
+    for (j = 1; j + 8 <= w - 1; j += 8)
+    {
+        k = i * w + j;
+
+        f = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                    (const __m128i *) (op.flags + k)));
+        xc = _mm256_loadu_ps(x + k);
+
+        v = _mm256_mul_ps(_mm256_cvtepi32_ps(
+                    _mm256_srli_epi32(f, ASI_STENCIL_DEG_SHIFT)), xc);
+        v = _mm256_sub_ps(v, _mm256_and_ps(_mm256_castsi256_ps(
+                        _mm256_cmpgt_epi32(_mm256_and_si256(f,
+                                _mm256_set1_epi32(ASI_STENCIL_N)), zero)),
+                    _mm256_loadu_ps(x + k - w)));
+        v = _mm256_sub_ps(v, _mm256_and_ps(_mm256_castsi256_ps(
+                        _mm256_cmpgt_epi32(_mm256_and_si256(f,
+                                _mm256_set1_epi32(ASI_STENCIL_S)), zero)),
+                    _mm256_loadu_ps(x + k + w)));
+        v = _mm256_sub_ps(v, _mm256_and_ps(_mm256_castsi256_ps(
+                        _mm256_cmpgt_epi32(_mm256_and_si256(f,
+                                _mm256_set1_epi32(ASI_STENCIL_W)), zero)),
+                    _mm256_loadu_ps(x + k - 1)));
+        v = _mm256_sub_ps(v, _mm256_and_ps(_mm256_castsi256_ps(
+                        _mm256_cmpgt_epi32(_mm256_and_si256(f,
+                                _mm256_set1_epi32(ASI_STENCIL_E)), zero)),
+                    _mm256_loadu_ps(x + k + 1)));
+
+        v = _mm256_blendv_ps(v, xc, _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+                        _mm256_and_si256(f,
+                            _mm256_set1_epi32(ASI_STENCIL_KNOWN)), zero)));
+
+        _mm256_storeu_ps(b + k, v);
+    }
+
+    mixed_interior_scalar(op, x, b, i, j);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 scalar product of single precision vectors, accumulated in double
+ * precision.
+ * @a, b    [ I ] Vectors
+ * @n       [ I ] Vector length
+ */
+ASI_TARGET_AVX2
+static double mixed_dot_avx2(const float *a, const float *b, int n)
+{
+    int k; /* Loop variable */
+    __m256 ab; /* Products of eight entries */
+    __m256d sum_lo, sum_hi; /* Partial sums */
+    double partial[4]; /* Horizontal sum */
+
+    sum_lo = _mm256_setzero_pd();
+    sum_hi = _mm256_setzero_pd();
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        ab = _mm256_mul_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k));
+        sum_lo = _mm256_add_pd(sum_lo,
+                _mm256_cvtps_pd(_mm256_castps256_ps128(ab)));
+        sum_hi = _mm256_add_pd(sum_hi,
+                _mm256_cvtps_pd(_mm256_extractf128_ps(ab, 1)));
+    }
+
+    _mm256_storeu_pd(partial, _mm256_add_pd(sum_lo, sum_hi));
+
+    return partial[0] + partial[1] + partial[2] + partial[3]
+        + mixed_dot_scalar(a + k, b + k, n - k);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 CG update x += alpha p, r -= alpha q, see mixed_update_scalar.
+ * @x, r    [I/O] Solution and residual
+ * @p, q    [ I ] Search direction and A times p
+ * @alpha   [ I ] Step size
+ * @n       [ I ] Vector length
+ */
+ASI_TARGET_AVX2
+static double mixed_update_avx2(float *x, float *r, const float *p,
+        const float *q, float alpha, int n)
+{
+    int k; /* Loop variable */
+    __m256 va = _mm256_set1_ps(alpha);
+    __m256 rk; /* Updated residual entries */
+    __m256d sum_lo, sum_hi; /* Partial sums */
+    double partial[4]; /* Horizontal sum */
+
+    sum_lo = _mm256_setzero_pd();
+    sum_hi = _mm256_setzero_pd();
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        _mm256_storeu_ps(x + k, _mm256_fmadd_ps(va, _mm256_loadu_ps(p + k),
+                    _mm256_loadu_ps(x + k)));
+        rk = _mm256_fnmadd_ps(va, _mm256_loadu_ps(q + k),
+                _mm256_loadu_ps(r + k));
+        _mm256_storeu_ps(r + k, rk);
+
+        rk = _mm256_mul_ps(rk, rk);
+        sum_lo = _mm256_add_pd(sum_lo,
+                _mm256_cvtps_pd(_mm256_castps256_ps128(rk)));
+        sum_hi = _mm256_add_pd(sum_hi,
+                _mm256_cvtps_pd(_mm256_extractf128_ps(rk, 1)));
+    }
+
+    _mm256_storeu_pd(partial, _mm256_add_pd(sum_lo, sum_hi));
+
+    return partial[0] + partial[1] + partial[2] + partial[3]
+        + mixed_update_scalar(x + k, r + k, p + k, q + k, alpha, n - k);
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Matrix-free operator vector product b = A x in single precision. Halves
+ * the memory traffic of the double precision product and doubles the
+ * number of pixels per SIMD instruction.
+ * @op      [ I ] Inpainting operator
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+void mixed_operator_product(const diffusion_operator_type op, const float *x,
+        float *b)
+{
+    int i, j, k; /* Loop variables */
+    int w = op.width, h = op.height;
+
+    for (i = 0; i < h; i++)
+    {
+        /* Boundary rows */
+        if (i == 0 || i == h - 1 || w < 3)
+        {
+            for (j = 0; j < w; j++)
+            {
+                k = i * w + j;
+                b[k] = mixed_stencil_checked(op.flags[k], x, k, w);
+            }
+
+            continue;
+        }
+
+        k = i * w;
+        b[k] = mixed_stencil_checked(op.flags[k], x, k, w);
+        k = i * w + w - 1;
+        b[k] = mixed_stencil_checked(op.flags[k], x, k, w);
+
+#ifdef ASI_SIMD_X86
+        if (simd_detect() >= ASI_SIMD_AVX2)
+        {
+            mixed_interior_avx2(op, x, b, i);
+            continue;
+        }
+#endif
+
+        mixed_interior_scalar(op, x, b, i, 1);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Conjugate gradient method in single precision for the inpainting operator.
+ * Vectors are stored as floats, scalar products are accumulated in double
+ * precision. The attainable relative residual is limited by the single
+ * precision round-off to about 1e-5.
+ * @op      [ I ] Inpainting operator
+ * @b       [ I ] Right-hand side
+ * @x       [I/O] Initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int mixed_conjugate_gradient(const diffusion_operator_type op, const float *b,
+        float *x, int iter, double eps, solver_info_type *info)
+{
+    int k, it; /* Loop variables */
+    int n = op.n;
+    float *r, *p, *q; /* Residual, search direction, A times p */
+    double rr, rr_new, rr_0; /* Squared residual norms */
+    double pq; /* Scalar product of p and q */
+    float alpha, beta; /* Step sizes */
+    double (*dot)(const float *, const float *, int);
+    double (*update)(float *, float *, const float *, const float *, float,
+            int);
+
+    dot = mixed_dot_scalar;
+    update = mixed_update_scalar;
+
+#ifdef ASI_SIMD_X86
+    if (simd_detect() >= ASI_SIMD_AVX2)
+    {
+        dot = mixed_dot_avx2;
+        update = mixed_update_avx2;
+    }
+#endif
+
+    r = (float *) simd_calloc(n, sizeof(float));
+    p = (float *) simd_calloc(n, sizeof(float));
+    q = (float *) simd_calloc(n, sizeof(float));
+
+    if (r == NULL || p == NULL || q == NULL)
+    {
+        free(r);
+        free(p);
+        free(q);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Initial residual r = b - A x */
+    mixed_operator_product(op, x, q);
+
+    for (k = 0; k < n; k++)
+    {
+        r[k] = b[k] - q[k];
+        p[k] = r[k];
+    }
+
+    rr = dot(r, r, n);
+    rr_0 = rr;
+
+    for (it = 0; it < iter && rr > eps * eps * rr_0; it++)
+    {
+        mixed_operator_product(op, p, q);
+        pq = dot(p, q, n);
+
+        /* Breakdown: search direction lies in the null space */
+        if (pq <= 0.0)
+        {
+            break;
+        }
+
+        alpha = (float) (rr / pq);
+        rr_new = update(x, r, p, q, alpha, n);
+
+        beta = (float) (rr_new / rr);
+        rr = rr_new;
+
+        for (k = 0; k < n; k++)
+        {
+            p[k] = r[k] + beta * p[k];
+        }
+    }
+
+    if (info != NULL)
+    {
+        info->iterations = it;
+        info->residual_0 = sqrt(rr_0);
+        info->residual = rr_0 > 0.0 ? sqrt(rr / rr_0) : 0.0;
+    }
+
+    free(r);
+    free(p);
+    free(q);
+
+    if (rr > eps * eps * rr_0)
+    {
+        return ASI_EXIT_NOT_CONVERGED;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Residual r = b - A u in double precision. Returns its Euclidean norm.
+ * @op      [ I ] Inpainting operator
+ * @b       [ I ] Right-hand side
+ * @u       [ I ] Current iterate
+ * @r       [ O ] Residual
+ */
+static double mixed_residual(const diffusion_operator_type op,
+        const double *b, const double *u, double *r)
+{
+    int k; /* Loop variable */
+    double sum; /* Squared residual norm */
+
+    diffusion_operator_product(op, u, r);
+
+    sum = 0.0;
+    for (k = 0; k < op.n; k++)
+    {
+        r[k] = b[k] - r[k];
+        sum += r[k] * r[k];
+    }
+
+    return sqrt(sum);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting with mixed precision iterative
+ * refinement. The residual r = b - A u and the solution are kept in double
+ * precision, while corrections A d = r are solved by single precision CG to
+ * the inner tolerance. Each refinement step reduces the residual by about
+ * the inner tolerance, so the final accuracy matches a double precision
+ * solve. The reported residual is the true double precision residual.
+ * @image       [ I ] Double-valued image providing the known pixel values
+ * @mask        [ I ] Inpainting mask, non-zero for known pixels
+ * @u           [I/O] Initial guess on input, reconstruction on output
+ * @iter        [ I ] Maximum number of inner iterations in total
+ * @eps         [ I ] Relative residual tolerance
+ * @inner_eps   [ I ] Relative tolerance of inner solves, <= 0 for default
+ * @info        [ O ] Convergence information, may be NULL
+ */
+int mixed_inpainting_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps, double inner_eps,
+        solver_info_type *info)
+{
+    diffusion_operator_type op; /* Inpainting operator */
+    solver_info_type inner; /* Convergence of an inner solve */
+    double *b, *r; /* Right-hand side and residual */
+    float *r_f, *d_f; /* Single precision residual and correction */
+    double *ud = (double *) u.data;
+    const double *f = (const double *) image.data;
+    double res, res_0, res_prev; /* Residual norms */
+    int k, n, it; /* Loop variables, number of pixels */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (inner_eps <= 0.0)
+    {
+        inner_eps = MIXED_INNER_EPS;
+    }
+
+    ret = diffusion_operator_init(&op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    n = op.n;
+    b = (double *) simd_calloc(n, sizeof(double));
+    r = (double *) simd_calloc(n, sizeof(double));
+    r_f = (float *) simd_calloc(n, sizeof(float));
+    d_f = (float *) simd_calloc(n, sizeof(float));
+
+    if (b == NULL || r == NULL || r_f == NULL || d_f == NULL)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+        goto cleanup;
+    }
+
+    diffusion_operator_rhs(op, f, b);
+
+    for (k = 0; k < n; k++)
+    {
+        if (op.flags[k] & ASI_STENCIL_KNOWN)
+        {
+            ud[k] = f[k];
+        }
+    }
+
+    res_0 = mixed_residual(op, b, ud, r);
+    res = res_0;
+    it = 0;
+
+    while (res > eps * res_0 && it < iter)
+    {
+        /* Correction in single precision */
+        for (k = 0; k < n; k++)
+        {
+            r_f[k] = (float) r[k];
+            d_f[k] = 0.0f;
+        }
+
+        ret = mixed_conjugate_gradient(op, r_f, d_f, iter - it, inner_eps,
+                &inner);
+
+        if (ret == ASI_EXIT_FAILED_ALLOC)
+        {
+            goto cleanup;
+        }
+
+        it += inner.iterations;
+
+        for (k = 0; k < n; k++)
+        {
+            ud[k] += d_f[k];
+        }
+
+        res_prev = res;
+        res = mixed_residual(op, b, ud, r);
+
+        /* Stagnation in round-off */
+        if (inner.iterations == 0 || res >= res_prev)
+        {
+            break;
+        }
+    }
+
+    if (info != NULL)
+    {
+        info->iterations = it;
+        info->residual_0 = res_0;
+        info->residual = res_0 > 0.0 ? res / res_0 : 0.0;
+    }
+
+    ret = res > eps * res_0 ? ASI_EXIT_NOT_CONVERGED : ASI_EXIT_SUCCESS;
+
+cleanup:
+    free(b);
+    free(r);
+    free(r_f);
+    free(d_f);
+    diffusion_operator_delete(&op);
+
+    return ret;
+}
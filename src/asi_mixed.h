@@ -0,0 +1,21 @@
+#ifndef _ASI_MIXED_H_
+#define _ASI_MIXED_H_
+
+#include "asi_image.h"
+#include "asi_sparse.h"
+#include "asi_diffusion.h"
+
+/* Operator vector product b = A x in single precision */
+void mixed_operator_product(const diffusion_operator_type op, const float *x,
+        float *b);
+
+/* Conjugate gradient method in single precision */
+int mixed_conjugate_gradient(const diffusion_operator_type op, const float *b,
+        float *x, int iter, double eps, solver_info_type *info);
+
+/* Inpainting with single precision CG and double precision refinement */
+int mixed_inpainting_cg(const image_type image, const image_type mask,
+        image_type u, int iter, double eps, double inner_eps,
+        solver_info_type *info);
+
+#endif
@@ -0,0 +1,790 @@
+#include "asi_multigrid.h"
+#include "asi_diffusion.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets default parameters of the multigrid solver.
+ * @params  [ O ] Solver parameters
+ */
+void multigrid_params_default(multigrid_params_type *params)
+{
+    params->cycle = ASI_MG_FMG;
+    params->pre_smooth = 2;
+    params->post_smooth = 2;
+    params->coarse_size = 4;
+    params->coarse_iter = 50;
+    params->max_cycles = 100;
+    params->eps = 1e-6;
+    params->omega = 1.0;
+    params->alpha = 1.8;
+    params->krylov = 1;
+    params->num_threads = 0;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates the arrays of a grid level.
+ * @lv      [ O ] Grid level
+ * @width   [ I ] Level width
+ * @height  [ I ] Level height
+ */
+static int multigrid_level_alloc(multigrid_level_type *lv, int width,
+        int height)
+{
+    size_t n = (size_t) width * height;
+
+    lv->width = width;
+    lv->height = height;
+    lv->diag = (double *) simd_calloc(n, sizeof(double));
+    lv->ce = (double *) simd_calloc(n, sizeof(double));
+    lv->cs = (double *) simd_calloc(n, sizeof(double));
+    lv->x = (double *) simd_calloc(n, sizeof(double));
+    lv->b = (double *) simd_calloc(n, sizeof(double));
+    lv->r = (double *) simd_calloc(n, sizeof(double));
+
+    if (lv->diag == NULL || lv->ce == NULL || lv->cs == NULL
+            || lv->x == NULL || lv->b == NULL || lv->r == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees the arrays of a grid level.
+ * @lv      [ I ] Grid level
+ */
+static void multigrid_level_delete(multigrid_level_type *lv)
+{
+    free(lv->diag);
+    free(lv->ce);
+    free(lv->cs);
+    free(lv->x);
+    free(lv->b);
+    free(lv->r);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Galerkin coarsening P^T A P of a level, where P copies a coarse cell to
+ * its (up to) four fine children. Children without unknowns have zero
+ * couplings, so the coarse operator is aware of the mask: known pixels
+ * neither receive corrections nor contribute to coarse residuals.
+ * @fine    [ I ] Fine level
+ * @coarse  [I/O] Coarse level, allocated
+ */
+static void multigrid_coarsen(const multigrid_level_type *fine,
+        multigrid_level_type *coarse)
+{
+    int i, j, k, kc; /* Loop variables, fine and coarse index */
+    int ic, jc; /* Coarse coordinates */
+    int wf = fine->width, hf = fine->height, wc = coarse->width;
+
+    for (i = 0; i < hf; i++)
+    {
+        ic = i / 2;
+
+        for (j = 0; j < wf; j++)
+        {
+            jc = j / 2;
+            k = i * wf + j;
+            kc = ic * wc + jc;
+
+            coarse->diag[kc] += fine->diag[k];
+
+            /* Couplings within a coarse cell reduce the diagonal */
+            if (j < wf - 1)
+            {
+                if ((j + 1) / 2 == jc)
+                {
+                    coarse->diag[kc] -= 2.0 * fine->ce[k];
+                }
+                else
+                {
+                    coarse->ce[kc] += fine->ce[k];
+                }
+            }
+            if (i < hf - 1)
+            {
+                if ((i + 1) / 2 == ic)
+                {
+                    coarse->diag[kc] -= 2.0 * fine->cs[k];
+                }
+                else
+                {
+                    coarse->cs[kc] += fine->cs[k];
+                }
+            }
+        }
+    }
+
+    /* Suppress round-off in cells without unknowns */
+    for (kc = 0; kc < coarse->width * coarse->height; kc++)
+    {
+        if (coarse->diag[kc] < 1e-12)
+        {
+            coarse->diag[kc] = 0.0;
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Builds the multigrid hierarchy. The finest level is the inpainting
+ * operator with known pixels eliminated, coarser levels are obtained by
+ * Galerkin coarsening with 2x2 aggregation.
+ * @mg      [ O ] Multigrid hierarchy
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @params  [ I ] Solver parameters
+ */
+int multigrid_init(multigrid_type *mg, const image_type mask,
+        const multigrid_params_type params)
+{
+    multigrid_level_type *fine; /* Finest level */
+    int w, h, l, k; /* Dimensions and loop variables */
+    unsigned char flag; /* Stencil flags */
+    int ret; /* Return value */
+
+    mg->params = params;
+    mg->op.flags = NULL;
+    mg->sched = NULL;
+
+    /* Count levels */
+    w = mask.width;
+    h = mask.height;
+    mg->num_levels = 1;
+
+    while (w > params.coarse_size && h > params.coarse_size)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        mg->num_levels++;
+    }
+
+    mg->levels = (multigrid_level_type *) calloc(mg->num_levels,
+            sizeof(multigrid_level_type));
+
+    if (mg->levels == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    ret = diffusion_operator_init(&mg->op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        multigrid_delete(mg);
+        return ret;
+    }
+
+    /* Finest level from the stencil flags */
+    fine = &mg->levels[0];
+    ret = multigrid_level_alloc(fine, mask.width, mask.height);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        multigrid_delete(mg);
+        return ret;
+    }
+
+    for (k = 0; k < mg->op.n; k++)
+    {
+        flag = mg->op.flags[k];
+
+        if (!(flag & ASI_STENCIL_KNOWN))
+        {
+            fine->diag[k] = flag >> ASI_STENCIL_DEG_SHIFT;
+            fine->ce[k] = (flag & ASI_STENCIL_E) ? 1.0 : 0.0;
+            fine->cs[k] = (flag & ASI_STENCIL_S) ? 1.0 : 0.0;
+        }
+    }
+
+    /* Coarser levels */
+    for (l = 1; l < mg->num_levels; l++)
+    {
+        ret = multigrid_level_alloc(&mg->levels[l],
+                (mg->levels[l-1].width + 1) / 2,
+                (mg->levels[l-1].height + 1) / 2);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            multigrid_delete(mg);
+            return ret;
+        }
+
+        multigrid_coarsen(&mg->levels[l-1], &mg->levels[l]);
+    }
+
+    /* Threads split the half-sweeps of the fine-level smoother into bands */
+    if (params.num_threads != 1)
+    {
+        mg->sched = (scheduler_type *) malloc(sizeof(scheduler_type));
+
+        if (mg->sched == NULL)
+        {
+            multigrid_delete(mg);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        ret = scheduler_init(mg->sched, params.num_threads);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            free(mg->sched);
+            mg->sched = NULL;
+            multigrid_delete(mg);
+            return ret;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of a multigrid hierarchy
+ * @mg      [ I ] Multigrid hierarchy to be deleted
+ */
+void multigrid_delete(multigrid_type *mg)
+{
+    int l; /* Loop variable */
+
+    if (mg->levels != NULL)
+    {
+        for (l = 0; l < mg->num_levels; l++)
+        {
+            multigrid_level_delete(&mg->levels[l]);
+        }
+    }
+
+    free(mg->levels);
+    mg->levels = NULL;
+    diffusion_operator_delete(&mg->op);
+
+    if (mg->sched != NULL)
+    {
+        scheduler_delete(mg->sched);
+        free(mg->sched);
+        mg->sched = NULL;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sum of the couplings times neighbouring values at a cell.
+ * @lv      [ I ] Grid level
+ * @x       [ I ] Vector
+ * @i       [ I ] Row index
+ * @j       [ I ] Column index
+ */
+static double multigrid_neighbours(const multigrid_level_type *lv,
+        const double *x, int i, int j)
+{
+    int w = lv->width;
+    int k = i * w + j;
+    double sum = 0.0;
+
+    if (j < w - 1)
+    {
+        sum += lv->ce[k] * x[k + 1];
+    }
+    if (j > 0)
+    {
+        sum += lv->ce[k - 1] * x[k - 1];
+    }
+    if (i < lv->height - 1)
+    {
+        sum += lv->cs[k] * x[k + w];
+    }
+    if (i > 0)
+    {
+        sum += lv->cs[k - w] * x[k - w];
+    }
+
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Red-black Gauss-Seidel smoothing (with over-relaxation) of A x = b on one
+ * level. Cells without unknowns are left untouched.
+ * @lv      [I/O] Grid level
+ * @omega   [ I ] Relaxation parameter
+ * @sweeps  [ I ] Number of sweeps
+ * @reverse [ I ] Flag to process black before red cells
+ */
+static void multigrid_smooth(multigrid_level_type *lv, double omega,
+        int sweeps, int reverse)
+{
+    int s, c, i, j, k; /* Loop variables */
+    int color; /* Current colour */
+
+    for (s = 0; s < sweeps; s++)
+    {
+        for (c = 0; c < 2; c++)
+        {
+            color = reverse ? 1 - c : c;
+
+            for (i = 0; i < lv->height; i++)
+            {
+                for (j = (i + color) % 2; j < lv->width; j += 2)
+                {
+                    k = i * lv->width + j;
+
+                    if (lv->diag[k] == 0.0)
+                    {
+                        continue;
+                    }
+
+                    lv->x[k] += omega * ((lv->b[k]
+                                + multigrid_neighbours(lv, lv->x, i, j))
+                            / lv->diag[k] - lv->x[k]);
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Smoothing on level l. The finest level carries the unscaled five-point
+ * stencil, so it is smoothed with the vectorised red-black SOR kernel of the
+ * matrix-free operator; this requires zero values at known pixels, which
+ * the finest level maintains, in row bands on the scheduler of the
+ * hierarchy. Coarse levels use the generic smoother.
+ * @mg      [I/O] Multigrid hierarchy
+ * @l       [ I ] Level index
+ * @sweeps  [ I ] Number of sweeps
+ * @reverse [ I ] Flag to process black before red cells
+ */
+static void multigrid_smooth_level(multigrid_type *mg, int l, int sweeps,
+        int reverse)
+{
+    multigrid_level_type *lv = &mg->levels[l];
+    image_type x; /* Iterate of the finest level as image */
+
+    if (l > 0 || mg->params.omega <= 0.0 || mg->params.omega >= 2.0)
+    {
+        multigrid_smooth(lv, mg->params.omega, sweeps, reverse);
+        return;
+    }
+
+    x.data = lv->x;
+    x.width = lv->width;
+    x.height = lv->height;
+    x.dtype = ASI_DTYPE_DOUBLE;
+
+    diffusion_sor_red_black(mg->op, x, lv->b, mg->params.omega, sweeps,
+            reverse, mg->sched);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Residual r = b - A x on one level, zero at cells without unknowns.
+ * Returns the squared residual norm.
+ * @lv      [I/O] Grid level
+ */
+static double multigrid_residual(multigrid_level_type *lv)
+{
+    int i, j, k; /* Loop variables */
+    double sum; /* Squared residual norm */
+
+    sum = 0.0;
+    for (i = 0; i < lv->height; i++)
+    {
+        for (j = 0; j < lv->width; j++)
+        {
+            k = i * lv->width + j;
+
+            if (lv->diag[k] == 0.0)
+            {
+                lv->r[k] = 0.0;
+                continue;
+            }
+
+            lv->r[k] = lv->b[k] + multigrid_neighbours(lv, lv->x, i, j)
+                - lv->diag[k] * lv->x[k];
+            sum += lv->r[k] * lv->r[k];
+        }
+    }
+
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Restriction P^T v: sums up the values of the children of each coarse cell.
+ * @fine    [ I ] Fine level
+ * @v       [ I ] Fine vector
+ * @coarse  [ I ] Coarse level
+ * @vc      [ O ] Coarse vector
+ */
+static void multigrid_restrict(const multigrid_level_type *fine,
+        const double *v, const multigrid_level_type *coarse, double *vc)
+{
+    int i, j; /* Loop variables */
+
+    memset(vc, 0, (size_t) coarse->width * coarse->height * sizeof(double));
+
+    for (i = 0; i < fine->height; i++)
+    {
+        for (j = 0; j < fine->width; j++)
+        {
+            vc[(i / 2) * coarse->width + j / 2] += v[i * fine->width + j];
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Prolongation v += scale * P vc, restricted to cells with unknowns.
+ * @coarse  [ I ] Coarse level
+ * @vc      [ I ] Coarse vector
+ * @fine    [ I ] Fine level
+ * @v       [I/O] Fine vector
+ * @scale   [ I ] Scaling of the prolongated vector
+ */
+static void multigrid_prolongate(const multigrid_level_type *coarse,
+        const double *vc, const multigrid_level_type *fine, double *v,
+        double scale)
+{
+    int i, j, k; /* Loop variables */
+
+    for (i = 0; i < fine->height; i++)
+    {
+        for (j = 0; j < fine->width; j++)
+        {
+            k = i * fine->width + j;
+
+            if (fine->diag[k] != 0.0)
+            {
+                v[k] += scale * vc[(i / 2) * coarse->width + j / 2];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Recursive V-cycle on level l for the system stored in levels[l].b, using
+ * levels[l].x as initial guess. Smoothing orders are mirrored between pre-
+ * and post-smoothing so that the cycle is a symmetric operator.
+ * @mg      [I/O] Multigrid hierarchy
+ * @l       [ I ] Level index
+ */
+static void multigrid_v_cycle(multigrid_type *mg, int l)
+{
+    multigrid_level_type *lv = &mg->levels[l];
+    multigrid_level_type *coarse;
+    const multigrid_params_type *params = &mg->params;
+
+    if (l == mg->num_levels - 1)
+    {
+        multigrid_smooth_level(mg, l, params->coarse_iter, 0);
+        multigrid_smooth_level(mg, l, params->coarse_iter, 1);
+        return;
+    }
+
+    coarse = &mg->levels[l+1];
+
+    multigrid_smooth_level(mg, l, params->pre_smooth, 0);
+    multigrid_residual(lv);
+
+    multigrid_restrict(lv, lv->r, coarse, coarse->b);
+    memset(coarse->x, 0, (size_t) coarse->width * coarse->height
+            * sizeof(double));
+
+    multigrid_v_cycle(mg, l+1);
+
+    multigrid_prolongate(coarse, coarse->x, lv, lv->x, params->alpha);
+    multigrid_smooth_level(mg, l, params->post_smooth, 1);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Full multigrid initialisation: the right-hand side is restricted to the
+ * coarsest level, solved there and interpolated upwards, followed by one
+ * V-cycle per level.
+ * @mg      [I/O] Multigrid hierarchy, right-hand side in levels[0].b
+ */
+static void multigrid_fmg(multigrid_type *mg)
+{
+    int l; /* Loop variable */
+    multigrid_level_type *lv, *coarse;
+
+    for (l = 1; l < mg->num_levels; l++)
+    {
+        multigrid_restrict(&mg->levels[l-1], mg->levels[l-1].b,
+                &mg->levels[l], mg->levels[l].b);
+    }
+
+    for (l = mg->num_levels - 1; l >= 0; l--)
+    {
+        lv = &mg->levels[l];
+
+        if (l < mg->num_levels - 1)
+        {
+            coarse = &mg->levels[l+1];
+            multigrid_prolongate(coarse, coarse->x, lv, lv->x, 1.0);
+        }
+
+        multigrid_v_cycle(mg, l);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Preconditioner z = M^-1 r given by one V-cycle with zero initial guess.
+ * Known pixels are identity rows of the inpainting operator.
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void multigrid_precond_apply(const preconditioner_type *pc,
+        const double *r, double *z)
+{
+    multigrid_type *mg = (multigrid_type *) pc->data;
+    multigrid_level_type *fine = &mg->levels[0];
+    int k, n; /* Loop variable, number of pixels */
+
+    n = fine->width * fine->height;
+
+    for (k = 0; k < n; k++)
+    {
+        fine->b[k] = fine->diag[k] != 0.0 ? r[k] : 0.0;
+        fine->x[k] = 0.0;
+    }
+
+    multigrid_v_cycle(mg, 0);
+
+    for (k = 0; k < n; k++)
+    {
+        z[k] = fine->diag[k] != 0.0 ? fine->x[k] : r[k];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets up a multigrid V-cycle as preconditioner for the conjugate gradient
+ * method applied to the inpainting operator (see diffusion_linear_operator).
+ * The hierarchy needs to outlive the preconditioner.
+ * @pc      [ O ] Preconditioner
+ * @mg      [I/O] Multigrid hierarchy, used as work memory
+ */
+void multigrid_precond_init(preconditioner_type *pc, multigrid_type *mg)
+{
+    precond_init(pc, NULL, ASI_PRECOND_CUSTOM, 0);
+    pc->apply = multigrid_precond_apply;
+    pc->data = mg;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting with geometric multigrid. Optionally
+ * starts with full multigrid, then repeats V-cycles until the residual norm
+ * dropped below eps times the residual norm of the initial guess. Since the
+ * aggregation-based hierarchy converges slowly as a stationary method, the
+ * V-cycles are by default used as preconditioner of conjugate gradients.
+ * Over-correction makes plain cycling (krylov = 0) diverge, so it always
+ * uses alpha <= 1; cycling stops once the residual grows beyond the one of
+ * the initial guess, and u keeps the full multigrid result or initial guess.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction on output
+ * @params  [ I ] Solver parameters
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int multigrid_inpainting(const image_type image, const image_type mask,
+        image_type u, const multigrid_params_type params,
+        solver_info_type *info)
+{
+    multigrid_type mg; /* Multigrid hierarchy */
+    multigrid_level_type *fine; /* Finest level */
+    const diffusion_operator_type *op; /* Inpainting operator */
+    preconditioner_type pc; /* V-cycle preconditioner */
+    solver_info_type cg_info; /* Convergence of the Krylov iteration */
+    double *ud; /* Solution data */
+    double *b; /* Right-hand side including known pixels */
+    const double *f; /* Known values */
+    double res, res_0; /* Squared residual norms */
+    int k, n, cycle; /* Loop variables, number of pixels */
+    int diverged = 0; /* Flag for a growing or non-finite residual */
+    int ret; /* Return value */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    ret = multigrid_init(&mg, mask, params);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    /* Over-corrected stationary cycles are not contractive */
+    if (!params.krylov && mg.params.alpha > 1.0)
+    {
+        mg.params.alpha = 1.0;
+    }
+
+    op = &mg.op;
+    n = op->n;
+    b = (double *) simd_calloc(n, sizeof(double));
+
+    if (b == NULL)
+    {
+        multigrid_delete(&mg);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    fine = &mg.levels[0];
+    ud = (double *) u.data;
+    f = (const double *) image.data;
+
+    /* Finest level solves for the unknown pixels directly */
+    diffusion_operator_rhs(*op, f, b);
+
+    for (k = 0; k < n; k++)
+    {
+        if (op->flags[k] & ASI_STENCIL_KNOWN)
+        {
+            ud[k] = f[k];
+        }
+
+        fine->b[k] = fine->diag[k] != 0.0 ? b[k] : 0.0;
+        fine->x[k] = fine->diag[k] != 0.0 ? ud[k] : 0.0;
+    }
+
+    res_0 = multigrid_residual(fine);
+    res = res_0;
+    cycle = 0;
+
+    if (params.cycle == ASI_MG_FMG && res_0 > 0.0)
+    {
+        memset(fine->x, 0, n * sizeof(double));
+        multigrid_fmg(&mg);
+        res = multigrid_residual(fine);
+        cycle++;
+    }
+
+    /* Write back unknown pixels */
+    for (k = 0; k < n; k++)
+    {
+        if (fine->diag[k] != 0.0)
+        {
+            ud[k] = fine->x[k];
+        }
+    }
+
+    if (params.krylov && res > params.eps * params.eps * res_0)
+    {
+        /* Tolerance of the Krylov iteration relative to its initial guess */
+        multigrid_precond_init(&pc, &mg);
+        ret = preconditioned_conjugate_gradient(diffusion_linear_operator(op),
+                &pc, b, ud, params.max_cycles - cycle,
+                params.eps * sqrt(res_0 / res), &cg_info);
+        precond_delete(&pc);
+
+        if (ret == ASI_EXIT_FAILED_ALLOC)
+        {
+            free(b);
+            multigrid_delete(&mg);
+            return ret;
+        }
+
+        cycle += cg_info.iterations;
+        res = res * cg_info.residual * cg_info.residual;
+    }
+    else
+    {
+        for (; cycle < params.max_cycles
+                && res > params.eps * params.eps * res_0; cycle++)
+        {
+            multigrid_v_cycle(&mg, 0);
+            res = multigrid_residual(fine);
+
+            if (!isfinite(res) || res > res_0)
+            {
+                diverged = 1;
+                break;
+            }
+        }
+
+        for (k = 0; k < n && !diverged; k++)
+        {
+            if (fine->diag[k] != 0.0)
+            {
+                ud[k] = fine->x[k];
+            }
+        }
+    }
+
+    if (info != NULL)
+    {
+        info->iterations = cycle;
+        info->residual_0 = sqrt(res_0);
+        info->residual = res_0 > 0.0 ? sqrt(res / res_0) : 0.0;
+    }
+
+    free(b);
+    multigrid_delete(&mg);
+
+    /* Written such that a NaN residual does not pass */
+    return diverged || !(res <= params.eps * params.eps * res_0)
+        ? ASI_EXIT_NOT_CONVERGED : ASI_EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#ifndef _ASI_MULTIGRID_H_
+#define _ASI_MULTIGRID_H_
+
+#include "asi_image.h"
+#include "asi_sparse.h"
+#include "asi_diffusion.h"
+#include "asi_scheduler.h"
+
+/* Supported multigrid cycles */
+typedef enum multigrid_cycle
+{
+    ASI_MG_V_CYCLE, /* V-cycles starting from the initial guess */
+    ASI_MG_FMG /* Full multigrid followed by V-cycles */
+} multigrid_cycle_enum;
+
+/* Parameters of the multigrid solver */
+typedef struct multigrid_params
+{
+    multigrid_cycle_enum cycle; /* Cycle type */
+    int pre_smooth; /* Number of pre-smoothing sweeps */
+    int post_smooth; /* Number of post-smoothing sweeps */
+    int coarse_size; /* Stop coarsening at this width or height */
+    int coarse_iter; /* Smoothing sweeps on the coarsest level */
+    int max_cycles; /* Maximum number of cycles */
+    double eps; /* Relative residual tolerance */
+    double omega; /* Relaxation parameter of the smoother */
+    double alpha; /* Over-correction of coarse corrections, krylov only */
+    int krylov; /* Flag to accelerate cycles with conjugate gradients */
+    int num_threads; /* Threads of the fine-level smoother, <= 0 for all */
+} multigrid_params_type;
+
+/* Grid level with a symmetric five-point operator */
+typedef struct multigrid_level
+{
+    int width; /* Level width */
+    int height; /* Level height */
+    double *diag; /* Diagonal, zero for cells without unknowns */
+    double *ce; /* Coupling to the eastern neighbour */
+    double *cs; /* Coupling to the southern neighbour */
+    double *x; /* Solution or correction */
+    double *b; /* Right-hand side */
+    double *r; /* Residual */
+} multigrid_level_type;
+
+/* Multigrid hierarchy */
+typedef struct multigrid
+{
+    multigrid_level_type *levels; /* Levels, 0 is the finest */
+    int num_levels; /* Number of levels */
+    diffusion_operator_type op; /* Stencil flags of the finest level */
+    multigrid_params_type params; /* Solver parameters */
+    scheduler_type *sched; /* Scheduler of the smoother, NULL for one thread */
+} multigrid_type;
+
+/* Default parameters */
+void multigrid_params_default(multigrid_params_type *params);
+
+/* Build the multigrid hierarchy for an inpainting mask */
+int multigrid_init(multigrid_type *mg, const image_type mask,
+        const multigrid_params_type params);
+
+/* Free memory */
+void multigrid_delete(multigrid_type *mg);
+
+/* Set up one V-cycle as a preconditioner for conjugate gradients */
+void multigrid_precond_init(preconditioner_type *pc, multigrid_type *mg);
+
+/* Homogeneous diffusion inpainting with multigrid */
+int multigrid_inpainting(const image_type image, const image_type mask,
+        image_type u, const multigrid_params_type params,
+        solver_info_type *info);
+
+#endif
@@ -0,0 +1,241 @@
+#include "asi_partition.h"
+#include "asi_mask.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Chamfer weights of axial and diagonal steps, axial distance 1 = 3 */
+#define PARTITION_AXIAL 3
+#define PARTITION_DIAGONAL 4
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Estimates the solver work per pixel. Iterative solvers need a number of
+ * iterations proportional to the diameter of a hole to carry information
+ * from its boundary into its interior, so unknown pixels are weighted by
+ * one plus their distance to the nearest known pixel, known pixels by one.
+ * Distances are computed by a two-pass 3-4 chamfer transform.
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @cost    [ O ] Cost per pixel
+ */
+int partition_cost_map(const image_type mask, double *cost)
+{
+    int *dist; /* Chamfer distance, three units per pixel */
+    int w = mask.width, h = mask.height;
+    int i, j, k, d; /* Loop variables, candidate distance */
+    int inf; /* Distance without any known pixel */
+
+    dist = (int *) malloc((size_t) w * h * sizeof(int));
+
+    if (dist == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    inf = PARTITION_AXIAL * (w + h);
+
+    /* Forward pass from the top left */
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+            dist[k] = mask_get(mask, i, j) ? 0 : inf;
+
+            if (j > 0 && (d = dist[k - 1] + PARTITION_AXIAL) < dist[k])
+            {
+                dist[k] = d;
+            }
+            if (i > 0)
+            {
+                if ((d = dist[k - w] + PARTITION_AXIAL) < dist[k])
+                {
+                    dist[k] = d;
+                }
+                if (j > 0 && (d = dist[k - w - 1] + PARTITION_DIAGONAL)
+                        < dist[k])
+                {
+                    dist[k] = d;
+                }
+                if (j < w - 1 && (d = dist[k - w + 1] + PARTITION_DIAGONAL)
+                        < dist[k])
+                {
+                    dist[k] = d;
+                }
+            }
+        }
+    }
+
+    /* Backward pass from the bottom right */
+    for (i = h - 1; i >= 0; i--)
+    {
+        for (j = w - 1; j >= 0; j--)
+        {
+            k = i * w + j;
+
+            if (j < w - 1 && (d = dist[k + 1] + PARTITION_AXIAL) < dist[k])
+            {
+                dist[k] = d;
+            }
+            if (i < h - 1)
+            {
+                if ((d = dist[k + w] + PARTITION_AXIAL) < dist[k])
+                {
+                    dist[k] = d;
+                }
+                if (j < w - 1 && (d = dist[k + w + 1] + PARTITION_DIAGONAL)
+                        < dist[k])
+                {
+                    dist[k] = d;
+                }
+                if (j > 0 && (d = dist[k + w - 1] + PARTITION_DIAGONAL)
+                        < dist[k])
+                {
+                    dist[k] = d;
+                }
+            }
+
+            cost[k] = 1.0 + (double) dist[k] / PARTITION_AXIAL;
+        }
+    }
+
+    free(dist);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Splits a cost profile into consecutive parts of equal total cost. Each
+ * boundary is placed where the cumulative cost is closest to its share and
+ * then moved to respect the minimum size of all parts.
+ * @profile  [ I ] Cost per entry
+ * @n        [ I ] Number of entries
+ * @parts    [ I ] Number of parts
+ * @min_size [ I ] Minimum number of entries per part
+ * @bounds   [ O ] Part boundaries, parts + 1 entries from 0 to n
+ */
+void partition_split(const double *profile, int n, int parts, int min_size,
+        int *bounds)
+{
+    double total, sum, target; /* Total, cumulative and target cost */
+    int i, b; /* Loop variables */
+
+    min_size = min_size * parts > n ? n / parts : min_size;
+
+    total = 0.0;
+    for (b = 0; b < n; b++)
+    {
+        total += profile[b];
+    }
+
+    bounds[0] = 0;
+    sum = 0.0;
+    b = 0;
+
+    for (i = 1; i < parts; i++)
+    {
+        target = total * i / parts;
+
+        /* Advance while adding the next entry gets closer to the target */
+        while (b < n && sum + profile[b] - target < target - sum)
+        {
+            sum += profile[b];
+            b++;
+        }
+
+        bounds[i] = b;
+
+        if (bounds[i] < bounds[i - 1] + min_size)
+        {
+            bounds[i] = bounds[i - 1] + min_size;
+        }
+        if (bounds[i] > n - (parts - i) * min_size)
+        {
+            bounds[i] = n - (parts - i) * min_size;
+        }
+    }
+
+    bounds[parts] = n;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Jagged partition of an image by two levels of bisection: the rows are
+ * split into ny strips of equal estimated work, and every strip is split
+ * into nx subdomains of equal estimated work. Subdomains keep the
+ * neighbourhood structure of a regular grid, so the grid colouring of
+ * Schwarz solvers remains valid as long as all sizes respect min_size.
+ * @mask       [ I ] Inpainting mask, non-zero for known pixels
+ * @nx         [ I ] Number of subdomains per strip
+ * @ny         [ I ] Number of strips
+ * @min_size   [ I ] Minimum width and height of a subdomain
+ * @row_bounds [ O ] Strip boundaries, ny + 1 entries
+ * @col_bounds [ O ] Subdomain boundaries, nx + 1 entries per strip
+ */
+int partition_adaptive(const image_type mask, int nx, int ny, int min_size,
+        int *row_bounds, int *col_bounds)
+{
+    int w = mask.width, h = mask.height;
+    double *cost; /* Cost per pixel */
+    double *profile; /* Cost per row or per column of a strip */
+    int s, i, j; /* Loop variables */
+    int ret; /* Return value */
+
+    if (nx < 1 || ny < 1 || nx > w || ny > h)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    cost = (double *) malloc((size_t) w * h * sizeof(double));
+    profile = (double *) malloc((w > h ? w : h) * sizeof(double));
+
+    if (cost == NULL || profile == NULL)
+    {
+        free(cost);
+        free(profile);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    ret = partition_cost_map(mask, cost);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        for (i = 0; i < h; i++)
+        {
+            profile[i] = 0.0;
+
+            for (j = 0; j < w; j++)
+            {
+                profile[i] += cost[i * w + j];
+            }
+        }
+
+        partition_split(profile, h, ny, min_size, row_bounds);
+
+        for (s = 0; s < ny; s++)
+        {
+            memset(profile, 0, w * sizeof(double));
+
+            for (i = row_bounds[s]; i < row_bounds[s + 1]; i++)
+            {
+                for (j = 0; j < w; j++)
+                {
+                    profile[j] += cost[i * w + j];
+                }
+            }
+
+            partition_split(profile, w, nx, min_size,
+                    col_bounds + s * (nx + 1));
+        }
+    }
+
+    free(cost);
+    free(profile);
+
+    return ret;
+}
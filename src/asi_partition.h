@@ -0,0 +1,24 @@
+#ifndef _ASI_PARTITION_H_
+#define _ASI_PARTITION_H_
+
+#include "asi_image.h"
+
+/* Supported partitioning strategies of subdomain solvers */
+typedef enum partition_strategy
+{
+    ASI_PARTITION_UNIFORM, /* Regular grid of equally sized subdomains */
+    ASI_PARTITION_ADAPTIVE /* Equal estimated work from the mask */
+} partition_strategy_enum;
+
+/* Estimated solver work per pixel from the distance to known pixels */
+int partition_cost_map(const image_type mask, double *cost);
+
+/* Split n entries into parts of equal total cost and a minimum size */
+void partition_split(const double *profile, int n, int parts, int min_size,
+        int *bounds);
+
+/* Jagged partition into ny strips of nx subdomains of equal cost */
+int partition_adaptive(const image_type mask, int nx, int ny, int min_size,
+        int *row_bounds, int *col_bounds);
+
+#endif
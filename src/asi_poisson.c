@@ -0,0 +1,674 @@
+#include "asi_poisson.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Maximum number of known pixels inside a window for which the fast solver
+ * preconditions conjugate gradients. The iteration count grows with the
+ * number of known pixels, so beyond a few of them plain conjugate gradients
+ * are cheaper than one transform pair per iteration.
+ */
+#define POISSON_CAPACITANCE_MAX 8
+
+/* Rectangle of a window solve, handed to the preconditioner */
+typedef struct poisson_window
+{
+    const poisson_plan_type *plan; /* Fast solver of the rectangle */
+    const diffusion_operator_type *op; /* Window operator */
+    int x0, y0; /* Window coordinates of the rectangle origin */
+    double *rect; /* Right-hand side and solution on the rectangle */
+} poisson_window_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises one axis of the separable solver.
+ * @axis    [ O ] Axis
+ * @n       [ I ] Number of grid points
+ * @bc0     [ I ] Condition at the start
+ * @bc1     [ I ] Condition at the end
+ */
+static int poisson_axis_init(poisson_axis_type *axis, int n,
+        poisson_bc_enum bc0, poisson_bc_enum bc1)
+{
+    int k; /* Loop variable */
+    int ret; /* Return value */
+
+    axis->n = n;
+    axis->bc0 = bc0;
+    axis->bc1 = bc1;
+    axis->buffer = NULL;
+    axis->eigen = (double *) malloc(n * sizeof(double));
+
+    if (axis->eigen == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (bc0 == ASI_BC_NEUMANN && bc1 == ASI_BC_NEUMANN)
+    {
+        ret = dct_plan_init(&axis->dct, n, ASI_DCT_COSINE);
+
+        for (k = 0; k < n; k++)
+        {
+            axis->eigen[k] = 2.0 - 2.0 * cos(M_PI * k / n);
+        }
+    }
+    else if (bc0 == ASI_BC_DIRICHLET && bc1 == ASI_BC_DIRICHLET)
+    {
+        ret = dct_plan_init(&axis->dct, n, ASI_DCT_SINE);
+
+        for (k = 0; k < n; k++)
+        {
+            axis->eigen[k] = 2.0 - 2.0 * cos(M_PI * (k + 1) / (n + 1));
+        }
+    }
+    else
+    {
+        /* Mirroring at the Neumann end gives symmetric Dirichlet problems of
+         * twice the length, whose even sine modes span the solution */
+        ret = dct_plan_init(&axis->dct, 2 * n, ASI_DCT_SINE);
+        axis->buffer = (double *) malloc(4 * n * sizeof(double));
+
+        if (axis->buffer == NULL && ret == ASI_EXIT_SUCCESS)
+        {
+            dct_plan_delete(&axis->dct);
+            ret = ASI_EXIT_FAILED_ALLOC;
+        }
+
+        for (k = 0; k < n; k++)
+        {
+            axis->eigen[k] = 2.0 - 2.0 * cos(M_PI * (2 * k + 1)
+                    / (2 * n + 1));
+        }
+    }
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        free(axis->eigen);
+        free(axis->buffer);
+        axis->eigen = axis->buffer = NULL;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of an axis
+ * @axis    [ I ] Axis to be deleted
+ */
+static void poisson_axis_delete(poisson_axis_type *axis)
+{
+    if (axis->eigen != NULL)
+    {
+        dct_plan_delete(&axis->dct);
+    }
+
+    free(axis->eigen);
+    free(axis->buffer);
+    axis->eigen = axis->buffer = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Expands count rows into the eigenvectors of the axis Laplacian. In-place
+ * operation (x == y) is allowed.
+ * @axis    [ I ] Axis
+ * @x       [ I ] Signals, row-major
+ * @y       [ O ] Coefficients, row-major
+ * @count   [ I ] Number of rows
+ */
+static void poisson_axis_forward(const poisson_axis_type *axis,
+        const double *x, double *y, int count)
+{
+    int j, k, r, c; /* Loop variables */
+    int n = axis->n;
+    int pair; /* Number of rows of the current pair */
+    double *buf; /* Mirrored row */
+
+    if (axis->buffer == NULL)
+    {
+        if (axis->bc0 == ASI_BC_NEUMANN)
+        {
+            dct_ii(&axis->dct, x, y, count);
+        }
+        else
+        {
+            dst_i(&axis->dct, x, y, count);
+        }
+        return;
+    }
+
+    for (r = 0; r < count; r += 2)
+    {
+        pair = r + 1 < count ? 2 : 1;
+
+        /* Mirror at the Neumann end, which becomes the centre */
+        for (c = 0; c < pair; c++)
+        {
+            buf = axis->buffer + 2 * c * n;
+
+            for (j = 0; j < n; j++)
+            {
+                if (axis->bc0 == ASI_BC_NEUMANN)
+                {
+                    buf[n + j] = x[(r + c) * n + j];
+                    buf[n - 1 - j] = x[(r + c) * n + j];
+                }
+                else
+                {
+                    buf[j] = x[(r + c) * n + j];
+                    buf[2 * n - 1 - j] = x[(r + c) * n + j];
+                }
+            }
+        }
+
+        dst_i(&axis->dct, axis->buffer, axis->buffer, pair);
+
+        for (c = 0; c < pair; c++)
+        {
+            buf = axis->buffer + 2 * c * n;
+
+            for (k = 0; k < n; k++)
+            {
+                y[(r + c) * n + k] = buf[2 * k];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Synthesises count rows from their eigenvector coefficients, the inverse of
+ * poisson_axis_forward. In-place operation (x == y) is allowed.
+ * @axis    [ I ] Axis
+ * @y       [ I ] Coefficients, row-major
+ * @x       [ O ] Signals, row-major
+ * @count   [ I ] Number of rows
+ */
+static void poisson_axis_inverse(const poisson_axis_type *axis,
+        const double *y, double *x, int count)
+{
+    int j, k, r, c; /* Loop variables */
+    int n = axis->n;
+    int pair; /* Number of rows of the current pair */
+    double *buf; /* Mirrored row */
+    double scale; /* Normalisation of the transform pair */
+
+    if (axis->buffer == NULL)
+    {
+        if (axis->bc0 == ASI_BC_NEUMANN)
+        {
+            dct_iii(&axis->dct, y, x, count);
+            scale = 2.0 / n;
+        }
+        else
+        {
+            dst_i(&axis->dct, y, x, count);
+            scale = 2.0 / (n + 1);
+        }
+
+        for (j = 0; j < count * n; j++)
+        {
+            x[j] *= scale;
+        }
+        return;
+    }
+
+    scale = 2.0 / (2 * n + 1);
+
+    for (r = 0; r < count; r += 2)
+    {
+        pair = r + 1 < count ? 2 : 1;
+
+        /* Odd modes vanish for mirrored signals */
+        for (c = 0; c < pair; c++)
+        {
+            buf = axis->buffer + 2 * c * n;
+
+            for (k = 0; k < n; k++)
+            {
+                buf[2 * k] = y[(r + c) * n + k];
+                buf[2 * k + 1] = 0.0;
+            }
+        }
+
+        dst_i(&axis->dct, axis->buffer, axis->buffer, pair);
+
+        for (c = 0; c < pair; c++)
+        {
+            buf = axis->buffer + 2 * c * n
+                + (axis->bc0 == ASI_BC_NEUMANN ? n : 0);
+
+            for (j = 0; j < n; j++)
+            {
+                x[(r + c) * n + j] = scale * buf[j];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a fast solver for the negative five-point Laplacian on a
+ * rectangle. A Neumann side mirrors the grid, a Dirichlet side couples the
+ * border pixels to known values that enter through the right-hand side.
+ * Sides are indexed by ASI_SIDE_LEFT, ASI_SIDE_RIGHT, ASI_SIDE_TOP and
+ * ASI_SIDE_BOTTOM. One axis is diagonalised by a transform, preferably one
+ * with equal conditions at both ends, the other one solved by tridiagonal
+ * eliminations whose pivots are precomputed per frequency.
+ * @plan    [ O ] Solver plan
+ * @width   [ I ] Rectangle width
+ * @height  [ I ] Rectangle height
+ * @bc      [ I ] Boundary condition of each side
+ */
+int poisson_plan_init(poisson_plan_type *plan, int width, int height,
+        const poisson_bc_enum bc[4])
+{
+    int i, k; /* Loop variables */
+    int nt, nl; /* Length of the transformed axis and of the lines */
+    poisson_bc_enum bt[2], bl[2]; /* Conditions of both axes */
+    double diag; /* Diagonal entry of the tridiagonal system */
+    double pivot; /* Pivot of the elimination */
+    double *inv; /* Inverse pivots of one line */
+    int ret; /* Return value */
+
+    if (width < 1 || height < 1)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    plan->width = width;
+    plan->height = height;
+    plan->work = NULL;
+
+    /* Transform along columns only if this avoids mixed ends */
+    plan->transposed = bc[ASI_SIDE_LEFT] != bc[ASI_SIDE_RIGHT]
+        && bc[ASI_SIDE_TOP] == bc[ASI_SIDE_BOTTOM];
+
+    nt = plan->transposed ? height : width;
+    nl = plan->transposed ? width : height;
+    bt[0] = bc[plan->transposed ? ASI_SIDE_TOP : ASI_SIDE_LEFT];
+    bt[1] = bc[plan->transposed ? ASI_SIDE_BOTTOM : ASI_SIDE_RIGHT];
+    bl[0] = bc[plan->transposed ? ASI_SIDE_LEFT : ASI_SIDE_TOP];
+    bl[1] = bc[plan->transposed ? ASI_SIDE_RIGHT : ASI_SIDE_BOTTOM];
+
+    plan->inv_pivot = (double *) malloc((size_t) nt * nl * sizeof(double));
+
+    if (plan->transposed)
+    {
+        plan->work = (double *) malloc((size_t) nt * nl * sizeof(double));
+    }
+
+    if (plan->inv_pivot == NULL || (plan->transposed && plan->work == NULL))
+    {
+        free(plan->inv_pivot);
+        free(plan->work);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    ret = poisson_axis_init(&plan->axis, nt, bt[0], bt[1]);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        free(plan->inv_pivot);
+        free(plan->work);
+        return ret;
+    }
+
+    /* Elimination of -u_(i-1) + (d_i + lambda_k) u_i - u_(i+1) with
+     * pivots p_i = d_i + lambda_k - 1 / p_(i-1). A vanishing pivot only
+     * occurs for the constant mode of a fully mirrored rectangle. Replacing
+     * it by 1 adds a symmetric rank one term, which keeps the solver usable
+     * as preconditioner and does not alter solutions of consistent
+     * systems. */
+    for (i = 0; i < nl; i++)
+    {
+        inv = plan->inv_pivot + i * nt;
+        diag = (i > 0 || bl[0] == ASI_BC_DIRICHLET)
+            + (i < nl - 1 || bl[1] == ASI_BC_DIRICHLET);
+
+        for (k = 0; k < nt; k++)
+        {
+            pivot = diag + plan->axis.eigen[k] - (i > 0 ? inv[k - nt] : 0.0);
+            inv[k] = pivot > 1e-12 ? 1.0 / pivot : 1.0;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of a solver plan
+ * @plan    [ I ] Plan to be deleted
+ */
+void poisson_plan_delete(poisson_plan_type *plan)
+{
+    poisson_axis_delete(&plan->axis);
+    free(plan->inv_pivot);
+    free(plan->work);
+    plan->inv_pivot = plan->work = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves L u = b on the rectangle of the plan. Lines along the transformed
+ * axis are expanded into eigenvectors of its one-dimensional Laplacian,
+ * which decouples L into one tridiagonal system per frequency. These are
+ * solved by sweeping over whole lines, so the elimination runs over
+ * contiguous memory. If all sides are mirrored, L is singular and one of
+ * its solutions is returned for consistent right-hand sides. The plan
+ * provides work memory, so it must not be shared between threads. In-place
+ * operation (b == u) is allowed.
+ * @plan    [ I ] Solver plan
+ * @b       [ I ] Right-hand side, row-major
+ * @u       [ O ] Solution, row-major
+ */
+void poisson_solve(const poisson_plan_type *plan, const double *b,
+        double *u)
+{
+    int i, j, k; /* Loop variables */
+    int w = plan->width, h = plan->height;
+    int nt = plan->axis.n, nl; /* Line length and number of lines */
+    const double *inv; /* Inverse pivots of a line */
+    double *data; /* Lines along the transformed axis */
+    double *line; /* Current line */
+
+    nl = w * h / nt;
+
+    if (plan->transposed)
+    {
+        data = plan->work;
+
+        for (i = 0; i < h; i++)
+        {
+            for (j = 0; j < w; j++)
+            {
+                data[j * h + i] = b[i * w + j];
+            }
+        }
+
+        poisson_axis_forward(&plan->axis, data, data, nl);
+    }
+    else
+    {
+        data = u;
+        poisson_axis_forward(&plan->axis, b, data, nl);
+    }
+
+    /* Forward elimination and back substitution for all frequencies */
+    for (i = 0; i < nl; i++)
+    {
+        line = data + i * nt;
+        inv = plan->inv_pivot + i * nt;
+
+        for (k = 0; k < nt; k++)
+        {
+            line[k] = (line[k] + (i > 0 ? line[k - nt] : 0.0)) * inv[k];
+        }
+    }
+
+    for (i = nl - 2; i >= 0; i--)
+    {
+        line = data + i * nt;
+        inv = plan->inv_pivot + i * nt;
+
+        for (k = 0; k < nt; k++)
+        {
+            line[k] += line[k + nt] * inv[k];
+        }
+    }
+
+    poisson_axis_inverse(&plan->axis, data, data, nl);
+
+    if (plan->transposed)
+    {
+        for (i = 0; i < h; i++)
+        {
+            for (j = 0; j < w; j++)
+            {
+                u[i * w + j] = data[j * h + i];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Preconditioner z = P L^-1 P r, where P restricts to the unknown pixels of
+ * the rectangle and L is its Laplacian with all pixels treated as unknown.
+ * Since the operator restricted to the unknowns is a principal submatrix of
+ * L, the two only differ by a correction of the rank of the number of known
+ * pixels inside the rectangle, which bounds the number of iterations
+ * (capacitance matrix method). Elsewhere z = r.
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void poisson_precond_apply(const preconditioner_type *pc,
+        const double *r, double *z)
+{
+    const poisson_window_type *win = (const poisson_window_type *) pc->data;
+    const diffusion_operator_type *op = win->op;
+    int i, j; /* Loop variables */
+    int w = win->plan->width, h = win->plan->height;
+    int k; /* Pixel index */
+
+    memcpy(z, r, op->n * sizeof(double));
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = (win->y0 + i) * op->width + win->x0 + j;
+            win->rect[i * w + j] = op->flags[k] & ASI_STENCIL_KNOWN
+                ? 0.0 : r[k];
+        }
+    }
+
+    poisson_solve(win->plan, win->rect, win->rect);
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = (win->y0 + i) * op->width + win->x0 + j;
+
+            if (!(op->flags[k] & ASI_STENCIL_KNOWN))
+            {
+                z[k] = win->rect[i * w + j];
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Checks whether all pixels of a row or column of the operator are known.
+ * @op      [ I ] Inpainting operator
+ * @start   [ I ] Index of the first pixel
+ * @stride  [ I ] Index distance of consecutive pixels
+ * @count   [ I ] Number of pixels
+ */
+static int poisson_line_known(const diffusion_operator_type op, int start,
+        int stride, int count)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k < count; k++)
+    {
+        if (!(op.flags[start + k * stride] & ASI_STENCIL_KNOWN))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves the inpainting problem of an operator, typically a window built by
+ * diffusion_operator_init_window, with the fast Poisson solver. Fully known
+ * border rows and columns, such as the boundary ring of a window, become
+ * Dirichlet sides of the rectangle they enclose, the other sides are
+ * mirrored. Without known pixels inside the rectangle, one direct solve is
+ * exact. With few of them, the direct solver preconditions conjugate
+ * gradients, otherwise plain conjugate gradients are used.
+ * @op      [ I ] Inpainting operator
+ * @u       [I/O] Known values and initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int poisson_window_solve(const diffusion_operator_type op, double *u,
+        int iter, double eps, solver_info_type *info)
+{
+    poisson_bc_enum bc[4]; /* Boundary conditions of the rectangle */
+    poisson_plan_type plan; /* Fast solver */
+    poisson_window_type win; /* Rectangle within the window */
+    preconditioner_type pc; /* Fast solver as preconditioner */
+    int x1, y1; /* End of the rectangle */
+    int w, h; /* Size of the rectangle */
+    int i, j; /* Loop variables */
+    int known; /* Number of known pixels inside the rectangle */
+    double *b; /* Right-hand side */
+    int ret; /* Return value */
+
+    if (info != NULL)
+    {
+        info->iterations = 0;
+        info->residual = 0.0;
+        info->residual_0 = 0.0;
+    }
+
+    bc[ASI_SIDE_LEFT] = poisson_line_known(op, 0, op.width, op.height)
+        ? ASI_BC_DIRICHLET : ASI_BC_NEUMANN;
+    bc[ASI_SIDE_RIGHT] = poisson_line_known(op, op.width - 1, op.width,
+            op.height) ? ASI_BC_DIRICHLET : ASI_BC_NEUMANN;
+    bc[ASI_SIDE_TOP] = poisson_line_known(op, 0, 1, op.width)
+        ? ASI_BC_DIRICHLET : ASI_BC_NEUMANN;
+    bc[ASI_SIDE_BOTTOM] = poisson_line_known(op, (op.height - 1) * op.width,
+            1, op.width) ? ASI_BC_DIRICHLET : ASI_BC_NEUMANN;
+
+    win.op = &op;
+    win.x0 = bc[ASI_SIDE_LEFT] == ASI_BC_DIRICHLET;
+    win.y0 = bc[ASI_SIDE_TOP] == ASI_BC_DIRICHLET;
+    x1 = op.width - (bc[ASI_SIDE_RIGHT] == ASI_BC_DIRICHLET);
+    y1 = op.height - (bc[ASI_SIDE_BOTTOM] == ASI_BC_DIRICHLET);
+    w = x1 - win.x0;
+    h = y1 - win.y0;
+
+    /* Nothing to solve if all pixels are known */
+    if (w <= 0 || h <= 0)
+    {
+        return ASI_EXIT_SUCCESS;
+    }
+
+    known = 0;
+    for (i = win.y0; i < y1; i++)
+    {
+        for (j = win.x0; j < x1; j++)
+        {
+            known += op.flags[i * op.width + j] & ASI_STENCIL_KNOWN;
+        }
+    }
+
+    b = (double *) simd_calloc(op.n, sizeof(double));
+
+    if (b == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    diffusion_operator_rhs(op, u, b);
+
+    if (known > POISSON_CAPACITANCE_MAX)
+    {
+        ret = preconditioned_conjugate_gradient(diffusion_linear_operator(&op),
+                NULL, b, u, iter, eps, info);
+        free(b);
+        return ret;
+    }
+
+    ret = poisson_plan_init(&plan, w, h, bc);
+    win.plan = &plan;
+    win.rect = (double *) malloc((size_t) w * h * sizeof(double));
+
+    if (ret != ASI_EXIT_SUCCESS || win.rect == NULL)
+    {
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            poisson_plan_delete(&plan);
+            ret = ASI_EXIT_FAILED_ALLOC;
+        }
+        free(win.rect);
+        free(b);
+        return ret;
+    }
+
+    if (known == 0)
+    {
+        /* Direct solve, the rectangle holds all unknowns */
+        for (i = 0; i < h; i++)
+        {
+            memcpy(win.rect + i * w, b + (win.y0 + i) * op.width + win.x0,
+                    w * sizeof(double));
+        }
+
+        poisson_solve(&plan, win.rect, win.rect);
+
+        for (i = 0; i < h; i++)
+        {
+            memcpy(u + (win.y0 + i) * op.width + win.x0, win.rect + i * w,
+                    w * sizeof(double));
+        }
+
+        if (info != NULL)
+        {
+            info->iterations = 1;
+        }
+
+        ret = ASI_EXIT_SUCCESS;
+    }
+    else
+    {
+        precond_init(&pc, NULL, ASI_PRECOND_CUSTOM, 0);
+        pc.apply = poisson_precond_apply;
+        pc.data = &win;
+
+        ret = preconditioned_conjugate_gradient(diffusion_linear_operator(&op),
+                &pc, b, u, iter, eps, info);
+    }
+
+    poisson_plan_delete(&plan);
+    free(win.rect);
+    free(b);
+
+    return ret;
+}
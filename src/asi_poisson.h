@@ -0,0 +1,69 @@
+#ifndef _ASI_POISSON_H_
+#define _ASI_POISSON_H_
+
+#include "asi_image.h"
+#include "asi_sparse.h"
+#include "asi_diffusion.h"
+#include "asi_dct.h"
+
+/* Boundary conditions of a rectangle side */
+typedef enum poisson_bc
+{
+    ASI_BC_NEUMANN, /* Mirrored boundary, no neighbour beyond the side */
+    ASI_BC_DIRICHLET /* Known values beyond the side */
+} poisson_bc_enum;
+
+/* Sides of a rectangle, index into the boundary condition array */
+#define ASI_SIDE_LEFT 0
+#define ASI_SIDE_RIGHT 1
+#define ASI_SIDE_TOP 2
+#define ASI_SIDE_BOTTOM 3
+
+/*
+ * One axis of a separable Poisson solve. The one-dimensional Laplacian with
+ * the given end conditions is diagonalised by a trigonometric transform:
+ * Neumann-Neumann by the DCT-II, Dirichlet-Dirichlet by the DST-I and mixed
+ * ends by the DST-I of the signal mirrored at its Neumann end.
+ */
+typedef struct poisson_axis
+{
+    int n; /* Number of grid points */
+    poisson_bc_enum bc0; /* Condition at the start */
+    poisson_bc_enum bc1; /* Condition at the end */
+    dct_plan_type dct; /* Transform plan */
+    double *eigen; /* Eigenvalues of the one-dimensional Laplacian */
+    double *buffer; /* Pair of mirrored rows of mixed ends */
+} poisson_axis_type;
+
+/*
+ * Fast direct solver for the five-point negative Laplacian on a rectangle,
+ * where every side is either mirrored or adjacent to known values. One axis
+ * is diagonalised by a transform, the other one solved by tridiagonal
+ * eliminations per frequency.
+ */
+typedef struct poisson_plan
+{
+    int width; /* Rectangle width */
+    int height; /* Rectangle height */
+    int transposed; /* Flag to transform columns instead of rows */
+    poisson_axis_type axis; /* Transformed axis */
+    double *inv_pivot; /* Inverse elimination pivots, one line per row */
+    double *work; /* Transposed data, NULL if not transposed */
+} poisson_plan_type;
+
+/* Initialise a solver for a rectangle with boundary conditions per side */
+int poisson_plan_init(poisson_plan_type *plan, int width, int height,
+        const poisson_bc_enum bc[4]);
+
+/* Free memory */
+void poisson_plan_delete(poisson_plan_type *plan);
+
+/* Solve L u = b on the rectangle */
+void poisson_solve(const poisson_plan_type *plan, const double *b,
+        double *u);
+
+/* Solve the inpainting problem of a window operator */
+int poisson_window_solve(const diffusion_operator_type op, double *u,
+        int iter, double eps, solver_info_type *info);
+
+#endif
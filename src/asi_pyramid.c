@@ -0,0 +1,309 @@
+#include "asi_pyramid.h"
+#include "asi_mask.h"
+#include <stdlib.h>
+#include <math.h>
+
+/* Level of the push-pull pyramid */
+typedef struct pyramid_level
+{
+    int width; /* Level width */
+    int height; /* Level height */
+    double *value; /* Weighted mean of known values */
+    double *weight; /* Confidence in [0, 1], 0 without known values */
+} pyramid_level_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Push step: averages the known values of 2x2 blocks, weighted by their
+ * confidence. The confidence of the coarse pixel is the clamped sum of the
+ * fine confidences.
+ * @fine    [ I ] Fine level
+ * @coarse  [ O ] Coarse level
+ */
+static void pyramid_push(const pyramid_level_type *fine,
+        pyramid_level_type *coarse)
+{
+    int i, j, di, dj, k; /* Loop variables */
+    int fi, fj; /* Fine coordinates */
+    double sum_w, sum_v; /* Sums of weights and weighted values */
+
+    for (i = 0; i < coarse->height; i++)
+    {
+        for (j = 0; j < coarse->width; j++)
+        {
+            sum_w = 0.0;
+            sum_v = 0.0;
+
+            for (di = 0; di < 2; di++)
+            {
+                fi = 2 * i + di;
+
+                for (dj = 0; dj < 2; dj++)
+                {
+                    fj = 2 * j + dj;
+
+                    if (fi < fine->height && fj < fine->width)
+                    {
+                        k = fi * fine->width + fj;
+                        sum_w += fine->weight[k];
+                        sum_v += fine->weight[k] * fine->value[k];
+                    }
+                }
+            }
+
+            k = i * coarse->width + j;
+            coarse->weight[k] = sum_w < 1.0 ? sum_w : 1.0;
+            coarse->value[k] = sum_w > 0.0 ? sum_v / sum_w : 0.0;
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Pull step: blends every fine pixel without full confidence with the
+ * bilinear interpolation of the already filled coarse level.
+ * @coarse  [ I ] Filled coarse level
+ * @fine    [I/O] Fine level, filled on output
+ */
+static void pyramid_pull(const pyramid_level_type *coarse,
+        pyramid_level_type *fine)
+{
+    int i, j, k; /* Loop variables */
+    int ci, cj, ci1, cj1; /* Coarse neighbours */
+    double y, x, fy, fx; /* Coarse coordinates and interpolation weights */
+    double interp; /* Interpolated coarse value */
+    const double *cv = coarse->value;
+    int cw = coarse->width;
+
+    for (i = 0; i < fine->height; i++)
+    {
+        /* Pixel centres of the fine level in coarse coordinates */
+        y = 0.5 * i - 0.25;
+        y = y < 0.0 ? 0.0 : (y > coarse->height - 1 ? coarse->height - 1 : y);
+        ci = (int) y;
+        ci1 = ci + 1 < coarse->height ? ci + 1 : ci;
+        fy = y - ci;
+
+        for (j = 0; j < fine->width; j++)
+        {
+            k = i * fine->width + j;
+
+            if (fine->weight[k] >= 1.0)
+            {
+                continue;
+            }
+
+            x = 0.5 * j - 0.25;
+            x = x < 0.0 ? 0.0 : (x > cw - 1 ? cw - 1 : x);
+            cj = (int) x;
+            cj1 = cj + 1 < cw ? cj + 1 : cj;
+            fx = x - cj;
+
+            interp = (1.0 - fy) * ((1.0 - fx) * cv[ci * cw + cj]
+                        + fx * cv[ci * cw + cj1])
+                + fy * ((1.0 - fx) * cv[ci1 * cw + cj]
+                        + fx * cv[ci1 * cw + cj1]);
+
+            fine->value[k] = fine->weight[k] * fine->value[k]
+                + (1.0 - fine->weight[k]) * interp;
+            fine->weight[k] = 1.0;
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Push-pull interpolation of an RGB image, one channel at a time. The
+ * channels share the mask and therefore the confidences of the pyramid.
+ * @image   [ I ] Double-valued RGB image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [ O ] Double-valued RGB result
+ */
+static int pyramid_push_pull_rgb(const image_type image,
+        const image_type mask, image_type u)
+{
+    image_type f_c, u_c; /* Channel of the image and of the result */
+    const double *f = (const double *) image.data;
+    double *ud = (double *) u.data;
+    int n, c, k; /* Number of pixels and loop variables */
+    int ret; /* Return value */
+
+    n = image.width * image.height;
+
+    ret = image_init(&f_c, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = image_init(&u_c, image.width, image.height, ASI_DTYPE_DOUBLE);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        image_delete(&f_c);
+        return ret;
+    }
+
+    for (c = 0; c < 3 && ret == ASI_EXIT_SUCCESS; c++)
+    {
+        for (k = 0; k < n; k++)
+        {
+            ((double *) f_c.data)[k] = f[3 * k + c];
+        }
+
+        ret = pyramid_push_pull(f_c, mask, u_c);
+
+        for (k = 0; k < n && ret == ASI_EXIT_SUCCESS; k++)
+        {
+            ud[3 * k + c] = ((double *) u_c.data)[k];
+        }
+    }
+
+    image_delete(&f_c);
+    image_delete(&u_c);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Push-pull interpolation: known values are averaged down a pyramid of
+ * halved resolutions until every level is covered, then holes are filled on
+ * the way up by interpolating from the coarser level. Costs O(N) and
+ * produces a smooth fill of large holes, e.g. as initial guess of the
+ * iterative inpainting solvers. Known pixels of u are set to the image
+ * values, unknown pixels to the interpolation. RGB images are interpolated
+ * per channel.
+ * @image   [ I ] Double-valued greyscale or RGB image providing the known
+ *                pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [ O ] Double-valued result of the same type as the image
+ */
+int pyramid_push_pull(const image_type image, const image_type mask,
+        image_type u)
+{
+    pyramid_level_type *levels; /* Pyramid, 0 is the finest level */
+    int num_levels; /* Number of levels */
+    int w, h, l, i, j, k; /* Dimensions and loop variables */
+    const double *f = (const double *) image.data;
+    double *ud = (double *) u.data;
+    int ret = ASI_EXIT_SUCCESS; /* Return value */
+
+    if ((image.dtype != ASI_DTYPE_DOUBLE
+                && image.dtype != ASI_DTYPE_DOUBLE_RGB)
+            || u.dtype != image.dtype)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (image.dtype == ASI_DTYPE_DOUBLE_RGB)
+    {
+        return pyramid_push_pull_rgb(image, mask, u);
+    }
+
+    /* Count levels down to a single pixel */
+    w = image.width;
+    h = image.height;
+    num_levels = 1;
+
+    while (w > 1 || h > 1)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        num_levels++;
+    }
+
+    levels = (pyramid_level_type *) calloc(num_levels,
+            sizeof(pyramid_level_type));
+
+    if (levels == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* The finest level works in place on u */
+    levels[0].width = image.width;
+    levels[0].height = image.height;
+    levels[0].value = ud;
+    levels[0].weight = (double *) malloc((size_t) image.width * image.height
+            * sizeof(double));
+
+    if (levels[0].weight == NULL)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+        goto cleanup;
+    }
+
+    for (l = 1; l < num_levels; l++)
+    {
+        levels[l].width = (levels[l-1].width + 1) / 2;
+        levels[l].height = (levels[l-1].height + 1) / 2;
+        k = levels[l].width * levels[l].height;
+        levels[l].value = (double *) malloc(k * sizeof(double));
+        levels[l].weight = (double *) malloc(k * sizeof(double));
+
+        if (levels[l].value == NULL || levels[l].weight == NULL)
+        {
+            ret = ASI_EXIT_FAILED_ALLOC;
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < image.height; i++)
+    {
+        for (j = 0; j < image.width; j++)
+        {
+            k = i * image.width + j;
+
+            if (mask_get(mask, i, j))
+            {
+                ud[k] = f[k];
+                levels[0].weight[k] = 1.0;
+            }
+            else
+            {
+                ud[k] = 0.0;
+                levels[0].weight[k] = 0.0;
+            }
+        }
+    }
+
+    for (l = 1; l < num_levels; l++)
+    {
+        pyramid_push(&levels[l-1], &levels[l]);
+    }
+
+    /* Without any known value the coarsest level stays zero */
+    levels[num_levels - 1].weight[0] = 1.0;
+
+    for (l = num_levels - 2; l >= 0; l--)
+    {
+        pyramid_pull(&levels[l+1], &levels[l]);
+    }
+
+cleanup:
+    free(levels[0].weight);
+    for (l = 1; l < num_levels; l++)
+    {
+        free(levels[l].value);
+        free(levels[l].weight);
+    }
+    free(levels);
+
+    return ret;
+}
@@ -0,0 +1,10 @@
+#ifndef _ASI_PYRAMID_H_
+#define _ASI_PYRAMID_H_
+
+#include "asi_image.h"
+
+/* Fill unknown pixels by push-pull interpolation on a mask pyramid */
+int pyramid_push_pull(const image_type image, const image_type mask,
+        image_type u);
+
+#endif
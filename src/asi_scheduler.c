@@ -0,0 +1,718 @@
+#include "asi_scheduler.h"
+#include "asi_image.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Initial number of slots of a worker deque */
+#define SCHEDULER_RING_CAPACITY 256
+
+/* Initial capacity of the successor list of a task */
+#define SCHEDULER_SUCCESSORS 4
+
+/* Worker run by the current thread, NULL outside of any scheduler */
+static _Thread_local scheduler_worker_type *scheduler_self = NULL;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates the buffer of a deque.
+ * @capacity    [ I ] Number of slots, a power of two
+ */
+static scheduler_ring_type *scheduler_ring_new(long capacity)
+{
+    scheduler_ring_type *ring; /* New buffer */
+    long k; /* Loop variable */
+
+    ring = (scheduler_ring_type *) malloc(sizeof(scheduler_ring_type)
+            + capacity * sizeof(_Atomic(scheduler_task_type *)));
+
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+
+    ring->capacity = capacity;
+    ring->retired = NULL;
+    ring->slots = (_Atomic(scheduler_task_type *) *) (ring + 1);
+
+    for (k = 0; k < capacity; k++)
+    {
+        atomic_init(&ring->slots[k], NULL);
+    }
+
+    return ring;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Pushes a ready task to the bottom of the deque of a worker. Only called by
+ * the thread owning the worker. When the buffer is full it is replaced by
+ * one of twice the size; the old buffer is kept until the scheduler is
+ * deleted since thieves may still read from it.
+ * @worker  [I/O] Worker owned by the calling thread
+ * @task    [ I ] Ready task
+ */
+static int scheduler_push(scheduler_worker_type *worker,
+        scheduler_task_type *task)
+{
+    scheduler_ring_type *ring, *grown; /* Current and enlarged buffer */
+    long top, bottom; /* Deque range */
+    long k; /* Loop variable */
+
+    bottom = atomic_load_explicit(&worker->bottom, memory_order_relaxed);
+    top = atomic_load_explicit(&worker->top, memory_order_acquire);
+    ring = atomic_load_explicit(&worker->ring, memory_order_relaxed);
+
+    if (bottom - top > ring->capacity - 1)
+    {
+        grown = scheduler_ring_new(2 * ring->capacity);
+
+        if (grown == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        for (k = top; k < bottom; k++)
+        {
+            atomic_store_explicit(&grown->slots[k & (grown->capacity - 1)],
+                    atomic_load_explicit(
+                        &ring->slots[k & (ring->capacity - 1)],
+                        memory_order_relaxed),
+                    memory_order_relaxed);
+        }
+
+        grown->retired = ring;
+        atomic_store_explicit(&worker->ring, grown, memory_order_release);
+        ring = grown;
+    }
+
+    atomic_store_explicit(&ring->slots[bottom & (ring->capacity - 1)], task,
+            memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&worker->bottom, bottom + 1, memory_order_relaxed);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Pops the newest task from the bottom of the deque of a worker. Only called
+ * by the thread owning the worker.
+ * @worker  [I/O] Worker owned by the calling thread
+ */
+static scheduler_task_type *scheduler_pop(scheduler_worker_type *worker)
+{
+    scheduler_ring_type *ring; /* Current buffer */
+    scheduler_task_type *task; /* Popped task */
+    long top, bottom; /* Deque range */
+
+    bottom = atomic_load_explicit(&worker->bottom, memory_order_relaxed) - 1;
+    ring = atomic_load_explicit(&worker->ring, memory_order_relaxed);
+    atomic_store_explicit(&worker->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&worker->top, memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        /* Deque was empty */
+        atomic_store_explicit(&worker->bottom, bottom + 1,
+                memory_order_relaxed);
+        return NULL;
+    }
+
+    task = atomic_load_explicit(&ring->slots[bottom & (ring->capacity - 1)],
+            memory_order_relaxed);
+
+    if (top == bottom)
+    {
+        /* Last task, race against thieves */
+        if (!atomic_compare_exchange_strong_explicit(&worker->top, &top,
+                    top + 1, memory_order_seq_cst, memory_order_relaxed))
+        {
+            task = NULL;
+        }
+
+        atomic_store_explicit(&worker->bottom, bottom + 1,
+                memory_order_relaxed);
+    }
+
+    return task;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Steals the oldest task from the top of the deque of another worker.
+ * @victim  [I/O] Worker to steal from
+ * @retry   [ O ] Set to 1 if the deque was not empty but the steal lost a race
+ */
+static scheduler_task_type *scheduler_steal(scheduler_worker_type *victim,
+        int *retry)
+{
+    scheduler_ring_type *ring; /* Current buffer */
+    scheduler_task_type *task; /* Stolen task */
+    long top, bottom; /* Deque range */
+
+    top = atomic_load_explicit(&victim->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    bottom = atomic_load_explicit(&victim->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+    {
+        return NULL;
+    }
+
+    ring = atomic_load_explicit(&victim->ring, memory_order_acquire);
+    task = atomic_load_explicit(&ring->slots[top & (ring->capacity - 1)],
+            memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&victim->top, &top,
+                top + 1, memory_order_seq_cst, memory_order_relaxed))
+    {
+        *retry = 1;
+        return NULL;
+    }
+
+    return task;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Finds a task for a worker: its own newest task first, otherwise the oldest
+ * task of another worker, starting at a random victim.
+ * @worker  [I/O] Worker owned by the calling thread
+ */
+static scheduler_task_type *scheduler_find(scheduler_worker_type *worker)
+{
+    scheduler_type *sched = worker->sched;
+    scheduler_task_type *task; /* Found task */
+    int start, v, k; /* Victim selection */
+    int retry; /* Flag for steals that lost a race */
+
+    task = scheduler_pop(worker);
+
+    if (task != NULL || sched->num_threads == 1)
+    {
+        return task;
+    }
+
+    do
+    {
+        retry = 0;
+
+        worker->seed = worker->seed * 1103515245u + 12345u;
+        start = (int) ((worker->seed >> 16) % (unsigned) sched->num_threads);
+
+        for (k = 0; k < sched->num_threads; k++)
+        {
+            v = (start + k) % sched->num_threads;
+
+            if (v == worker->id)
+            {
+                continue;
+            }
+
+            task = scheduler_steal(&sched->workers[v], &retry);
+
+            if (task != NULL)
+            {
+                return task;
+            }
+        }
+    }
+    while (retry);
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Records an event idle workers wait for and wakes them up.
+ * @sched   [I/O] Scheduler
+ * @all     [ I ] Flag to wake all idle workers instead of one
+ */
+static void scheduler_notify(scheduler_type *sched, int all)
+{
+    atomic_fetch_add(&sched->epoch, 1);
+
+    if (atomic_load(&sched->sleepers) > 0)
+    {
+        pthread_mutex_lock(&sched->lock);
+
+        if (all)
+        {
+            pthread_cond_broadcast(&sched->wake);
+        }
+        else
+        {
+            pthread_cond_signal(&sched->wake);
+        }
+
+        pthread_mutex_unlock(&sched->lock);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Makes a task whose predecessors have completed available to the workers.
+ * Runs it right away if the deque cannot grow.
+ * @worker  [I/O] Worker owned by the calling thread
+ * @task    [ I ] Ready task
+ */
+static void scheduler_ready(scheduler_worker_type *worker,
+        scheduler_task_type *task);
+
+/*
+ * Executes a task, releases its successors and updates the completion count.
+ * @worker  [I/O] Worker owned by the calling thread
+ * @task    [I/O] Task to be executed
+ */
+static void scheduler_run(scheduler_worker_type *worker,
+        scheduler_task_type *task)
+{
+    scheduler_type *sched = worker->sched;
+    int s; /* Loop variable */
+
+    task->fn(task->arg, task->index);
+
+    for (s = 0; s < task->num_successors; s++)
+    {
+        if (atomic_fetch_sub(&task->successors[s]->pending, 1) == 1)
+        {
+            scheduler_ready(worker, task->successors[s]);
+        }
+    }
+
+    /* Last task wakes up the waiting thread */
+    if (atomic_fetch_sub(&sched->unfinished, 1) == 1)
+    {
+        scheduler_notify(sched, 1);
+    }
+
+    return;
+}
+
+static void scheduler_ready(scheduler_worker_type *worker,
+        scheduler_task_type *task)
+{
+    if (scheduler_push(worker, task) != ASI_EXIT_SUCCESS)
+    {
+        scheduler_run(worker, task);
+        return;
+    }
+
+    scheduler_notify(worker->sched, 0);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Puts a worker to sleep until the event counter moves past a given value.
+ * @sched   [I/O] Scheduler
+ * @epoch   [ I ] Event counter observed before searching for work
+ * @done    [ I ] Flag to also return once all tasks have completed
+ */
+static void scheduler_idle(scheduler_type *sched, long epoch, int done)
+{
+    pthread_mutex_lock(&sched->lock);
+    atomic_fetch_add(&sched->sleepers, 1);
+
+    while (atomic_load(&sched->epoch) == epoch
+            && !atomic_load(&sched->shutdown)
+            && !(done && atomic_load(&sched->unfinished) == 0))
+    {
+        pthread_cond_wait(&sched->wake, &sched->lock);
+    }
+
+    atomic_fetch_sub(&sched->sleepers, 1);
+    pthread_mutex_unlock(&sched->lock);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Main loop of a worker thread.
+ * @arg     [I/O] Worker
+ */
+static void *scheduler_worker(void *arg)
+{
+    scheduler_worker_type *worker = (scheduler_worker_type *) arg;
+    scheduler_type *sched = worker->sched;
+    scheduler_task_type *task; /* Task to be executed */
+    long epoch; /* Event counter before searching for work */
+
+    scheduler_self = worker;
+
+    while (!atomic_load(&sched->shutdown))
+    {
+        epoch = atomic_load(&sched->epoch);
+        task = scheduler_find(worker);
+
+        if (task != NULL)
+        {
+            scheduler_run(worker, task);
+        }
+        else
+        {
+            scheduler_idle(sched, epoch, 0);
+        }
+    }
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Joins the running worker threads and frees the deques and the memory of a
+ * scheduler, also one that was only partly initialised.
+ * @sched   [I/O] Scheduler
+ * @started [ I ] Number of threads including the caller, 1 for none spawned
+ * @rings   [ I ] Number of workers whose deque was allocated
+ */
+static void scheduler_teardown(scheduler_type *sched, int started, int rings)
+{
+    scheduler_ring_type *ring, *retired; /* Buffers of a deque */
+    int t; /* Loop variable */
+
+    if (started > 1)
+    {
+        /* Workers check the flag under the lock before sleeping */
+        atomic_store(&sched->shutdown, 1);
+        pthread_mutex_lock(&sched->lock);
+        pthread_cond_broadcast(&sched->wake);
+        pthread_mutex_unlock(&sched->lock);
+
+        for (t = 1; t < started; t++)
+        {
+            pthread_join(sched->threads[t], NULL);
+        }
+    }
+
+    for (t = 0; t < rings; t++)
+    {
+        ring = atomic_load(&sched->workers[t].ring);
+
+        while (ring != NULL)
+        {
+            retired = ring->retired;
+            free(ring);
+            ring = retired;
+        }
+    }
+
+    pthread_cond_destroy(&sched->wake);
+    pthread_mutex_destroy(&sched->lock);
+
+    free(sched->workers);
+    free(sched->threads);
+    sched->workers = NULL;
+    sched->threads = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a work-stealing scheduler. The calling thread owns worker 0
+ * and takes part in the execution while waiting, hence num_threads - 1
+ * worker threads are spawned. If one cannot be created, the ones already
+ * running are stopped and everything is released again.
+ * @sched       [ O ] Scheduler
+ * @num_threads [ I ] Number of threads, <= 0 uses all online cores
+ */
+int scheduler_init(scheduler_type *sched, int num_threads)
+{
+    int t; /* Loop variable */
+
+    if (num_threads <= 0)
+    {
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+
+    sched->num_threads = num_threads;
+    atomic_init(&sched->unfinished, 0);
+    atomic_init(&sched->epoch, 0);
+    atomic_init(&sched->sleepers, 0);
+    atomic_init(&sched->shutdown, 0);
+
+    sched->threads = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+    sched->workers = (scheduler_worker_type *) malloc(num_threads
+            * sizeof(scheduler_worker_type));
+
+    if (sched->threads == NULL || sched->workers == NULL)
+    {
+        free(sched->threads);
+        free(sched->workers);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->wake, NULL);
+
+    for (t = 0; t < num_threads; t++)
+    {
+        sched->workers[t].sched = sched;
+        sched->workers[t].id = t;
+        sched->workers[t].seed = 2654435761u * (unsigned) (t + 1);
+        atomic_init(&sched->workers[t].top, 0);
+        atomic_init(&sched->workers[t].bottom, 0);
+        atomic_init(&sched->workers[t].ring,
+                scheduler_ring_new(SCHEDULER_RING_CAPACITY));
+
+        if (atomic_load(&sched->workers[t].ring) == NULL)
+        {
+            scheduler_teardown(sched, 1, t);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+    }
+
+    for (t = 1; t < num_threads; t++)
+    {
+        if (pthread_create(&sched->threads[t], NULL, scheduler_worker,
+                    &sched->workers[t]) != 0)
+        {
+            /* Stop the threads started so far, they steal from all rings */
+            scheduler_teardown(sched, t, num_threads);
+            return ASI_EXIT_FAILURE;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Terminates worker threads and frees memory of a scheduler. Tasks must not
+ * be pending.
+ * @sched   [ I ] Scheduler to be deleted
+ */
+void scheduler_delete(scheduler_type *sched)
+{
+    if (sched->threads == NULL)
+    {
+        return;
+    }
+
+    scheduler_teardown(sched, sched->num_threads, sched->num_threads);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a task without dependencies.
+ * @task    [ O ] Task
+ * @fn      [ I ] Task function
+ * @arg     [I/O] Argument passed to the task function
+ * @index   [ I ] Index passed to the task function
+ */
+void scheduler_task_init(scheduler_task_type *task, scheduler_task_fn fn,
+        void *arg, int index)
+{
+    task->fn = fn;
+    task->arg = arg;
+    task->index = index;
+    atomic_init(&task->pending, 1);
+    task->num_predecessors = 0;
+    task->successors = NULL;
+    task->num_successors = 0;
+    task->max_successors = 0;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees the successor list of a task.
+ * @task    [I/O] Task
+ */
+void scheduler_task_delete(scheduler_task_type *task)
+{
+    free(task->successors);
+    task->successors = NULL;
+    task->num_successors = 0;
+    task->max_successors = 0;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Adds a dependency: task does not start before predecessor has completed.
+ * Must be called before the predecessor is submitted.
+ * @task        [I/O] Dependent task
+ * @predecessor [I/O] Task to be completed first
+ */
+int scheduler_task_depend(scheduler_task_type *task,
+        scheduler_task_type *predecessor)
+{
+    scheduler_task_type **successors; /* Enlarged successor list */
+    int capacity; /* Enlarged capacity */
+
+    if (predecessor->num_successors == predecessor->max_successors)
+    {
+        capacity = predecessor->max_successors == 0
+            ? SCHEDULER_SUCCESSORS : 2 * predecessor->max_successors;
+        successors = (scheduler_task_type **) realloc(predecessor->successors,
+                capacity * sizeof(scheduler_task_type *));
+
+        if (successors == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+
+        predecessor->successors = successors;
+        predecessor->max_successors = capacity;
+    }
+
+    predecessor->successors[predecessor->num_successors++] = task;
+    task->num_predecessors++;
+    atomic_fetch_add(&task->pending, 1);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Rearms a completed task with its dependencies, such that a dependency
+ * graph can be submitted again, e.g. once per iteration of a solver.
+ * @task    [I/O] Completed task
+ */
+void scheduler_task_reset(scheduler_task_type *task)
+{
+    atomic_store(&task->pending, task->num_predecessors + 1);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Submits a task. It becomes ready once all its predecessors have completed.
+ * Tasks are submitted either by the thread that created the scheduler or by
+ * running tasks, and must stay valid until scheduler_wait returns.
+ * @sched   [I/O] Scheduler
+ * @task    [I/O] Task
+ */
+void scheduler_submit(scheduler_type *sched, scheduler_task_type *task)
+{
+    scheduler_worker_type *worker; /* Worker of the calling thread */
+
+    worker = scheduler_self != NULL && scheduler_self->sched == sched
+        ? scheduler_self : &sched->workers[0];
+
+    atomic_fetch_add(&sched->unfinished, 1);
+
+    if (atomic_fetch_sub(&task->pending, 1) == 1)
+    {
+        scheduler_ready(worker, task);
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Executes tasks on the calling thread until all submitted tasks have
+ * completed. Called by the thread that created the scheduler, possibly from
+ * within a task of another scheduler.
+ * @sched   [I/O] Scheduler
+ */
+void scheduler_wait(scheduler_type *sched)
+{
+    scheduler_worker_type *outer; /* Worker of an enclosing scheduler */
+    scheduler_task_type *task; /* Task to be executed */
+    long epoch; /* Event counter before searching for work */
+
+    outer = scheduler_self;
+    scheduler_self = &sched->workers[0];
+
+    while (atomic_load(&sched->unfinished) > 0)
+    {
+        epoch = atomic_load(&sched->epoch);
+        task = scheduler_find(&sched->workers[0]);
+
+        if (task != NULL)
+        {
+            scheduler_run(&sched->workers[0], task);
+        }
+        else
+        {
+            scheduler_idle(sched, epoch, 1);
+        }
+    }
+
+    scheduler_self = outer;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Executes fn(arg, index) for all indices 0, ..., count-1 as independent
+ * tasks and returns once all of them have completed. Idle threads steal
+ * indices from busy ones, so tasks of uneven cost are balanced. Called from
+ * within a task of the same scheduler, the loop runs inline, since waiting
+ * would include the calling task itself.
+ * @sched   [I/O] Scheduler
+ * @count   [ I ] Number of indices
+ * @fn      [ I ] Task function
+ * @arg     [I/O] Argument passed to the task function
+ */
+void scheduler_parallel_for(scheduler_type *sched, int count,
+        scheduler_task_fn fn, void *arg)
+{
+    scheduler_task_type *tasks; /* One task per index */
+    int index; /* Loop variable */
+
+    tasks = sched->num_threads == 1 || count == 1
+        || (scheduler_self != NULL && scheduler_self->sched == sched) ? NULL
+        : (scheduler_task_type *) malloc(count * sizeof(scheduler_task_type));
+
+    /* Serial execution avoids synchronisation overhead */
+    if (tasks == NULL)
+    {
+        for (index = 0; index < count; index++)
+        {
+            fn(arg, index);
+        }
+
+        return;
+    }
+
+    /* Submit in reverse such that the calling thread starts at index 0 */
+    for (index = count - 1; index >= 0; index--)
+    {
+        scheduler_task_init(&tasks[index], fn, arg, index);
+        scheduler_submit(sched, &tasks[index]);
+    }
+
+    scheduler_wait(sched);
+    free(tasks);
+
+    return;
+}
@@ -0,0 +1,87 @@
+#ifndef _ASI_SCHEDULER_H_
+#define _ASI_SCHEDULER_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* Function executed by a task for its index */
+typedef void (*scheduler_task_fn)(void *arg, int index);
+
+/* Task with dependencies, the memory is owned by the submitting code */
+typedef struct scheduler_task
+{
+    scheduler_task_fn fn; /* Task function */
+    void *arg; /* Argument passed to the task function */
+    int index; /* Index passed to the task function */
+    atomic_int pending; /* Unfinished predecessors, plus one until submitted */
+    int num_predecessors; /* Number of predecessors */
+    struct scheduler_task **successors; /* Tasks depending on this one */
+    int num_successors; /* Number of successors */
+    int max_successors; /* Capacity of the successor array */
+} scheduler_task_type;
+
+/* Circular buffer of a work-stealing deque */
+typedef struct scheduler_ring
+{
+    long capacity; /* Number of slots, a power of two */
+    struct scheduler_ring *retired; /* Smaller buffer replaced by this one */
+    _Atomic(scheduler_task_type *) *slots; /* Task slots */
+} scheduler_ring_type;
+
+/* Worker with a deque of ready tasks, the owner pushes and pops at the
+ * bottom while other workers steal from the top */
+typedef struct scheduler_worker
+{
+    struct scheduler *sched; /* Scheduler the worker belongs to */
+    int id; /* Worker index, 0 is the thread that created the scheduler */
+    unsigned int seed; /* State of the victim selection */
+    atomic_long top; /* Index of the oldest task */
+    atomic_long bottom; /* Index after the newest task */
+    _Atomic(scheduler_ring_type *) ring; /* Current buffer */
+} scheduler_worker_type;
+
+/* Work-stealing task scheduler with persistent worker threads */
+typedef struct scheduler
+{
+    pthread_t *threads; /* Worker threads */
+    scheduler_worker_type *workers; /* Workers including the calling thread */
+    int num_threads; /* Number of threads including the calling thread */
+    atomic_long unfinished; /* Submitted tasks that have not completed */
+    atomic_long epoch; /* Counter of events idle workers wait for */
+    atomic_int sleepers; /* Number of idle workers */
+    atomic_int shutdown; /* Flag to terminate worker threads */
+    pthread_mutex_t lock; /* Protects sleeping on the condition below */
+    pthread_cond_t wake; /* Signals new tasks or completion */
+} scheduler_type;
+
+/* Initialise scheduler, num_threads <= 0 uses all online cores */
+int scheduler_init(scheduler_type *sched, int num_threads);
+
+/* Terminate worker threads and free memory */
+void scheduler_delete(scheduler_type *sched);
+
+/* Initialise a task executing fn(arg, index) */
+void scheduler_task_init(scheduler_task_type *task, scheduler_task_fn fn,
+        void *arg, int index);
+
+/* Free the successor list of a task */
+void scheduler_task_delete(scheduler_task_type *task);
+
+/* Let task start only after predecessor has completed */
+int scheduler_task_depend(scheduler_task_type *task,
+        scheduler_task_type *predecessor);
+
+/* Rearm a completed task such that its dependency graph can run again */
+void scheduler_task_reset(scheduler_task_type *task);
+
+/* Submit a task, it runs once all of its predecessors have completed */
+void scheduler_submit(scheduler_type *sched, scheduler_task_type *task);
+
+/* Execute tasks until all submitted tasks have completed */
+void scheduler_wait(scheduler_type *sched);
+
+/* Execute fn(arg, index) for index = 0, ..., count-1 in parallel */
+void scheduler_parallel_for(scheduler_type *sched, int count,
+        scheduler_task_fn fn, void *arg);
+
+#endif
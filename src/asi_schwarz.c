@@ -0,0 +1,1019 @@
+#include "asi_schwarz.h"
+#include "asi_diffusion.h"
+#include "asi_poisson.h"
+#include "asi_scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+/* Maximum number of colour classes of a rectangular decomposition */
+#define SCHWARZ_MAX_COLORS 4
+
+/* Number of SOR sweeps between residual checks of a subdomain solve */
+#define SCHWARZ_SOR_CHECK 8
+
+/* Memory budget of the factor cache owned by a single solve in bytes */
+#define SCHWARZ_CACHE_BYTES ((size_t) 256 << 20)
+
+/* State of a subdomain for lazy updates */
+typedef struct schwarz_lazy
+{
+    double *values; /* Window values neighbours may change, after the solve */
+    double residual; /* RMS residual per unknown of the last local solution */
+} schwarz_lazy_type;
+
+/* Shared state of a Schwarz solve, handed to the scheduler tasks */
+typedef struct schwarz_context
+{
+    const schwarz_params_type *params; /* Solver parameters */
+    subdomain_type *subdomains; /* Subdomains */
+    int num_subdomains; /* Number of subdomains */
+    int *order; /* Subdomain indices sorted by colour */
+    int write_core; /* Flag to write back the core region only */
+    diffusion_operator_type op; /* Matrix-free inpainting operator */
+    const double *f; /* Known pixel values */
+    const double *u_src; /* Iterate the subdomain solves read from */
+    double *u; /* Iterate the subdomain solves write to */
+    int width; /* Image width */
+    int height; /* Image height */
+    int num_bands; /* Number of row bands for residual computation */
+    double *partial; /* Partial sums of the residual per row band */
+    cholesky_cache_type *cache; /* Cache of subdomain factors */
+    int overlap; /* Overlap after clamping to the decomposition */
+    schwarz_lazy_type *lazy; /* Lazy update state per subdomain, or NULL */
+    double lazy_eps; /* Current tolerance of lazy updates */
+    atomic_long solved; /* Subdomain solves of the current sweep */
+    atomic_long skipped; /* Subdomain solves skipped so far */
+    int sweep; /* Current sweep, reported in telemetry records */
+    scheduler_type *sched; /* Scheduler of the solve */
+    atomic_int status; /* First error code raised by a task */
+} schwarz_context_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets default parameters of the Schwarz solver.
+ * @params  [ O ] Solver parameters
+ */
+void schwarz_params_default(schwarz_params_type *params)
+{
+    params->variant = ASI_SCHWARZ_MULTIPLICATIVE;
+    params->subdomains_x = 4;
+    params->subdomains_y = 4;
+    params->overlap = 8;
+    params->num_threads = 0;
+    params->max_sweeps = 200;
+    params->eps = 1e-6;
+    params->local_iter = 500;
+    params->local_eps = 1e-3;
+    params->local_solver = ASI_SCHWARZ_LOCAL_CG;
+    params->local_omega = 0.0;
+    params->cache = NULL;
+    params->partition = ASI_PARTITION_UNIFORM;
+    params->lazy_eps = 0.0;
+    params->telemetry = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Records an error raised by a task. Tasks run concurrently, the first error
+ * is kept and later ones are dropped.
+ * @ctx     [I/O] Schwarz context
+ * @ret     [ I ] Error code
+ */
+static void schwarz_fail(schwarz_context_type *ctx, int ret)
+{
+    int expected = ASI_EXIT_SUCCESS; /* Status before the first error */
+
+    atomic_compare_exchange_strong(&ctx->status, &expected, ret);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Computes the squared residual norm of the inpainting equation on a band of
+ * rows: the Laplacian of u at unknown pixels.
+ * @arg     [I/O] Schwarz context
+ * @index   [ I ] Row band index
+ */
+static void schwarz_residual_band(void *arg, int index)
+{
+    schwarz_context_type *ctx = (schwarz_context_type *) arg;
+    int i0, i1; /* Row range */
+
+    i0 = (int) ((long) index * ctx->height / ctx->num_bands);
+    i1 = (int) ((long) (index + 1) * ctx->height / ctx->num_bands);
+
+    ctx->partial[index] = diffusion_operator_residual(ctx->op, ctx->f,
+            ctx->u, NULL, i0, i1);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Euclidean norm of the inpainting residual of the current iterate.
+ * @ctx     [I/O] Schwarz context
+ * @sched   [I/O] Task scheduler
+ */
+static double schwarz_residual_norm(schwarz_context_type *ctx,
+        scheduler_type *sched)
+{
+    int b; /* Loop variable */
+    double sum; /* Sum of squares */
+
+    scheduler_parallel_for(sched, ctx->num_bands, schwarz_residual_band, ctx);
+
+    sum = 0.0;
+    for (b = 0; b < ctx->num_bands; b++)
+    {
+        sum += ctx->partial[b];
+    }
+
+    return sqrt(sum);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Red-black SOR on a subdomain until the residual is reduced by the local
+ * tolerance, checked every SCHWARZ_SOR_CHECK sweeps.
+ * @op      [ I ] Inpainting operator of the subdomain
+ * @u       [I/O] Local iterate including boundary data
+ * @iter    [ I ] Maximum number of sweeps
+ * @eps     [ I ] Relative residual tolerance
+ * @omega   [ I ] Relaxation parameter, <= 0 for an estimate
+ * @sched   [I/O] Scheduler splitting half-sweeps into bands; inside a
+ *                subdomain task the sweeps run on the calling thread
+ */
+static int schwarz_local_sor(const diffusion_operator_type op, double *u,
+        int iter, double eps, double omega, scheduler_type *sched)
+{
+    image_type u_img; /* Local iterate as image */
+    double res, res_0; /* Squared residual norms */
+    int sweep, sweeps; /* Loop variable, sweeps per residual check */
+    int size; /* Larger side of the subdomain */
+    int ret; /* Return value */
+
+    u_img.data = u;
+    u_img.width = op.width;
+    u_img.height = op.height;
+    u_img.dtype = ASI_DTYPE_DOUBLE;
+
+    /* Optimal relaxation for the Laplacian on a square of this size */
+    if (omega <= 0.0)
+    {
+        size = op.width > op.height ? op.width : op.height;
+        omega = 2.0 / (1.0 + sin(M_PI / (size + 1)));
+    }
+
+    res_0 = diffusion_operator_residual(op, u, u, NULL, 0, op.height);
+    res = res_0;
+
+    for (sweep = 0; sweep < iter && res > eps * eps * res_0;
+            sweep += sweeps)
+    {
+        sweeps = iter - sweep < SCHWARZ_SOR_CHECK
+            ? iter - sweep : SCHWARZ_SOR_CHECK;
+
+        ret = diffusion_sor_red_black(op, u_img, NULL, omega, sweeps, 0,
+                sched);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            return ret;
+        }
+
+        res = diffusion_operator_residual(op, u, u, NULL, 0, op.height);
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reports a timed phase of a sweep to the telemetry sink.
+ * @ctx     [ I ] Schwarz context
+ * @phase   [ I ] Phase name
+ * @start   [ I ] Start time of the phase
+ * @bytes   [ I ] Estimated memory traffic of the phase
+ */
+static void schwarz_phase(const schwarz_context_type *ctx, const char *phase,
+        double start, double bytes)
+{
+    telemetry_record_type record; /* Phase record */
+
+    if (ctx->params->telemetry == NULL)
+    {
+        return;
+    }
+
+    record = telemetry_record(ASI_TELEMETRY_PHASE, "schwarz");
+    record.phase = phase;
+    record.iteration = ctx->sweep;
+    record.seconds = telemetry_time() - start;
+    record.bytes = bytes;
+    telemetry_emit(ctx->params->telemetry, &record);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Conjugate gradient method on a subdomain.
+ * @op      [ I ] Inpainting operator of the subdomain
+ * @u       [I/O] Local iterate including boundary data
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ */
+static int schwarz_local_cg(const diffusion_operator_type *op, double *u,
+        int iter, double eps)
+{
+    double *b; /* Right-hand side */
+    int ret; /* Return value */
+
+    b = (double *) malloc(op->n * sizeof(double));
+
+    if (b == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    diffusion_operator_rhs(*op, u, b);
+    ret = conjugate_gradient(diffusion_linear_operator(op), b, u, iter, eps);
+    free(b);
+
+    /* Inexact subdomain solves are fine */
+    return ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Direct subdomain solve with a banded Cholesky factor. The factor depends
+ * on the window and the mask only, so it is computed in the first sweep and
+ * later sweeps reuse it from the cache.
+ * @cache   [I/O] Factor cache
+ * @op      [ I ] Inpainting operator of the subdomain
+ * @ox, oy  [ I ] Image coordinates of the window origin
+ * @u       [I/O] Local iterate including boundary data
+ */
+static int schwarz_local_cholesky(cholesky_cache_type *cache,
+        const diffusion_operator_type op, int ox, int oy, double *u)
+{
+    banded_cholesky_type local; /* Uncached factor */
+    const banded_cholesky_type *factor; /* Factor of the operator */
+    double *b; /* Right-hand side */
+    int ret; /* Return value */
+
+    b = (double *) malloc(op.n * sizeof(double));
+
+    if (b == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    diffusion_operator_rhs(op, u, b);
+
+    ret = cholesky_cache_get(cache, op, ox, oy, &local, &factor);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = banded_cholesky_solve(factor, b, u);
+
+        if (factor == &local)
+        {
+            banded_cholesky_delete(&local);
+        }
+    }
+
+    free(b);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Compares the window values of a subdomain that neighbouring subdomains
+ * may write to with the ones its last solve left behind, or stores them.
+ * These are the boundary ring and the overlap bands; the interior of the
+ * core further than the overlap from any neighbour is only written by the
+ * subdomain itself.
+ * @ctx     [ I ] Schwarz context
+ * @sub     [ I ] Subdomain
+ * @u       [I/O] Local iterate of the window
+ * @ox, oy  [ I ] Image coordinates of the window origin
+ * @w, h    [ I ] Window size
+ * @values  [I/O] Stored values
+ * @store   [ I ] Flag to store the values instead of comparing them
+ */
+static double schwarz_lazy_change(const schwarz_context_type *ctx,
+        const subdomain_type *sub, const double *u, int ox, int oy, int w,
+        int h, double *values, int store)
+{
+    int px0, px1, py0, py1; /* Region private to the subdomain */
+    int i, j, n; /* Loop variables */
+    double change; /* Largest change */
+
+    px0 = sub->x0 > 0 ? sub->x0 + ctx->overlap : 0;
+    px1 = sub->x1 < ctx->width ? sub->x1 - ctx->overlap : ctx->width;
+    py0 = sub->y0 > 0 ? sub->y0 + ctx->overlap : 0;
+    py1 = sub->y1 < ctx->height ? sub->y1 - ctx->overlap : ctx->height;
+
+    change = 0.0;
+    n = 0;
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            if (oy + i >= py0 && oy + i < py1 && ox + j >= px0
+                    && ox + j < px1)
+            {
+                continue;
+            }
+
+            if (store)
+            {
+                values[n] = u[i * w + j];
+            }
+            else if (fabs(u[i * w + j] - values[n]) > change)
+            {
+                change = fabs(u[i * w + j] - values[n]);
+            }
+
+            n++;
+        }
+    }
+
+    return change;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Records the state of a subdomain after its solve for lazy updates: the
+ * values neighbours may change and the residual of the local solution. The
+ * residual is the root mean square over the unknown pixels, so it is
+ * compared with the grey-value tolerance independently of the window size.
+ * @ctx     [I/O] Schwarz context
+ * @sub     [ I ] Subdomain
+ * @lazy    [I/O] Lazy update state of the subdomain
+ * @op      [ I ] Inpainting operator of the window
+ * @ox, oy  [ I ] Image coordinates of the window origin
+ * @u       [ I ] Local solution
+ */
+static int schwarz_lazy_record(const schwarz_context_type *ctx,
+        const subdomain_type *sub, schwarz_lazy_type *lazy,
+        const diffusion_operator_type op, int ox, int oy, const double *u)
+{
+    int k, unknowns; /* Loop variable, number of unknown pixels */
+
+    if (lazy->values == NULL)
+    {
+        lazy->values = (double *) malloc(op.n * sizeof(double));
+
+        if (lazy->values == NULL)
+        {
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+    }
+
+    schwarz_lazy_change(ctx, sub, u, ox, oy, op.width, op.height,
+            lazy->values, 1);
+
+    unknowns = 0;
+
+    for (k = 0; k < op.n; k++)
+    {
+        unknowns += !(op.flags[k] & ASI_STENCIL_KNOWN);
+    }
+
+    /* Direct solves leave rounding errors only */
+    lazy->residual = ctx->params->local_solver == ASI_SCHWARZ_LOCAL_CHOLESKY
+        || unknowns == 0 ? 0.0 : sqrt(diffusion_operator_residual(op, u, u,
+                    NULL, 0, op.height) / unknowns);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves the inpainting problem on one subdomain with Dirichlet data taken
+ * from the current iterate and writes the result back. The extended region
+ * together with a ring of boundary data forms a window of the image, whose
+ * local operator treats the ring as known pixels.
+ * @arg     [I/O] Schwarz context
+ * @index   [ I ] Index within the current phase
+ */
+static void schwarz_solve_subdomain(void *arg, int index)
+{
+    schwarz_context_type *ctx = (schwarz_context_type *) arg;
+    const schwarz_params_type *params = ctx->params;
+    const subdomain_type *sub;
+    schwarz_lazy_type *lazy = NULL; /* Lazy update state */
+    diffusion_operator_type op; /* Local inpainting operator */
+    telemetry_record_type record; /* Telemetry record of the solve */
+    double start; /* Start time of the solve */
+    long written = 0; /* Number of pixels written back */
+    int i; /* Loop variable */
+    int gi, gj; /* Global coordinates */
+    int ox, oy; /* Image coordinates of the local window origin */
+    int wx0, wx1, wy0, wy1; /* Region to be written back */
+    double *u; /* Local iterate */
+    int ret; /* Return value */
+
+    sub = &ctx->subdomains[ctx->order[index]];
+    start = params->telemetry != NULL ? telemetry_time() : 0.0;
+
+    ret = diffusion_operator_init_window(&op, ctx->op, sub->ex0, sub->ex1,
+            sub->ey0, sub->ey1, &ox, &oy);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        schwarz_fail(ctx, ret);
+        return;
+    }
+
+    u = (double *) malloc(op.n * sizeof(double));
+
+    if (u == NULL)
+    {
+        diffusion_operator_delete(&op);
+        schwarz_fail(ctx, ASI_EXIT_FAILED_ALLOC);
+        return;
+    }
+
+    /* Gather local iterate and boundary data */
+    for (i = 0; i < op.height; i++)
+    {
+        memcpy(u + i * op.width, ctx->u_src + (oy + i) * ctx->width + ox,
+                op.width * sizeof(double));
+    }
+
+    /* Skip the solve if it would reproduce the data left by the last one */
+    if (ctx->lazy != NULL)
+    {
+        lazy = &ctx->lazy[ctx->order[index]];
+
+        if (lazy->values != NULL && lazy->residual <= ctx->lazy_eps
+                && schwarz_lazy_change(ctx, sub, u, ox, oy, op.width,
+                    op.height, lazy->values, 0) <= ctx->lazy_eps)
+        {
+            atomic_fetch_add(&ctx->skipped, 1);
+            free(u);
+            diffusion_operator_delete(&op);
+            return;
+        }
+    }
+
+    atomic_fetch_add(&ctx->solved, 1);
+
+    if (params->local_solver == ASI_SCHWARZ_LOCAL_SOR)
+    {
+        ret = schwarz_local_sor(op, u, params->local_iter, params->local_eps,
+                params->local_omega, ctx->sched);
+    }
+    else if (params->local_solver == ASI_SCHWARZ_LOCAL_POISSON)
+    {
+        ret = poisson_window_solve(op, u, params->local_iter,
+                params->local_eps, NULL);
+        ret = ret == ASI_EXIT_NOT_CONVERGED ? ASI_EXIT_SUCCESS : ret;
+    }
+    else if (params->local_solver == ASI_SCHWARZ_LOCAL_CHOLESKY)
+    {
+        ret = schwarz_local_cholesky(ctx->cache, op, ox, oy, u);
+    }
+    else
+    {
+        ret = schwarz_local_cg(&op, u, params->local_iter, params->local_eps);
+    }
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        schwarz_fail(ctx, ret);
+    }
+
+    /* Write back the extended region or, for additive Schwarz, the core */
+    if (ctx->write_core)
+    {
+        wx0 = sub->x0;
+        wx1 = sub->x1;
+        wy0 = sub->y0;
+        wy1 = sub->y1;
+    }
+    else
+    {
+        wx0 = sub->ex0;
+        wx1 = sub->ex1;
+        wy0 = sub->ey0;
+        wy1 = sub->ey1;
+    }
+
+    for (gi = wy0; gi < wy1; gi++)
+    {
+        for (gj = wx0; gj < wx1; gj++)
+        {
+            if (!(ctx->op.flags[gi * ctx->width + gj] & ASI_STENCIL_KNOWN))
+            {
+                ctx->u[gi * ctx->width + gj]
+                    = u[(gi - oy) * op.width + gj - ox];
+                written++;
+            }
+        }
+    }
+
+    if (lazy != NULL && ret == ASI_EXIT_SUCCESS)
+    {
+        ret = schwarz_lazy_record(ctx, sub, lazy, op, ox, oy, u);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            schwarz_fail(ctx, ret);
+        }
+    }
+
+    /* Traffic of gathering the window and writing the solution back */
+    if (params->telemetry != NULL)
+    {
+        record = telemetry_record(ASI_TELEMETRY_SUBDOMAIN, "schwarz");
+        record.iteration = ctx->sweep;
+        record.subdomain = ctx->order[index];
+        record.seconds = telemetry_time() - start;
+        record.bytes = (2.0 * op.n + 2.0 * written) * sizeof(double)
+            + op.n * sizeof(unsigned char);
+        telemetry_emit(params->telemetry, &record);
+    }
+
+    free(u);
+    diffusion_operator_delete(&op);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Splits the image into a grid of overlapping subdomains and assigns colours
+ * such that subdomains of the same colour neither overlap nor touch each
+ * other's boundary data: red / black along strips, four colours for a
+ * two-dimensional grid. The grid is either regular or, for the adaptive
+ * strategy, a jagged grid of equal estimated work per subdomain. Both keep
+ * every subdomain at least 2 * overlap + 1 pixels wide and high.
+ * @ctx      [I/O] Schwarz context
+ * @mask     [ I ] Inpainting mask
+ * @nx       [ I ] Number of subdomains in x direction
+ * @ny       [ I ] Number of subdomains in y direction
+ * @overlap  [ I ] Overlap in pixels
+ * @strategy [ I ] Partitioning strategy
+ */
+static int schwarz_decompose(schwarz_context_type *ctx, const image_type mask,
+        int nx, int ny, int overlap, partition_strategy_enum strategy)
+{
+    int bx, by, c, n; /* Loop variables */
+    int *row_bounds = NULL, *col_bounds = NULL; /* Adaptive grid */
+    subdomain_type *sub;
+    int ret; /* Return value */
+
+    ctx->num_subdomains = nx * ny;
+    ctx->subdomains = (subdomain_type *) malloc(ctx->num_subdomains
+            * sizeof(subdomain_type));
+    ctx->order = (int *) malloc(ctx->num_subdomains * sizeof(int));
+
+    if (ctx->subdomains == NULL || ctx->order == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (strategy == ASI_PARTITION_ADAPTIVE)
+    {
+        row_bounds = (int *) malloc((ny + 1) * sizeof(int));
+        col_bounds = (int *) malloc(ny * (nx + 1) * sizeof(int));
+
+        ret = row_bounds == NULL || col_bounds == NULL
+            ? ASI_EXIT_FAILED_ALLOC
+            : partition_adaptive(mask, nx, ny, 2 * overlap + 1, row_bounds,
+                    col_bounds);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            free(row_bounds);
+            free(col_bounds);
+            return ret;
+        }
+    }
+
+    for (by = 0; by < ny; by++)
+    {
+        for (bx = 0; bx < nx; bx++)
+        {
+            sub = &ctx->subdomains[by * nx + bx];
+
+            if (strategy == ASI_PARTITION_ADAPTIVE)
+            {
+                sub->x0 = col_bounds[by * (nx + 1) + bx];
+                sub->x1 = col_bounds[by * (nx + 1) + bx + 1];
+                sub->y0 = row_bounds[by];
+                sub->y1 = row_bounds[by + 1];
+            }
+            else
+            {
+                sub->x0 = (int) ((long) bx * ctx->width / nx);
+                sub->x1 = (int) ((long) (bx + 1) * ctx->width / nx);
+                sub->y0 = (int) ((long) by * ctx->height / ny);
+                sub->y1 = (int) ((long) (by + 1) * ctx->height / ny);
+            }
+
+            sub->ex0 = sub->x0 - overlap < 0 ? 0 : sub->x0 - overlap;
+            sub->ex1 = sub->x1 + overlap > ctx->width
+                ? ctx->width : sub->x1 + overlap;
+            sub->ey0 = sub->y0 - overlap < 0 ? 0 : sub->y0 - overlap;
+            sub->ey1 = sub->y1 + overlap > ctx->height
+                ? ctx->height : sub->y1 + overlap;
+
+            sub->color = (bx % 2) + 2 * (by % 2);
+        }
+    }
+
+    free(row_bounds);
+    free(col_bounds);
+
+    /* Sort subdomains by colour */
+    n = 0;
+    for (c = 0; c < SCHWARZ_MAX_COLORS; c++)
+    {
+        for (bx = 0; bx < ctx->num_subdomains; bx++)
+        {
+            if (ctx->subdomains[bx].color == c)
+            {
+                ctx->order[n++] = bx;
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Builds the task graph of one multiplicative sweep. A subdomain reads its
+ * extended region plus a ring of boundary data and writes its extended
+ * region, so it only has to wait for overlapping subdomains of smaller
+ * colour instead of for the whole previous colour phase.
+ * @ctx     [I/O] Schwarz context
+ * @tasks   [ O ] One task per entry of the colour order
+ */
+static int schwarz_task_graph(schwarz_context_type *ctx,
+        scheduler_task_type *tasks)
+{
+    const subdomain_type *a, *b; /* Subdomains of a pair */
+    int k, l; /* Loop variables */
+    int ret; /* Return value */
+
+    for (k = 0; k < ctx->num_subdomains; k++)
+    {
+        scheduler_task_init(&tasks[k], schwarz_solve_subdomain, ctx, k);
+    }
+
+    for (k = 0; k < ctx->num_subdomains; k++)
+    {
+        a = &ctx->subdomains[ctx->order[k]];
+
+        for (l = k + 1; l < ctx->num_subdomains; l++)
+        {
+            b = &ctx->subdomains[ctx->order[l]];
+
+            if (a->color == b->color
+                    || a->ex0 - 1 >= b->ex1 || b->ex0 >= a->ex1 + 1
+                    || a->ey0 - 1 >= b->ey1 || b->ey0 >= a->ey1 + 1)
+            {
+                continue;
+            }
+
+            ret = scheduler_task_depend(&tasks[l], &tasks[k]);
+
+            if (ret != ASI_EXIT_SUCCESS)
+            {
+                return ret;
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting with the alternating Schwarz method. The
+ * image is split into overlapping rectangular subdomains on which the
+ * inpainting problem is solved with Dirichlet data from the neighbouring
+ * subdomains. The multiplicative variant processes subdomains colour by
+ * colour, the additive variant solves all subdomains on the previous iterate
+ * and keeps the core regions (restricted additive Schwarz). Subdomain solves
+ * are tasks of a work-stealing scheduler; in the multiplicative variant a
+ * subdomain starts as soon as its overlapping neighbours of smaller colour
+ * are done, which gives the same result as processing colour by colour.
+ * With lazy updates, a subdomain is only solved again once the data its
+ * neighbours write into its window moved by more than params.lazy_eps
+ * grey values since its last solve, or if the RMS residual per unknown of
+ * that solve exceeded params.lazy_eps. A telemetry sink in params.telemetry
+ * receives one record per sweep, per subdomain solve and per phase.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @u       [I/O] Initial guess on input, reconstruction on output
+ * @params  [ I ] Solver parameters
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int schwarz_inpainting(const image_type image, const image_type mask,
+        image_type u, const schwarz_params_type params,
+        schwarz_info_type *info)
+{
+    schwarz_context_type ctx; /* Shared state of the subdomain solves */
+    cholesky_cache_type cache; /* Factor cache of this solve */
+    scheduler_type sched; /* Task scheduler */
+    scheduler_task_type *tasks = NULL; /* Subdomain tasks of one sweep */
+    double *u_old = NULL; /* Previous iterate for additive Schwarz */
+    telemetry_record_type record; /* Telemetry record of a sweep */
+    double start, sweep_start; /* Start times of the setup and a sweep */
+    double residual_bytes; /* Memory traffic of a residual evaluation */
+    double res, res_0; /* Residual norms */
+    int nx, ny, overlap; /* Decomposition */
+    int min_core; /* Smallest core size */
+    int k, sweep; /* Loop variables */
+    int ret; /* Return value */
+
+    /* Check data types and dimensions */
+    if (image.dtype != ASI_DTYPE_DOUBLE || u.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != u.width || image.height != u.height
+            || image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    if (params.subdomains_x < 1 || params.subdomains_y < 1
+            || params.overlap < 0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    start = telemetry_time();
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.params = &params;
+    atomic_init(&ctx.status, ASI_EXIT_SUCCESS);
+    ctx.width = image.width;
+    ctx.height = image.height;
+    ctx.f = (const double *) image.data;
+    ctx.u = (double *) u.data;
+    ctx.u_src = ctx.u;
+
+    /* Clamp decomposition such that same-coloured subdomains stay apart */
+    nx = params.subdomains_x > ctx.width ? ctx.width : params.subdomains_x;
+    ny = params.subdomains_y > ctx.height ? ctx.height : params.subdomains_y;
+    overlap = params.overlap;
+
+    if (nx > 1)
+    {
+        min_core = ctx.width / nx;
+        overlap = (min_core - 1) / 2 < overlap ? (min_core - 1) / 2 : overlap;
+    }
+    if (ny > 1)
+    {
+        min_core = ctx.height / ny;
+        overlap = (min_core - 1) / 2 < overlap ? (min_core - 1) / 2 : overlap;
+    }
+
+    /* Without a cache from the caller, factors are reused across sweeps */
+    ctx.cache = params.cache;
+
+    if (params.local_solver == ASI_SCHWARZ_LOCAL_CHOLESKY
+            && ctx.cache == NULL)
+    {
+        ret = cholesky_cache_init(&cache, SCHWARZ_CACHE_BYTES);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            return ret;
+        }
+
+        ctx.cache = &cache;
+    }
+
+    ret = scheduler_init(&sched, params.num_threads);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        if (ctx.cache == &cache)
+        {
+            cholesky_cache_delete(&cache);
+        }
+
+        return ret;
+    }
+
+    ctx.sched = &sched;
+    ctx.num_bands = sched.num_threads * 4 > ctx.height
+        ? ctx.height : sched.num_threads * 4;
+    ctx.partial = (double *) malloc(ctx.num_bands * sizeof(double));
+
+    if (ctx.partial == NULL)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+        goto cleanup;
+    }
+
+    ret = diffusion_operator_init(&ctx.op, mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        goto cleanup;
+    }
+
+    ret = schwarz_decompose(&ctx, mask, nx, ny, overlap, params.partition);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        goto cleanup;
+    }
+
+    ctx.overlap = overlap;
+    ctx.lazy_eps = params.lazy_eps;
+    atomic_init(&ctx.solved, 0);
+    atomic_init(&ctx.skipped, 0);
+
+    if (params.lazy_eps > 0.0)
+    {
+        ctx.lazy = (schwarz_lazy_type *) calloc(ctx.num_subdomains,
+                sizeof(schwarz_lazy_type));
+
+        if (ctx.lazy == NULL)
+        {
+            ret = ASI_EXIT_FAILED_ALLOC;
+            goto cleanup;
+        }
+    }
+
+    /* Impose known pixel values */
+    for (k = 0; k < ctx.op.n; k++)
+    {
+        if (ctx.op.flags[k] & ASI_STENCIL_KNOWN)
+        {
+            ctx.u[k] = ctx.f[k];
+        }
+    }
+
+    if (params.variant == ASI_SCHWARZ_ADDITIVE)
+    {
+        u_old = (double *) malloc((size_t) ctx.width * ctx.height
+                * sizeof(double));
+
+        if (u_old == NULL)
+        {
+            ret = ASI_EXIT_FAILED_ALLOC;
+            goto cleanup;
+        }
+
+        ctx.u_src = u_old;
+        ctx.write_core = 1;
+    }
+    else
+    {
+        tasks = (scheduler_task_type *) calloc(ctx.num_subdomains,
+                sizeof(scheduler_task_type));
+
+        ret = tasks == NULL ? ASI_EXIT_FAILED_ALLOC
+            : schwarz_task_graph(&ctx, tasks);
+
+        if (ret != ASI_EXIT_SUCCESS)
+        {
+            goto cleanup;
+        }
+    }
+
+    res_0 = schwarz_residual_norm(&ctx, &sched);
+    res = res_0 > 0.0 ? 1.0 : 0.0;
+
+    /* The residual reads u, f and the stencil flags once */
+    residual_bytes = (double) ctx.op.n * (2 * sizeof(double)
+            + sizeof(unsigned char));
+    ctx.sweep = 0;
+    schwarz_phase(&ctx, "setup", start, -1.0);
+
+    for (sweep = 0; sweep < params.max_sweeps && res > params.eps; sweep++)
+    {
+        ctx.sweep = sweep + 1;
+        sweep_start = start = telemetry_time();
+        atomic_store(&ctx.solved, 0);
+
+        if (params.variant == ASI_SCHWARZ_ADDITIVE)
+        {
+            memcpy(u_old, ctx.u, (size_t) ctx.width * ctx.height
+                    * sizeof(double));
+
+            scheduler_parallel_for(&sched, ctx.num_subdomains,
+                    schwarz_solve_subdomain, &ctx);
+        }
+        else if (ctx.num_subdomains == 1)
+        {
+            /* Outside a task, the local solver may use all threads */
+            schwarz_solve_subdomain(&ctx, 0);
+        }
+        else
+        {
+            /* Reverse order lets the calling thread start with colour 0 */
+            for (k = ctx.num_subdomains - 1; k >= 0; k--)
+            {
+                scheduler_task_reset(&tasks[k]);
+                scheduler_submit(&sched, &tasks[k]);
+            }
+
+            scheduler_wait(&sched);
+        }
+
+        if (atomic_load(&ctx.status) != ASI_EXIT_SUCCESS)
+        {
+            ret = atomic_load(&ctx.status);
+            goto cleanup;
+        }
+
+        /* A sweep without solves cannot make progress: tighten tolerance */
+        if (atomic_load(&ctx.solved) == 0)
+        {
+            ctx.lazy_eps *= 0.1;
+        }
+
+        schwarz_phase(&ctx, "subdomains", start, -1.0);
+        start = telemetry_time();
+        res = schwarz_residual_norm(&ctx, &sched) / res_0;
+        schwarz_phase(&ctx, "residual", start, residual_bytes);
+
+        if (params.telemetry != NULL)
+        {
+            record = telemetry_record(ASI_TELEMETRY_ITERATION, "schwarz");
+            record.iteration = ctx.sweep;
+            record.residual = res;
+            record.seconds = telemetry_time() - sweep_start;
+            telemetry_emit(params.telemetry, &record);
+        }
+    }
+
+    if (info != NULL)
+    {
+        info->sweeps = sweep;
+        info->residual = res;
+        info->skipped = atomic_load(&ctx.skipped);
+    }
+
+    ret = res > params.eps ? ASI_EXIT_NOT_CONVERGED : ASI_EXIT_SUCCESS;
+
+cleanup:
+    scheduler_delete(&sched);
+
+    if (tasks != NULL)
+    {
+        for (k = 0; k < ctx.num_subdomains; k++)
+        {
+            scheduler_task_delete(&tasks[k]);
+        }
+    }
+
+    if (ctx.lazy != NULL)
+    {
+        for (k = 0; k < ctx.num_subdomains; k++)
+        {
+            free(ctx.lazy[k].values);
+        }
+    }
+
+    free(ctx.lazy);
+    free(tasks);
+    free(u_old);
+    diffusion_operator_delete(&ctx.op);
+    free(ctx.partial);
+    free(ctx.subdomains);
+    free(ctx.order);
+
+    if (ctx.cache == &cache)
+    {
+        cholesky_cache_delete(&cache);
+    }
+
+    return ret;
+}
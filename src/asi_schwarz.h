@@ -0,0 +1,69 @@
+#ifndef _ASI_SCHWARZ_H_
+#define _ASI_SCHWARZ_H_
+
+#include "asi_image.h"
+#include "asi_cholesky.h"
+#include "asi_partition.h"
+#include "asi_telemetry.h"
+
+/* Supported Schwarz variants */
+typedef enum schwarz_variant
+{
+    ASI_SCHWARZ_MULTIPLICATIVE, /* Coloured alternating Schwarz */
+    ASI_SCHWARZ_ADDITIVE /* Restricted additive Schwarz */
+} schwarz_variant_enum;
+
+/* Supported subdomain solvers */
+typedef enum schwarz_local_solver
+{
+    ASI_SCHWARZ_LOCAL_CG, /* Conjugate gradients */
+    ASI_SCHWARZ_LOCAL_SOR, /* Red-black successive over-relaxation */
+    ASI_SCHWARZ_LOCAL_POISSON, /* Fast Poisson solver, CG for dense masks */
+    ASI_SCHWARZ_LOCAL_CHOLESKY /* Cached banded Cholesky, small subdomains */
+} schwarz_local_solver_enum;
+
+/* Parameters of the Schwarz domain decomposition solver */
+typedef struct schwarz_params
+{
+    schwarz_variant_enum variant; /* Multiplicative or additive Schwarz */
+    int subdomains_x; /* Number of subdomains in x direction */
+    int subdomains_y; /* Number of subdomains in y direction */
+    int overlap; /* Overlap of neighbouring subdomains in pixels */
+    int num_threads; /* Number of threads, <= 0 uses all online cores */
+    int max_sweeps; /* Maximum number of Schwarz sweeps */
+    double eps; /* Relative residual tolerance */
+    int local_iter; /* Maximum number of iterations per subdomain solve */
+    double local_eps; /* Relative residual tolerance of subdomain solves */
+    schwarz_local_solver_enum local_solver; /* Subdomain solver */
+    double local_omega; /* SOR relaxation parameter, <= 0 for an estimate */
+    cholesky_cache_type *cache; /* Factor cache, NULL for one per solve */
+    partition_strategy_enum partition; /* Placement of subdomain borders */
+    double lazy_eps; /* Data change and RMS residual for skipping, 0 off */
+    telemetry_type *telemetry; /* Sweep, subdomain and phase records, or NULL */
+} schwarz_params_type;
+
+/* Rectangular subdomain, all ranges are half-open */
+typedef struct subdomain
+{
+    int x0, x1, y0, y1; /* Non-overlapping core region */
+    int ex0, ex1, ey0, ey1; /* Region extended by the overlap */
+    int color; /* Colour class, subdomains of one colour are solved at once */
+} subdomain_type;
+
+/* Convergence information of a Schwarz solve */
+typedef struct schwarz_info
+{
+    int sweeps; /* Number of performed sweeps */
+    double residual; /* Final residual norm relative to the initial one */
+    long skipped; /* Number of subdomain solves skipped by lazy updates */
+} schwarz_info_type;
+
+/* Default parameters */
+void schwarz_params_default(schwarz_params_type *params);
+
+/* Homogeneous diffusion inpainting with the Schwarz method */
+int schwarz_inpainting(const image_type image, const image_type mask,
+        image_type u, const schwarz_params_type params,
+        schwarz_info_type *info);
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "asi_simd.h"
+
+/*----------------------------------------------------------------------------*/
+
+/* Best instruction set, detected once by the first caller */
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+static simd_level_enum simd_level = ASI_SIMD_SCALAR;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Detects the best instruction set supported by the CPU and stores it in
+ * simd_level. Runs once through pthread_once.
+ */
+static void simd_detect_once(void)
+{
+    const char *env; /* Environment override */
+    simd_level_enum detected;
+
+    detected = ASI_SIMD_SCALAR;
+
+#ifdef ASI_SIMD_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        detected = ASI_SIMD_AVX512;
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        detected = ASI_SIMD_AVX2;
+    }
+#endif
+
+    env = getenv("ASI_SIMD");
+
+    if (env != NULL && strcmp(env, "scalar") == 0)
+    {
+        detected = ASI_SIMD_SCALAR;
+    }
+    else if (env != NULL && strcmp(env, "avx2") == 0
+            && detected > ASI_SIMD_AVX2)
+    {
+        detected = ASI_SIMD_AVX2;
+    }
+
+    simd_level = detected;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Detects the best instruction set supported by the CPU. The result can be
+ * lowered by setting the environment variable ASI_SIMD to "scalar" or
+ * "avx2", e.g. to compare kernels against the scalar reference. Safe to call
+ * from several threads, detection only runs on the first call.
+ */
+simd_level_enum simd_detect(void)
+{
+    pthread_once(&simd_once, simd_detect_once);
+
+    return simd_level;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates zero-initialised memory aligned to ASI_SIMD_ALIGNMENT bytes, to
+ * be released with free.
+ * @count   [ I ] Number of elements
+ * @size    [ I ] Size of an element in bytes
+ */
+void *simd_calloc(size_t count, size_t size)
+{
+    void *ptr; /* Allocated memory */
+    size_t bytes; /* Requested size rounded up to the alignment */
+
+    bytes = count * size;
+    bytes = (bytes + ASI_SIMD_ALIGNMENT - 1) / ASI_SIMD_ALIGNMENT
+        * ASI_SIMD_ALIGNMENT;
+
+    if (bytes == 0 || posix_memalign(&ptr, ASI_SIMD_ALIGNMENT, bytes) != 0)
+    {
+        return NULL;
+    }
+
+    memset(ptr, 0, bytes);
+
+    return ptr;
+}
@@ -0,0 +1,30 @@
+#ifndef _ASI_SIMD_H_
+#define _ASI_SIMD_H_
+
+#include <stddef.h>
+
+/* Instruction set levels selected at runtime */
+typedef enum simd_level
+{
+    ASI_SIMD_SCALAR,
+    ASI_SIMD_AVX2,
+    ASI_SIMD_AVX512
+} simd_level_enum;
+
+/* Compiler support for x86 kernels compiled with function-level targets */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASI_SIMD_X86 1
+#define ASI_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define ASI_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+/* Alignment of arrays processed by SIMD kernels in bytes */
+#define ASI_SIMD_ALIGNMENT 64
+
+/* Detect the best instruction set supported by the CPU */
+simd_level_enum simd_detect(void);
+
+/* Allocate zero-initialised memory aligned to ASI_SIMD_ALIGNMENT */
+void *simd_calloc(size_t count, size_t size);
+
+#endif
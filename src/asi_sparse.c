@@ -0,0 +1,967 @@
+#include "asi_sparse.h"
+#include "asi_mask.h"
+#include "asi_simd.h"
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef ASI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/* Number of rows processed at once by the matrix vector product */
+#define CDS_BLOCK_SIZE 2048
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Allocates a five-diagonal CDS matrix for an image with zero entries. The
+ * diagonals are aligned for the SIMD matrix vector product.
+ * @mat             [ O ] CDS matrix
+ * @image_width     [ I ] Image width (number of pixel columns)
+ * @image_height    [ I ] Image height (number of pixel rows)
+ */
+static int cds_alloc_five_point(cds_sparse_mat_type *mat, int image_width,
+    int image_height)
+{
+    int d; /* Loop variable */
+
+    if (image_width < 1 || image_height < 1)
+    {
+        return ASI_EXIT_INVALID_IMG_DIM;
+    }
+
+    mat->n = image_width * image_height;
+    mat->bandwidth = image_width;
+    mat->num_diags = 5;
+
+    /* Allocate offsets and diagonals */
+    mat->ioff = (int *) malloc(mat->num_diags * sizeof(int));
+    mat->a = (double **) calloc(mat->num_diags, sizeof(double *));
+
+    if (mat->ioff == NULL || mat->a == NULL)
+    {
+        cds_delete(mat);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    for (d = 0; d < mat->num_diags; d++)
+    {
+        mat->a[d] = (double *) simd_calloc(mat->n, sizeof(double));
+
+        if (mat->a[d] == NULL)
+        {
+            cds_delete(mat);
+            return ASI_EXIT_FAILED_ALLOC;
+        }
+    }
+
+    /* Diagonals are ordered by offset: north, west, centre, east, south */
+    mat->ioff[0] = -image_width;
+    mat->ioff[1] = -1;
+    mat->ioff[2] = 0;
+    mat->ioff[3] = 1;
+    mat->ioff[4] = image_width;
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises the five-point diffusion matrix (negative Laplacian) of an
+ * image in CDS format. Pixels are numbered row by row, boundaries are
+ * mirrored, i.e. neighbours outside of the image do not contribute.
+ * @mat             [ O ] Diffusion matrix
+ * @image_width     [ I ] Image width (number of pixel columns)
+ * @image_height    [ I ] Image height (number of pixel rows)
+ */
+int cds_init_diffusion_matrix(cds_sparse_mat_type *mat, int image_width,
+    int image_height)
+{
+    int i, j, k; /* Loop variables */
+    int ret; /* Return value */
+
+    ret = cds_alloc_five_point(mat, image_width, image_height);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    /* Fill diagonals row by row */
+    for (i = 0; i < image_height; i++)
+    {
+        for (j = 0; j < image_width; j++)
+        {
+            k = i * image_width + j;
+
+            if (i > 0)
+            {
+                mat->a[0][k] = -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (j > 0)
+            {
+                mat->a[1][k] = -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (j < image_width - 1)
+            {
+                mat->a[3][k] = -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (i < image_height - 1)
+            {
+                mat->a[4][k] = -1.0;
+                mat->a[2][k] += 1.0;
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises the inpainting matrix in CDS format. Known pixels become
+ * identity rows, unknown pixels carry the diffusion stencil with mirrored
+ * boundaries. Couplings to known pixels are moved to the right-hand side
+ * (see cds_inpainting_rhs), which keeps the matrix symmetric positive
+ * definite as long as the mask is not empty.
+ * @mat     [ O ] Inpainting matrix
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ */
+int cds_init_inpainting_matrix(cds_sparse_mat_type *mat,
+    const image_type mask)
+{
+    int i, j, k; /* Loop variables */
+    int w, h; /* Image dimensions */
+    int ret; /* Return value */
+
+    w = mask.width;
+    h = mask.height;
+
+    ret = cds_alloc_five_point(mat, w, h);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+
+            if (mask_get(mask, i, j))
+            {
+                mat->a[2][k] = 1.0;
+                continue;
+            }
+
+            /* Degree counts all neighbours, couplings only unknown ones */
+            if (i > 0)
+            {
+                mat->a[0][k] = mask_get(mask, i-1, j) ? 0.0 : -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (j > 0)
+            {
+                mat->a[1][k] = mask_get(mask, i, j-1) ? 0.0 : -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (j < w - 1)
+            {
+                mat->a[3][k] = mask_get(mask, i, j+1) ? 0.0 : -1.0;
+                mat->a[2][k] += 1.0;
+            }
+            if (i < h - 1)
+            {
+                mat->a[4][k] = mask_get(mask, i+1, j) ? 0.0 : -1.0;
+                mat->a[2][k] += 1.0;
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Right-hand side of the inpainting system assembled by
+ * cds_init_inpainting_matrix: known values at known pixels, the sum of known
+ * neighbouring values at unknown pixels.
+ * @image   [ I ] Double-valued image providing the known pixel values
+ * @mask    [ I ] Inpainting mask, non-zero for known pixels
+ * @b       [ O ] Right-hand side
+ */
+int cds_inpainting_rhs(const image_type image, const image_type mask,
+    double *b)
+{
+    int i, j, k; /* Loop variables */
+    int w, h; /* Image dimensions */
+
+    if (image.dtype != ASI_DTYPE_DOUBLE)
+    {
+        return ASI_EXIT_INVALID_DTYPE;
+    }
+
+    if (image.width != mask.width || image.height != mask.height)
+    {
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    w = image.width;
+    h = image.height;
+
+    for (i = 0; i < h; i++)
+    {
+        for (j = 0; j < w; j++)
+        {
+            k = i * w + j;
+
+            if (mask_get(mask, i, j))
+            {
+                b[k] = image_fget(image, i, j);
+                continue;
+            }
+
+            b[k] = 0.0;
+
+            if (i > 0 && mask_get(mask, i-1, j))
+            {
+                b[k] += image_fget(image, i-1, j);
+            }
+            if (j > 0 && mask_get(mask, i, j-1))
+            {
+                b[k] += image_fget(image, i, j-1);
+            }
+            if (j < w - 1 && mask_get(mask, i, j+1))
+            {
+                b[k] += image_fget(image, i, j+1);
+            }
+            if (i < h - 1 && mask_get(mask, i+1, j))
+            {
+                b[k] += image_fget(image, i+1, j);
+            }
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of a CDS matrix
+ * @mat     [ I ] Matrix to be deleted
+ */
+void cds_delete(cds_sparse_mat_type *mat)
+{
+    int d; /* Loop variable */
+
+    if (mat->a != NULL)
+    {
+        for (d = 0; d < mat->num_diags; d++)
+        {
+            free(mat->a[d]);
+        }
+    }
+
+    free(mat->a);
+    free(mat->ioff);
+
+    mat->a = NULL;
+    mat->ioff = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Scalar kernel accumulating one diagonal: b[k] += a[k] * x[k].
+ * @a       [ I ] Diagonal entries
+ * @x       [ I ] Vector x, shifted by the diagonal offset
+ * @b       [I/O] Result vector
+ * @len     [ I ] Number of entries
+ */
+static void cds_diagonal_scalar(const double *a, const double *x, double *b,
+    int len)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k < len; k++)
+    {
+        b[k] += a[k] * x[k];
+    }
+
+    return;
+}
+
+#ifdef ASI_SIMD_X86
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX2 kernel accumulating one diagonal: b[k] += a[k] * x[k].
+ * @a       [ I ] Diagonal entries
+ * @x       [ I ] Vector x, shifted by the diagonal offset
+ * @b       [I/O] Result vector
+ * @len     [ I ] Number of entries
+ */
+ASI_TARGET_AVX2
+static void cds_diagonal_avx2(const double *a, const double *x, double *b,
+    int len)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k + 8 <= len; k += 8)
+    {
+        _mm256_storeu_pd(b + k, _mm256_fmadd_pd(_mm256_loadu_pd(a + k),
+                    _mm256_loadu_pd(x + k), _mm256_loadu_pd(b + k)));
+        _mm256_storeu_pd(b + k + 4, _mm256_fmadd_pd(_mm256_loadu_pd(a + k + 4),
+                    _mm256_loadu_pd(x + k + 4), _mm256_loadu_pd(b + k + 4)));
+    }
+
+    cds_diagonal_scalar(a + k, x + k, b + k, len - k);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * AVX-512 kernel accumulating one diagonal: b[k] += a[k] * x[k].
+ * @a       [ I ] Diagonal entries
+ * @x       [ I ] Vector x, shifted by the diagonal offset
+ * @b       [I/O] Result vector
+ * @len     [ I ] Number of entries
+ */
+ASI_TARGET_AVX512
+static void cds_diagonal_avx512(const double *a, const double *x, double *b,
+    int len)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k + 8 <= len; k += 8)
+    {
+        _mm512_storeu_pd(b + k, _mm512_fmadd_pd(_mm512_loadu_pd(a + k),
+                    _mm512_loadu_pd(x + k), _mm512_loadu_pd(b + k)));
+    }
+
+    cds_diagonal_scalar(a + k, x + k, b + k, len - k);
+
+    return;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sparse matrix vector product b = A x in CDS format. The product is computed
+ * diagonal by diagonal on blocks of rows small enough for the partial result
+ * to stay in cache, using the widest SIMD kernel supported by the CPU.
+ * @mat     [ I ] Matrix A
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+void cds_matrix_vector_product(const cds_sparse_mat_type mat, const double *x,
+    double *b)
+{
+    int k0, k1, d; /* Loop variables */
+    int k_start, k_end; /* Valid row range of a diagonal within a block */
+    int off; /* Diagonal offset */
+    void (*kernel)(const double *, const double *, double *, int);
+
+    kernel = cds_diagonal_scalar;
+
+#ifdef ASI_SIMD_X86
+    if (simd_detect() == ASI_SIMD_AVX512)
+    {
+        kernel = cds_diagonal_avx512;
+    }
+    else if (simd_detect() == ASI_SIMD_AVX2)
+    {
+        kernel = cds_diagonal_avx2;
+    }
+#endif
+
+    for (k0 = 0; k0 < mat.n; k0 += CDS_BLOCK_SIZE)
+    {
+        k1 = k0 + CDS_BLOCK_SIZE < mat.n ? k0 + CDS_BLOCK_SIZE : mat.n;
+
+        memset(b + k0, 0, (k1 - k0) * sizeof(double));
+
+        for (d = 0; d < mat.num_diags; d++)
+        {
+            off = mat.ioff[d];
+            k_start = k0 < -off ? -off : k0;
+            k_end = k1 > mat.n - off ? mat.n - off : k1;
+
+            if (k_start < k_end)
+            {
+                kernel(mat.a[d] + k_start, x + k_start + off, b + k_start,
+                        k_end - k_start);
+            }
+        }
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Adapter evaluating a CDS matrix vector product through the generic
+ * linear operator interface.
+ * @data    [ I ] CDS matrix
+ * @x       [ I ] Vector x
+ * @b       [ O ] Result vector b
+ */
+static void cds_linear_operator_product(const void *data, const double *x,
+    double *b)
+{
+    cds_matrix_vector_product(*(const cds_sparse_mat_type *) data, x, b);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Wraps a CDS matrix as a generic linear operator. The matrix needs to
+ * outlive the operator.
+ * @mat     [ I ] CDS matrix
+ */
+linear_operator_type cds_linear_operator(const cds_sparse_mat_type *mat)
+{
+    linear_operator_type op;
+
+    op.product = cds_linear_operator_product;
+    op.data = mat;
+    op.n = mat->n;
+
+    return op;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Conjugate gradient method for a symmetric positive (semi-)definite matrix
+ * in CDS format.
+ * @mat     [ I ] System matrix A
+ * @b       [ I ] Right-hand side
+ * @x       [I/O] Initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ */
+int cds_conjugate_gradient(const cds_sparse_mat_type mat, const double *b,
+    double *x, int iter, double eps)
+{
+    return conjugate_gradient(cds_linear_operator(&mat), b, x, iter, eps);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Conjugate gradient method for a symmetric positive (semi-)definite linear
+ * operator. Stops once the residual norm dropped below eps times the initial
+ * residual norm.
+ * @op      [ I ] System operator A
+ * @b       [ I ] Right-hand side
+ * @x       [I/O] Initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ */
+int conjugate_gradient(const linear_operator_type op, const double *b,
+    double *x, int iter, double eps)
+{
+    return preconditioned_conjugate_gradient(op, NULL, b, x, iter, eps, NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Jacobi preconditioner z = D^-1 r.
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void precond_apply_jacobi(const preconditioner_type *pc,
+    const double *r, double *z)
+{
+    int k; /* Loop variable */
+
+    for (k = 0; k < pc->mat->n; k++)
+    {
+        z[k] = pc->pivots[k] * r[k];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Applies z = M^-1 r for M = (P + L) P^-1 (P + U) with pivots P and the
+ * strictly lower and upper parts L, U of the CDS matrix: a forward solve
+ * with (P + L) followed by a backward solve with (I + P^-1 U). Covers IC(0)
+ * as well as SSOR, which only differ in the choice of pivots.
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void precond_triangular_solves(const preconditioner_type *pc,
+    const double *r, double *z)
+{
+    const cds_sparse_mat_type *mat = pc->mat;
+    int k, d; /* Loop variables */
+    int off; /* Diagonal offset */
+    double sum; /* Accumulated off-diagonal contributions */
+
+    /* Forward substitution with (P + L) */
+    for (k = 0; k < mat->n; k++)
+    {
+        sum = r[k];
+
+        for (d = 0; d < mat->num_diags; d++)
+        {
+            off = mat->ioff[d];
+
+            if (off < 0 && k + off >= 0)
+            {
+                sum -= mat->a[d][k] * z[k + off];
+            }
+        }
+
+        z[k] = sum * pc->pivots[k];
+    }
+
+    /* Backward substitution with (I + P^-1 U) */
+    for (k = mat->n - 1; k >= 0; k--)
+    {
+        sum = 0.0;
+
+        for (d = 0; d < mat->num_diags; d++)
+        {
+            off = mat->ioff[d];
+
+            if (off > 0 && k + off < mat->n)
+            {
+                sum += mat->a[d][k] * z[k + off];
+            }
+        }
+
+        z[k] -= sum * pc->pivots[k];
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * SSOR preconditioner, M = w/(2-w) (D/w + L) (D/w)^-1 (D/w + U).
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void precond_apply_ssor(const preconditioner_type *pc,
+    const double *r, double *z)
+{
+    int k; /* Loop variable */
+    double scale; /* Scaling of the SSOR splitting */
+
+    precond_triangular_solves(pc, r, z);
+
+    scale = (2.0 - pc->omega) / pc->omega;
+
+    for (k = 0; k < pc->mat->n; k++)
+    {
+        z[k] *= scale;
+    }
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Incomplete Cholesky preconditioner IC(0), M = (P + L) P^-1 (P + L^T).
+ * @pc      [ I ] Preconditioner
+ * @r       [ I ] Residual
+ * @z       [ O ] Preconditioned residual
+ */
+static void precond_apply_ic0(const preconditioner_type *pc,
+    const double *r, double *z)
+{
+    precond_triangular_solves(pc, r, z);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a preconditioner for a symmetric CDS matrix. The matrix needs
+ * to outlive the preconditioner. For ASI_PRECOND_CUSTOM, apply and data have
+ * to be set by the caller afterwards.
+ * @pc      [ O ] Preconditioner
+ * @mat     [ I ] System matrix
+ * @name    [ I ] Preconditioner type
+ * @argc    [ I ] Argument count (needs to be 0 if no arguments provided)
+ * @...     [ I ] Optional relaxation parameter omega for SSOR (default 1.5)
+ */
+int precond_init(preconditioner_type *pc, const cds_sparse_mat_type *mat,
+    precond_name_enum name, int argc, ...)
+{
+    va_list args;
+    int k, d; /* Loop variables */
+    int off; /* Diagonal offset */
+    int main_diag; /* Index of the main diagonal */
+    double pivot; /* Pivot of the incomplete factorisation */
+
+    pc->apply = NULL;
+    pc->name = name;
+    pc->mat = mat;
+    pc->pivots = NULL;
+    pc->omega = 1.0;
+    pc->data = NULL;
+
+    if (name == ASI_PRECOND_NONE || name == ASI_PRECOND_CUSTOM)
+    {
+        return ASI_EXIT_SUCCESS;
+    }
+
+    /* Fetch optional relaxation parameter */
+    if (name == ASI_PRECOND_SSOR)
+    {
+        pc->omega = 1.5;
+
+        if (argc == 1)
+        {
+            va_start(args, argc);
+            pc->omega = va_arg(args, double);
+            va_end(args);
+        }
+        else if (argc != 0)
+        {
+            return ASI_EXIT_INVALID_ARG_COUNT;
+        }
+
+        if (pc->omega <= 0.0 || pc->omega >= 2.0)
+        {
+            return ASI_EXIT_INVALID_VALUE;
+        }
+    }
+    else if (argc != 0)
+    {
+        return ASI_EXIT_INVALID_ARG_COUNT;
+    }
+
+    /* Locate main diagonal */
+    main_diag = -1;
+    for (d = 0; d < mat->num_diags; d++)
+    {
+        if (mat->ioff[d] == 0)
+        {
+            main_diag = d;
+        }
+    }
+
+    if (main_diag < 0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    pc->pivots = (double *) simd_calloc(mat->n, sizeof(double));
+
+    if (pc->pivots == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    if (name == ASI_PRECOND_JACOBI)
+    {
+        for (k = 0; k < mat->n; k++)
+        {
+            pc->pivots[k] = 1.0 / mat->a[main_diag][k];
+        }
+
+        pc->apply = precond_apply_jacobi;
+    }
+    else if (name == ASI_PRECOND_SSOR)
+    {
+        for (k = 0; k < mat->n; k++)
+        {
+            pc->pivots[k] = pc->omega / mat->a[main_diag][k];
+        }
+
+        pc->apply = precond_apply_ssor;
+    }
+    else if (name == ASI_PRECOND_IC0)
+    {
+        /*
+         * Pivots p_k = a_kk - sum_j a_kj^2 / p_j over the lower diagonals.
+         * For the five-point matrices of this library the factor keeps the
+         * off-diagonals of A, since their fill-in lies outside the stored
+         * diagonals and is dropped.
+         */
+        for (k = 0; k < mat->n; k++)
+        {
+            pivot = mat->a[main_diag][k];
+
+            for (d = 0; d < mat->num_diags; d++)
+            {
+                off = mat->ioff[d];
+
+                if (off < 0 && k + off >= 0)
+                {
+                    pivot -= mat->a[d][k] * mat->a[d][k] * pc->pivots[k + off];
+                }
+            }
+
+            /* Guard against breakdown of the incomplete factorisation */
+            if (pivot <= 0.0)
+            {
+                pivot = mat->a[main_diag][k];
+            }
+
+            pc->pivots[k] = 1.0 / pivot;
+        }
+
+        pc->apply = precond_apply_ic0;
+    }
+    else
+    {
+        free(pc->pivots);
+        pc->pivots = NULL;
+        return ASI_NOT_IMPLEMENTED_YET;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees memory of a preconditioner
+ * @pc      [ I ] Preconditioner to be deleted
+ */
+void precond_delete(preconditioner_type *pc)
+{
+    free(pc->pivots);
+    pc->pivots = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Preconditioned conjugate gradient method for a symmetric positive definite
+ * matrix in CDS format.
+ * @mat     [ I ] System matrix A
+ * @pc      [ I ] Preconditioner, NULL for plain CG
+ * @b       [ I ] Right-hand side
+ * @x       [I/O] Initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int cds_preconditioned_conjugate_gradient(const cds_sparse_mat_type mat,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info)
+{
+    return preconditioned_conjugate_gradient(cds_linear_operator(&mat), pc,
+            b, x, iter, eps, info);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Preconditioned conjugate gradient method for a symmetric positive
+ * (semi-)definite linear operator. Stops once the Euclidean norm of the
+ * residual dropped below eps times the initial residual norm.
+ * @op      [ I ] System operator A
+ * @pc      [ I ] Preconditioner, NULL for plain CG
+ * @b       [ I ] Right-hand side
+ * @x       [I/O] Initial guess on input, solution on output
+ * @iter    [ I ] Maximum number of iterations
+ * @eps     [ I ] Relative residual tolerance
+ * @info    [ O ] Convergence information, may be NULL
+ */
+int preconditioned_conjugate_gradient(const linear_operator_type op,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info)
+{
+    return preconditioned_conjugate_gradient_traced(op, pc, b, x, iter, eps,
+            info, NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Preconditioned conjugate gradient method reporting every iteration to a
+ * telemetry sink: the relative residual norm and the estimated vector
+ * traffic of the iteration. Traffic inside the operator and the
+ * preconditioner is not included as it depends on their implementation.
+ * @op          [ I ] System operator A
+ * @pc          [ I ] Preconditioner, NULL for plain CG
+ * @b           [ I ] Right-hand side
+ * @x           [I/O] Initial guess on input, solution on output
+ * @iter        [ I ] Maximum number of iterations
+ * @eps         [ I ] Relative residual tolerance
+ * @info        [ O ] Convergence information, may be NULL
+ * @telemetry   [I/O] Telemetry sink, may be NULL
+ */
+int preconditioned_conjugate_gradient_traced(const linear_operator_type op,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info, telemetry_type *telemetry)
+{
+    telemetry_record_type record; /* Record of an iteration */
+    double start; /* Start time of an iteration */
+    int k, it; /* Loop variables */
+    double *r, *z, *p, *q; /* Residual, preconditioned residual, search
+                              direction, A times p */
+    double rr, rr_0; /* Squared residual norms */
+    double rz, rz_new; /* Scalar products of r and z */
+    double pq; /* Scalar product of p and q */
+    double alpha, beta; /* Step sizes */
+
+    if (pc != NULL && pc->apply == NULL)
+    {
+        pc = NULL;
+    }
+
+    r = (double *) simd_calloc(op.n, sizeof(double));
+    p = (double *) simd_calloc(op.n, sizeof(double));
+    q = (double *) simd_calloc(op.n, sizeof(double));
+    z = pc != NULL ? (double *) simd_calloc(op.n, sizeof(double)) : r;
+
+    if (r == NULL || p == NULL || q == NULL || z == NULL)
+    {
+        free(r);
+        free(p);
+        free(q);
+        if (pc != NULL)
+        {
+            free(z);
+        }
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    /* Initial residual r = b - A x */
+    op.product(op.data, x, q);
+
+    rr = 0.0;
+    for (k = 0; k < op.n; k++)
+    {
+        r[k] = b[k] - q[k];
+        rr += r[k] * r[k];
+    }
+
+    if (pc != NULL)
+    {
+        pc->apply(pc, r, z);
+    }
+
+    rz = 0.0;
+    for (k = 0; k < op.n; k++)
+    {
+        p[k] = z[k];
+        rz += r[k] * z[k];
+    }
+
+    rr_0 = rr;
+
+    record = telemetry_record(ASI_TELEMETRY_ITERATION, "cg");
+
+    /* Reads and writes of x, r, z, p and q in dot products and updates */
+    record.bytes = (pc != NULL ? 15.0 : 13.0) * op.n * sizeof(double);
+    start = telemetry != NULL ? telemetry_time() : 0.0;
+
+    for (it = 0; it < iter && rr > eps * eps * rr_0; it++)
+    {
+        op.product(op.data, p, q);
+
+        pq = 0.0;
+        for (k = 0; k < op.n; k++)
+        {
+            pq += p[k] * q[k];
+        }
+
+        /* Breakdown: search direction lies in the null space */
+        if (pq <= 0.0)
+        {
+            break;
+        }
+
+        alpha = rz / pq;
+
+        rr = 0.0;
+        for (k = 0; k < op.n; k++)
+        {
+            x[k] += alpha * p[k];
+            r[k] -= alpha * q[k];
+            rr += r[k] * r[k];
+        }
+
+        if (pc != NULL)
+        {
+            pc->apply(pc, r, z);
+        }
+
+        rz_new = 0.0;
+        for (k = 0; k < op.n; k++)
+        {
+            rz_new += r[k] * z[k];
+        }
+
+        beta = rz_new / rz;
+        rz = rz_new;
+
+        for (k = 0; k < op.n; k++)
+        {
+            p[k] = z[k] + beta * p[k];
+        }
+
+        if (telemetry != NULL)
+        {
+            record.iteration = it + 1;
+            record.residual = sqrt(rr / rr_0);
+            record.seconds = telemetry_time() - start;
+            telemetry_emit(telemetry, &record);
+            start = telemetry_time();
+        }
+    }
+
+    if (info != NULL)
+    {
+        info->iterations = it;
+        info->residual_0 = sqrt(rr_0);
+        info->residual = rr_0 > 0.0 ? sqrt(rr / rr_0) : 0.0;
+    }
+
+    free(r);
+    free(p);
+    free(q);
+    if (pc != NULL)
+    {
+        free(z);
+    }
+
+    if (rr > eps * eps * rr_0)
+    {
+        return ASI_EXIT_NOT_CONVERGED;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
@@ -1,6 +1,9 @@
 #ifndef _ASI_SPARSE_H_
 #define _ASI_SPARSE_H_
 
+#include "asi_image.h"
+#include "asi_telemetry.h"
+
 /* Sparse matrix in compressed diagonal storage (CDS) format */
 typedef struct cds_sparse_mat
 {
@@ -8,18 +11,97 @@ typedef struct cds_sparse_mat
     int *ioff; // Array indicating non-zero diagonals
     int n; // Length of main diagonal of A
     int bandwidth; // Bandwidth of A
+    int num_diags; // Number of stored diagonals
 } cds_sparse_mat_type;
 
+/* Generic linear operator evaluating b = A x, e.g. a matrix-free stencil */
+typedef struct linear_operator
+{
+    void (*product)(const void *data, const double *x, double *b);
+    const void *data; // Operator data passed to product
+    int n; // Dimension of the operator
+} linear_operator_type;
+
+/* Supported preconditioners */
+typedef enum precond_name
+{
+    ASI_PRECOND_NONE,
+    ASI_PRECOND_JACOBI,
+    ASI_PRECOND_SSOR,
+    ASI_PRECOND_IC0,
+    ASI_PRECOND_CUSTOM
+} precond_name_enum;
+
+/* Preconditioner evaluating z = M^-1 r */
+typedef struct preconditioner
+{
+    void (*apply)(const struct preconditioner *pc, const double *r,
+        double *z);
+    precond_name_enum name; // Preconditioner type
+    const cds_sparse_mat_type *mat; // Matrix the preconditioner was built for
+    double *pivots; // Inverse diagonal (Jacobi) or pivots (SSOR, IC(0))
+    double omega; // Relaxation parameter (SSOR)
+    void *data; // User data of custom preconditioners
+} preconditioner_type;
+
+/* Convergence information of an iterative solver */
+typedef struct solver_info
+{
+    int iterations; // Number of performed iterations
+    double residual; // Final residual norm relative to the initial one
+    double residual_0; // Initial residual norm
+} solver_info_type;
+
 /* Initialise diffusion matrix given image dimensions */
-void cds_init_diffusion_matrix(struct cds_sparse_mat mat, int image_width, 
+int cds_init_diffusion_matrix(cds_sparse_mat_type *mat, int image_width,
     int image_height);
 
+/* Initialise inpainting matrix with identity rows at known mask pixels */
+int cds_init_inpainting_matrix(cds_sparse_mat_type *mat,
+    const image_type mask);
+
+/* Right-hand side of the inpainting system given known pixel values */
+int cds_inpainting_rhs(const image_type image, const image_type mask,
+    double *b);
+
+/* Free memory of a CDS matrix */
+void cds_delete(cds_sparse_mat_type *mat);
+
 /* Sparse matrix vector product */
-void cds_matrix_vector_product(const struct cds_sparse_mat mat, const double *x, 
+void cds_matrix_vector_product(const cds_sparse_mat_type mat, const double *x,
     double *b);
 
+/* Wrap a CDS matrix as a generic linear operator */
+linear_operator_type cds_linear_operator(const cds_sparse_mat_type *mat);
+
 /* Conjuage gradient method */
-int cds_conjugate_gradient(const struct cds_sparse_mat mat, const double *b, 
-    double *b, int iter, double eps); 
+int cds_conjugate_gradient(const cds_sparse_mat_type mat, const double *b,
+    double *x, int iter, double eps);
+
+/* Conjugate gradient method for a generic linear operator */
+int conjugate_gradient(const linear_operator_type op, const double *b,
+    double *x, int iter, double eps);
+
+/* Initialise a preconditioner for a CDS matrix */
+int precond_init(preconditioner_type *pc, const cds_sparse_mat_type *mat,
+    precond_name_enum name, int argc, ...);
+
+/* Free memory of a preconditioner */
+void precond_delete(preconditioner_type *pc);
+
+/* Preconditioned conjugate gradient method for a CDS matrix */
+int cds_preconditioned_conjugate_gradient(const cds_sparse_mat_type mat,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info);
+
+/* Preconditioned conjugate gradient method for a generic linear operator */
+int preconditioned_conjugate_gradient(const linear_operator_type op,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info);
+
+/* Preconditioned conjugate gradient method reporting every iteration */
+int preconditioned_conjugate_gradient_traced(const linear_operator_type op,
+    const preconditioner_type *pc, const double *b, double *x, int iter,
+    double eps, solver_info_type *info, telemetry_type *telemetry);
 
 #endif
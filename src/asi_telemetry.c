@@ -0,0 +1,189 @@
+#include "asi_telemetry.h"
+#include "asi_image.h"
+#include <time.h>
+
+/* Names of the record kinds in dumps */
+static const char *telemetry_event_names[] = {"iteration", "subdomain",
+    "phase"};
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Monotonic wall clock time.
+ */
+double telemetry_time(void)
+{
+    struct timespec ts; /* Current time */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises a telemetry sink.
+ * @t           [ O ] Telemetry sink
+ * @callback    [ I ] Function receiving every record, may be NULL
+ * @data        [I/O] Argument passed to the callback
+ */
+int telemetry_init(telemetry_type *t, telemetry_fn callback, void *data)
+{
+    t->callback = callback;
+    t->data = data;
+    t->file = NULL;
+    t->format = ASI_TELEMETRY_CSV;
+    t->count = 0;
+    t->start = telemetry_time();
+
+    if (pthread_mutex_init(&t->lock, NULL) != 0)
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Dumps all further records of a sink to a file: one row per record after a
+ * header line for CSV, an array of objects for JSON.
+ * @t       [I/O] Telemetry sink
+ * @file    [ I ] File name
+ * @format  [ I ] Dump format
+ */
+int telemetry_open(telemetry_type *t, const char *file,
+        telemetry_format_enum format)
+{
+    t->file = fopen(file, "w");
+
+    if (t->file == NULL)
+    {
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    t->format = format;
+
+    if (format == ASI_TELEMETRY_CSV)
+    {
+        fprintf(t->file, "time,event,solver,phase,iteration,subdomain,"
+                "residual,seconds,bytes\n");
+    }
+    else
+    {
+        fprintf(t->file, "[");
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Finishes the dump of a sink and frees its resources.
+ * @t       [I/O] Telemetry sink
+ */
+void telemetry_delete(telemetry_type *t)
+{
+    if (t->file != NULL)
+    {
+        if (t->format == ASI_TELEMETRY_JSON)
+        {
+            fprintf(t->file, "\n]\n");
+        }
+
+        fclose(t->file);
+        t->file = NULL;
+    }
+
+    pthread_mutex_destroy(&t->lock);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Returns a record of a given kind with all optional fields unset.
+ * @event   [ I ] Kind of record
+ * @solver  [ I ] Emitting solver
+ */
+telemetry_record_type telemetry_record(telemetry_event_enum event,
+        const char *solver)
+{
+    telemetry_record_type record; /* New record */
+
+    record.event = event;
+    record.solver = solver;
+    record.phase = NULL;
+    record.iteration = -1;
+    record.subdomain = -1;
+    record.residual = -1.0;
+    record.seconds = -1.0;
+    record.bytes = -1.0;
+
+    return record;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Passes a record to the callback and appends it to the dump.
+ * @t       [I/O] Telemetry sink, NULL to discard the record
+ * @record  [ I ] Record
+ */
+void telemetry_emit(telemetry_type *t, const telemetry_record_type *record)
+{
+    double time; /* Time since initialisation of the sink */
+
+    if (t == NULL)
+    {
+        return;
+    }
+
+    time = telemetry_time() - t->start;
+
+    pthread_mutex_lock(&t->lock);
+
+    if (t->callback != NULL)
+    {
+        t->callback(t->data, record);
+    }
+
+    if (t->file != NULL && t->format == ASI_TELEMETRY_CSV)
+    {
+        fprintf(t->file, "%.9f,%s,%s,%s,%d,%d,%.9e,%.9e,%.0f\n", time,
+                telemetry_event_names[record->event], record->solver,
+                record->phase != NULL ? record->phase : "",
+                record->iteration, record->subdomain, record->residual,
+                record->seconds, record->bytes);
+    }
+    else if (t->file != NULL)
+    {
+        fprintf(t->file, "%s\n  {\"time\": %.9f, \"event\": \"%s\", "
+                "\"solver\": \"%s\", \"phase\": ", t->count > 0 ? "," : "",
+                time, telemetry_event_names[record->event], record->solver);
+
+        if (record->phase != NULL)
+        {
+            fprintf(t->file, "\"%s\"", record->phase);
+        }
+        else
+        {
+            fprintf(t->file, "null");
+        }
+
+        fprintf(t->file, ", \"iteration\": %d, \"subdomain\": %d, "
+                "\"residual\": %.9e, \"seconds\": %.9e, \"bytes\": %.0f}",
+                record->iteration, record->subdomain, record->residual,
+                record->seconds, record->bytes);
+    }
+
+    t->count++;
+
+    pthread_mutex_unlock(&t->lock);
+
+    return;
+}
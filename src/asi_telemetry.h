@@ -0,0 +1,71 @@
+#ifndef _ASI_TELEMETRY_H_
+#define _ASI_TELEMETRY_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* Kinds of telemetry records */
+typedef enum telemetry_event
+{
+    ASI_TELEMETRY_ITERATION, /* One iteration or sweep of a solver */
+    ASI_TELEMETRY_SUBDOMAIN, /* One subdomain or tile solve */
+    ASI_TELEMETRY_PHASE /* A timed phase such as setup or residual */
+} telemetry_event_enum;
+
+/* Supported dump formats */
+typedef enum telemetry_format
+{
+    ASI_TELEMETRY_CSV,
+    ASI_TELEMETRY_JSON
+} telemetry_format_enum;
+
+/* One telemetry record, fields that do not apply are -1 */
+typedef struct telemetry_record
+{
+    telemetry_event_enum event; /* Kind of record */
+    const char *solver; /* Emitting solver, e.g. "cg" or "schwarz" */
+    const char *phase; /* Phase name of phase records, NULL otherwise */
+    int iteration; /* Iteration or sweep */
+    int subdomain; /* Subdomain or tile index */
+    double residual; /* Residual norm relative to the initial one */
+    double seconds; /* Duration of the subdomain solve or phase */
+    double bytes; /* Estimated memory traffic in bytes */
+} telemetry_record_type;
+
+/* Callback receiving every record */
+typedef void (*telemetry_fn)(void *data, const telemetry_record_type *record);
+
+/* Telemetry sink, records may be emitted from several threads */
+typedef struct telemetry
+{
+    telemetry_fn callback; /* Callback, may be NULL */
+    void *data; /* Argument passed to the callback */
+    FILE *file; /* Dump file, may be NULL */
+    telemetry_format_enum format; /* Format of the dump */
+    long count; /* Number of emitted records */
+    double start; /* Time of initialisation in seconds */
+    pthread_mutex_t lock; /* Serialises callback and dump */
+} telemetry_type;
+
+/* Initialise a sink with an optional callback */
+int telemetry_init(telemetry_type *t, telemetry_fn callback, void *data);
+
+/* Additionally dump all records to a CSV or JSON file */
+int telemetry_open(telemetry_type *t, const char *file,
+        telemetry_format_enum format);
+
+/* Finish the dump and free resources */
+void telemetry_delete(telemetry_type *t);
+
+/* Pass a record to the callback and the dump */
+void telemetry_emit(telemetry_type *t, const telemetry_record_type *record);
+
+/* Record with all optional fields unset */
+telemetry_record_type telemetry_record(telemetry_event_enum event,
+        const char *solver);
+
+/* Monotonic wall clock time in seconds */
+double telemetry_time(void);
+
+#endif
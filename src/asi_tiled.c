@@ -0,0 +1,668 @@
+#include "asi_tiled.h"
+#include "asi_io.h"
+#include "asi_diffusion.h"
+#include "asi_pyramid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+/*
+ * Estimated resident bytes per pixel of a tile window: iterate, boundary
+ * data, two masks and a residual as doubles, stencil flags, plus the work
+ * memory of push-pull and of the concurrently solved Schwarz subdomains.
+ */
+#define TILED_BYTES_PER_PIXEL 96
+
+/* Smallest edge length of a tile core */
+#define TILED_MIN_TILE 8
+
+/* Shared state of a tiled solve */
+typedef struct tiled_context
+{
+    FILE *u_file; /* Scratch file of the iterate, NaN if not yet visited */
+    FILE *m_file; /* Scratch file of the mask, one byte per pixel */
+    int width; /* Image width */
+    int height; /* Image height */
+    int overlap; /* Overlap of tiles */
+    const schwarz_params_type *solver; /* Tile solver */
+    image_type u; /* Window of the iterate */
+    image_type f; /* Boundary data of the window solve, push-pull result */
+    image_type m; /* Window of the mask */
+    image_type m_s; /* Mask of the window solve, push-pull mask */
+    double *r; /* Residual of the window */
+    unsigned char *bytes; /* Window of the mask as stored */
+    double transferred; /* Scratch file traffic of the last tile in bytes */
+} tiled_context_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Sets default parameters of tiled inpainting.
+ * @params  [ O ] Parameters
+ */
+void tiled_params_default(tiled_params_type *params)
+{
+    params->memory_bytes = (size_t) 256 << 20;
+    params->overlap = 16;
+    params->max_sweeps = 100;
+    params->eps = 1e-4;
+    params->binary_mode = 1;
+    params->scratch_dir = NULL;
+
+    /* Few sweeps per visit, convergence is driven by the tile sweeps */
+    schwarz_params_default(&params->tile);
+    params->tile.max_sweeps = 2;
+    params->telemetry = NULL;
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Creates an anonymous scratch file which is removed when closed.
+ * @dir     [ I ] Directory, NULL for the system default
+ */
+static FILE *tiled_scratch(const char *dir)
+{
+    char path[4096]; /* File name template */
+    FILE *file; /* Scratch file */
+    int fd; /* File descriptor */
+
+    if (dir == NULL)
+    {
+        return tmpfile();
+    }
+
+    snprintf(path, sizeof(path), "%s/asi_tiled_XXXXXX", dir);
+    fd = mkstemp(path);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    unlink(path);
+    file = fdopen(fd, "w+b");
+
+    if (file == NULL)
+    {
+        close(fd);
+    }
+
+    return file;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reads or writes a contiguous range of a scratch file.
+ * @file    [I/O] Scratch file
+ * @data    [I/O] Buffer
+ * @bytes   [ I ] Number of bytes
+ * @offset  [ I ] Offset within the file
+ * @write   [ I ] Flag to write instead of read
+ */
+static int tiled_transfer(FILE *file, void *data, size_t bytes, off_t offset,
+        int write)
+{
+    ssize_t done; /* Bytes transferred by one call */
+    int fd = fileno(file);
+
+    while (bytes > 0)
+    {
+        done = write ? pwrite(fd, data, bytes, offset)
+            : pread(fd, data, bytes, offset);
+
+        if (done <= 0)
+        {
+            return ASI_EXIT_FAILURE;
+        }
+
+        data = (char *) data + done;
+        bytes -= done;
+        offset += done;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Streams image and mask in bands of rows into the scratch files. Known
+ * pixels hold their values, unknown pixels NaN until their first solve.
+ * @ctx     [I/O] Tiled context
+ * @image   [I/O] Image stream
+ * @mask    [I/O] Mask stream
+ * @budget  [ I ] Memory budget in bytes
+ */
+static int tiled_import(tiled_context_type *ctx, pnm_stream_type *image,
+        pnm_stream_type *mask, size_t budget)
+{
+    int *values, *known; /* Band of the image and the mask */
+    double *u; /* Band of the iterate */
+    unsigned char *m; /* Band of the mask bytes */
+    size_t pixels; /* Pixels of a band */
+    off_t offset; /* Offset of a band */
+    int rows, i, k; /* Rows per band, loop variables */
+    int ret; /* Return value */
+
+    rows = (int) (budget / ((size_t) ctx->width * (2 * sizeof(int)
+                    + sizeof(double) + 1)));
+    rows = rows < 1 ? 1 : (rows > ctx->height ? ctx->height : rows);
+    pixels = (size_t) rows * ctx->width;
+
+    values = (int *) malloc(pixels * sizeof(int));
+    known = (int *) malloc(pixels * sizeof(int));
+    u = (double *) malloc(pixels * sizeof(double));
+    m = (unsigned char *) malloc(pixels);
+
+    ret = values == NULL || known == NULL || u == NULL || m == NULL
+        ? ASI_EXIT_FAILED_ALLOC : ASI_EXIT_SUCCESS;
+
+    for (i = 0; ret == ASI_EXIT_SUCCESS && i < ctx->height; i += rows)
+    {
+        rows = ctx->height - i < rows ? ctx->height - i : rows;
+        pixels = (size_t) rows * ctx->width;
+
+        ret = pnm_stream_read_rows(image, values, rows);
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = pnm_stream_read_rows(mask, known, rows);
+        }
+
+        for (k = 0; ret == ASI_EXIT_SUCCESS && k < (int) pixels; k++)
+        {
+            m[k] = known[k] != 0;
+            u[k] = m[k] ? values[k] : NAN;
+        }
+
+        offset = (off_t) i * ctx->width;
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = tiled_transfer(ctx->u_file, u, pixels * sizeof(double),
+                    offset * (off_t) sizeof(double), 1);
+        }
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = tiled_transfer(ctx->m_file, m, pixels, offset, 1);
+        }
+    }
+
+    free(values);
+    free(known);
+    free(u);
+    free(m);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Streams the iterate in bands of rows from the scratch file into a PNM
+ * file, rounded to integers.
+ * @ctx     [I/O] Tiled context
+ * @output  [I/O] Output stream
+ * @budget  [ I ] Memory budget in bytes
+ */
+static int tiled_export(tiled_context_type *ctx, pnm_stream_type *output,
+        size_t budget)
+{
+    int *values; /* Band of the result */
+    double *u; /* Band of the iterate */
+    size_t pixels; /* Pixels of a band */
+    int rows, i, k; /* Rows per band, loop variables */
+    int ret; /* Return value */
+
+    rows = (int) (budget / ((size_t) ctx->width * (sizeof(int)
+                    + sizeof(double))));
+    rows = rows < 1 ? 1 : (rows > ctx->height ? ctx->height : rows);
+    pixels = (size_t) rows * ctx->width;
+
+    values = (int *) malloc(pixels * sizeof(int));
+    u = (double *) malloc(pixels * sizeof(double));
+
+    ret = values == NULL || u == NULL
+        ? ASI_EXIT_FAILED_ALLOC : ASI_EXIT_SUCCESS;
+
+    for (i = 0; ret == ASI_EXIT_SUCCESS && i < ctx->height; i += rows)
+    {
+        rows = ctx->height - i < rows ? ctx->height - i : rows;
+        pixels = (size_t) rows * ctx->width;
+
+        ret = tiled_transfer(ctx->u_file, u, pixels * sizeof(double),
+                (off_t) i * ctx->width * (off_t) sizeof(double), 0);
+
+        for (k = 0; ret == ASI_EXIT_SUCCESS && k < (int) pixels; k++)
+        {
+            values[k] = isnan(u[k]) ? 0 : (int) floor(u[k] + 0.5);
+        }
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = pnm_stream_write_rows(output, values, rows);
+        }
+    }
+
+    free(values);
+    free(u);
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Fills pixels of a window which have not been solved yet by push-pull
+ * interpolation of the known and already solved pixels.
+ * @ctx     [I/O] Tiled context with the window loaded
+ */
+static int tiled_warm_start(tiled_context_type *ctx)
+{
+    double *u = (double *) ctx->u.data;
+    double *f = (double *) ctx->f.data;
+    double *valid = (double *) ctx->m_s.data;
+    image_type fill; /* Interpolation result */
+    int n, k; /* Number of pixels, loop variable */
+    int missing, present; /* Number of unset and set pixels */
+    int ret; /* Return value */
+
+    n = ctx->u.width * ctx->u.height;
+    missing = 0;
+    present = 0;
+
+    for (k = 0; k < n; k++)
+    {
+        valid[k] = isnan(u[k]) ? 0.0 : 1.0;
+        f[k] = isnan(u[k]) ? 0.0 : u[k];
+        missing += isnan(u[k]) != 0;
+    }
+
+    present = n - missing;
+
+    if (missing == 0)
+    {
+        return ASI_EXIT_SUCCESS;
+    }
+
+    /* Without any information the window starts from zero */
+    if (present == 0)
+    {
+        memset(u, 0, n * sizeof(double));
+        return ASI_EXIT_SUCCESS;
+    }
+
+    fill = ctx->u;
+    fill.data = ctx->r;
+
+    ret = pyramid_push_pull(ctx->f, ctx->m_s, fill);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    for (k = 0; k < n; k++)
+    {
+        if (valid[k] == 0.0)
+        {
+            u[k] = ctx->r[k];
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Solves one tile: loads its window, i.e. the core extended by the overlap
+ * and a ring of boundary data, measures the residual of the core, solves the
+ * window with the ring as known pixels and writes the extended region back.
+ * @ctx        [I/O] Tiled context
+ * @x0, x1     [ I ] Column range of the core
+ * @y0, y1     [ I ] Row range of the core
+ * @residual   [ O ] Squared residual norm of the core before the solve
+ */
+static int tiled_solve_tile(tiled_context_type *ctx, int x0, int x1, int y0,
+        int y1, double *residual)
+{
+    diffusion_operator_type op; /* Operator of the window */
+    double *u = (double *) ctx->u.data;
+    double *m = (double *) ctx->m.data;
+    double *m_s = (double *) ctx->m_s.data;
+    int ex0, ex1, ey0, ey1; /* Extended region */
+    int wx0, wx1, wy0, wy1; /* Window */
+    int ww, wh; /* Window size */
+    int i, j, k; /* Loop variables */
+    off_t offset; /* Pixel offset of a window row */
+    int ret; /* Return value */
+
+    ex0 = x0 - ctx->overlap < 0 ? 0 : x0 - ctx->overlap;
+    ex1 = x1 + ctx->overlap > ctx->width ? ctx->width : x1 + ctx->overlap;
+    ey0 = y0 - ctx->overlap < 0 ? 0 : y0 - ctx->overlap;
+    ey1 = y1 + ctx->overlap > ctx->height ? ctx->height : y1 + ctx->overlap;
+
+    wx0 = ex0 > 0 ? ex0 - 1 : 0;
+    wx1 = ex1 < ctx->width ? ex1 + 1 : ex1;
+    wy0 = ey0 > 0 ? ey0 - 1 : 0;
+    wy1 = ey1 < ctx->height ? ey1 + 1 : ey1;
+
+    ww = wx1 - wx0;
+    wh = wy1 - wy0;
+
+    ctx->u.width = ctx->f.width = ctx->m.width = ctx->m_s.width = ww;
+    ctx->u.height = ctx->f.height = ctx->m.height = ctx->m_s.height = wh;
+
+    for (i = 0; i < wh; i++)
+    {
+        offset = (off_t) (wy0 + i) * ctx->width + wx0;
+
+        if (tiled_transfer(ctx->u_file, u + i * ww, ww * sizeof(double),
+                    offset * (off_t) sizeof(double), 0) != ASI_EXIT_SUCCESS
+                || tiled_transfer(ctx->m_file, ctx->bytes + i * ww, ww,
+                    offset, 0) != ASI_EXIT_SUCCESS)
+        {
+            return ASI_EXIT_FAILURE;
+        }
+    }
+
+    for (k = 0; k < ww * wh; k++)
+    {
+        m[k] = ctx->bytes[k];
+    }
+
+    ret = tiled_warm_start(ctx);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    /* Residual of the core with the current boundary data */
+    ret = diffusion_operator_init(&op, ctx->m);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    diffusion_operator_residual(op, u, u, ctx->r, 0, wh);
+    diffusion_operator_delete(&op);
+
+    *residual = 0.0;
+
+    for (i = y0 - wy0; i < y1 - wy0; i++)
+    {
+        for (j = x0 - wx0; j < x1 - wx0; j++)
+        {
+            *residual += ctx->r[i * ww + j] * ctx->r[i * ww + j];
+        }
+    }
+
+    /* The ring around the extended region is known boundary data */
+    for (i = 0; i < wh; i++)
+    {
+        for (j = 0; j < ww; j++)
+        {
+            k = i * ww + j;
+            m_s[k] = wy0 + i < ey0 || wy0 + i >= ey1 || wx0 + j < ex0
+                || wx0 + j >= ex1 ? 1.0 : m[k];
+        }
+    }
+
+    memcpy(ctx->f.data, u, ww * wh * sizeof(double));
+
+    ctx->transferred = (double) ww * wh * (sizeof(double) + 1)
+        + (double) (ex1 - ex0) * (ey1 - ey0) * sizeof(double);
+
+    ret = schwarz_inpainting(ctx->f, ctx->m_s, ctx->u, *ctx->solver, NULL);
+
+    if (ret != ASI_EXIT_SUCCESS && ret != ASI_EXIT_NOT_CONVERGED)
+    {
+        return ret;
+    }
+
+    for (i = ey0 - wy0; i < ey1 - wy0; i++)
+    {
+        offset = (off_t) (wy0 + i) * ctx->width + ex0;
+
+        if (tiled_transfer(ctx->u_file, u + i * ww + ex0 - wx0,
+                    (ex1 - ex0) * sizeof(double),
+                    offset * (off_t) sizeof(double), 1) != ASI_EXIT_SUCCESS)
+        {
+            return ASI_EXIT_FAILURE;
+        }
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Homogeneous diffusion inpainting of greyscale PNM files that do not fit
+ * into memory. Image and mask are streamed in bands of rows into scratch
+ * files, the image is solved in overlapping tiles with multiplicative
+ * Schwarz sweeps, only one tile window being resident at a time, and the
+ * result is streamed into the output file. The tile size follows from the
+ * memory budget, so peak memory is independent of the image size. Tiles
+ * are warm-started by push-pull interpolation on their first visit. The
+ * residual of a sweep is accumulated over the tile cores just before each
+ * tile is solved.
+ * @image_file  [ I ] Greyscale PNM file of the known values
+ * @mask_file   [ I ] Greyscale PNM file of the mask, non-zero for known
+ * @output_file [ I ] PNM file of the result
+ * @params      [ I ] Parameters
+ * @info        [ O ] Convergence information, may be NULL
+ */
+int tiled_inpainting(const char *image_file, const char *mask_file,
+        const char *output_file, const tiled_params_type params,
+        tiled_info_type *info)
+{
+    tiled_context_type ctx; /* Shared state */
+    pnm_stream_type image, mask, output; /* Streams */
+    telemetry_record_type record; /* Telemetry record */
+    double start, sweep_start; /* Start times of a tile and a sweep */
+    double sum, res, res_0; /* Residual norms */
+    double tile_res = 0.0; /* Squared residual of a tile core */
+    int side, tile; /* Window and core edge length */
+    int nx, ny, tx, ty; /* Tile grid and loop variables */
+    int sweep; /* Loop variable */
+    int ret; /* Return value */
+
+    if (params.overlap < 0 || params.max_sweeps < 0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    side = (int) sqrt((double) params.memory_bytes / TILED_BYTES_PER_PIXEL);
+    tile = side - 2 * (params.overlap + 1);
+
+    if (tile < TILED_MIN_TILE)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    ret = pnm_stream_open(&image, image_file);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        return ret;
+    }
+
+    ret = pnm_stream_open(&mask, mask_file);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        pnm_stream_close(&image);
+        return ret;
+    }
+
+    if (image.header.width != mask.header.width
+            || image.header.height != mask.header.height)
+    {
+        pnm_stream_close(&image);
+        pnm_stream_close(&mask);
+        return ASI_EXIT_IMG_DIM_MISMATCH;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.width = image.header.width;
+    ctx.height = image.header.height;
+    ctx.overlap = params.overlap;
+    ctx.solver = &params.tile;
+
+    ctx.u_file = tiled_scratch(params.scratch_dir);
+    ctx.m_file = tiled_scratch(params.scratch_dir);
+
+    if (ctx.u_file == NULL || ctx.m_file == NULL)
+    {
+        ret = ASI_EXIT_FILE_OPEN_FAILED;
+    }
+    else
+    {
+        ret = tiled_import(&ctx, &image, &mask, params.memory_bytes);
+    }
+
+    pnm_stream_close(&mask);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        pnm_stream_close(&image);
+        goto cleanup;
+    }
+
+    /* Even split into tiles of at most the budgeted size */
+    nx = (ctx.width + tile - 1) / tile;
+    ny = (ctx.height + tile - 1) / tile;
+
+    if (image_init(&ctx.u, side, side, ASI_DTYPE_DOUBLE) != ASI_EXIT_SUCCESS
+            || image_init(&ctx.f, side, side, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS
+            || image_init(&ctx.m, side, side, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS
+            || image_init(&ctx.m_s, side, side, ASI_DTYPE_DOUBLE)
+            != ASI_EXIT_SUCCESS)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+    }
+
+    ctx.r = (double *) malloc((size_t) side * side * sizeof(double));
+    ctx.bytes = (unsigned char *) malloc((size_t) side * side);
+
+    if (ctx.r == NULL || ctx.bytes == NULL)
+    {
+        ret = ASI_EXIT_FAILED_ALLOC;
+    }
+
+    res = 1.0;
+    res_0 = 0.0;
+
+    for (sweep = 0; ret == ASI_EXIT_SUCCESS && sweep < params.max_sweeps
+            && res > params.eps; sweep++)
+    {
+        sum = 0.0;
+        sweep_start = telemetry_time();
+
+        for (ty = 0; ret == ASI_EXIT_SUCCESS && ty < ny; ty++)
+        {
+            for (tx = 0; ret == ASI_EXIT_SUCCESS && tx < nx; tx++)
+            {
+                start = telemetry_time();
+                ret = tiled_solve_tile(&ctx,
+                        (int) ((long) tx * ctx.width / nx),
+                        (int) ((long) (tx + 1) * ctx.width / nx),
+                        (int) ((long) ty * ctx.height / ny),
+                        (int) ((long) (ty + 1) * ctx.height / ny),
+                        &tile_res);
+                sum += tile_res;
+
+                if (params.telemetry != NULL && ret == ASI_EXIT_SUCCESS)
+                {
+                    record = telemetry_record(ASI_TELEMETRY_SUBDOMAIN,
+                            "tiled");
+                    record.iteration = sweep + 1;
+                    record.subdomain = ty * nx + tx;
+                    record.seconds = telemetry_time() - start;
+                    record.bytes = ctx.transferred;
+                    telemetry_emit(params.telemetry, &record);
+                }
+            }
+        }
+
+        if (sweep == 0)
+        {
+            res_0 = sqrt(sum);
+        }
+
+        res = res_0 > 0.0 ? sqrt(sum) / res_0 : 0.0;
+
+        if (params.telemetry != NULL && ret == ASI_EXIT_SUCCESS)
+        {
+            record = telemetry_record(ASI_TELEMETRY_ITERATION, "tiled");
+            record.iteration = sweep + 1;
+            record.residual = res;
+            record.seconds = telemetry_time() - sweep_start;
+            telemetry_emit(params.telemetry, &record);
+        }
+    }
+
+    /* Free tile memory before streaming the result */
+    image_delete(&ctx.u);
+    image_delete(&ctx.f);
+    image_delete(&ctx.m);
+    image_delete(&ctx.m_s);
+    free(ctx.r);
+    free(ctx.bytes);
+
+    if (ret == ASI_EXIT_SUCCESS)
+    {
+        ret = pnm_stream_create(&output, output_file, ctx.width, ctx.height,
+                image.header.data_depth, params.binary_mode);
+
+        if (ret == ASI_EXIT_SUCCESS)
+        {
+            ret = tiled_export(&ctx, &output, params.memory_bytes);
+
+            if (pnm_stream_close(&output) != ASI_EXIT_SUCCESS
+                    && ret == ASI_EXIT_SUCCESS)
+            {
+                ret = ASI_EXIT_FAILURE;
+            }
+        }
+    }
+
+    pnm_stream_close(&image);
+
+    if (info != NULL)
+    {
+        info->sweeps = sweep;
+        info->residual = res;
+        info->tile_size = tile;
+        info->num_tiles = nx * ny;
+    }
+
+    if (ret == ASI_EXIT_SUCCESS && res > params.eps)
+    {
+        ret = ASI_EXIT_NOT_CONVERGED;
+    }
+
+cleanup:
+    if (ctx.u_file != NULL)
+    {
+        fclose(ctx.u_file);
+    }
+    if (ctx.m_file != NULL)
+    {
+        fclose(ctx.m_file);
+    }
+
+    return ret;
+}
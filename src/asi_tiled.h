@@ -0,0 +1,37 @@
+#ifndef _ASI_TILED_H_
+#define _ASI_TILED_H_
+
+#include <stddef.h>
+#include "asi_schwarz.h"
+
+/* Parameters of out-of-core tiled inpainting */
+typedef struct tiled_params
+{
+    size_t memory_bytes; /* Budget of resident data in bytes */
+    int overlap; /* Overlap of neighbouring tiles in pixels */
+    int max_sweeps; /* Maximum number of sweeps over all tiles */
+    double eps; /* Relative residual tolerance */
+    int binary_mode; /* Flag to write the result as P5 instead of P2 */
+    const char *scratch_dir; /* Directory of scratch files, NULL for tmp */
+    schwarz_params_type tile; /* Solver of a single tile */
+    telemetry_type *telemetry; /* Sweep and tile records, or NULL */
+} tiled_params_type;
+
+/* Convergence information of a tiled solve */
+typedef struct tiled_info
+{
+    int sweeps; /* Number of performed sweeps */
+    double residual; /* Final residual norm relative to the initial one */
+    int tile_size; /* Edge length of the tile cores */
+    int num_tiles; /* Number of tiles */
+} tiled_info_type;
+
+/* Default parameters */
+void tiled_params_default(tiled_params_type *params);
+
+/* Inpainting of PNM files larger than memory in overlapping tiles */
+int tiled_inpainting(const char *image_file, const char *mask_file,
+        const char *output_file, const tiled_params_type params,
+        tiled_info_type *info);
+
+#endif
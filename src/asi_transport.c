@@ -0,0 +1,459 @@
+#include "asi_transport.h"
+#include "asi_image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Alignment of the data area within a shared-memory segment */
+#define SHM_ALIGNMENT 64
+
+/* Header at the start of a shared-memory segment */
+typedef struct shm_header
+{
+    pthread_barrier_t barrier; /* Process-shared barrier of all ranks */
+    int size; /* Number of processes */
+    int capacity; /* Number of values per exchange slot */
+} shm_header_type;
+
+/* Mapping of a shared-memory segment within one process */
+typedef struct shm_transport
+{
+    shm_header_type *header; /* Segment header */
+    double *reduce; /* Reduction values, one block per rank */
+    double *slots; /* Exchange slots, one towards each neighbour per rank */
+    size_t bytes; /* Mapped size */
+} shm_transport_type;
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Offset of the data area and total size of a segment.
+ * @size     [ I ] Number of processes
+ * @capacity [ I ] Number of values per exchange slot
+ * @offset   [ O ] Offset of the data area in bytes
+ */
+static size_t shm_segment_bytes(int size, int capacity, size_t *offset)
+{
+    *offset = (sizeof(shm_header_type) + SHM_ALIGNMENT - 1)
+        / SHM_ALIGNMENT * SHM_ALIGNMENT;
+
+    return *offset + ((size_t) size * ASI_TRANSPORT_MAX_REDUCE
+            + 2 * (size_t) size * capacity) * sizeof(double);
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Creates a named POSIX shared-memory segment with a process-shared barrier.
+ * The segment must be created once before the processes attach to it, e.g.
+ * by the parent of forked processes or by a launcher script. Processes
+ * started independently can be pinned to NUMA nodes before attaching.
+ * @name     [ I ] Segment name starting with a slash
+ * @size     [ I ] Number of processes
+ * @capacity [ I ] Maximum number of values of one exchange
+ */
+int transport_shm_create(const char *name, int size, int capacity)
+{
+    shm_header_type *header; /* Segment header */
+    pthread_barrierattr_t attr; /* Barrier attributes */
+    size_t bytes, offset; /* Segment size, data offset */
+    int fd; /* File descriptor */
+    int ret; /* Return value */
+
+    if (size < 1 || capacity < 0)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    bytes = shm_segment_bytes(size, capacity, &offset);
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+    if (fd < 0)
+    {
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    if (ftruncate(fd, bytes) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    header = (shm_header_type *) mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (header == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    header->size = size;
+    header->capacity = capacity;
+
+    ret = ASI_EXIT_SUCCESS;
+    pthread_barrierattr_init(&attr);
+
+    if (pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0
+            || pthread_barrier_init(&header->barrier, &attr, size) != 0)
+    {
+        ret = ASI_EXIT_FAILURE;
+    }
+
+    pthread_barrierattr_destroy(&attr);
+    munmap(header, bytes);
+
+    if (ret != ASI_EXIT_SUCCESS)
+    {
+        shm_unlink(name);
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Removes the name of a shared-memory segment. Attached processes keep
+ * their mapping until they delete their transport.
+ * @name    [ I ] Segment name
+ */
+int transport_shm_unlink(const char *name)
+{
+    return shm_unlink(name) == 0 ? ASI_EXIT_SUCCESS : ASI_EXIT_FAILURE;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Neighbour exchange through shared memory: every rank writes its outgoing
+ * strips into its own slots and, after a barrier, reads the neighbours'
+ * slots. A second barrier keeps slots from being overwritten by the next
+ * exchange before they are read.
+ * @t         [ I ] Transport
+ * @send_prev [ I ] Values sent to the previous rank
+ * @recv_prev [ O ] Values received from the previous rank
+ * @send_next [ I ] Values sent to the next rank
+ * @recv_next [ O ] Values received from the next rank
+ * @count     [ I ] Number of values in each direction
+ */
+static int shm_exchange(const transport_type *t, const double *send_prev,
+        double *recv_prev, const double *send_next, double *recv_next,
+        int count)
+{
+    const shm_transport_type *shm = (const shm_transport_type *) t->data;
+    size_t cap; /* Slot capacity */
+    double *own; /* Slots of this rank */
+
+    cap = shm->header->capacity;
+
+    if (count > shm->header->capacity)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    own = shm->slots + 2 * cap * t->rank;
+
+    if (t->rank > 0)
+    {
+        memcpy(own, send_prev, count * sizeof(double));
+    }
+    if (t->rank < t->size - 1)
+    {
+        memcpy(own + cap, send_next, count * sizeof(double));
+    }
+
+    pthread_barrier_wait(&shm->header->barrier);
+
+    /* Slot of the previous rank towards its next, i.e. this rank */
+    if (t->rank > 0)
+    {
+        memcpy(recv_prev, own - cap, count * sizeof(double));
+    }
+    if (t->rank < t->size - 1)
+    {
+        memcpy(recv_next, own + 2 * cap, count * sizeof(double));
+    }
+
+    pthread_barrier_wait(&shm->header->barrier);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reduction through shared memory. Every rank combines the contributions in
+ * rank order, so all ranks obtain bitwise identical results.
+ * @t       [ I ] Transport
+ * @values  [I/O] Contribution on input, reduced values on output
+ * @count   [ I ] Number of values, at most ASI_TRANSPORT_MAX_REDUCE
+ * @op      [ I ] Reduction operation
+ */
+static int shm_allreduce(const transport_type *t, double *values, int count,
+        transport_reduce_enum op)
+{
+    const shm_transport_type *shm = (const shm_transport_type *) t->data;
+    const double *block; /* Contribution of a rank */
+    int r, k; /* Loop variables */
+
+    if (count > ASI_TRANSPORT_MAX_REDUCE)
+    {
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    memcpy(shm->reduce + ASI_TRANSPORT_MAX_REDUCE * t->rank, values,
+            count * sizeof(double));
+
+    pthread_barrier_wait(&shm->header->barrier);
+
+    for (k = 0; k < count; k++)
+    {
+        values[k] = shm->reduce[k];
+    }
+
+    for (r = 1; r < t->size; r++)
+    {
+        block = shm->reduce + ASI_TRANSPORT_MAX_REDUCE * r;
+
+        for (k = 0; k < count; k++)
+        {
+            if (op == ASI_REDUCE_SUM)
+            {
+                values[k] += block[k];
+            }
+            else if (block[k] > values[k])
+            {
+                values[k] = block[k];
+            }
+        }
+    }
+
+    pthread_barrier_wait(&shm->header->barrier);
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Unmaps a shared-memory segment.
+ * @t       [I/O] Transport
+ */
+static void shm_close(transport_type *t)
+{
+    shm_transport_type *shm = (shm_transport_type *) t->data;
+
+    munmap(shm->header, shm->bytes);
+    free(shm);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Attaches to a shared-memory segment created by transport_shm_create.
+ * @t       [ O ] Transport
+ * @name    [ I ] Segment name
+ * @rank    [ I ] Rank of this process
+ */
+int transport_init_shm(transport_type *t, const char *name, int rank)
+{
+    shm_transport_type *shm; /* Backend data */
+    struct stat st; /* Segment status */
+    size_t offset; /* Offset of the data area */
+    void *base; /* Mapped segment */
+    int fd; /* File descriptor */
+
+    memset(t, 0, sizeof(transport_type));
+
+    fd = shm_open(name, O_RDWR, 0600);
+
+    if (fd < 0)
+    {
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return ASI_EXIT_FILE_OPEN_FAILED;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    shm = (shm_transport_type *) malloc(sizeof(shm_transport_type));
+
+    if (shm == NULL)
+    {
+        munmap(base, st.st_size);
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    shm->header = (shm_header_type *) base;
+    shm->bytes = st.st_size;
+
+    if (rank < 0 || rank >= shm->header->size
+            || shm_segment_bytes(shm->header->size, shm->header->capacity,
+                &offset) > shm->bytes)
+    {
+        munmap(base, st.st_size);
+        free(shm);
+        return ASI_EXIT_INVALID_VALUE;
+    }
+
+    shm->reduce = (double *) ((char *) base + offset);
+    shm->slots = shm->reduce
+        + (size_t) shm->header->size * ASI_TRANSPORT_MAX_REDUCE;
+
+    t->exchange = shm_exchange;
+    t->allreduce = shm_allreduce;
+    t->close = shm_close;
+    t->rank = rank;
+    t->size = shm->header->size;
+    t->data = shm;
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+#ifdef ASI_USE_MPI
+
+/*
+ * Neighbour exchange with MPI, ranks at the ends talk to MPI_PROC_NULL.
+ * @t         [ I ] Transport
+ * @send_prev [ I ] Values sent to the previous rank
+ * @recv_prev [ O ] Values received from the previous rank
+ * @send_next [ I ] Values sent to the next rank
+ * @recv_next [ O ] Values received from the next rank
+ * @count     [ I ] Number of values in each direction
+ */
+static int mpi_exchange(const transport_type *t, const double *send_prev,
+        double *recv_prev, const double *send_next, double *recv_next,
+        int count)
+{
+    MPI_Comm comm = *(const MPI_Comm *) t->data;
+    int prev, next; /* Neighbour ranks */
+
+    prev = t->rank > 0 ? t->rank - 1 : MPI_PROC_NULL;
+    next = t->rank < t->size - 1 ? t->rank + 1 : MPI_PROC_NULL;
+
+    /* Shift towards the next rank, then towards the previous one */
+    if (MPI_Sendrecv(send_next, count, MPI_DOUBLE, next, 0, recv_prev,
+                count, MPI_DOUBLE, prev, 0, comm, MPI_STATUS_IGNORE)
+            != MPI_SUCCESS
+            || MPI_Sendrecv(send_prev, count, MPI_DOUBLE, prev, 1, recv_next,
+                count, MPI_DOUBLE, next, 1, comm, MPI_STATUS_IGNORE)
+            != MPI_SUCCESS)
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Reduction with MPI.
+ * @t       [ I ] Transport
+ * @values  [I/O] Contribution on input, reduced values on output
+ * @count   [ I ] Number of values
+ * @op      [ I ] Reduction operation
+ */
+static int mpi_allreduce(const transport_type *t, double *values, int count,
+        transport_reduce_enum op)
+{
+    MPI_Comm comm = *(const MPI_Comm *) t->data;
+
+    if (MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_DOUBLE,
+                op == ASI_REDUCE_SUM ? MPI_SUM : MPI_MAX, comm)
+            != MPI_SUCCESS)
+    {
+        return ASI_EXIT_FAILURE;
+    }
+
+    return ASI_EXIT_SUCCESS;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Frees the communicator copy.
+ * @t       [I/O] Transport
+ */
+static void mpi_close(transport_type *t)
+{
+    free(t->data);
+
+    return;
+}
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Initialises an MPI transport. MPI must be initialised by the caller, the
+ * communicator needs to outlive the transport.
+ * @t       [ O ] Transport
+ * @comm    [ I ] Communicator
+ */
+int transport_init_mpi(transport_type *t, MPI_Comm comm)
+{
+    MPI_Comm *data; /* Communicator copy */
+
+    memset(t, 0, sizeof(transport_type));
+
+    data = (MPI_Comm *) malloc(sizeof(MPI_Comm));
+
+    if (data == NULL)
+    {
+        return ASI_EXIT_FAILED_ALLOC;
+    }
+
+    *data = comm;
+    MPI_Comm_rank(comm, &t->rank);
+    MPI_Comm_size(comm, &t->size);
+
+    t->exchange = mpi_exchange;
+    t->allreduce = mpi_allreduce;
+    t->close = mpi_close;
+    t->data = data;
+
+    return ASI_EXIT_SUCCESS;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------*/
+
+/*
+ * Releases a transport of any backend.
+ * @t       [I/O] Transport
+ */
+void transport_delete(transport_type *t)
+{
+    if (t->close != NULL)
+    {
+        t->close(t);
+    }
+
+    t->close = NULL;
+    t->data = NULL;
+
+    return;
+}
@@ -0,0 +1,57 @@
+#ifndef _ASI_TRANSPORT_H_
+#define _ASI_TRANSPORT_H_
+
+#ifdef ASI_USE_MPI
+#include <mpi.h>
+#endif
+
+/* Maximum number of values of one shared-memory reduction */
+#define ASI_TRANSPORT_MAX_REDUCE 8
+
+/* Supported reduction operations */
+typedef enum transport_reduce
+{
+    ASI_REDUCE_SUM,
+    ASI_REDUCE_MAX
+} transport_reduce_enum;
+
+/*
+ * Communication between the processes of a distributed solve, which are
+ * arranged in a chain of ranks. Backends provide the neighbour exchange of
+ * halo data and global reductions; all processes call every operation
+ * collectively.
+ */
+typedef struct transport
+{
+    /* Send to and receive from the previous and next rank, count values */
+    int (*exchange)(const struct transport *t, const double *send_prev,
+        double *recv_prev, const double *send_next, double *recv_next,
+        int count);
+    /* In-place reduction of count values over all ranks */
+    int (*allreduce)(const struct transport *t, double *values, int count,
+        transport_reduce_enum op);
+    /* Release backend resources */
+    void (*close)(struct transport *t);
+    int rank; /* Rank of this process */
+    int size; /* Number of processes */
+    void *data; /* Backend data */
+} transport_type;
+
+/* Create a named shared-memory segment for size processes */
+int transport_shm_create(const char *name, int size, int capacity);
+
+/* Remove a named shared-memory segment */
+int transport_shm_unlink(const char *name);
+
+/* Attach to a shared-memory segment as the given rank */
+int transport_init_shm(transport_type *t, const char *name, int rank);
+
+#ifdef ASI_USE_MPI
+/* Use an MPI communicator, ranks follow the communicator */
+int transport_init_mpi(transport_type *t, MPI_Comm comm);
+#endif
+
+/* Release the transport */
+void transport_delete(transport_type *t);
+
+#endif